@@ -30,6 +30,7 @@ int main()
   ui::theme.head_font = TX_02;
   ui::theme.body_font = TX_02;
   ui::theme.icon_font = CupertinoIcons;
+  ui::theme.body_font_fallbacks.extend(span({Roboto, Amiri})).unwrap();
 
   ui::Flex flex;
 
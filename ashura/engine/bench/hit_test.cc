@@ -0,0 +1,137 @@
+/// SPDX-License-Identifier: MIT
+#include "ashura/engine/view_system.h"
+#include "ashura/std/async.h"
+#include "ashura/std/types.h"
+#include <benchmark/benchmark.h>
+#include <thread>
+
+using namespace ash;
+
+constexpr f32x2 VIEWPORT = {1'920, 1'080};
+
+constexpr f32x2 CELL = {120, 24};
+
+constexpr u32 COLUMNS = 16;
+
+/// @brief a laid-out table of `n` cells scrolled to its top, the rows below the
+/// viewport are culled
+struct Table
+{
+  Dyn<Scheduler> sched;
+  ui::View       cell;
+  IViewSys       sys;
+
+  explicit Table(u16 n) :
+    sched{IScheduler::create(
+      SchedulerInfo{.allocator      = default_allocator,
+                    .main_thread_id = std::this_thread::get_id()})},
+    cell{},
+    sys{default_allocator}
+  {
+    hook_scheduler(sched);
+    sys.push_view(sys.root_view, 0, 0, RootView::PARENT);
+
+    for (u16 i = 0; i < n; i++)
+    {
+      sys.push_view(cell, 1, i, RootView::NODE);
+    }
+
+    u16 const total = size16(sys.views);
+    sys.prepare_for(total);
+    sys.viewport_extent = VIEWPORT;
+
+    for (u16 i = 0; i < total; i++)
+    {
+      sys.nodes.children[i] = CoreSlice<ViewIdx>{};
+      sys.att.viewports[i]  = RootView::VIEWPORT;
+      sys.att.concealed.set(i, false);
+      sys.att.hidden.set(i, false);
+    }
+
+    sys.nodes.children[RootView::NODE] = CoreSlice<ViewIdx>{1, n};
+    sys.canvas_centers[RootView::NODE] = f32x2::splat(0);
+    sys.canvas_extents[RootView::NODE] = VIEWPORT;
+    sys.clips[RootView::NODE] = CRect{.center = {}, .extent = VIEWPORT};
+
+    for (u16 i = 0; i < n; i++)
+    {
+      f32x2 const pos{(f32) (i % COLUMNS), (f32) (i / COLUMNS)};
+      sys.canvas_centers[1 + i] = -0.5F * VIEWPORT + (pos + 0.5F) * CELL;
+      sys.canvas_extents[1 + i] = CELL;
+    }
+
+    iota(sys.z_ord.view(), 0U);
+    sys.visibility();
+    sys.index();
+  }
+
+  ~Table()
+  {
+    sched->shutdown();
+    hook_scheduler(nullptr);
+  }
+};
+
+/// @brief pseudo-random pointer positions within the viewport
+struct Pointer
+{
+  u32 seed = 1;
+
+  f32x2 next()
+  {
+    seed = seed * 1'664'525U + 1'013'904'223U;
+    f32 const x = (f32) ((seed >> 8) & 0xFFFF) / 0xFFFF;
+    seed = seed * 1'664'525U + 1'013'904'223U;
+    f32 const y = (f32) ((seed >> 8) & 0xFFFF) / 0xFFFF;
+    return (f32x2{x, y} - 0.5F) * VIEWPORT;
+  }
+};
+
+static void BM_HitTest(benchmark::State & state)
+{
+  Table   table{(u16) state.range(0)};
+  Pointer pointer;
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(table.sys.hit_test(pointer.next()));
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief baseline: testing all the views in reverse z-order
+static void BM_HitTestScan(benchmark::State & state)
+{
+  Table   table{(u16) state.range(0)};
+  Pointer pointer;
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(table.sys.scan_hit(pointer.next()));
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief cost of building the grid after a layout
+static void BM_HitTestIndex(benchmark::State & state)
+{
+  Table table{(u16) state.range(0)};
+
+  for (auto _ : state)
+  {
+    table.sys.index();
+    benchmark::DoNotOptimize(table.sys.grid.entries.size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_HitTest)->Arg(1'000)->Arg(10'000)->Arg(60'000);
+BENCHMARK(BM_HitTestScan)->Arg(1'000)->Arg(10'000)->Arg(60'000);
+BENCHMARK(BM_HitTestIndex)
+  ->Arg(1'000)
+  ->Arg(10'000)
+  ->Arg(60'000)
+  ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,147 @@
+/// SPDX-License-Identifier: MIT
+#include "ashura/engine/font_system_impl.h"
+#include "ashura/std/fs.h"
+#include "ashura/std/types.h"
+#include <benchmark/benchmark.h>
+
+using namespace ash;
+
+constexpr Str FONT_PATH = "assets/fonts/Roboto/Roboto-Regular.ttf"_str;
+
+constexpr Str32 PARAGRAPH =
+  U"The quick brown fox jumps over the lazy dog. Pack my box with five dozen "
+  U"liquor jugs. How vexingly quick daft zebras jump!"_str;
+
+constexpr f32 MAX_WIDTH = 720;
+
+struct Document
+{
+  Dyn<FontSys> sys;
+  FontId       font;
+  Vec<c32>     text;
+  TextLayout   layout;
+
+  /// @param size number of codepoints in the document
+  explicit Document(usize size) :
+    sys{IFontSys::create(default_allocator)},
+    font{FontId::None},
+    text{default_allocator},
+    layout{default_allocator}
+  {
+    FontSysImpl & impl = (FontSysImpl &) *sys;
+
+    Vec<u8> encoded{default_allocator};
+    read_file(FONT_PATH, encoded).unwrap();
+
+    font = FontId{
+      impl.fonts_.push(impl.decode_(FONT_PATH, encoded).unwrap()).unwrap()};
+
+    while (text.size() < size)
+    {
+      text.extend(PARAGRAPH).unwrap();
+      text.push(U'\n').unwrap();
+    }
+  }
+
+  void layout_text(TextEdit edit = {})
+  {
+    FontStyle const fonts[] = {{.font = font}};
+    usize const     runs[]  = {0, USIZE_MAX};
+
+    sys->layout_text(
+      TextBlock{.text = text.view(), .runs = span(runs), .fonts = span(fonts)},
+      MAX_WIDTH, layout, edit);
+  }
+};
+
+/// @brief type and delete a codepoint at `caret` alternately, re-laying out
+/// the document after each keystroke so its size stays constant
+static void keystrokes(benchmark::State & state, Document & doc, usize caret)
+{
+  bool inserted = false;
+
+  for (auto _ : state)
+  {
+    usize const size = doc.text.size();
+
+    if (inserted)
+    {
+      doc.text.erase(caret, 1);
+    }
+    else
+    {
+      doc.text.insert(caret, U'x').unwrap();
+    }
+    inserted = !inserted;
+
+    doc.layout_text(
+      TextEdit{.first = caret, .tail = size - caret - (inserted ? 0 : 1)});
+    benchmark::DoNotOptimize(doc.layout.extent);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief latency of re-laying out the document after a keystroke in its
+/// middle paragraph, for documents of `range(0)` KiB of codepoints
+static void BM_TextLayoutKeystroke(benchmark::State & state)
+{
+  Document doc{(usize) state.range(0) << 10};
+  doc.layout_text();
+  keystrokes(state, doc, doc.text.size() / 2);
+}
+
+/// @brief latency of re-laying out the document after a keystroke in its
+/// first paragraph, for documents of `range(0)` KiB of codepoints. All the
+/// paragraphs after it are moved within the layout.
+static void BM_TextLayoutKeystrokeStart(benchmark::State & state)
+{
+  Document doc{(usize) state.range(0) << 10};
+  doc.layout_text();
+  keystrokes(state, doc, PARAGRAPH.size() / 2);
+}
+
+/// @brief baseline: latency of laying out the entire document after a
+/// keystroke, the shaped runs are still cached
+static void BM_TextLayoutKeystrokeFull(benchmark::State & state)
+{
+  Document doc{(usize) state.range(0) << 10};
+  doc.layout_text();
+
+  usize const caret    = doc.text.size() / 2;
+  bool        inserted = false;
+
+  for (auto _ : state)
+  {
+    if (inserted)
+    {
+      doc.text.erase(caret, 1);
+    }
+    else
+    {
+      doc.text.insert(caret, U'x').unwrap();
+    }
+    inserted = !inserted;
+
+    doc.layout.clear();
+    doc.layout_text();
+    benchmark::DoNotOptimize(doc.layout.extent);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_TextLayoutKeystroke)
+  ->RangeMultiplier(4)
+  ->Range(1, 256)
+  ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_TextLayoutKeystrokeStart)
+  ->RangeMultiplier(4)
+  ->Range(1, 1024)
+  ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_TextLayoutKeystrokeFull)
+  ->RangeMultiplier(4)
+  ->Range(1, 256)
+  ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,257 @@
+/// SPDX-License-Identifier: MIT
+#include "ashura/engine/view_system.h"
+#include "ashura/std/async.h"
+#include "ashura/std/time.h"
+#include "ashura/std/types.h"
+#include <benchmark/benchmark.h>
+#include <thread>
+
+using namespace ash;
+
+constexpr f32x2 VIEWPORT = {1'920, 1'080};
+
+constexpr f32x2 CELL = {120, 24};
+
+constexpr u32 COLUMNS = 16;
+
+/// @brief max sleep times of the scheduler's worker threads, the benchmark
+/// thread takes part in the layout as the 8th
+constexpr nanoseconds WORKER_SLEEP[] = {1ms, 1ms, 1ms, 1ms, 1ms, 1ms, 1ms};
+
+/// @brief a row of `COLUMNS` cells, the same cell view is built repeatedly
+struct Row : ui::View
+{
+  ui::View & cell;
+
+  explicit Row(ui::View & cell) : cell{cell}
+  {
+    retained_   = true;
+    concurrent_ = true;
+  }
+
+  virtual ui::State tick(ui::Ctx const &, ui::Events const &,
+                         Fn<void(ui::View &)> build) override
+  {
+    for (u32 i = 0; i < COLUMNS; i++)
+    {
+      build(cell);
+    }
+    return {};
+  }
+
+  virtual void size(f32x2, Span<f32x2> sizes) override
+  {
+    fill(sizes, CELL);
+  }
+
+  virtual ui::Layout fit(f32x2, Span<f32x2 const>,
+                         Span<f32x2> centers) override
+  {
+    for (usize i = 0; i < centers.size(); i++)
+    {
+      centers[i] = f32x2{((f32) i + 0.5F - COLUMNS * 0.5F) * CELL.x(), 0};
+    }
+    return ui::Layout{
+      .extent = f32x2{COLUMNS * CELL.x(), CELL.y()}
+    };
+  }
+};
+
+/// @brief a column of `rows` rows
+struct Table : ui::View
+{
+  Row & row;
+  u32   rows;
+
+  Table(Row & row, u32 rows) : row{row}, rows{rows}
+  {
+    retained_   = true;
+    concurrent_ = true;
+  }
+
+  virtual ui::State tick(ui::Ctx const &, ui::Events const &,
+                         Fn<void(ui::View &)> build) override
+  {
+    for (u32 i = 0; i < rows; i++)
+    {
+      build(row);
+    }
+    return ui::State{.viewport = true};
+  }
+
+  virtual void size(f32x2, Span<f32x2> sizes) override
+  {
+    fill(sizes, f32x2{COLUMNS * CELL.x(), CELL.y()});
+  }
+
+  virtual ui::Layout fit(f32x2 allocated, Span<f32x2 const>,
+                         Span<f32x2> centers) override
+  {
+    f32 const height = rows * CELL.y();
+    for (usize i = 0; i < centers.size(); i++)
+    {
+      centers[i] = f32x2{0, ((f32) i + 0.5F) * CELL.y() - height * 0.5F};
+    }
+    return ui::Layout{
+      .extent          = allocated,
+      .viewport_extent = f32x2{COLUMNS * CELL.x(), height},
+      .viewport_center = f32x2{0, (VIEWPORT.y() - height) * 0.5F}
+    };
+  }
+};
+
+/// @brief a table of about `n` views, indexed with u32 as it can exceed the
+/// u16 limit
+struct Tree
+{
+  Dyn<Scheduler> sched;
+  ui::View       cell;
+  Row            row;
+  Table          table;
+  IViewSysT<u32> sys;
+  InputState     input;
+
+  explicit Tree(u32 n) :
+    sched{IScheduler::create(
+      SchedulerInfo{.allocator           = default_allocator,
+                    .worker_thread_sleep = span(WORKER_SLEEP),
+                    .main_thread_id      = std::this_thread::get_id()})},
+    cell{},
+    row{cell},
+    table{row, max(n / (COLUMNS + 1), 1U)},
+    sys{default_allocator},
+    input{default_allocator}
+  {
+    hook_scheduler(sched);
+    cell.retained_      = true;
+    cell.concurrent_    = true;
+    sys.root_view.next_ = table;
+    input.window.extent = VIEWPORT.to<u32>();
+    rebuild();
+    relayout();
+  }
+
+  ~Tree()
+  {
+    sched->shutdown();
+    hook_scheduler(nullptr);
+  }
+
+  void rebuild()
+  {
+    sys.clear_frame();
+    sys.build(sys.ctx, sys.root_view);
+    sys.prepare_for((u32) sys.views.size());
+  }
+
+  void relayout()
+  {
+    sys.viewport_extent = VIEWPORT;
+    sys.focus_order();
+    sys.layout(VIEWPORT);
+    sys.stack();
+    sys.visibility();
+    sys.index();
+    sys.occlusion();
+  }
+};
+
+static void BM_ViewBuild(benchmark::State & state)
+{
+  Tree tree{(u32) state.range(0)};
+
+  for (auto _ : state)
+  {
+    tree.rebuild();
+    benchmark::DoNotOptimize(tree.sys.views.size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * tree.sys.views.size());
+  state.SetComplexityN(tree.sys.views.size());
+}
+
+static void BM_ViewLayout(benchmark::State & state)
+{
+  Tree tree{(u32) state.range(0)};
+
+  for (auto _ : state)
+  {
+    tree.relayout();
+    benchmark::DoNotOptimize(tree.sys.grid.entries.size());
+  }
+
+  state.SetItemsProcessed(state.iterations() * tree.sys.views.size());
+  state.SetComplexityN(tree.sys.views.size());
+}
+
+/// @brief sorting the z-order after the views' stacking changed
+static void BM_ViewStack(benchmark::State & state)
+{
+  Tree tree{(u32) state.range(0)};
+
+  for (auto _ : state)
+  {
+    tree.sys.stacking.clear();
+    tree.sys.stack();
+    benchmark::DoNotOptimize(tree.sys.z_ord.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * tree.sys.views.size());
+  state.SetComplexityN(tree.sys.views.size());
+}
+
+/// @brief the z-order is reused if the views' stacking is unchanged
+static void BM_ViewStackUnchanged(benchmark::State & state)
+{
+  Tree tree{(u32) state.range(0)};
+
+  for (auto _ : state)
+  {
+    tree.sys.stack();
+    benchmark::DoNotOptimize(tree.sys.z_ord.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * tree.sys.views.size());
+  state.SetComplexityN(tree.sys.views.size());
+}
+
+/// @brief the retained per-frame cost: no view is dirty, nothing is rebuilt or
+/// laid out
+static void BM_ViewTick(benchmark::State & state)
+{
+  Tree tree{(u32) state.range(0)};
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(tree.sys.tick(tree.input, tree.table, noop));
+  }
+
+  state.SetItemsProcessed(state.iterations() * tree.sys.views.size());
+  state.SetComplexityN(tree.sys.views.size());
+}
+
+BENCHMARK(BM_ViewBuild)
+  ->RangeMultiplier(10)
+  ->Range(1'000, 500'000)
+  ->Unit(benchmark::kMicrosecond)
+  ->Complexity(benchmark::oN);
+BENCHMARK(BM_ViewLayout)
+  ->RangeMultiplier(10)
+  ->Range(1'000, 500'000)
+  ->Unit(benchmark::kMicrosecond)
+  ->Complexity(benchmark::oN);
+BENCHMARK(BM_ViewTick)
+  ->RangeMultiplier(10)
+  ->Range(1'000, 500'000)
+  ->Unit(benchmark::kMicrosecond)
+  ->Complexity(benchmark::oN);
+BENCHMARK(BM_ViewStack)
+  ->RangeMultiplier(10)
+  ->Range(10'000, 100'000)
+  ->Unit(benchmark::kMicrosecond)
+  ->Complexity(benchmark::oN);
+BENCHMARK(BM_ViewStackUnchanged)
+  ->RangeMultiplier(10)
+  ->Range(10'000, 100'000)
+  ->Unit(benchmark::kMicrosecond)
+  ->Complexity(benchmark::oN);
@@ -575,12 +575,21 @@ affinef32x4 ICanvas::world_to_fb() const
   return world_to_fb_;
 }
 
+CRect ICanvas::damage() const
+{
+  return damage_;
+}
+
 RectU ICanvas::clip_to_scissor(CRect const & clip) const
 {
+  // only the damaged region is redrawn
+  CRect const area =
+    clip.overlaps(damage_) ? clip.intersect(damage_) : CRect{};
+
   // clips are always unscaled
   Rect scissor_f{.offset = viewport_.offset +
-                           (clip.begin() + 0.5F * extent_) * virtual_scale_,
-                 .extent = clip.extent * virtual_scale_};
+                           (area.begin() + 0.5F * extent_) * virtual_scale_,
+                 .extent = area.extent * virtual_scale_};
 
   scissor_f =
     Rect::range(scissor_f.offset.clamp(f32x2::splat(0.0F), MAX_CLIP.extent),
@@ -590,18 +599,30 @@ RectU ICanvas::clip_to_scissor(CRect const & clip) const
                       scissor_f.end().to<u32>().min(framebuffer_extent_));
 }
 
+f32x4 ICanvas::clip_to_bounds(CRect const & clip) const
+{
+  auto scissor = clip_to_scissor(clip);
+  auto begin   = scissor.begin().to<f32>();
+  auto end     = scissor.end().to<f32>();
+  return f32x4{begin.x(), begin.y(), end.x(), end.y()};
+}
+
 TextRenderer ICanvas::default_text_renderer()
 {
   return TextRenderer{
-    this, [](Canvas c, TextBlockRenderInfo const & text) { c->text(text); }};
+    this, [](Canvas c, Span<TextLayer const> layers, Span<Shape const> shapes,
+             Span<TextRenderInfo const> infos, Span<usize const> sorted) {
+      c->text(layers, shapes, infos, sorted);
+    }};
 }
 
 void ICanvas::begin(gpu::Viewport const & viewport, f32x2 extent,
-                    u32x2 framebuffer_extent)
+                    u32x2 framebuffer_extent, GpuFramePlan plan)
 {
   static_assert(DEFAULT_NUM_IMAGE_SLOTS >= 3, "");
   CHECK(state_ == CanvasState::Reset, "");
 
+  plan_                = plan;
   viewport_            = viewport;
   extent_              = extent;
   framebuffer_extent_  = framebuffer_extent;
@@ -667,6 +688,8 @@ void ICanvas::reset()
   ndc_to_viewport_     = affinef32x4::identity();
   viewport_to_fb_      = affinef32x4::identity();
   world_to_fb_         = affinef32x4::identity();
+  damage_              = MAX_CLIP;
+  plan_                = nullptr;
   encoders_.shrink_clear().unwrap();
   encoder_arena_.reclaim();
   tmp_arena_.reclaim();
@@ -677,6 +700,7 @@ void ICanvas::reset()
 void ICanvas::execute(GpuFramePlan plan)
 {
   CHECK(state_ == CanvasState::Recorded, "");
+  CHECK(plan_ == nullptr || plan_ == plan, "");
 
   plan->reserve_scratch_images(num_image_slots());
 
@@ -768,6 +792,11 @@ void ICanvas::set_clip(CRect const & area)
   clip_ = area;
 }
 
+void ICanvas::set_damage(CRect const & area)
+{
+  damage_ = area;
+}
+
 constexpr f32x4x4 object_to_world(f32x4x4 const & transform, CRect const & area)
 {
   return transform * translate3d(area.center.append(0)) *
@@ -824,6 +853,7 @@ void ICanvas::render_(TextureSet const & texture_set, Shape const & shape,
   shader::FlatSdfItem item{
     .world_transform  = object_to_world(shape.world_transform, shape.bbox()),
     .uv_transform     = shape.uv_transform,
+    .clip             = clip_to_bounds(clip_),
     .radii            = shape.radii,
     .half_bbox_extent = 0.5F * shape.bbox_extent,
     .half_extent      = 0.5F * shape.area.extent,
@@ -844,12 +874,13 @@ void ICanvas::render_(TextureSet const & texture_set, Shape const & shape,
   return encode_(SdfEncoder::Item{.color         = color_,
                                   .depth_stencil = depth_stencil_,
                                   .stencil_op    = stencil_op_,
-                                  .scissor       = clip_to_scissor(clip_),
+                                  .scissor       = clip_to_scissor(MAX_CLIP),
                                   .viewport      = viewport_,
                                   .texture_set   = texture_set,
                                   .world_to_ndc  = world_to_ndc_.to_mat(),
-                                  .shape         = as_u8_span(item),
-                                  .variant       = SdfPipeline::FLAT});
+                                  .item          = as_u8_span(item),
+                                  .variant       = SdfPipeline::FLAT,
+                                  .plan          = plan_});
 }
 
 void ICanvas::render_noise_(TextureSet const & texture_set, Shape const & shape,
@@ -858,6 +889,7 @@ void ICanvas::render_noise_(TextureSet const & texture_set, Shape const & shape,
   shader::NoiseSdfItem item{
     .world_transform  = object_to_world(shape.world_transform, shape.bbox()),
     .uv_transform     = shape.uv_transform,
+    .clip             = clip_to_bounds(clip_),
     .radii            = shape.radii,
     .half_bbox_extent = 0.5F * shape.bbox_extent,
     .half_extent      = 0.5F * shape.area.extent,
@@ -872,12 +904,13 @@ void ICanvas::render_noise_(TextureSet const & texture_set, Shape const & shape,
   return encode_(SdfEncoder::Item{.color         = color_,
                                   .depth_stencil = depth_stencil_,
                                   .stencil_op    = stencil_op_,
-                                  .scissor       = clip_to_scissor(clip_),
+                                  .scissor       = clip_to_scissor(MAX_CLIP),
                                   .viewport      = viewport_,
                                   .texture_set   = texture_set,
                                   .world_to_ndc  = world_to_ndc_.to_mat(),
-                                  .shape         = as_u8_span(item),
-                                  .variant       = SdfPipeline::NOISE});
+                                  .item          = as_u8_span(item),
+                                  .variant       = SdfPipeline::NOISE,
+                                  .plan          = plan_});
 }
 
 void ICanvas::render_(TextureSet const &       texture_set,
@@ -886,6 +919,7 @@ void ICanvas::render_(TextureSet const &       texture_set,
   shader::MeshGradientSdfItem item{
     .world_transform  = object_to_world(shape.world_transform, shape.bbox()),
     .uv_transform     = shape.uv_transform,
+    .clip             = clip_to_bounds(clip_),
     .radii            = shape.radii,
     .half_bbox_extent = 0.5F * shape.bbox_extent,
     .half_extent      = 0.5F * shape.area.extent,
@@ -908,12 +942,13 @@ void ICanvas::render_(TextureSet const &       texture_set,
   return encode_(SdfEncoder::Item{.color         = color_,
                                   .depth_stencil = depth_stencil_,
                                   .stencil_op    = stencil_op_,
-                                  .scissor       = clip_to_scissor(clip_),
+                                  .scissor       = clip_to_scissor(MAX_CLIP),
                                   .viewport      = viewport_,
                                   .texture_set   = texture_set,
                                   .world_to_ndc  = world_to_ndc_.to_mat(),
-                                  .shape         = as_u8_span(item),
-                                  .variant       = SdfPipeline::MESH_GRADIENT});
+                                  .item          = as_u8_span(item),
+                                  .variant       = SdfPipeline::MESH_GRADIENT,
+                                  .plan          = plan_});
 }
 
 void ICanvas::render_(TextureSet const &      texture_set,
@@ -968,12 +1003,13 @@ void ICanvas::render_(TextureSet const & texture_set, QuadInfo const & shape)
   return encode_(QuadEncoder::Item{.color         = color_,
                                    .depth_stencil = depth_stencil_,
                                    .stencil_op    = stencil_op_,
-                                   .scissor       = clip_to_scissor(clip_),
+                                   .scissor       = clip_to_scissor(MAX_CLIP),
                                    .viewport      = viewport_,
                                    .texture_set   = texture_set,
                                    .world_to_ndc  = world_to_ndc_.to_mat(),
                                    .quad          = shape.quad.as_u8(),
-                                   .variant       = shape.variant});
+                                   .variant       = shape.variant,
+                                   .clip          = clip_to_bounds(clip_)});
 }
 
 void ICanvas::render_blur_(Shape const & shape_)
@@ -1507,6 +1543,17 @@ ICanvas & ICanvas::sdf_map(Shape const & shape)
   return *this;
 }
 
+ICanvas & ICanvas::glyph_sdf(Shape const & shape_)
+{
+  // the atlas layer is sampled as the distance field and the glyph is shaded
+  // with the tint
+  Shape shape   = shape_;
+  shape.sdf_map = shape_.map;
+  shape.map     = TextureIndex::White;
+  render_(sampled_textures, shape, shader::sdf::ShapeType::GlyphSDF);
+  return *this;
+}
+
 ICanvas & ICanvas::noise(Shape const & shape)
 {
   render_noise_(sampled_textures, shape, shader::sdf::ShapeType::RRect);
@@ -1564,7 +1611,9 @@ ICanvas & ICanvas::quad(QuadInfo const & quad)
   return *this;
 }
 
-ICanvas & ICanvas::text(TextBlockRenderInfo const & text)
+ICanvas & ICanvas::text(Span<TextLayer const> layers, Span<Shape const> shapes,
+                        Span<TextRenderInfo const> infos,
+                        Span<usize const>          sorted)
 {
   for (auto i : sorted)
   {
@@ -1575,7 +1624,14 @@ ICanvas & ICanvas::text(TextBlockRenderInfo const & text)
     {
       case TextLayer::Glyphs:
       case TextLayer::GlyphShadows:
-        rect(shape);
+        if (infos[i].atlas == GlyphAtlasFormat::Sdf)
+        {
+          glyph_sdf(shape);
+        }
+        else
+        {
+          rect(shape);
+        }
         break;
       default:
         rrect(shape);
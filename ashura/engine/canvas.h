@@ -489,6 +489,10 @@ struct ICanvas
 
   CRect clip_;
 
+  /// @brief The region of the framebuffer being redrawn, the passes' scissors
+  /// are restricted to it so the rest of the framebuffer keeps its contents
+  CRect damage_;
+
   SmallVec<CRect, 4, 0> clip_saves_;
 
   SmallVec<u32, 4, 0> color_saves_;
@@ -499,6 +503,10 @@ struct ICanvas
 
   Vec<Dyn<CanvasEncoder>> encoders_;
 
+  /// @brief The plan the canvas will be executed on, if known when recording
+  /// begins the shapes are written straight to its mapped GPU memory
+  GpuFramePlan plan_;
+
   ArenaPool encoder_arena_;
 
   ArenaPool tmp_arena_;
@@ -520,11 +528,13 @@ struct ICanvas
     viewport_to_fb_{affinef32x4::identity()},
     world_to_fb_{affinef32x4::identity()},
     clip_{MAX_CLIP},
+    damage_{MAX_CLIP},
     clip_saves_{allocator},
     color_saves_{allocator},
     depth_stencil_saves_{allocator},
     stencil_op_saves_{allocator},
     encoders_{allocator},
+    plan_{nullptr},
     encoder_arena_{allocator, ArenaPoolCfg{.min_arena_size = 1_MB}},
     tmp_arena_{allocator, ArenaPoolCfg{.min_arena_size = 1_MB}}
   {
@@ -566,12 +576,21 @@ struct ICanvas
 
   affinef32x4 world_to_fb() const;
 
+  CRect damage() const;
+
   RectU clip_to_scissor(CRect const & clip) const;
 
+  /// @brief The framebuffer-space bounds (x0, y0, x1, y1) of `clip`, tested
+  /// per-instance by the SDF and quad shaders. Their passes are scissored to
+  /// the damaged region only, so shapes with different clips share draw calls.
+  f32x4 clip_to_bounds(CRect const & clip) const;
+
   TextRenderer default_text_renderer();
 
+  /// @param plan the plan the canvas will be executed on, if not `nullptr`
+  /// the shapes are written to its GPU buffers as they are recorded
   void begin(gpu::Viewport const & viewport, f32x2 extent,
-             u32x2 framebuffer_extent);
+             u32x2 framebuffer_extent, GpuFramePlan plan = nullptr);
 
   void end();
 
@@ -597,6 +616,9 @@ struct ICanvas
 
   void set_clip(CRect const & area);
 
+  /// @brief Restrict the rendering to the damaged `area` of the framebuffer.
+  void set_damage(CRect const & area);
+
   /// @brief Register a custom canvas pass to be executed in the render thread
   template <Callable<GpuFramePlan> Lambda>
   void encode_pass_(Lambda && task)
@@ -673,6 +695,10 @@ struct ICanvas
   /// @brief render an SDF texture
   ICanvas & sdf_map(Shape const & shape);
 
+  /// @brief render a glyph from a distance-field font atlas, `shape.map` is
+  /// the atlas layer and the shape's uvs span the glyph's area in it
+  ICanvas & glyph_sdf(Shape const & shape);
+
   /// @brief render a noise-grained shape
   ICanvas & noise(Shape const & shape);
 
@@ -697,7 +723,10 @@ struct ICanvas
   /// @brief render a quad using a custom shader
   ICanvas & quad(QuadInfo const & quad);
 
-  ICanvas & text(TextBlockRenderInfo const & info);
+  /// @brief render the shapes of a text block in the `sorted` order.
+  /// Glyphs of distance-field atlases are rendered with `glyph_sdf`.
+  ICanvas & text(Span<TextLayer const> layers, Span<Shape const> shapes,
+                 Span<TextRenderInfo const> infos, Span<usize const> sorted);
 };
 
 }    // namespace ash
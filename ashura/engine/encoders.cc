@@ -15,11 +15,63 @@
 namespace ash
 {
 
+void SdfEncoder::push_(Span<u8 const> item)
+{
+  num_instances_++;
+
+  if (plan_ == nullptr)
+  {
+    items_.extend(item).unwrap();
+    return;
+  }
+
+  if ((size_ + item.size()) > mapped_.size())
+  {
+    grow_(item.size());
+  }
+
+  mem::copy(item, mapped_.slice(size_));
+  size_ += item.size();
+}
+
+void SdfEncoder::grow_(u64 extension)
+{
+  if (mapped_.is_empty())
+  {
+    auto [id, map] = plan_->push_gpu_uninit(extension);
+    i_items_       = id;
+    mapped_        = map;
+    return;
+  }
+
+  // grow geometrically so most items are written in place
+  auto extended = plan_->extend_gpu(i_items_, max(extension, size_));
+
+  if (extended.is_none())
+  {
+    extended = plan_->extend_gpu(i_items_, extension);
+  }
+
+  if (extended.is_some())
+  {
+    mapped_ = extended.v();
+    return;
+  }
+
+  // another buffer was allocated after the items' or their block is full,
+  // relocate them
+  auto [id, map] = plan_->push_gpu_uninit(max(size_ * 2, size_ + extension));
+  mem::copy(mapped_.slice(0, size_).as_const(), map);
+  i_items_ = id;
+  mapped_  = map;
+}
+
 void SdfEncoder::operator()(GpuFramePlan plan)
 {
-  auto items          = items_.view();
+  CHECK(plan_ == nullptr || plan_ == plan, "");
   auto i_world_to_ndc = plan->push_gpu(span({world_to_ndc_}));
-  auto i_items        = plan->push_gpu(items);
+  auto i_items =
+    (plan_ == nullptr) ? plan->push_gpu(items_.view().as_const()) : i_items_;
 
   plan->add_pass(
     [color = this->color_, depth_stencil = this->depth_stencil_,
@@ -4,6 +4,7 @@
 #include "ashura/engine/pipeline.h"
 #include "ashura/std/allocator.h"
 #include "ashura/std/math.h"
+#include "ashura/std/mem.h"
 #include "ashura/std/obj.h"
 #include "ashura/std/types.h"
 
@@ -86,6 +87,10 @@ struct SdfEncoder final : ICanvasEncoder
     f32x4x4                 world_to_ndc;
     Span<u8 const>          item;
     PipelineVariantId       variant;
+
+    /// @brief The plan the items are written to as they are recorded, if
+    /// `nullptr` they are staged and written when the encoder is executed
+    GpuFramePlan plan = nullptr;
   };
 
   u32 num_instances_;
@@ -108,9 +113,21 @@ struct SdfEncoder final : ICanvasEncoder
 
   PipelineVariantId variant_;
 
+  GpuFramePlan plan_;
+
+  /// @brief The GPU buffer of the items in `plan_`'s mapped memory
+  GpuBufferId i_items_;
+
+  /// @brief The mapped memory of `i_items_`
+  Span<u8> mapped_;
+
+  /// @brief Number of bytes of the items written to `mapped_`
+  u64 size_;
+
   explicit SdfEncoder(Allocator allocator, Item const & item) :
     ICanvasEncoder{CanvasEncoderType::Sdf},
-    num_instances_{1},
+    num_instances_{0},
+    color_{item.color},
     depth_stencil_{item.depth_stencil},
     stencil_op_{item.stencil_op},
     scissor_{item.scissor},
@@ -118,7 +135,11 @@ struct SdfEncoder final : ICanvasEncoder
     texture_set_{item.texture_set},
     world_to_ndc_{item.world_to_ndc},
     items_{allocator},
-    variant_{item.variant}
+    variant_{item.variant},
+    plan_{item.plan},
+    i_items_{},
+    mapped_{},
+    size_{0}
   {
     push_(item.item);
   }
@@ -129,19 +150,19 @@ struct SdfEncoder final : ICanvasEncoder
   SdfEncoder & operator=(SdfEncoder &&)      = default;
   ~SdfEncoder()                              = default;
 
-  void push_(Span<u8 const> item)
-  {
-    items_.extend(item).unwrap();
-    num_instances_++;
-  }
+  void push_(Span<u8 const> item);
+
+  /// @brief Grow the mapped memory of the items by at least `extension` bytes
+  void grow_(u64 extension);
 
   bool push(Item const & item)
   {
     auto mergeable = obj::byte_eq(
       Tuple{color_, depth_stencil_, stencil_op_, scissor_, viewport_,
-            texture_set_, world_to_ndc_, variant_},
+            texture_set_, world_to_ndc_, variant_, plan_},
       Tuple{item.color, item.depth_stencil, item.stencil_op, item.scissor,
-            item.viewport, item.texture_set, item.world_to_ndc, item.variant});
+            item.viewport, item.texture_set, item.world_to_ndc, item.variant,
+            item.plan});
 
     if (!mergeable)
     {
@@ -169,8 +190,16 @@ struct QuadEncoder final : ICanvasEncoder
     f32x4x4                 world_to_ndc;
     Span<u8 const>          quad;
     PipelineVariantId       variant;
+
+    /// @brief framebuffer-space clip rect (x0, y0, x1, y1) written to the
+    /// quad's `clip`, so quads clipped differently are still drawn together
+    f32x4 clip;
   };
 
+  /// @brief Offset of the clip rect in the quad items, the same for all the
+  /// materials
+  static constexpr usize CLIP_OFFSET = offsetof(shader::FlatQuadItem, clip);
+
   u32 num_instances_;
 
   u32 color_;
@@ -193,7 +222,8 @@ struct QuadEncoder final : ICanvasEncoder
 
   explicit QuadEncoder(Allocator allocator, Item const & item) :
     ICanvasEncoder{CanvasEncoderType::Quad},
-    num_instances_{1},
+    num_instances_{0},
+    color_{item.color},
     depth_stencil_{item.depth_stencil},
     stencil_op_{item.stencil_op},
     scissor_{item.scissor},
@@ -203,7 +233,7 @@ struct QuadEncoder final : ICanvasEncoder
     quads_{allocator},
     variant_{item.variant}
   {
-    push_(item.quad);
+    push_(item.quad, item.clip);
   }
 
   QuadEncoder(QuadEncoder const &)             = delete;
@@ -212,9 +242,12 @@ struct QuadEncoder final : ICanvasEncoder
   QuadEncoder & operator=(QuadEncoder &&)      = default;
   ~QuadEncoder()                               = default;
 
-  void push_(Span<u8 const> quad)
+  void push_(Span<u8 const> quad, f32x4 clip)
   {
+    CHECK(quad.size() >= (CLIP_OFFSET + sizeof(f32x4)), "");
+    auto offset = quads_.size();
     quads_.extend(quad).unwrap();
+    mem::copy(as_u8_span(clip), quads_.view().slice(offset + CLIP_OFFSET));
     num_instances_++;
   }
 
@@ -231,7 +264,7 @@ struct QuadEncoder final : ICanvasEncoder
       return false;
     }
 
-    push_(item.quad);
+    push_(item.quad, item.clip);
 
     return true;
   }
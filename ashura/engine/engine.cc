@@ -13,7 +13,8 @@ Result<EngineCfg> EngineCfg::parse(AllocatorRef allocator, Vec<u8> & json)
   EngineCfg out{.shaders{allocator},
                 .fonts{allocator},
                 .images{allocator},
-                .pipeline_cache{allocator}};
+                .pipeline_cache{allocator},
+                .font_cache{allocator}};
 
   json.reserve(json.size() + simdjson::SIMDJSON_PADDING).unwrap();
 
@@ -135,6 +136,20 @@ Result<EngineCfg> EngineCfg::parse(AllocatorRef allocator, Vec<u8> & json)
   out.font_height =
     clamp((u32) cfg["fonts.height"].get_int64().value(), 16U, 256U);
 
+  std::string_view font_mode = cfg["fonts.mode"].get_string().value();
+  if (font_mode == "bitmap")
+  {
+    out.font_mode = FontRasterMode::Bitmap;
+  }
+  else if (font_mode == "sdf")
+  {
+    out.font_mode = FontRasterMode::Sdf;
+  }
+  else
+  {
+    CHECK(false, "");
+  }
+
   auto images = cfg["images"].get_object().value();
   for (auto entry : images)
   {
@@ -151,6 +166,11 @@ Result<EngineCfg> EngineCfg::parse(AllocatorRef allocator, Vec<u8> & json)
 
   out.pipeline_cache.extend(pipeline_cache_path).unwrap();
 
+  std::string_view font_cache_path =
+    cfg["cache.fonts.path"].get_string().value();
+
+  out.font_cache.extend(font_cache_path).unwrap();
+
   return Ok{std::move(out)};
 }
 
@@ -330,6 +350,8 @@ Dyn<Engine *> Engine::create(AllocatorRef allocator, Str config_path,
 
   Dyn<FontSystem *> font_sys = FontSystem::create(allocator);
 
+  font_sys->set_cache_dir(cfg.font_cache);
+
   ShaderSystem shader_sys{allocator};
 
   Dyn<WindowSystem *> window_sys = WindowSystem::create_SDL(allocator);
@@ -468,7 +490,7 @@ void Engine::engage_(EngineCfg const & cfg)
     trace("Loading font: {} from: {}"_str, label, resolved_path);
     futures
       .push(font_sys->load_from_path(std::move(label), resolved_path,
-                                     cfg.font_height, 0))
+                                     cfg.font_height, 0, cfg.font_mode))
       .unwrap();
   }
 
@@ -484,7 +506,7 @@ void Engine::engage_(EngineCfg const & cfg)
   trace("Waiting for resources"_str);
   while (!await_futures(futures, 0ns))
   {
-    gpu_sys.frame(nullptr);
+    gpu_sys.submit_frame();
     scheduler->run_main_loop(1ms, 1ms);
   }
 
@@ -697,6 +719,22 @@ void Engine::run(ui::View & view, Fn<void(ui::Ctx const &)> loop)
   Option<Cursor>        cursor             = Cursor::Default;
   Option<TextInputInfo> current_input_info = none;
   time_point            frame_end          = steady_clock::now();
+  u64                   frames_skipped     = 0;
+
+  // each frame in flight renders into its own framebuffer, which was last
+  // drawn `MAX_BUFFERING` presented frames ago. the damage of the frames
+  // since then has to be redrawn as well.
+  Array<CRect, IGpuSys::MAX_BUFFERING> damage_history;
+  u32                                  damage_ring = 0;
+
+  auto invalidate = [&]() {
+    for (CRect & d : damage_history)
+    {
+      d = MAX_CLIP;
+    }
+  };
+
+  invalidate();
 
   window_sys->set_cursor(cursor);
 
@@ -709,22 +747,76 @@ void Engine::run(ui::View & view, Fn<void(ui::Ctx const &)> loop)
     if (input_state.window.resized || input_state.window.surface_resized)
     {
       gpu_sys.recreate_framebuffers(input_state.window.surface_extent);
+      invalidate();
     }
 
-    ScopeTrace record_trace{{"frame.record"_str}};
+    running = ui_sys.tick(input_state, view, loop);
 
-    canvas.begin_recording(
-      gpu::Viewport{
-        .offset{0, 0},
-        .extent    = as_vec2(input_state.window.surface_extent),
-        .min_depth = 0,
-        .max_depth = 1
-    },
-      as_vec2(input_state.window.extent), input_state.window.surface_extent);
+    auto current_cursor = ui_sys.cursor;
+
+    if (current_cursor != cursor)
+    {
+      cursor = current_cursor;
+      window_sys->set_cursor(current_cursor);
+    }
+
+    auto input_info = ui_sys.text_input();
+
+    if (input_info != current_input_info)
+    {
+      window_sys->set_text_input(window, input_info);
+      current_input_info = input_info;
+    }
 
-    running = ui_sys.tick(input_state, view, canvas, loop);
+    f32 damaged_area = 0;
 
+    if (ui_sys.damage.is_none())
     {
+      // nothing changed since the last presented frame, skip recording and
+      // presenting entirely
+      frames_skipped++;
+    }
+    else
+    {
+      ScopeTrace record_trace{{"frame.record"_str}};
+
+      auto const extent = as_vec2(input_state.window.extent);
+      CRect      redraw = ui_sys.damage.v();
+
+      damage_history[damage_ring] = redraw;
+      damage_ring = (damage_ring + 1) % IGpuSys::MAX_BUFFERING;
+
+      for (CRect const & d : damage_history)
+      {
+        redraw = redraw.unioned(d);
+      }
+
+      redraw = redraw.intersect(CRect{.center = {}, .extent = extent});
+
+      if (extent.x() != 0 && extent.y() != 0)
+      {
+        damaged_area = redraw.area() / (extent.x() * extent.y());
+      }
+
+      // the canvas is executed on the plan being recorded, so its shapes are
+      // written straight to the plan's mapped GPU buffers
+      GpuFramePlan const plan = gpu_sys.plan();
+
+      canvas.begin(
+        gpu::Viewport{
+          .offset{0, 0},
+          .extent    = as_vec2(input_state.window.surface_extent),
+          .min_depth = 0,
+          .max_depth = 1
+      },
+        extent, input_state.window.surface_extent, plan);
+
+      canvas.set_damage(redraw);
+
+      ui_sys.render(canvas);
+
+      image_sys.trim();
+
       // [ ] squircle for blur shape
       // [ ] masks for blur shape
       canvas.squircle(ShapeInfo{
@@ -742,30 +834,23 @@ void Engine::run(ui::View & view, Fn<void(ui::Ctx const &)> loop)
           .extent{400, 400}
       },
         Vec2::splat(2), Vec4::splat(100));
-    }
 
-    auto current_cursor = ui_sys.cursor;
-
-    if (current_cursor != cursor)
-    {
-      cursor = current_cursor;
-      window_sys->set_cursor(current_cursor);
-    }
+      canvas.end();
 
-    auto input_info = ui_sys.text_input();
+      font_sys->upload_glyphs();
 
-    if (input_info != current_input_info)
-    {
-      window_sys->set_text_input(window, input_info);
-      current_input_info = input_info;
+      canvas.execute(plan);
+      canvas.reset();
+      gpu_sys.submit_frame();
     }
 
-    canvas.end_recording();
+    TraceRecord const damage_records[] = {
+      {.label = "frames_skipped"_str, .i = (i64) frames_skipped},
+      {.label = "damaged_area"_str,   .f = damaged_area          }
+    };
 
-    renderer.render_canvas(gpu_sys.frame_graph_, canvas, gpu_sys.fb_,
-                           gpu_sys.scratch_color_,
-                           gpu_sys.scratch_depth_stencil_);
-    gpu_sys.frame(swapchain);
+    trace_sink->trace(TraceEvent{.label = "frame.damage"_str},
+                      span(damage_records));
 
     frame_end             = steady_clock::now();
     auto const frame_time = frame_end - frame_start;
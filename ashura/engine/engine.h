@@ -36,6 +36,8 @@ struct EngineCfg
 
   u32 font_height = 64;
 
+  FontRasterMode font_mode = FontRasterMode::Bitmap;
+
   StringDict<Vec<char>> shaders{};
 
   StringDict<Vec<char>> fonts{};
@@ -44,6 +46,8 @@ struct EngineCfg
 
   Vec<char> pipeline_cache{};
 
+  Vec<char> font_cache{};
+
   static Result<EngineCfg> parse(Allocator allocator, Vec<u8> & json);
 };
 
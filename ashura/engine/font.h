@@ -103,43 +103,111 @@ struct FontMetrics
   }
 };
 
-/// @param later atlas layer this glyph belongs to
+/// @param has_color if the glyph is a color glyph, i.e. emoji
+/// @param layer atlas layer this glyph belongs to, `NO_LAYER` if the glyph
+/// has not been rasterized yet or has been evicted from the atlas
 /// @param area area in the atlas this glyph's cache data is placed
 /// @param uv normalized texture coordinates of this glyph in the layer
 struct AtlasGlyph
 {
+  static constexpr u16 NO_LAYER = U16_MAX;
+
   bool16 has_color = false;
-  u16    layer     = 0;
+  u16    layer     = NO_LAYER;
   RectU  area      = {};
   f32x2  uv[2]     = {};
+
+  constexpr bool is_resident() const
+  {
+    return layer != NO_LAYER;
+  }
 };
 
-struct CpuFontAtlas
+/// @brief Storage format of a glyph atlas layer
+enum class GlyphAtlasFormat : u8
 {
-  i32             font_height = 0;
-  u32x2           extent      = {};
-  u32             num_layers  = 0;
-  Vec<AtlasGlyph> glyphs      = {};
-  Vec<u8>         channels    = {};
+  /// @brief single-channel (R8) coverage, for non-color glyphs. The layer's
+  /// view swizzles it to (1, 1, 1, R) so it is sampled like a white BGRA
+  /// glyph.
+  Alpha = 0,
+
+  /// @brief BGRA, for color glyphs, i.e. emoji
+  Color = 1,
+
+  /// @brief single-channel (R8) signed distance field, for non-color glyphs
+  /// of fonts rasterized with `FontRasterMode::Sdf`. 0.5 on the outline,
+  /// increasing inwards.
+  Sdf = 2
+};
 
-  ImageLayerSpan<u8, 1> span() const
-  {
-    return ImageLayerSpan<u8, 1>{
-      .channels = channels, .extent = extent, .layers = num_layers};
-  }
+constexpr u32 glyph_pixel_size(GlyphAtlasFormat format)
+{
+  return format == GlyphAtlasFormat::Color ? 4 : 1;
+}
+
+/// @brief How a font's glyphs are rasterized into its atlas
+enum class FontRasterMode : u8
+{
+  /// @brief coverage bitmaps, crisp only at the atlas' font height
+  Bitmap = 0,
+
+  /// @brief signed distance fields generated from the glyph outlines. A
+  /// single atlas serves all font heights and zoom levels. Color glyphs are
+  /// still stored as BGRA bitmaps.
+  Sdf = 1
 };
 
+/// @brief A layer of the dynamic glyph atlas
+/// @param format storage format of the layer, only glyphs of the matching
+/// color mode are packed into it
+/// @param image the layer's image
+/// @param texture texture index of the layer's image
+/// @param last_use frame the layer was last sampled in, used for LRU eviction
+/// @param glyphs glyphs currently packed into the layer
+struct GlyphAtlasLayer
+{
+  GlyphAtlasFormat format   = GlyphAtlasFormat::Alpha;
+  ImageId          image    = ImageId::None;
+  TextureIndex     texture  = TextureIndex::White;
+  u64              last_use = 0;
+  Vec<u32>         glyphs   = {};
+};
+
+/// @brief Dynamic glyph atlas. Glyphs are rasterized on first use and packed
+/// incrementally into fixed-extent layers. When the atlas is full, the
+/// least-recently-used layer is evicted as a whole.
+/// @param mode how the glyphs are rasterized
+/// @param font_height font height at which the glyphs are rasterized (px)
+/// @param extent extent of each atlas layer
+/// @param glyphs atlas entry of each glyph in the font
 struct GpuFontAtlas
 {
-  Vec<TextureIndex> textures    = {};
-  ImageId           image       = ImageId::None;
-  i32               font_height = 0;
-  u32x2             extent      = {};
-  Vec<AtlasGlyph>   glyphs      = {};
+  FontRasterMode       mode        = FontRasterMode::Bitmap;
+  i32                  font_height = 0;
+  u32x2                extent      = {};
+  Vec<GlyphAtlasLayer> layers      = {};
+  Vec<TextureIndex>    textures    = {};
+  Vec<AtlasGlyph>      glyphs      = {};
 
   constexpr u32 num_layers() const
   {
-    return size32(textures);
+    return size32(layers);
+  }
+
+  constexpr GlyphAtlasFormat format(AtlasGlyph const & glyph) const
+  {
+    return layers[glyph.layer].format;
+  }
+
+  /// @brief GPU memory used by the atlas' layers
+  constexpr u64 size_bytes() const
+  {
+    u64 size = 0;
+    for (GlyphAtlasLayer const & layer : layers)
+    {
+      size += pixel_size_bytes(extent, glyph_pixel_size(layer.format));
+    }
+    return size;
   }
 };
 
@@ -154,8 +222,6 @@ enum class FontId : u64
 /// @param replacement_glyph glyph for the replacement glyph 0xFFFD if
 /// found, otherwise glyph index 0
 /// @param ellipsis_glyph glyph for the ellipsis character '…'
-/// @param font_height font height at which the this atlas was rendered (px)
-/// @param cpu_atlas cpu font atlas if loaded
 /// @param gpu_atlas gpu font atlas if loaded
 struct FontInfo
 {
@@ -169,7 +235,6 @@ struct FontInfo
   u32                          space_glyph       = 0;
   u32                          ellipsis_glyph    = 0;
   FontMetrics                  metrics           = {};
-  Option<CpuFontAtlas const &> cpu_atlas         = none;
   Option<GpuFontAtlas const &> gpu_atlas         = none;
 };
 
@@ -22,25 +22,50 @@ struct IFontSys
 
   virtual void shutdown() = 0;
 
-  /// @brief rasterize the font at the specified font height. Note: raster is
-  /// stored as alpha values.
+  /// @brief prepare the font for rasterization at the specified font height.
+  /// Glyphs are rasterized lazily on first use (see: `glyph`).
   /// @note rasterizing mutates the font's internal data, not thread-safe
-  /// @param font_height the font height at which the texture should be
+  /// @param font_height the font height at which the glyphs should be
   /// rasterized at (px)
-  /// @param allocator scratch allocator to use for storing intermediates
-  virtual Result<> rasterize(Font font, u32 font_height) = 0;
+  /// @param mode how the glyphs are rasterized
+  virtual Result<> rasterize(Font font, u32 font_height,
+                             FontRasterMode mode = FontRasterMode::Bitmap) = 0;
 
+  /// @brief get the atlas entry of a glyph, rasterizing it into the font's
+  /// atlas if it is not resident. The returned entry is valid for the current
+  /// frame.
+  virtual AtlasGlyph glyph(FontId font, u32 glyph) = 0;
+
+  /// @brief upload the glyphs rasterized during the current frame to their
+  /// atlas layers and advance the frame
+  virtual void upload_glyphs() = 0;
+
+  /// @brief set the directory the fonts' glyph metrics, coverage, and
+  /// prewarmed atlas glyphs are cached in across runs. Fonts loaded afterwards
+  /// with the same contents, face, height, and raster mode skip preprocessing.
+  /// Caching is disabled if `dir` is empty.
+  virtual void set_cache_dir(Str dir) = 0;
+
+  /// @brief lay out the text block. The paragraphs of `layout` before and
+  /// after the edited codepoints are re-used in place, so only the edited
+  /// paragraphs are segmented, shaped, and broken into lines again, and the
+  /// paragraphs after them are shifted. Large edits are laid out in parallel
+  /// across the scheduler's workers.
+  ///
+  /// Thread-safe: distinct layouts can be laid out concurrently, but fonts
+  /// must not be loaded or unloaded meanwhile.
+  /// @param edit the codepoints edited since `layout` was laid out, the whole
+  /// block by default
   virtual void layout_text(TextBlock const & block, f32 max_width,
-                           TextLayout & layout) = 0;
+                           TextLayout & layout, TextEdit edit = {}) = 0;
 
   virtual Future<Result<FontId, FontLoadErr>>
     load_from_memory(Vec<char> label, Vec<u8> encoded, u32 font_height,
-                     u32 face = 0) = 0;
+                     u32 face = 0, FontRasterMode mode = FontRasterMode::Bitmap) = 0;
 
-  virtual Future<Result<FontId, FontLoadErr>> load_from_path(Vec<char> label,
-                                                             Str       path,
-                                                             u32 font_height,
-                                                             u32 face = 0) = 0;
+  virtual Future<Result<FontId, FontLoadErr>>
+    load_from_path(Vec<char> label, Str path, u32 font_height, u32 face = 0,
+                   FontRasterMode mode = FontRasterMode::Bitmap) = 0;
 
   virtual FontInfo get(FontId id) = 0;
 
@@ -3,6 +3,7 @@
 #include "ashura/engine/file_system.h"
 #include "ashura/engine/rect_pack.h"
 #include "ashura/engine/systems.h"
+#include "ashura/std/fs.h"
 #include "ashura/std/range.h"
 #include "ashura/std/vec.h"
 
@@ -19,11 +20,7 @@ namespace ash
 
 Dyn<FontSys> IFontSys::create(Allocator allocator)
 {
-  hb_buffer_t * hb_buffer = hb_buffer_create();
-  CHECK(hb_buffer != nullptr && hb_buffer_allocation_successful(hb_buffer), "");
-
-  return cast<FontSys>(
-    dyn<FontSysImpl>(inplace, allocator, allocator, hb_buffer).unwrap());
+  return cast<FontSys>(dyn<FontSysImpl>(inplace, allocator, allocator).unwrap());
 }
 
 FontImpl::~FontImpl()
@@ -49,11 +46,6 @@ FontInfo FontImpl::info()
                 .ellipsis_glyph    = ellipsis_glyph,
                 .metrics           = metrics};
 
-  if (cpu_atlas.is_some())
-  {
-    info.cpu_atlas = cpu_atlas.v();
-  }
-
   if (gpu_atlas.is_some())
   {
     info.gpu_atlas = gpu_atlas.v();
@@ -62,11 +54,6 @@ FontInfo FontImpl::info()
   return info;
 }
 
-FontSysImpl::~FontSysImpl()
-{
-  hb_buffer_destroy(hb_buffer_);
-}
-
 void FontSysImpl::shutdown()
 {
   while (!fonts_.is_empty())
@@ -76,7 +63,8 @@ void FontSysImpl::shutdown()
 }
 
 Result<Dyn<Font>, FontLoadErr>
-  FontSysImpl::decode_(Str label_ref, Span<u8 const> encoded, u32 face)
+  FontSysImpl::decode_(Str label_ref, Span<u8 const> encoded, u32 face,
+                       FontCache * cache)
 {
   Vec<char> font_data{allocator_};
   if (!font_data.extend(encoded.as_char()))
@@ -208,27 +196,48 @@ Result<Dyn<Font>, FontLoadErr>
   i32 const advance = ft_face->size->metrics.max_advance;
 
   Vec<GlyphMetrics> glyphs{allocator_};
+  FontCoverage      coverage{allocator_};
 
-  if (!glyphs.resize(num_glyphs))
+  if (cache != nullptr && cache->glyphs.size() == num_glyphs)
   {
-    return Err{FontLoadErr::OutOfMemory};
+    glyphs   = std::move(cache->glyphs);
+    coverage = std::move(cache->coverage);
   }
-
-  for (auto [i, metric] : enumerate<u32>(glyphs))
+  else
   {
-    if (FT_Error err = FT_Load_Glyph(ft_face, i, FT_LOAD_DEFAULT); err != 0)
+    if (!glyphs.resize(num_glyphs))
     {
-      continue;
+      return Err{FontLoadErr::OutOfMemory};
     }
 
-    FT_GlyphSlot s = ft_face->glyph;
+    for (auto [i, metric] : enumerate<u32>(glyphs))
+    {
+      if (FT_Error err = FT_Load_Glyph(ft_face, i, FT_LOAD_DEFAULT); err != 0)
+      {
+        continue;
+      }
 
-    // bin offsets are determined after binning and during rect packing
-    metric = GlyphMetrics{
-      .bearing{(i32) s->metrics.horiBearingX, (i32) -s->metrics.horiBearingY},
-      .advance = (i32) s->metrics.horiAdvance,
-      .extent{(i32) s->metrics.width,        (i32) s->metrics.height       }
-    };
+      FT_GlyphSlot s = ft_face->glyph;
+
+      // bin offsets are determined after binning and during rect packing
+      metric = GlyphMetrics{
+        .bearing{(i32) s->metrics.horiBearingX, (i32) -s->metrics.horiBearingY},
+        .advance = (i32) s->metrics.horiAdvance,
+        .extent{(i32) s->metrics.width,        (i32) s->metrics.height       }
+      };
+    }
+
+    FT_UInt  glyph     = 0;
+    FT_ULong codepoint = FT_Get_First_Char(ft_face, &glyph);
+
+    while (glyph != 0)
+    {
+      if (!coverage.add((c32) codepoint))
+      {
+        return Err{FontLoadErr::OutOfMemory};
+      }
+      codepoint = FT_Get_Next_Char(ft_face, codepoint, &glyph);
+    }
   }
 
   Vec<char> label{allocator_};
@@ -243,7 +252,8 @@ Result<Dyn<Font>, FontLoadErr>
     std::move(postscript_name), std::move(family_name), std::move(style_name),
     hb_blob, hb_face, hb_font, ft_lib, ft_face, face, std::move(glyphs),
     replacement_glyph, ellipsis_glyph, space_glyph,
-    FontMetrics{.ascent = ascent, .descent = descent, .advance = advance});
+    FontMetrics{.ascent = ascent, .descent = descent, .advance = advance},
+    std::move(coverage));
 
   if (!font)
   {
@@ -259,375 +269,1400 @@ Result<Dyn<Font>, FontLoadErr>
   return Ok{cast<ash::Font>(std::move(font.v()))};
 }
 
-Result<> FontSysImpl::rasterize(Font font_, u32 font_height)
+/// @brief set the spread of the signed distance fields generated by the
+/// library's SDF renderer
+static FT_Error set_sdf_spread(FT_Library lib)
 {
-  FontImpl &           font             = (FontImpl &) *font_;
-  static constexpr u32 MIN_ATLAS_EXTENT = 512;
-  static_assert(MIN_ATLAS_EXTENT > 0, "Font atlas extent must be non-zero");
-  static_assert(MIN_ATLAS_EXTENT >= 128,
-                "Font atlas extent must be at least 128px");
-  static_assert(MIN_ATLAS_EXTENT % 64 == 0,
-                "Font atlas extent should be a multiple of 64");
-  static_assert(MIN_ATLAS_EXTENT <= 1'024,
-                "Font atlas extent too large for GPU platform");
-
-  font.cpu_atlas.unwrap_none("CPU font atlas has already been loaded"_str);
+  FT_Int spread = (FT_Int) FontSysImpl::SDF_SPREAD;
+  return FT_Property_Set(lib, "sdf", "spread", &spread);
+}
 
-  CpuFontAtlas atlas;
+Result<> FontSysImpl::rasterize(Font font_, u32 font_height,
+                                FontRasterMode mode)
+{
+  FontImpl & font = (FontImpl &) *font_;
 
-  u32 const num_glyphs = size32(font.glyphs);
+  font.gpu_atlas.unwrap_none("GPU font atlas has already been loaded"_str);
 
-  if (!atlas.glyphs.resize(num_glyphs))
+  if (FT_Error err = FT_Set_Pixel_Sizes(font.ft_face, font_height, font_height);
+      err != 0)
   {
     return Err{};
   }
 
-  if (FT_Error err = FT_Set_Pixel_Sizes(font.ft_face, font_height, font_height);
-      err != 0)
+  if (mode == FontRasterMode::Sdf)
+  {
+    if (FT_Error err = set_sdf_spread(font.ft_lib); err != 0)
+    {
+      return Err{};
+    }
+  }
+
+  GpuFontAtlas atlas{.mode        = mode,
+                     .font_height = (i32) font_height,
+                     .extent      = u32x2::splat(ATLAS_EXTENT),
+                     .layers{allocator_},
+                     .textures{allocator_},
+                     .glyphs{allocator_}};
+
+  if (!atlas.glyphs.resize(size32(font.glyphs)))
   {
     return Err{};
   }
 
-  static constexpr u16 GLYPH_PADDING = 1;
+  font.gpu_atlas = std::move(atlas);
 
-  u32x2 max_glyph_extent;
+  return Ok{};
+}
 
-  for (auto [i, g] : enumerate<u32>(atlas.glyphs))
+/// @brief codepoints rasterized in parallel when a font is loaded: the
+/// printable characters of Basic Latin and Latin-1 Supplement. The remaining
+/// glyphs are rasterized on first use.
+static constexpr Slice32 PREWARM_CODEPOINTS[] = {
+  {0x20, 95},
+  {0xA0, 96}
+};
+
+/// @brief resolve the atlas format of a loaded but not yet rendered glyph.
+/// Only outline glyphs can be converted to distance fields, embedded bitmaps
+/// are stored as coverage.
+static GlyphAtlasFormat glyph_format(FT_GlyphSlot slot, FontRasterMode mode)
+{
+  if (slot->bitmap.pixel_mode == FT_PIXEL_MODE_BGRA)
   {
-    if (FT_Error err = FT_Load_Glyph(font.ft_face, i, FT_LOAD_DEFAULT);
-        err != 0)
-    {
-      continue;
-    }
+    return GlyphAtlasFormat::Color;
+  }
+
+  if (mode == FontRasterMode::Sdf && slot->format == FT_GLYPH_FORMAT_OUTLINE)
+  {
+    return GlyphAtlasFormat::Sdf;
+  }
+
+  return GlyphAtlasFormat::Alpha;
+}
+
+/// @brief extent of the glyph's bitmap once rendered in `format`, from the
+/// slot's preset bitmap metrics
+static u32x2 glyph_extent(FT_GlyphSlot slot, GlyphAtlasFormat format)
+{
+  u32x2 const extent{slot->bitmap.width, slot->bitmap.rows};
+
+  // the SDF renderer expands the outline's bounding box by the spread
+  if (format == GlyphAtlasFormat::Sdf && extent.x() != 0 && extent.y() != 0)
+  {
+    return extent + FontSysImpl::SDF_SPREAD * 2;
+  }
 
-    g.area.extent = u32x2{font.ft_face->glyph->bitmap.width,
-                          font.ft_face->glyph->bitmap.rows};
+  return extent;
+}
 
-    max_glyph_extent = max_glyph_extent.max(g.area.extent);
+/// @brief render the loaded glyph into the slot's bitmap in `format`
+static FT_Error render_glyph(FT_GlyphSlot slot, GlyphAtlasFormat format)
+{
+  if (slot->format == FT_GLYPH_FORMAT_BITMAP)
+  {
+    return 0;
   }
 
-  CHECK(max_glyph_extent.x() <= MIN_ATLAS_EXTENT, "");
-  CHECK(max_glyph_extent.y() <= MIN_ATLAS_EXTENT, "");
+  return FT_Render_Glyph(slot, format == GlyphAtlasFormat::Sdf ?
+                                 FT_RENDER_MODE_SDF :
+                                 FT_RENDER_MODE_NORMAL);
+}
 
-  u32x2 const atlas_extent     = u32x2::splat(MIN_ATLAS_EXTENT);
+/// @brief resolve the atlas entry of a glyph packed at `pos`
+/// @param pos position of the glyph's padded area in the layer
+static AtlasGlyph place_glyph(u32 layer, u32x2 pos, u32x2 extent,
+                              GlyphAtlasFormat format, u32x2 atlas_extent)
+{
   f32x2 const inv_atlas_extent = 1 / atlas_extent.to<f32>();
 
-  u32 num_layers = 0;
-  {
-    Vec<rect_pack::rect> rects{allocator_};
+  // adjust back to original position from the padded position
+  RectU const area{.offset = pos + FontSysImpl::GLYPH_PADDING,
+                   .extent = extent};
+
+  // the uvs of distance-field glyphs exclude the spread so they map to the
+  // glyph's bounding box, same as coverage glyphs
+  u32 const inset = format == GlyphAtlasFormat::Sdf ? FontSysImpl::SDF_SPREAD : 0;
 
-    if (!rects.resize_uninit(num_glyphs))
+  return AtlasGlyph{
+    .has_color = format == GlyphAtlasFormat::Color,
+    .layer     = (u16) layer,
+    .area      = area,
+    .uv        = {(area.offset + inset).to<f32>() * inv_atlas_extent,
+                  (area.end() - inset).to<f32>() * inv_atlas_extent}
+  };
+}
+
+/// @brief copy a rendered glyph bitmap into its padded staging region
+/// @param staging the padded region, in the format of the bitmap
+static void stage_glyph(FT_Bitmap const & bitmap, Span<u8> staging,
+                        u32x2 padded_extent, u32x2 extent)
+{
+  /// we don't want to handle negative pitches
+  CHECK(bitmap.pitch >= 0, "");
+
+  u32x2 const padding = u32x2::splat(FontSysImpl::GLYPH_PADDING);
+
+  switch (bitmap.pixel_mode)
+  {
+    case FT_PIXEL_MODE_GRAY:
     {
-      return Err{};
-    }
+      ImageSpan<u8 const, 1> src{
+        .channels{bitmap.buffer, bitmap.rows * (u32) bitmap.pitch},
+        .extent = extent,
+        .stride = (u32) bitmap.pitch
+      };
 
-    for (auto [i, gl, ag, rect] :
-         zip(range(size32(font.glyphs)), font.glyphs, atlas.glyphs, rects))
+      ImageSpan<u8, 1> dst{.channels = staging,
+                           .extent   = padded_extent,
+                           .stride   = padded_extent.x()};
+
+      copy_image(src, dst.slice(padding, extent));
+    }
+    break;
+    case FT_PIXEL_MODE_BGRA:
     {
-      // added padding to avoid texture spilling due to accumulated
-      // floating-point uv interpolation errors
-      u32x2 padded_extent{};
+      ImageSpan<u8 const, 4> src{
+        .channels{bitmap.buffer, bitmap.rows * (u32) bitmap.pitch},
+        .extent = extent,
+        .stride = (u32) bitmap.pitch / 4
+      };
 
-      if (ag.area.extent.x() != 0 && ag.area.extent.y() != 0)
-      {
-        padded_extent = ag.area.extent + GLYPH_PADDING * 2;
-      }
+      ImageSpan<u8, 4> dst{.channels = staging,
+                           .extent   = padded_extent,
+                           .stride   = padded_extent.x()};
 
-      rect = rect_pack::rect{.id         = i,
-                             .extent     = padded_extent.to<i32>(),
-                             .pos        = {},
-                             .was_packed = false};
+      copy_image(src, dst.slice(padding, extent));
     }
+    break;
+    default:
+      CHECK(false, "Unrecognized pixel mode {}", bitmap.pixel_mode);
+  }
+}
+
+/// @brief open the shard's face over the font's shared memory blob and measure
+/// its glyphs from their preset bitmap metrics, without rendering them
+static void measure_glyphs(GlyphRasterJob & job, u32 shard)
+{
+  FontImpl &   font = *job.font;
+  FT_Library & lib  = job.ft_libs[shard];
+  FT_Face &    face = job.ft_faces[shard];
+
+  if (FT_Error err = FT_Init_FreeType(&lib); err != 0)
+  {
+    lib = nullptr;
+    return;
+  }
+
+  FontRasterMode const mode = font.gpu_atlas.v().mode;
+
+  // the property is per-library, so each shard's library needs it too
+  if (mode == FontRasterMode::Sdf && set_sdf_spread(lib) != 0)
+  {
+    face = nullptr;
+    return;
+  }
+
+  if (FT_Error err =
+        FT_New_Memory_Face(lib, (FT_Byte const *) font.font_data.data(),
+                           (FT_Long) font.font_data.size(),
+                           (FT_Long) font.face, &face);
+      err != 0)
+  {
+    face = nullptr;
+    return;
+  }
+
+  if (FT_Error err =
+        FT_Set_Pixel_Sizes(face, job.font_height, job.font_height);
+      err != 0)
+  {
+    FT_Done_Face(face);
+    face = nullptr;
+    return;
+  }
 
-    Vec<rect_pack::Node> nodes{allocator_};
-    u32 const            num_nodes = atlas_extent.x();
-    nodes.resize_uninit(num_nodes).unwrap();
+  Slice32 const range = job.ranges[shard];
 
-    Span<rect_pack::rect> unpacked = rects;
+  for (u32 i = range.begin(); i < range.end(); i++)
+  {
+    GlyphRaster & r = job.rasters[i];
 
-    while (!unpacked.is_empty())
+    if (FT_Error err = FT_Load_Glyph(face, job.glyphs[i],
+                                     FT_LOAD_DEFAULT | FT_LOAD_COLOR);
+        err != 0)
     {
-      // tries to pack all the glyph rects into the provided extent
-      rect_pack::Context ctx;
-      rect_pack::init(ctx, atlas_extent.to<i32>(), nodes.data(),
-                      (i32) num_nodes);
-      rect_pack::pack_rects(ctx, unpacked.data(), (i32) size32(unpacked));
+      continue;
+    }
 
-      auto [just_packed, still_unpacked] = partition(
-        unpacked, [](rect_pack::rect const & r) { return r.was_packed; });
+    r.format = glyph_format(face->glyph, mode);
+    r.extent = glyph_extent(face->glyph, r.format);
+  }
+}
 
-      CHECK(!just_packed.is_empty(), "");
+/// @brief render the shard's packed glyphs into their disjoint staging
+/// regions and release the shard's face
+static void render_glyphs(GlyphRasterJob & job, u32 shard)
+{
+  FT_Library lib  = job.ft_libs[shard];
+  FT_Face    face = job.ft_faces[shard];
 
-      for (rect_pack::rect const & r : just_packed)
-      {
-        atlas.glyphs[r.id].layer = num_layers;
-      }
+  defer lib_{[&] {
+    if (face != nullptr)
+    {
+      FT_Done_Face(face);
+    }
+    if (lib != nullptr)
+    {
+      FT_Done_FreeType(lib);
+    }
+  }};
+
+  if (face == nullptr)
+  {
+    return;
+  }
+
+  GpuFontAtlas & atlas = job.font->gpu_atlas.v();
+  Slice32 const  range = job.ranges[shard];
 
-      unpacked = still_unpacked;
+  for (u32 i = range.begin(); i < range.end(); i++)
+  {
+    GlyphRaster & r     = job.rasters[i];
+    u32 const     glyph = job.glyphs[i];
 
-      num_layers++;
+    // empty glyph
+    if (r.area.extent.x() == 0)
+    {
+      continue;
     }
 
-    for (auto [i, r] : enumerate(rects))
+    FT_Error err =
+      FT_Load_Glyph(face, glyph, FT_LOAD_DEFAULT | FT_LOAD_COLOR);
+
+    if (err == 0)
     {
-      auto & g = atlas.glyphs[r.id];
+      err = render_glyph(face->glyph, r.format);
+    }
 
-      if (g.area.extent.x() == 0 | g.area.extent.y() == 0)
-      {
-        g.area.offset = u32x2{};
-      }
-      else
-      {
-        // adjust back to original position from the padded position
-        g.area.offset = (r.pos + GLYPH_PADDING).to<u32>();
-      }
+    FT_Bitmap const & bitmap = face->glyph->bitmap;
 
-      g.uv[0] = g.area.offset.to<f32>() * inv_atlas_extent;
-      g.uv[1] = g.area.end().to<f32>() * inv_atlas_extent;
+    // the preset metrics didn't match the rendered bitmap, i.e. layered color
+    // glyphs. Leave the glyph to be rasterized on first use.
+    if (err != 0 ||
+        (bitmap.pixel_mode == FT_PIXEL_MODE_BGRA) !=
+          (r.format == GlyphAtlasFormat::Color) ||
+        bitmap.width != r.extent.x() || bitmap.rows != r.extent.y())
+    {
+      atlas.glyphs[glyph] = AtlasGlyph{};
+      continue;
     }
+
+    stage_glyph(bitmap, job.staging.view().slice(r.offset), r.area.extent,
+                r.extent);
+    r.rendered = true;
   }
+}
+
+FontId FontSysImpl::upload_(Dyn<Font> font_, GlyphRasterJob const & prewarm)
+{
+  FontImpl & font = (FontImpl &) *font_.get();
+  CHECK(font.gpu_atlas.is_some(), "");
 
-  u64 const atlas_layer_size =
-    (u64) atlas_extent.x() * (u64) atlas_extent.y() * 4;
-  u64 const atlas_size = atlas_layer_size * num_layers;
+  GpuFontAtlas & atlas = font.gpu_atlas.v();
 
-  if (!atlas.channels.resize(atlas_size))
+  // the first layer is created eagerly so empty glyphs always have a texture
+  // to reference
+  if (atlas.layers.is_empty())
   {
-    return Err{};
+    add_layer_(font, GlyphAtlasFormat::Alpha);
+  }
+
+  for (u32 i = 0; i < atlas.num_layers(); i++)
+  {
+    create_layer_image_(font, i);
   }
 
-  ImageLayerSpan<u8, 4> atlas_span{
-    .channels = atlas.channels, .extent = atlas_extent, .layers = num_layers};
+  u64 const base = align_offset_up<u64>(4, size(staging_));
+  staging_.resize(base).unwrap();
+  staging_.extend(prewarm.staging).unwrap();
 
-  for (auto [i, ag] : enumerate<u32>(atlas.glyphs))
+  for (auto [glyph, r] : zip(prewarm.glyphs, prewarm.rasters))
   {
-    if (FT_Error err = FT_Load_Glyph(
-          font.ft_face, i, FT_LOAD_DEFAULT | FT_LOAD_COLOR | FT_LOAD_RENDER);
-        err != 0)
+    if (r.area.extent.x() == 0)
     {
       continue;
     }
 
-    FT_GlyphSlot slot = font.ft_face->glyph;
-
-    /// we don't want to handle negative pitches
-    CHECK(slot->bitmap.pitch >= 0, "");
+    GlyphAtlasLayer & layer = atlas.layers[r.layer];
 
-    switch (slot->bitmap.pixel_mode)
+    if (!r.rendered)
     {
-      case FT_PIXEL_MODE_GRAY:
+      // release the area of the glyphs that failed to render
+      for (auto [i, g] : enumerate<u32>(layer.glyphs))
       {
-        ImageSpan<u8 const, 1> src{
-          .channels{slot->bitmap.buffer,
-                    slot->bitmap.rows * (u32) slot->bitmap.pitch},
-          .extent{slot->bitmap.width,  slot->bitmap.rows      },
-          .stride = (u32) slot->bitmap.pitch
-        };
-
-        copy_alpha_image_to_BGRA(
-          src, atlas_span.layer(ag.layer).slice(ag.area.offset, ag.area.extent),
-          (u8) 0xFFU, (u8) 0xFFU, (u8) 0xFFU);
-
-        ag.has_color = false;
+        if (g == glyph)
+        {
+          layer.glyphs.erase(i, 1);
+          break;
+        }
       }
-      break;
-      case FT_PIXEL_MODE_BGRA:
-      {
-        ImageSpan<u8 const, 4> src{
-          .channels{slot->bitmap.buffer,
-                    slot->bitmap.rows * (u32) slot->bitmap.pitch},
-          .extent{slot->bitmap.width,  slot->bitmap.rows      },
-          .stride = (u32) slot->bitmap.pitch / 4
-        };
+      continue;
+    }
 
-        copy_image(src, atlas_span.layer(ag.layer).slice(ag.area.offset,
-                                                         ag.area.extent));
+    uploads_
+      .push(GlyphUpload{.image  = sys.image->get(layer.image).image,
+                        .area   = r.area,
+                        .offset = base + r.offset})
+      .unwrap();
+  }
 
-        ag.has_color = true;
-      }
-      break;
-      default:
-        CHECK(false, "Unrecognized pixel mode {}", slot->bitmap.pixel_mode);
-    }
+  FontId id = FontId{fonts_.push(std::move(font_)).unwrap()};
+
+  return id;
+}
+
+void FontSysImpl::pack_raster_(FontImpl & font, u32 glyph, GlyphRaster & r)
+{
+  GpuFontAtlas & atlas = font.gpu_atlas.v();
+
+  if (r.extent.x() == 0 | r.extent.y() == 0)
+  {
+    atlas.glyphs[glyph] = AtlasGlyph{
+      .has_color = r.format == GlyphAtlasFormat::Color, .layer = 0};
+    r.area = RectU{};
+    return;
   }
 
-  atlas.font_height = font_height;
-  atlas.extent      = atlas_extent;
-  atlas.num_layers  = num_layers;
+  u32x2 const padded_extent = r.extent + GLYPH_PADDING * 2;
 
-  font.cpu_atlas = std::move(atlas);
+  auto [layer, pos] = pack_glyph_(font, glyph, padded_extent, r.format, false);
 
-  return Ok{};
+  atlas.glyphs[glyph] =
+    place_glyph(layer, pos, r.extent, r.format, atlas.extent);
+
+  r.layer = layer;
+  r.area  = RectU{.offset = pos, .extent = padded_extent};
 }
 
-FontId FontSysImpl::upload_(Dyn<Font> font_)
+void FontSysImpl::prewarm_(Dyn<Font> font_, u32 font_height,
+                           FontCacheKey const &                key,
+                           Future<Result<FontId, FontLoadErr>> fut)
 {
   FontImpl & font = (FontImpl &) *font_.get();
-  CHECK(font.cpu_atlas.is_some(), "");
-  CHECK(font.gpu_atlas.is_none(), "");
 
-  CpuFontAtlas & atlas = font.cpu_atlas.v();
+  Rc<GlyphRasterJob *> job =
+    rc<GlyphRasterJob>(inplace, allocator_, allocator_).unwrap();
+
+  job->font        = &font;
+  job->font_height = font_height;
 
-  CHECK(atlas.num_layers > 0, "");
-  CHECK(atlas.extent.x() > 0, "");
-  CHECK(atlas.extent.y() > 0, "");
+  auto add_glyph = [&](u32 glyph) {
+    if (!contains(job->glyphs, glyph))
+    {
+      job->glyphs.push(glyph).unwrap();
+    }
+  };
 
-  GpuFontAtlas gpu_atlas{.textures{allocator_},
-                         .font_height = atlas.font_height,
-                         .extent      = atlas.extent,
-                         .glyphs{allocator_}};
+  add_glyph(font.replacement_glyph);
+  add_glyph(font.ellipsis_glyph);
 
-  gpu_atlas.glyphs.extend(atlas.glyphs).unwrap();
+  for (Slice32 codepoints : PREWARM_CODEPOINTS)
+  {
+    for (u32 c = codepoints.begin(); c < codepoints.end(); c++)
+    {
+      // unmapped codepoints resolve to the replacement glyph
+      if (u32 const glyph = FT_Get_Char_Index(font.ft_face, c); glyph != 0)
+      {
+        add_glyph(glyph);
+      }
+    }
+  }
 
-  constexpr gpu::Format   format = gpu::Format::B8G8R8A8_UNORM;
-  Vec<gpu::ImageViewInfo> view_infos;
+  u32 const num_glyphs = size32(job->glyphs);
+  u32 const num_shards =
+    max(min(num_glyphs / MIN_GLYPHS_PER_SHARD, scheduler->num_workers()), 1U);
 
-  for (u32 i = 0; i < atlas.num_layers; i++)
+  for (u32 i = 0; i < num_shards; i++)
   {
-    view_infos
-      .push(gpu::ImageViewInfo{
-        .label        = font.label,
-        .view_type    = gpu::ImageViewType::Type2D,
-        .view_format  = format,
-        .mapping      = {},
-        .aspects      = gpu::ImageAspects::Color,
-        .mip_levels   = {0, 1},
-        .array_layers = {i, 1}
-    })
+    job->ranges
+      .push(Slice32::range(i * num_glyphs / num_shards,
+                           (i + 1) * num_glyphs / num_shards))
       .unwrap();
   }
 
-  ImageInfo image =
-    sys.image
-      ->load_from_memory(font.label.clone().unwrap(),
-                         gpu::ImageInfo{.label  = font.label,
-                                        .type   = gpu::ImageType::Type2D,
-                                        .format = format,
-                                        .usage  = gpu::ImageUsage::Sampled |
-                                                 gpu::ImageUsage::TransferDst |
-                                                 gpu::ImageUsage::TransferSrc,
-                                        .aspects    = gpu::ImageAspects::Color,
-                                        .extent     = atlas.extent.append(1),
-                                        .mip_levels = 1,
-                                        .array_layers = atlas.num_layers,
-                                        .sample_count = gpu::SampleCount::C1},
-                         view_infos, atlas.channels)
-      .unwrap();
+  job->rasters.resize(num_glyphs).unwrap();
+  job->ft_libs.resize(num_shards).unwrap();
+  job->ft_faces.resize(num_shards).unwrap();
 
-  gpu_atlas.textures.extend(image.textures).unwrap();
-  gpu_atlas.image = image.id;
+  scheduler->shard<GlyphRasterJob *>(
+    job.alias(),
+    [](TaskInstance shard, GlyphRasterJob * job) {
+      measure_glyphs(*job, (u32) shard.idx);
+      std::atomic_ref{job->num_measured}.fetch_add(1,
+                                                   std::memory_order_release);
+    },
+    num_shards);
 
-  font.gpu_atlas = std::move(gpu_atlas);
+  // pack once all the glyphs have been measured
+  scheduler->once(
+    [this, job = job.alias(), font_ = std::move(font_), key,
+     fut = std::move(fut)]() mutable {
+      FontImpl & font   = (FontImpl &) *font_.get();
+      u64        offset = 0;
 
-  // unload CPU atlas
-  font.cpu_atlas = none;
+      for (auto [shard, range] : enumerate<u32>(job->ranges))
+      {
+        // the shard's face failed to load, leave its glyphs to be rasterized
+        // on first use
+        if (job->ft_faces[shard] == nullptr)
+        {
+          continue;
+        }
 
-  FontId id = FontId{fonts_.push(std::move(font_)).unwrap()};
+        for (u32 i = range.begin(); i < range.end(); i++)
+        {
+          GlyphRaster & r = job->rasters[i];
 
-  return id;
-}
+          pack_raster_(font, job->glyphs[i], r);
 
-Future<Result<FontId, FontLoadErr>>
-  FontSysImpl::load_from_memory(Vec<char> label, Vec<u8> encoded,
-                                u32 font_height, u32 face)
-{
-  Future fut = future<Result<FontId, FontLoadErr>>(allocator_).unwrap();
-  scheduler->once(
-    [fut = fut.alias(), encoded = std::move(encoded), label = std::move(label),
-     this, face, font_height]() mutable {
-      decode_(label, encoded, face)
-        .match(
-          [&, this](Dyn<Font> & font) {
-            trace("Rasterizing font: {} @{}px"_str, label, font_height);
-            rasterize(font, font_height)
-              .match(
-                [&, this](Void) {
-                  scheduler->once(
-                    [font = std::move(font), this,
-                     fut  = std::move(fut)]() mutable {
-                      trace("Rasterized font {}, num layers = {}"_str,
-                            font->info().label,
-                            font->info().cpu_atlas.v().num_layers);
-
-                      FontId id = upload_(std::move(font));
-
-                      fut.yield(Ok{id}).unwrap();
-                    },
-                    Ready{}, ThreadId::Main);
-                },
-                [&](Void) {
-                  fut.yield(Err{FontLoadErr::OutOfMemory}).unwrap();
-                });
-          },
-          [&](FontLoadErr err) { fut.yield(Err{err}).unwrap(); });
-    },
-    Ready{}, ThreadId::AnyWorker);
+          if (r.area.extent.x() == 0)
+          {
+            continue;
+          }
 
-  return fut;
-}
+          // keep the offsets texel-aligned for the copies to the BGRA layers
+          offset   = align_offset_up<u64>(4, offset);
+          r.offset = offset;
+          offset +=
+            pixel_size_bytes(r.area.extent, glyph_pixel_size(r.format));
+        }
+      }
 
-Future<Result<FontId, FontLoadErr>> FontSysImpl::load_from_path(Vec<char> label,
-                                                                Str       path,
-                                                                u32 font_height,
-                                                                u32 face)
-{
-  Future file_load_fut = sys.file->load_file(allocator_, path);
+      // zeroed, the padding of each glyph must be transparent
+      job->staging.resize(offset).unwrap();
 
-  Future fut = future<Result<FontId, FontLoadErr>>(allocator_).unwrap();
+      scheduler->shard<GlyphRasterJob *>(
+        job.alias(),
+        [](TaskInstance shard, GlyphRasterJob * job) {
+          render_glyphs(*job, (u32) shard.idx);
+          std::atomic_ref{job->num_rendered}.fetch_add(
+            1, std::memory_order_release);
+        },
+        job->num_shards());
 
-  scheduler->once(
-    [file_load_fut = file_load_fut.alias(), fut = fut.alias(), this,
-     label = std::move(label), font_height, face]() mutable {
-      file_load_fut.get().match(
-        [&](Vec<u8> & encoded) {
-          Future mem_load_fut = load_from_memory(
-            std::move(label), std::move(encoded), font_height, face);
+      scheduler->once(
+        [this, job = job.alias(), font_ = std::move(font_), key,
+         fut = std::move(fut)]() mutable {
+          trace("Rasterized {} glyphs of font {} @{}px over {} shards"_str,
+                size(job->glyphs), font_->info().label, job->font_height,
+                job->num_shards());
 
-          scheduler->once(
-            [fut = fut.alias(), mem_load_fut = mem_load_fut.alias()]() {
-              fut.yield(mem_load_fut.get()).unwrap();
-            },
-            AwaitFutures{mem_load_fut.alias()}, ThreadId::AnyWorker);
+          if (!cache_dir_.is_empty())
+          {
+            store_cache_(key, (FontImpl const &) *font_.get(), *job);
+          }
+
+          FontId id = upload_(std::move(font_), *job);
+
+          fut.yield(Ok{id}).unwrap();
         },
-        [&](IoErr err) {
-          fut
-            .yield(Err{err == IoErr::InvalidFileOrDir ?
-                         FontLoadErr::InvalidPath :
-                         FontLoadErr::IoErr})
-            .unwrap();
-        });
+        [job = job.alias()] {
+          return std::atomic_ref{job->num_rendered}.load(
+                   std::memory_order_acquire) == job->num_shards();
+        },
+        ThreadId::Main);
     },
-    AwaitFutures{file_load_fut.alias()});
-
-  return fut;
+    [job = job.alias()] {
+      return std::atomic_ref{job->num_measured}.load(
+               std::memory_order_acquire) == job->num_shards();
+    });
 }
 
-FontInfo FontSysImpl::get(FontId id)
+void FontSysImpl::restore_(Dyn<Font> font_, u32 font_height, FontCache cache,
+                           Future<Result<FontId, FontLoadErr>> fut)
 {
-  CHECK(fonts_.is_valid_id((usize) id), "");
-  return fonts_[(usize) id].v0->info();
-}
+  FontImpl & font = (FontImpl &) *font_.get();
 
-Option<FontInfo> FontSysImpl::get(Str label)
-{
-  for (auto & font : fonts_.dense.v0)
+  Rc<GlyphRasterJob *> job =
+    rc<GlyphRasterJob>(inplace, allocator_, allocator_).unwrap();
+
+  job->font        = &font;
+  job->font_height = font_height;
+  job->glyphs      = std::move(cache.raster_glyphs);
+  job->rasters     = std::move(cache.rasters);
+  job->staging     = std::move(cache.staging);
+
+  for (auto [glyph, r] : zip(job->glyphs, job->rasters))
   {
-    if (mem::eq(label, font->info().label))
-    {
-      return font->info();
-    }
+    pack_raster_(font, glyph, r);
   }
 
-  return none;
+  scheduler->once(
+    [this, job = job.alias(), font_ = std::move(font_),
+     fut = std::move(fut)]() mutable {
+      trace("Restored {} cached glyphs of font {} @{}px"_str,
+            size(job->glyphs), font_->info().label, job->font_height);
+
+      FontId id = upload_(std::move(font_), *job);
+
+      fut.yield(Ok{id}).unwrap();
+    },
+    Ready{}, ThreadId::Main);
+}
+
+/// @brief Header of a font cache file. It is followed by the glyph metrics,
+/// the coverage pages and bits, the prewarmed glyphs and their rasters, and
+/// their staging buffer. All fields of the file are fixed-width little-endian
+/// integers, written field by field so the file doesn't depend on the
+/// in-memory layout of the cached structs.
+struct FontCacheHeader
+{
+  /// @brief "ASFONTCH"
+  static constexpr u64 MAGIC = 0x4843'544E'4F46'5341ULL;
+
+  /// @brief bumped whenever the layout of the file changes
+  static constexpr u32 VERSION = 2;
+
+  /// @brief size of the header in the file
+  static constexpr usize SIZE = 56;
+
+  /// @brief size of a glyph's metrics in the file
+  static constexpr usize GLYPH_SIZE = 20;
+
+  /// @brief size of a prewarmed glyph and its raster in the file
+  static constexpr usize RASTER_SIZE = 42;
+
+  u64 magic              = MAGIC;
+  u32 version            = VERSION;
+  u32 face               = 0;
+  u64 font_hash          = 0;
+  u32 font_height        = 0;
+  u32 mode               = 0;
+  u32 num_glyphs         = 0;
+  u32 num_coverage_pages = 0;
+  u32 num_coverage_words = 0;
+  u32 num_rasters        = 0;
+  u64 staging_size       = 0;
+};
+
+/// @brief Appends fixed-width little-endian integers to a font cache blob
+struct FontCacheWriter
+{
+  Vec<u8> & blob;
+
+  template <typename T>
+  requires (std::is_unsigned_v<T>)
+  void write(T value)
+  {
+    for (usize i = 0; i < sizeof(T); i++)
+    {
+      blob.push((u8) (value >> (i * 8))).unwrap();
+    }
+  }
+};
+
+/// @brief Reads fixed-width little-endian integers from a font cache blob.
+/// Reading past the end of the blob yields zeros and clears `ok`.
+struct FontCacheReader
+{
+  Span<u8 const> blob;
+
+  usize offset = 0;
+
+  bool ok = true;
+
+  /// @brief if `n` more elements of `size` bytes can be read
+  bool has(usize n, usize size) const
+  {
+    return n <= ((blob.size() - offset) / size);
+  }
+
+  template <typename T>
+  requires (std::is_unsigned_v<T>)
+  T read()
+  {
+    if (!has(1, sizeof(T)))
+    {
+      ok = false;
+      return 0;
+    }
+
+    T value = 0;
+
+    for (usize i = 0; i < sizeof(T); i++)
+    {
+      value |= (T) ((T) blob[offset + i] << (i * 8));
+    }
+
+    offset += sizeof(T);
+
+    return value;
+  }
+};
+
+static void write_cache_header(FontCacheWriter & w, FontCacheHeader const & h)
+{
+  w.write(h.magic);
+  w.write(h.version);
+  w.write(h.face);
+  w.write(h.font_hash);
+  w.write(h.font_height);
+  w.write(h.mode);
+  w.write(h.num_glyphs);
+  w.write(h.num_coverage_pages);
+  w.write(h.num_coverage_words);
+  w.write(h.num_rasters);
+  w.write(h.staging_size);
+}
+
+static FontCacheHeader read_cache_header(FontCacheReader & r)
+{
+  FontCacheHeader h;
+  h.magic              = r.read<u64>();
+  h.version            = r.read<u32>();
+  h.face               = r.read<u32>();
+  h.font_hash          = r.read<u64>();
+  h.font_height        = r.read<u32>();
+  h.mode               = r.read<u32>();
+  h.num_glyphs         = r.read<u32>();
+  h.num_coverage_pages = r.read<u32>();
+  h.num_coverage_words = r.read<u32>();
+  h.num_rasters        = r.read<u32>();
+  h.staging_size       = r.read<u64>();
+  return h;
+}
+
+static void write_cache_glyph(FontCacheWriter & w, GlyphMetrics const & m)
+{
+  w.write((u32) m.bearing.x());
+  w.write((u32) m.bearing.y());
+  w.write((u32) m.advance);
+  w.write((u32) m.extent.x());
+  w.write((u32) m.extent.y());
+}
+
+static GlyphMetrics read_cache_glyph(FontCacheReader & r)
+{
+  GlyphMetrics m;
+  m.bearing.x() = (i32) r.read<u32>();
+  m.bearing.y() = (i32) r.read<u32>();
+  m.advance     = (i32) r.read<u32>();
+  m.extent.x()  = (i32) r.read<u32>();
+  m.extent.y()  = (i32) r.read<u32>();
+  return m;
+}
+
+static void write_cache_raster(FontCacheWriter & w, u32 glyph,
+                               GlyphRaster const & r)
+{
+  w.write(glyph);
+  w.write(r.extent.x());
+  w.write(r.extent.y());
+  w.write((u8) r.format);
+  w.write((u8) r.rendered);
+  w.write(r.layer);
+  w.write(r.area.offset.x());
+  w.write(r.area.offset.y());
+  w.write(r.area.extent.x());
+  w.write(r.area.extent.y());
+  w.write(r.offset);
+}
+
+static GlyphRaster read_cache_raster(FontCacheReader & r, u32 & glyph)
+{
+  GlyphRaster raster;
+  glyph                  = r.read<u32>();
+  raster.extent.x()      = r.read<u32>();
+  raster.extent.y()      = r.read<u32>();
+  raster.format          = (GlyphAtlasFormat) r.read<u8>();
+  raster.rendered        = r.read<u8>() != 0;
+  raster.layer           = r.read<u32>();
+  raster.area.offset.x() = r.read<u32>();
+  raster.area.offset.y() = r.read<u32>();
+  raster.area.extent.x() = r.read<u32>();
+  raster.area.extent.y() = r.read<u32>();
+  raster.offset          = r.read<u64>();
+  return raster;
+}
+
+/// @brief path of the key's cache file in `dir`
+static Result<> font_cache_path(Str dir, FontCacheKey const & key,
+                                Vec<char> & path)
+{
+  static constexpr char DIGITS[] = "0123456789abcdef";
+
+  usize const hash =
+    hash_combine((usize) key.font_hash, (usize) key.face,
+                 (usize) key.font_height, (usize) key.mode);
+
+  InplaceVec<char, 32> name;
+
+  for (u32 i = 0; i < 16; i++)
+  {
+    name.push(DIGITS[(hash >> (60 - i * 4)) & 0xF]).unwrap();
+  }
+
+  name.extend(".font"_str).unwrap();
+
+  return path_join(dir, name.view(), path);
+}
+
+void FontSysImpl::set_cache_dir(Str dir)
+{
+  cache_dir_.clear();
+  cache_dir_.extend(dir).unwrap();
+}
+
+Option<FontCache> FontSysImpl::load_cache_(FontCacheKey const & key)
+{
+  if (cache_dir_.is_empty())
+  {
+    return none;
+  }
+
+  Vec<char> path{allocator_};
+  font_cache_path(cache_dir_, key, path).unwrap();
+
+  Vec<u8> blob{allocator_};
+
+  if (!read_file(path, blob) || blob.size() < FontCacheHeader::SIZE)
+  {
+    return none;
+  }
+
+  FontCacheReader       reader{.blob = blob};
+  FontCacheHeader const header = read_cache_header(reader);
+
+  if (header.magic != FontCacheHeader::MAGIC ||
+      header.version != FontCacheHeader::VERSION ||
+      header.font_hash != key.font_hash || header.face != key.face ||
+      header.font_height != key.font_height ||
+      header.mode != (u32) key.mode)
+  {
+    return none;
+  }
+
+  // the counts are checked against the size of the file before anything is
+  // allocated for them
+  if (!reader.has(header.num_glyphs, FontCacheHeader::GLYPH_SIZE) ||
+      !reader.has(header.num_coverage_pages, sizeof(u16)) ||
+      !reader.has(header.num_coverage_words, sizeof(u64)) ||
+      !reader.has(header.num_rasters, FontCacheHeader::RASTER_SIZE) ||
+      !reader.has(header.staging_size, 1))
+  {
+    warn("Font cache {} is truncated"_str, path);
+    return none;
+  }
+
+  FontCache cache{allocator_};
+
+  cache.glyphs.resize_uninit(header.num_glyphs).unwrap();
+  for (GlyphMetrics & m : cache.glyphs)
+  {
+    m = read_cache_glyph(reader);
+  }
+
+  cache.coverage.pages.resize_uninit(header.num_coverage_pages).unwrap();
+  for (u16 & page : cache.coverage.pages)
+  {
+    page = reader.read<u16>();
+  }
+
+  cache.coverage.bits.resize_uninit(header.num_coverage_words).unwrap();
+  for (u64 & word : cache.coverage.bits)
+  {
+    word = reader.read<u64>();
+  }
+
+  cache.raster_glyphs.resize_uninit(header.num_rasters).unwrap();
+  cache.rasters.resize_uninit(header.num_rasters).unwrap();
+  for (auto [glyph, r] : zip(cache.raster_glyphs, cache.rasters))
+  {
+    r = read_cache_raster(reader, glyph);
+  }
+
+  if (!reader.has(header.staging_size, 1))
+  {
+    reader.ok = false;
+  }
+  else
+  {
+    cache.staging.extend(blob.view().slice(reader.offset, header.staging_size))
+      .unwrap();
+    reader.offset += header.staging_size;
+  }
+
+  if (!reader.ok)
+  {
+    warn("Font cache {} is truncated"_str, path);
+    return none;
+  }
+
+  // the cache file is untrusted, validate all the indices and extents it
+  // provides
+  u64 const num_pages =
+    cache.coverage.bits.size() / FontCoverage::WORDS_PER_PAGE;
+
+  bool valid = cache.coverage.pages.is_empty() ||
+               cache.coverage.pages.size() == FontCoverage::NUM_PAGES;
+
+  for (u16 page : cache.coverage.pages)
+  {
+    valid = valid && (page == FontCoverage::NO_PAGE || page < num_pages);
+  }
+
+  for (auto [glyph, r] : zip(cache.raster_glyphs, cache.rasters))
+  {
+    if (glyph >= header.num_glyphs ||
+        (u8) r.format > (u8) GlyphAtlasFormat::Sdf)
+    {
+      valid = false;
+      break;
+    }
+
+    if (r.extent.x() == 0 | r.extent.y() == 0)
+    {
+      continue;
+    }
+
+    u32x2 const padded_extent = r.extent + GLYPH_PADDING * 2;
+    u64 const   pixels_size =
+      pixel_size_bytes(padded_extent, glyph_pixel_size(r.format));
+
+    if (!r.rendered || padded_extent.x() > ATLAS_EXTENT ||
+        padded_extent.y() > ATLAS_EXTENT || r.offset > header.staging_size ||
+        pixels_size > (header.staging_size - r.offset))
+    {
+      valid = false;
+      break;
+    }
+  }
+
+  if (!valid)
+  {
+    warn("Font cache {} is corrupted"_str, path);
+    return none;
+  }
+
+  trace("Loaded font cache {}"_str, path);
+
+  return Option<FontCache>{std::move(cache)};
+}
+
+void FontSysImpl::store_cache_(FontCacheKey const & key, FontImpl const & font,
+                               GlyphRasterJob const & job)
+{
+  Vec<u32>         glyphs{allocator_};
+  Vec<GlyphRaster> rasters{allocator_};
+
+  // the glyphs left to be rasterized on first use are not cached
+  for (auto [shard, range] : enumerate<u32>(job.ranges))
+  {
+    if (job.ft_faces[shard] == nullptr)
+    {
+      continue;
+    }
+
+    for (u32 i = range.begin(); i < range.end(); i++)
+    {
+      GlyphRaster const & r     = job.rasters[i];
+      bool const          empty = r.extent.x() == 0 | r.extent.y() == 0;
+
+      if (empty || r.rendered)
+      {
+        glyphs.push(job.glyphs[i]).unwrap();
+        rasters.push(r).unwrap();
+      }
+    }
+  }
+
+  FontCacheHeader const header{
+    .face               = key.face,
+    .font_hash          = key.font_hash,
+    .font_height        = key.font_height,
+    .mode               = (u32) key.mode,
+    .num_glyphs         = size32(font.glyphs),
+    .num_coverage_pages = size32(font.coverage.pages),
+    .num_coverage_words = size32(font.coverage.bits),
+    .num_rasters        = size32(glyphs),
+    .staging_size       = size(job.staging)};
+
+  Vec<u8> blob{allocator_};
+
+  blob
+    .reserve(FontCacheHeader::SIZE +
+             size(font.glyphs) * FontCacheHeader::GLYPH_SIZE +
+             size(font.coverage.pages) * sizeof(u16) +
+             size(font.coverage.bits) * sizeof(u64) +
+             size(glyphs) * FontCacheHeader::RASTER_SIZE + size(job.staging))
+    .unwrap();
+
+  FontCacheWriter writer{.blob = blob};
+
+  write_cache_header(writer, header);
+
+  for (GlyphMetrics const & m : font.glyphs)
+  {
+    write_cache_glyph(writer, m);
+  }
+
+  for (u16 page : font.coverage.pages)
+  {
+    writer.write(page);
+  }
+
+  for (u64 word : font.coverage.bits)
+  {
+    writer.write(word);
+  }
+
+  for (auto [glyph, r] : zip(glyphs, rasters))
+  {
+    write_cache_raster(writer, glyph, r);
+  }
+
+  blob.extend(job.staging).unwrap();
+
+  Vec<char> path{allocator_};
+  font_cache_path(cache_dir_, key, path).unwrap();
+
+  scheduler->once(
+    [path = std::move(path), blob = std::move(blob)]() {
+      write_to_file(path, blob, false)
+        .match([&](Void) { trace("Saved font cache to {}"_str, path); },
+               [&](IoErr err) {
+                 warn("Error {} writing font cache to {}"_str, err, path);
+               });
+    },
+    Ready{}, ThreadId::AnyWorker);
+}
+
+u32 FontSysImpl::add_layer_(FontImpl & font, GlyphAtlasFormat format)
+{
+  GpuFontAtlas & atlas = font.gpu_atlas.v();
+  u32 const      layer = atlas.num_layers();
+
+  atlas.layers
+    .push(GlyphAtlasLayer{.format   = format,
+                          .image    = ImageId::None,
+                          .texture  = TextureIndex::White,
+                          .last_use = 0,
+                          .glyphs{allocator_}})
+    .unwrap();
+  atlas.textures.push(TextureIndex::White).unwrap();
+
+  GlyphPacker packer{.ctx = dyn<rect_pack::Context>(inplace, allocator_).unwrap(),
+                     .nodes{allocator_}};
+  u32 const   num_nodes = atlas.extent.x();
+  packer.nodes.resize_uninit(num_nodes).unwrap();
+  rect_pack::init(*packer.ctx, atlas.extent.to<i32>(), packer.nodes.data(),
+                  (i32) num_nodes);
+
+  font.packers.push(std::move(packer)).unwrap();
+
+  return layer;
+}
+
+void FontSysImpl::create_layer_image_(FontImpl & font, u32 layer)
+{
+  GpuFontAtlas &    atlas = font.gpu_atlas.v();
+  GlyphAtlasLayer & l     = atlas.layers[layer];
+
+  CHECK(l.image == ImageId::None, "");
+
+  gpu::Format           format  = gpu::Format::B8G8R8A8_UNORM;
+  gpu::ComponentMapping mapping = {};
+
+  if (l.format == GlyphAtlasFormat::Alpha)
+  {
+    // sample coverage as white so alpha and color layers shade identically
+    format  = gpu::Format::R8_UNORM;
+    mapping = gpu::ComponentMapping{.r = gpu::ComponentSwizzle::One,
+                                    .g = gpu::ComponentSwizzle::One,
+                                    .b = gpu::ComponentSwizzle::One,
+                                    .a = gpu::ComponentSwizzle::ComponentR};
+  }
+  else if (l.format == GlyphAtlasFormat::Sdf)
+  {
+    // the distance field is sampled from the red channel by the text shader
+    format = gpu::Format::R8_UNORM;
+  }
+
+  ImageInfo image = sys.image->create_image_(
+    font.label.clone().unwrap(),
+    gpu::ImageInfo{.label  = font.label,
+                   .type   = gpu::ImageType::Type2D,
+                   .format = format,
+                   .usage  = gpu::ImageUsage::Sampled |
+                            gpu::ImageUsage::TransferDst |
+                            gpu::ImageUsage::TransferSrc,
+                   .aspects      = gpu::ImageAspects::Color,
+                   .extent       = atlas.extent.append(1),
+                   .mip_levels   = 1,
+                   .array_layers = 1,
+                   .sample_count = gpu::SampleCount::C1},
+    span({
+      gpu::ImageViewInfo{.label        = font.label,
+                         .view_type    = gpu::ImageViewType::Type2D,
+                         .view_format  = format,
+                         .mapping      = mapping,
+                         .aspects      = gpu::ImageAspects::Color,
+                         .mip_levels   = {0, 1},
+                         .array_layers = {0, 1}}
+  }));
+
+  l.image               = image.id;
+  l.texture             = image.textures[0];
+  atlas.textures[layer] = image.textures[0];
+
+  u64 const size      = atlas.size_bytes();
+  u64 const bgra_size = pixel_size_bytes(atlas.extent, 4) * atlas.num_layers();
+
+  trace("Added {} atlas layer {} to font {}, atlas size = {} bytes, saved {} "
+        "bytes over BGRA layers"_str,
+        l.format == GlyphAtlasFormat::Color ? "BGRA"_str : "R8"_str, layer,
+        font.label, size, bgra_size - size);
+}
+
+void FontSysImpl::evict_layer_(FontImpl & font, u32 layer)
+{
+  GpuFontAtlas &    atlas = font.gpu_atlas.v();
+  GlyphAtlasLayer & l     = atlas.layers[layer];
+  GlyphPacker &     p     = font.packers[layer];
+
+  trace("Evicting {} glyphs from font atlas layer {} of {}"_str,
+        size(l.glyphs), layer, font.label);
+
+  for (u32 glyph : l.glyphs)
+  {
+    atlas.glyphs[glyph] = AtlasGlyph{};
+  }
+
+  l.glyphs.clear();
+
+  rect_pack::init(*p.ctx, atlas.extent.to<i32>(), p.nodes.data(),
+                  (i32) size32(p.nodes));
+}
+
+Tuple<u32, u32x2> FontSysImpl::pack_glyph_(FontImpl & font, u32 glyph,
+                                           u32x2            padded_extent,
+                                           GlyphAtlasFormat format,
+                                           bool             can_evict)
+{
+  GpuFontAtlas & atlas = font.gpu_atlas.v();
+
+  CHECK(padded_extent.x() <= atlas.extent.x(), "");
+  CHECK(padded_extent.y() <= atlas.extent.y(), "");
+
+  rect_pack::rect rect{.id         = glyph,
+                       .extent     = padded_extent.to<i32>(),
+                       .pos        = {},
+                       .was_packed = false};
+
+  u32 layer = 0;
+
+  for (; layer < atlas.num_layers(); layer++)
+  {
+    if (atlas.layers[layer].format != format)
+    {
+      continue;
+    }
+
+    rect_pack::pack_rects(*font.packers[layer].ctx, &rect, 1);
+    if (rect.was_packed)
+    {
+      break;
+    }
+  }
+
+  if (!rect.was_packed)
+  {
+    // least-recently-used layer of the same format
+    Option<u32> lru = none;
+
+    for (auto [i, l] : enumerate<u32>(atlas.layers))
+    {
+      if (l.format == format &&
+          (lru.is_none() || l.last_use < atlas.layers[lru.v()].last_use))
+      {
+        lru = i;
+      }
+    }
+
+    // grow the atlas until it reaches its budget, then evict. If all the
+    // candidate layers are referenced by the current frame, grow the atlas
+    // past its budget instead of evicting glyphs that are about to be drawn
+    if (!can_evict || atlas.num_layers() < MAX_ATLAS_LAYERS ||
+        lru.is_none() || atlas.layers[lru.v()].last_use == frame_)
+    {
+      layer = add_layer_(font, format);
+    }
+    else
+    {
+      layer = lru.v();
+      evict_layer_(font, layer);
+    }
+
+    rect_pack::pack_rects(*font.packers[layer].ctx, &rect, 1);
+    CHECK(rect.was_packed, "");
+  }
+
+  atlas.layers[layer].glyphs.push(glyph).unwrap();
+
+  return {layer, rect.pos.to<u32>()};
+}
+
+void FontSysImpl::rasterize_glyph_(FontImpl & font, u32 glyph)
+{
+  GpuFontAtlas & atlas = font.gpu_atlas.v();
+  AtlasGlyph &   ag    = atlas.glyphs[glyph];
+
+  FT_Error err =
+    FT_Load_Glyph(font.ft_face, glyph, FT_LOAD_DEFAULT | FT_LOAD_COLOR);
+
+  GlyphAtlasFormat const format =
+    err == 0 ? glyph_format(font.ft_face->glyph, atlas.mode) :
+               GlyphAtlasFormat::Alpha;
+
+  if (err == 0)
+  {
+    err = render_glyph(font.ft_face->glyph, format);
+  }
+
+  if (err != 0)
+  {
+    // resolve to an empty area so the glyph is not retried
+    ag = AtlasGlyph{.has_color = false, .layer = 0};
+    return;
+  }
+
+  FT_Bitmap const & bitmap = font.ft_face->glyph->bitmap;
+  u32x2 const       extent{bitmap.width, bitmap.rows};
+
+  // empty glyphs, i.e. spaces, reference the first layer and are never evicted
+  if (extent.x() == 0 | extent.y() == 0)
+  {
+    ag = AtlasGlyph{.has_color = format == GlyphAtlasFormat::Color,
+                    .layer     = 0};
+    return;
+  }
+
+  u32x2 const padded_extent = extent + GLYPH_PADDING * 2;
+  u32 const   num_layers    = atlas.num_layers();
+
+  auto [layer, pos] = pack_glyph_(font, glyph, padded_extent, format, true);
+
+  if (layer >= num_layers)
+  {
+    create_layer_image_(font, layer);
+  }
+
+  ag = place_glyph(layer, pos, extent, format, atlas.extent);
+  atlas.layers[layer].last_use = frame_;
+
+  // the zeroed padding also clears stale texels left by evicted glyphs. The
+  // offset is kept texel-aligned for the copies to the BGRA layers.
+  u64 const offset = align_offset_up<u64>(4, size(staging_));
+  staging_
+    .resize(offset +
+            pixel_size_bytes(padded_extent, glyph_pixel_size(format)))
+    .unwrap();
+
+  stage_glyph(bitmap, staging_.view().slice(offset), padded_extent, extent);
+
+  uploads_
+    .push(GlyphUpload{
+      .image = sys.image->get(atlas.layers[layer].image).image,
+      .area{.offset = pos, .extent = padded_extent},
+      .offset = offset
+  })
+    .unwrap();
+}
+
+AtlasGlyph FontSysImpl::glyph(FontId id, u32 glyph)
+{
+  FontImpl &     font  = (FontImpl &) *fonts_[(usize) id].v0;
+  GpuFontAtlas & atlas = font.gpu_atlas.v();
+
+  CHECK(glyph < size32(atlas.glyphs), "");
+
+  if (!atlas.glyphs[glyph].is_resident())
+  {
+    rasterize_glyph_(font, glyph);
+  }
+
+  AtlasGlyph const & ag = atlas.glyphs[glyph];
+
+  if (ag.area.extent.x() != 0)
+  {
+    atlas.layers[ag.layer].last_use = frame_;
+  }
+
+  return ag;
+}
+
+void FontSysImpl::upload_glyphs()
+{
+  frame_++;
+
+  if (uploads_.is_empty())
+  {
+    return;
+  }
+
+  auto staging = sys.gpu->plan()->push_gpu(staging_.view());
+  auto uploads = sys.gpu->plan()->push_cpu(uploads_.view());
+
+  sys.gpu->plan()->add_pass(
+    [staging, uploads](GpuFrame frame, gpu::CommandEncoder enc) {
+      auto buffer = frame->get(staging);
+
+      for (GlyphUpload const & upload : frame->get<GlyphUpload>(uploads))
+      {
+        enc->copy_buffer_to_image(
+          buffer.buffer.buffer, upload.image,
+          span({
+            gpu::BufferImageCopy{
+                                 .buffer_offset = buffer.slice.offset + upload.offset,
+                                 .buffer_row_length   = upload.area.extent.x(),
+                                 .buffer_image_height = upload.area.extent.y(),
+                                 .image_layers{.aspects      = gpu::ImageAspects::Color,
+                              .mip_level    = 0,
+                              .array_layers = {0, 1}},
+                                 .image_area{.offset = upload.area.offset.append(0),
+                            .extent = upload.area.extent.append(1)}}
+        }));
+      }
+    });
+
+  staging_.clear();
+  uploads_.clear();
+}
+
+Future<Result<FontId, FontLoadErr>>
+  FontSysImpl::load_from_memory(Vec<char> label, Vec<u8> encoded,
+                                u32 font_height, u32 face, FontRasterMode mode)
+{
+  Future fut = future<Result<FontId, FontLoadErr>>(allocator_).unwrap();
+  scheduler->once(
+    [fut = fut.alias(), encoded = std::move(encoded), label = std::move(label),
+     this, face, font_height, mode]() mutable {
+      FontCacheKey const key{.font_hash   = hash_bytes(encoded.view()),
+                             .face        = face,
+                             .font_height = font_height,
+                             .mode        = mode};
+
+      Option<FontCache> cache = load_cache_(key);
+      usize const num_cached_glyphs =
+        cache.is_some() ? cache.v().glyphs.size() : 0;
+
+      decode_(label, encoded, face, cache.is_some() ? &cache.v() : nullptr)
+        .match(
+          [&, this](Dyn<Font> & font) {
+            trace("Rasterizing font: {} @{}px"_str, label, font_height);
+            rasterize(font, font_height, mode)
+              .match(
+                [&, this](Void) {
+                  // the cached rasters are only valid for the glyphs of the
+                  // font they were rasterized from
+                  if (cache.is_some() &&
+                      font->info().glyphs.size() == num_cached_glyphs)
+                  {
+                    restore_(std::move(font), font_height,
+                             std::move(cache.v()), std::move(fut));
+                  }
+                  else
+                  {
+                    prewarm_(std::move(font), font_height, key,
+                             std::move(fut));
+                  }
+                },
+                [&](Void) {
+                  fut.yield(Err{FontLoadErr::OutOfMemory}).unwrap();
+                });
+          },
+          [&](FontLoadErr err) { fut.yield(Err{err}).unwrap(); });
+    },
+    Ready{}, ThreadId::AnyWorker);
+
+  return fut;
+}
+
+Future<Result<FontId, FontLoadErr>>
+  FontSysImpl::load_from_path(Vec<char> label, Str path, u32 font_height,
+                              u32 face, FontRasterMode mode)
+{
+  Future file_load_fut = sys.file->load_file(allocator_, path);
+
+  Future fut = future<Result<FontId, FontLoadErr>>(allocator_).unwrap();
+
+  scheduler->once(
+    [file_load_fut = file_load_fut.alias(), fut = fut.alias(), this,
+     label = std::move(label), font_height, face, mode]() mutable {
+      file_load_fut.get().match(
+        [&](Vec<u8> & encoded) {
+          Future mem_load_fut = load_from_memory(
+            std::move(label), std::move(encoded), font_height, face, mode);
+
+          scheduler->once(
+            [fut = fut.alias(), mem_load_fut = mem_load_fut.alias()]() {
+              fut.yield(mem_load_fut.get()).unwrap();
+            },
+            AwaitFutures{mem_load_fut.alias()}, ThreadId::AnyWorker);
+        },
+        [&](IoErr err) {
+          fut
+            .yield(Err{err == IoErr::InvalidFileOrDir ?
+                         FontLoadErr::InvalidPath :
+                         FontLoadErr::IoErr})
+            .unwrap();
+        });
+    },
+    AwaitFutures{file_load_fut.alias()});
+
+  return fut;
+}
+
+FontInfo FontSysImpl::get(FontId id)
+{
+  CHECK(fonts_.is_valid_id((usize) id), "");
+  return fonts_[(usize) id].v0->info();
+}
+
+Option<FontInfo> FontSysImpl::get(Str label)
+{
+  for (auto & font : fonts_.dense.v0)
+  {
+    if (mem::eq(label, font->info().label))
+    {
+      return font->info();
+    }
+  }
+
+  return none;
 }
 
 void FontSysImpl::unload(FontId id)
 {
   Dyn<Font> & f    = fonts_[(usize) id].v0;
   FontImpl &  font = (FontImpl &) *f;
-  sys.image->unload(font.gpu_atlas.v().image);
+
+  for (GlyphAtlasLayer const & layer : font.gpu_atlas.v().layers)
+  {
+    // drop the staged glyphs targeting the layer's image
+    gpu::Image image = sys.image->get(layer.image).image;
+    auto [pending, _] = partition(uploads_.view(), [image](GlyphUpload const & u) {
+      return u.image != image;
+    });
+    uploads_.resize(size(pending)).unwrap();
+    sys.image->unload(layer.image);
+  }
+
   font.gpu_atlas = none;
 
+  shape_cache_.evict(id);
+
   fonts_.erase((usize) id);
 }
 
@@ -679,50 +1714,172 @@ static inline Tuple<Span<hb_glyph_info_t const>,
     hb_buffer_get_glyph_positions(buffer, &num_pos);
   CHECK(!(glyph_pos == nullptr && num_pos > 0), "");
 
-  u32                     num_info;
-  hb_glyph_info_t const * glyph_info =
-    hb_buffer_get_glyph_infos(buffer, &num_info);
-  CHECK(!(glyph_info == nullptr && num_info > 0), "");
+  u32                     num_info;
+  hb_glyph_info_t const * glyph_info =
+    hb_buffer_get_glyph_infos(buffer, &num_info);
+  CHECK(!(glyph_info == nullptr && num_info > 0), "");
+
+  CHECK(num_pos == num_info, "");
+
+  return Tuple{
+    Span{glyph_info, num_info},
+    Span{glyph_pos,  num_pos }
+  };
+}
+
+usize ShapeCache::hash(ShapeKey const & key, Str32 text)
+{
+  usize const seed = hash_combine(
+    (usize) key.font, (usize) key.script, (usize) key.direction,
+    (usize) key.language,
+    (usize) key.use_kerning | ((usize) key.use_ligatures << 1));
+  return hash_bytes(text.as_u8(), seed);
+}
+
+Option<Span<GlyphShape const>>
+  ShapeCache::find(ShapeKey const & key, usize hash, Str32 text)
+{
+  tick_++;
+
+  Option<u32 &> idx = index_.try_get(hash);
+
+  if (idx.is_some())
+  {
+    ShapedRun & run = runs_[idx.v()];
+
+    if (run.key == key &&
+        mem::eq(text, codepoints_.view().slice(run.codepoints)))
+    {
+      run.last_use = tick_;
+      hits_++;
+      return glyphs_.view().slice(run.glyphs);
+    }
+  }
+
+  misses_++;
+  return none;
+}
+
+Span<GlyphShape const>
+  ShapeCache::insert(ShapeKey const & key, usize hash, Str32 text,
+                     u32 first_cluster, Span<hb_glyph_info_t const> infos,
+                     Span<hb_glyph_position_t const> positions)
+{
+  if (size32(runs_) >= MAX_RUNS ||
+      (size(codepoints_) + size(text)) > MAX_CODEPOINTS ||
+      (size(glyphs_) + size(infos)) > MAX_GLYPHS)
+  {
+    evict_lru_();
+  }
+
+  Slice32 const codepoints{size32(codepoints_), size32(text)};
+  Slice32 const glyphs{size32(glyphs_), size32(infos)};
+
+  codepoints_.extend(text).unwrap();
+  glyphs_.extend_uninit(infos.size()).unwrap();
+
+  for (usize i = 0; i < infos.size(); i++)
+  {
+    hb_glyph_info_t const &     info = infos[i];
+    hb_glyph_position_t const & pos  = positions[i];
+    glyphs_[glyphs.offset + i]       = GlyphShape{
+            .glyph   = info.codepoint,
+            .cluster = info.cluster - first_cluster,
+            .advance = pos.x_advance,
+            .offset  = {pos.x_offset, -pos.y_offset}
+    };
+  }
+
+  u32 const idx = size32(runs_);
 
-  CHECK(num_pos == num_info, "");
+  runs_
+    .push(ShapedRun{.key        = key,
+                    .hash       = hash,
+                    .codepoints = codepoints,
+                    .glyphs     = glyphs,
+                    .last_use   = tick_})
+    .unwrap();
 
-  return Tuple{
-    Span{glyph_info, num_info},
-    Span{glyph_pos,  num_pos }
-  };
+  // replaces the colliding run's entry, the run is dropped on the next
+  // eviction
+  index_.push(hash, idx).unwrap();
+
+  return glyphs_.view().slice(glyphs);
 }
 
-/// @brief Only needs to be called if it contains multiple paragraphs
-static inline void segment_paragraphs(Str32 text, Span<TextSegment> segments)
+void ShapeCache::compact_(auto && keep)
 {
-  auto const text_size = text.size();
-  for (usize i = 0; i < text_size;)
+  u32 num_runs       = 0;
+  u32 num_codepoints = 0;
+  u32 num_glyphs     = 0;
+
+  // the runs' arena regions are in the same order as the runs, so they can be
+  // compacted in-place
+  for (u32 i = 0; i < size32(runs_); i++)
   {
-    while (i < text_size)
+    ShapedRun run = runs_[i];
+
+    // drop the runs replaced by hash collisions
+    if (!keep(run) || index_[run.hash] != i)
     {
-      if (text[i] == '\r' && ((i + 1) < text_size) && text[i + 1] == '\n')
-      {
-        segments[i].linebreak_begin = true;
-        if ((i + 2) < text_size)
-        {
-          segments[i + 2].paragraph_begin = true;
-        }
-        i += 2;
-        break;
-      }
-      else if (text[i] == '\n' || text[i] == '\r')
-      {
-        segments[i].linebreak_begin = true;
-        if ((i + 1) < text_size)
-        {
-          segments[i + 1].paragraph_begin = true;
-        }
-        i += 1;
-        break;
-      }
-      i++;
+      continue;
     }
+
+    mem::move(codepoints_.view().slice(run.codepoints),
+              codepoints_.data() + num_codepoints);
+    mem::move(glyphs_.view().slice(run.glyphs), glyphs_.data() + num_glyphs);
+
+    run.codepoints.offset = num_codepoints;
+    run.glyphs.offset     = num_glyphs;
+    num_codepoints += run.codepoints.span;
+    num_glyphs += run.glyphs.span;
+
+    runs_[num_runs] = run;
+    num_runs++;
   }
+
+  runs_.resize(num_runs).unwrap();
+
+  index_.clear();
+
+  for (auto [i, run] : enumerate<u32>(runs_))
+  {
+    index_.push(run.hash, i).unwrap();
+  }
+
+  codepoints_.resize(num_codepoints).unwrap();
+  glyphs_.resize(num_glyphs).unwrap();
+}
+
+void ShapeCache::evict_lru_()
+{
+  uses_.clear();
+
+  for (ShapedRun const & run : runs_)
+  {
+    uses_.push(run.last_use).unwrap();
+  }
+
+  u64 threshold = 0;
+
+  if (!uses_.is_empty())
+  {
+    sort(uses_.view());
+    threshold = uses_[uses_.size() / 2];
+  }
+
+  trace("Evicting shaped runs older than tick {} of {}, cache hits = {}, "
+        "misses = {}"_str,
+        threshold, tick_, hits_, misses_);
+
+  compact_([threshold](ShapedRun const & run) {
+    return run.last_use > threshold;
+  });
+}
+
+void ShapeCache::evict(FontId font)
+{
+  compact_([font](ShapedRun const & run) { return run.key.font != font; });
 }
 
 /// @brief Only needs to be called if it contains multiple scripts
@@ -821,14 +1978,86 @@ static inline void segment_wrap_points(Str32 text, Span<TextSegment> segments)
   }
 }
 
-static inline void insert_run(TextLayout & l, FontStyle const & s,
-                              Slice codepoints, usize base_cluster,
-                              FontMetrics const &             font_metrics,
-                              TextSegment const &             base_segment,
-                              Span<hb_glyph_info_t const>     infos,
-                              Span<hb_glyph_position_t const> positions)
+/// @brief resolve the font of each codepoint from its style's fallback chain,
+/// the first font of the chain covering the codepoint. Marks and format
+/// characters (i.e. combining marks, joiners, and variation selectors) keep
+/// the font of the codepoint they apply to so their clusters are shaped
+/// together.
+static inline void segment_fonts(Str32 text, Span<FontStyle const> styles,
+                                 SparseVec<Dyn<Font>> const & fonts,
+                                 Span<TextSegment>            segments)
+{
+  hb_unicode_funcs_t * unicode = hb_unicode_funcs_get_default();
+
+  InplaceVec<FontImpl const *, MAX_FONT_FALLBACKS + 1> chain;
+
+  u32 style = U32_MAX;
+
+  for (usize i = 0; i < text.size(); i++)
+  {
+    c32 const     cp      = text[i];
+    TextSegment & segment = segments[i];
+
+    if (segment.style != style)
+    {
+      style = segment.style;
+      chain.clear();
+
+      FontStyle const & s = styles[style];
+
+      for (u32 f = 0; f < s.chain_size(); f++)
+      {
+        FontId const id = s.chain(f);
+        chain
+          .push(fonts.is_valid_id(id) ? &(FontImpl const &) *fonts[id].v0 :
+                                        nullptr)
+          .unwrap();
+      }
+    }
+
+    switch (hb_unicode_general_category(unicode, cp))
+    {
+      case HB_UNICODE_GENERAL_CATEGORY_NON_SPACING_MARK:
+      case HB_UNICODE_GENERAL_CATEGORY_SPACING_MARK:
+      case HB_UNICODE_GENERAL_CATEGORY_ENCLOSING_MARK:
+      case HB_UNICODE_GENERAL_CATEGORY_FORMAT:
+        if (i > 0 && segments[i - 1].style == style)
+        {
+          segment.font = segments[i - 1].font;
+          continue;
+        }
+        break;
+      default:
+        break;
+    }
+
+    // codepoints no font covers fall back to the primary font's replacement
+    // glyph
+    segment.font = 0;
+
+    for (auto [f, font] : enumerate<u8>(chain))
+    {
+      if (font != nullptr && font->coverage.contains(cp))
+      {
+        segment.font = f;
+        break;
+      }
+    }
+  }
+}
+
+/// @param font the run's font, resolved from the style's fallback chain
+/// @param codepoints the run's codepoints, relative to the paragraph
+/// @param glyphs the run's shaped glyphs, with clusters relative to the run's
+/// first codepoint
+/// @param paragraph_glyphs first glyph of the run's paragraph in the layout
+static inline void insert_run(TextLayout & l, FontStyle const & s, FontId font,
+                              Slice codepoints, FontMetrics const & font_metrics,
+                              TextSegment const &    base_segment,
+                              Span<GlyphShape const> glyphs,
+                              usize                  paragraph_glyphs)
 {
-  auto const num_glyphs  = infos.size();
+  auto const num_glyphs  = glyphs.size();
   auto const first_glyph = l.glyphs.size();
 
   l.glyphs.extend_uninit(num_glyphs).unwrap();
@@ -837,17 +2066,11 @@ static inline void insert_run(TextLayout & l, FontStyle const & s,
 
   for (usize i = 0; i < num_glyphs; i++)
   {
-    hb_glyph_info_t const &     info = infos[i];
-    hb_glyph_position_t const & pos  = positions[i];
-    GlyphShape                  shape{
-                       .glyph   = info.codepoint,
-                       .cluster = base_cluster + info.cluster,
-                       .advance = pos.x_advance,
-                       .offset  = {pos.x_offset, -pos.y_offset}
-    };
+    GlyphShape shape = glyphs[i];
+    shape.cluster += codepoints.offset;
 
     l.glyphs[first_glyph + i] = shape;
-    advance += pos.x_advance;
+    advance += shape.advance;
   }
 
   TextRunType type = TextRunType::Char;
@@ -865,9 +2088,10 @@ static inline void insert_run(TextLayout & l, FontStyle const & s,
     .push(TextRun{
       .codepoints  = codepoints,
       .style       = base_segment.style,
+      .font        = font,
       .font_height = s.height,
       .line_height = max(s.line_height, 1.0F),
-      .glyphs{first_glyph, num_glyphs},
+      .glyphs{first_glyph - paragraph_glyphs, num_glyphs},
       .metrics{.ascent  = font_metrics.ascent,
               .descent = font_metrics.descent,
               .advance = advance},
@@ -918,246 +2142,660 @@ static inline void reorder_line(Span<TextRun> runs)
   }
 }
 
+/// @brief hash of the parameters the block's paragraphs are laid out with,
+/// besides their codepoints and run styles
+static usize layout_hash(TextBlock const & block, f32 max_width)
+{
+  usize hash = hash_combine(
+    (usize) bit_cast<u32>(max_width), (usize) bit_cast<u32>(block.font_scale),
+    (usize) block.direction, (usize) block.wrap, (usize) block.use_kerning,
+    (usize) block.use_ligatures, hash_bytes(block.language.as_u8()));
+
+  for (FontStyle const & s : block.fonts)
+  {
+    hash = hash_combine(hash, (usize) s.font, (usize) bit_cast<u32>(s.height),
+                        (usize) bit_cast<u32>(s.line_height),
+                        (usize) bit_cast<u32>(s.word_spacing));
+
+    for (FontId const fallback : s.fallbacks)
+    {
+      hash = hash_combine(hash, (usize) fallback);
+    }
+  }
+
+  return hash;
+}
+
+/// @brief number of codepoints of the paragraph separator at `p`, 0 if there
+/// is none. The separators are the bidi paragraph separators (Bidi_Class=B):
+/// LF, CR, CRLF, U+001C..U+001E, NEL (U+0085), and PS (U+2029)
+static usize paragraph_break(Str32 text, usize p)
+{
+  switch (text[p])
+  {
+    case U'\r':
+      return ((p + 1) < text.size() && text[p + 1] == U'\n') ? 2 : 1;
+    case U'\n':
+    case U'\x1C':
+    case U'\x1D':
+    case U'\x1E':
+    case U'\x85':
+    case U'\x2029':
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/// @brief replace the elements in `range` with `elements`, moving the
+/// elements after it once
+template <typename T>
+static void splice(Vec<T> & vec, Slice range, Span<T const> elements)
+{
+  if (elements.size() > range.span)
+  {
+    vec.shift_uninit(range.end(), elements.size() - range.span).unwrap();
+  }
+  else
+  {
+    vec.erase(range.offset + elements.size(), range.span - elements.size());
+  }
+
+  mem::copy(elements, vec.data() + range.offset);
+}
+
+/// @brief offsets added to the bases of laid-out paragraphs moved within the
+/// layout. Negative offsets wrap around.
+struct LayoutShift
+{
+  usize codepoint = 0;
+  usize glyph     = 0;
+  usize run       = 0;
+  usize line      = 0;
+  usize caret     = 0;
+  f32   top       = 0;
+};
+
+/// @brief shift the bases of the paragraphs in place. Their lines, runs, and
+/// glyphs are relative to them and are not visited. They must already be at
+/// their shifted positions.
+static void shift_paragraphs(TextLayout & layout, Slice paragraphs,
+                             LayoutShift const & shift)
+{
+  for (Paragraph & p : layout.paragraphs.view().slice(paragraphs))
+  {
+    p.lines.offset += shift.line;
+    p.runs.offset += shift.run;
+    p.glyphs.offset += shift.glyph;
+    p.codepoints.offset += shift.codepoint;
+    p.break_codepoints.offset += shift.codepoint;
+    p.carets.offset += shift.caret;
+    p.top += shift.top;
+  }
+}
+
+/// @brief place the paragraphs one after another, beginning at `caret` and
+/// `top`. They are advanced past the last paragraph.
+static void place_paragraphs(TextLayout & layout, Slice paragraphs,
+                             usize & caret, f32 & top)
+{
+  for (Paragraph & p : layout.paragraphs.view().slice(paragraphs))
+  {
+    p.carets.offset = caret;
+    p.top           = top;
+    caret += p.carets.span;
+    top += p.height;
+  }
+}
+
+/// @brief append the laid-out paragraphs of `src` to `dst`, rebasing them onto
+/// `dst`
+static void append_paragraphs(TextLayout & dst, TextLayout const & src)
+{
+  usize const paragraphs_begin = dst.paragraphs.size();
+
+  LayoutShift const shift{.glyph = dst.glyphs.size(),
+                          .run   = dst.runs.size(),
+                          .line  = dst.lines.size()};
+
+  dst.glyphs.extend(src.glyphs.view()).unwrap();
+  dst.runs.extend(src.runs.view()).unwrap();
+  dst.lines.extend(src.lines.view()).unwrap();
+  dst.line_bottoms.extend(src.line_bottoms.view()).unwrap();
+  dst.paragraphs.extend(src.paragraphs.view()).unwrap();
+
+  shift_paragraphs(dst, Slice::range(paragraphs_begin, dst.paragraphs.size()),
+                   shift);
+}
+
+Dyn<LayoutContext *> FontSysImpl::acquire_context_()
+{
+  {
+    LockGuard guard{contexts_lock_};
+    if (!contexts_.is_empty())
+    {
+      Dyn<LayoutContext *> ctx = std::move(contexts_.last());
+      contexts_.pop();
+      return ctx;
+    }
+  }
+
+  hb_buffer_t * hb_buffer = hb_buffer_create();
+  CHECK(hb_buffer != nullptr && hb_buffer_allocation_successful(hb_buffer), "");
+
+  return dyn<LayoutContext>(inplace, allocator_, allocator_, hb_buffer)
+    .unwrap();
+}
+
+void FontSysImpl::release_context_(Dyn<LayoutContext *> ctx)
+{
+  LockGuard guard{contexts_lock_};
+  contexts_.push(std::move(ctx)).unwrap();
+}
+
 /// see:
 /// https://stackoverflow.com/questions/62374506/how-do-i-align-glyphs-along-the-baseline-with-freetype
 ///
-void FontSysImpl::layout_text(TextBlock const & block, f32 max_width,
-                              TextLayout & layout)
+void FontSysImpl::layout_paragraph_(LayoutContext & ctx,
+                                    TextBlock const & block, f32 max_width,
+                                    hb_language_t     language,
+                                    Paragraph const & paragraph,
+                                    Str32             region_text,
+                                    TextLayout &      layout)
 {
-  segments_.clear();
-  layout.clear();
+  usize const paragraph_begin = paragraph.codepoints.begin();
+  usize const paragraph_end   = paragraph.codepoints.end();
 
-  auto const text_size = block.text.size();
-  CHECK(block.runs.size() == (block.fonts.size() + 1), "");
-  CHECK(!block.runs.is_empty(), "No run styling provided for text");
-  CHECK(block.runs.last() >= text_size,
-        "Text runs need to span the entire text");
+  // segments of the paragraph and its line-break, relative to the paragraph
+  Slice const region =
+    Slice::range(paragraph_begin, paragraph.break_codepoints.end());
+  Str32 const text = region_text.slice(0, paragraph.codepoints.span);
 
-  segments_.clear();
-  segments_.resize(text_size).unwrap();
+  ctx.segments.clear();
+  ctx.segments.resize(region.span).unwrap();
 
+  for (usize irun = 0; irun < (block.runs.size() - 1); irun++)
   {
-    for (usize irun = 0; irun < (block.runs.size() - 1); irun++)
+    auto const run_start = clamp(block.runs[irun], region.begin(), region.end());
+    auto const run_end =
+      clamp(block.runs[irun + 1], region.begin(), region.end());
+    for (usize i = run_start; i < run_end; i++)
     {
-      auto const run_start = min(block.runs[irun], text_size);
-      auto const run_end   = min(block.runs[irun + 1], text_size);
-      for (usize i = run_start; i < run_end; i++)
-      {
-        segments_[i].style = irun;
-      }
+      ctx.segments[i - paragraph_begin].style = irun;
     }
   }
 
-  segment_paragraphs(block.text, segments_);
-  segment_scripts(block.text, segments_);
-  segment_wrap_points(block.text, segments_);
+  segment_wrap_points(region_text, ctx.segments);
 
-  if (!block.text.is_empty())
+  if (!text.is_empty())
   {
+    Span<TextSegment> segments = ctx.segments.view().slice(0, text.size());
+
+    segment_scripts(text, segments);
+
+    segment_fonts(text, block.fonts, fonts_, segments);
+
     SBCodepointSequence codepoints{.stringEncoding = SBStringEncodingUTF32,
-                                   .stringBuffer   = (void *) block.text.data(),
-                                   .stringLength   = text_size};
+                                   .stringBuffer   = (void *) text.data(),
+                                   .stringLength   = text.size()};
     SBAlgorithmRef      algorithm = SBAlgorithmCreate(&codepoints);
     CHECK(algorithm != nullptr, "");
     defer algorithm_{[&] { SBAlgorithmRelease(algorithm); }};
-    segment_levels(block.text, algorithm, block.direction, segments_);
+    segment_levels(text, algorithm, block.direction, segments);
   }
 
+  // - paragraphs never have empty lines; they may have empty codepoints or break codepoints
+  // - lines never have empty runs; they may have empty codepoints
+  // - runs may have empty codepoints
+
+  auto const paragraph_runs_begin   = layout.runs.size();
+  auto const paragraph_glyphs_begin = layout.glyphs.size();
+  auto       i                      = paragraph_begin;
+
+  do
   {
-    hb_language_t language =
-      block.language.is_empty() ?
-        hb_language_get_default() :
-        hb_language_from_string(block.language.data(),
-                                (i32) block.language.size());
+    auto const        run_begin = i;
+    TextSegment const base_segment =
+      (run_begin < paragraph_end) ? ctx.segments[run_begin - paragraph_begin] :
+                                    TextSegment{.style  = 0,
+                                                .font   = 0,
+                                                .script = TextScript::None,
+                                                .linebreak_begin = false,
+                                                .paragraph_begin = true,
+                                                .whitespace      = false,
+                                                .tab             = false,
+                                                .wrappable       = false,
+                                                .base_level      = 0,
+                                                .level           = 0};
+
+    if (i < paragraph_end)
+    {
+      i++;
+    }
+
+    if (!base_segment.is_wrap_point())
+    {
+      while (i < paragraph_end)
+      {
+        TextSegment const & segment = ctx.segments[i - paragraph_begin];
+
+        if (base_segment.style != segment.style ||
+            base_segment.font != segment.font ||
+            base_segment.script != segment.script ||
+            base_segment.level != segment.level || segment.is_wrap_point())
+        {
+          break;
+        }
 
-    // - the block never has empty paragraphs
-    // - paragraphs never have empty lines; they may have empty codepoints or break codepoints
-    // - lines never have empty runs; they may have empty codepoints
-    // - runs may have empty codepoints
+        i++;
+      }
+    }
 
-    usize p = 0;
+    FontStyle const & s    = block.fonts[base_segment.style];
+    FontId const      font = s.chain(base_segment.font);
+    FontImpl const &  f    = (FontImpl const &) *fonts_[(usize) font].v0;
+
+    Slice const paragraph_subset{run_begin - paragraph_begin, i - run_begin};
+
+    ShapeKey const key{
+      .font      = font,
+      .script    = hb_script_from_iso15924_tag(
+        SBScriptGetOpenTypeTag(SBScript{(u8) base_segment.script})),
+      .direction = ((base_segment.level & 0x1) == 0) ? HB_DIRECTION_LTR :
+                                                       HB_DIRECTION_RTL,
+      .language      = language,
+      .use_kerning   = block.use_kerning,
+      .use_ligatures = block.use_ligatures};
+
+    // the run is shaped and cached along with the context around it in the
+    // paragraph, as the context affects its shaping
+    usize const pre_context =
+      min(paragraph_subset.offset, ShapeCache::CONTEXT);
+    usize const post_context =
+      min(text.size() - paragraph_subset.end(), ShapeCache::CONTEXT);
+    Str32 const run_text = text.slice(
+      Slice::range(paragraph_subset.offset - pre_context,
+                   paragraph_subset.end() + post_context));
+    usize const hash = ShapeCache::hash(key, run_text);
+
+    // the cached glyphs are only valid while the cache is locked, so they
+    // are copied out. the run is shaped outside the lock.
+    ctx.glyphs.clear();
+
+    bool hit = false;
 
-    do
     {
-      auto const paragraph_begin = p;
+      LockGuard guard{shape_cache_lock_};
+      Option<Span<GlyphShape const>> cached =
+        shape_cache_.find(key, hash, run_text);
 
-      while (p < text_size && !segments_[p].linebreak_begin)
+      if (cached.is_some())
       {
-        p++;
+        ctx.glyphs.extend(cached.v()).unwrap();
+        hit = true;
       }
+    }
+
+    if (!hit)
+    {
+      auto [infos, positions] =
+        shape(f.hb_font, ctx.hb_buffer, run_text,
+              Slice{pre_context, paragraph_subset.span}, key.script,
+              key.direction, key.language, key.use_kerning, key.use_ligatures);
+
+      LockGuard guard{shape_cache_lock_};
+      ctx.glyphs
+        .extend(shape_cache_.insert(key, hash, run_text, (u32) pre_context,
+                                    infos, positions))
+        .unwrap();
+    }
+
+    insert_run(layout, s, font, paragraph_subset, f.metrics, base_segment,
+               ctx.glyphs.view(), paragraph_glyphs_begin);
+
+  } while (i < paragraph_end);
 
-      auto const paragraph_end        = p;
-      auto const paragraph_runs_begin = layout.runs.size();
-      auto       i                    = paragraph_begin;
+  auto const paragraph_runs_end = layout.runs.size();
+  auto const lines_begin        = layout.lines.size();
+  f32        paragraph_width    = 0;
+  f32        paragraph_height   = 0;
+  usize      caret_iter         = 0;
 
-      do
+  for (usize i = paragraph_runs_begin; i < paragraph_runs_end;)
+  {
+    auto const   first             = i++;
+    auto const & first_run         = layout.runs[first];
+    u8 const     base_level        = first_run.base_level;
+    f32 const    font_height       = block.font_scale * first_run.font_height;
+    auto const   first_run_metrics = first_run.metrics.resolve(font_height);
+    auto const & style             = block.fonts[first_run.style];
+    auto const   advance =
+      first_run_metrics.advance +
+      (first_run.is_spacing() ? 0 : (block.font_scale * style.word_spacing));
+
+    f32 width   = advance;
+    f32 ascent  = first_run_metrics.ascent;
+    f32 descent = first_run_metrics.descent;
+    f32 line_height =
+      max(font_height * first_run.line_height, first_run_metrics.height());
+
+    while (i < paragraph_runs_end)
+    {
+      auto const & r = layout.runs[i];
+      auto const   f = block.font_scale * r.font_height;
+      auto const   m = r.metrics.resolve(f);
+      auto const   l = max(f * r.line_height, m.height());
+      auto const & s = block.fonts[r.style];
+      auto const   a =
+        m.advance + (r.is_spacing() ? 0 : (block.font_scale * s.word_spacing));
+
+      if (block.wrap && r.wrappable && (width + a) > max_width)
       {
-        auto const        run_begin = i;
-        TextSegment const base_segment =
-          (run_begin < paragraph_end) ? segments_[run_begin] :
-                                        TextSegment{.style  = 0,
-                                                    .script = TextScript::None,
-                                                    .linebreak_begin = false,
-                                                    .paragraph_begin = true,
-                                                    .whitespace      = false,
-                                                    .tab             = false,
-                                                    .wrappable       = false,
-                                                    .base_level      = 0,
-                                                    .level           = 0};
-
-        if (i < paragraph_end)
-        {
-          i++;
-        }
+        break;
+      }
 
-        if (!base_segment.is_wrap_point())
-        {
-          while (i < paragraph_end &&
-                 base_segment.style == segments_[i].style &&
-                 base_segment.script == segments_[i].script &&
-                 base_segment.level == segments_[i].level &&
-                 !segments_[i].is_wrap_point())
-          {
-            i++;
-          }
-        }
+      width += a;
+      ascent      = max(ascent, m.ascent);
+      descent     = max(descent, m.descent);
+      line_height = max(line_height, l);
+      i++;
+    }
+
+    auto const & last_run = layout.runs[i - 1];
+    auto const   codepoints =
+      Slice::range(first_run.codepoints.offset, last_run.codepoints.end());
+
+    Slice const runs =
+      Slice::range(first - paragraph_runs_begin, i - paragraph_runs_begin);
+
+    auto const num_carets = codepoints.span + 1;
+    auto const carets     = Slice{caret_iter, num_carets};
+
+    Line line{
+      .codepoints = codepoints,
+      .carets     = carets,
+      .runs       = runs,
+      .metrics{.width   = width,
+               .height  = line_height,
+               .ascent  = ascent,
+               .descent = descent,
+               .level   = base_level}
+    };
+
+    layout.lines.push(line).unwrap();
+
+    paragraph_width = max(paragraph_width, width);
+    paragraph_height += line_height;
 
-        FontStyle const & s = block.fonts[base_segment.style];
-        FontImpl const &  f = (FontImpl const &) *fonts_[(usize) s.font].v0;
+    layout.line_bottoms.push(paragraph_height).unwrap();
 
-        auto const paragraph =
-          block.text.slice(Slice::range(paragraph_begin, paragraph_end));
-        Slice const paragraph_subset{run_begin - paragraph_begin,
-                                     i - run_begin};
+    reorder_line(layout.runs.view().slice(first, i - first));
 
-        auto [infos, positions] =
-          shape(f.hb_font, hb_buffer_, paragraph, paragraph_subset,
-                hb_script_from_iso15924_tag(
-                  SBScriptGetOpenTypeTag(SBScript{(u8) base_segment.script})),
-                ((base_segment.level & 0x1) == 0) ? HB_DIRECTION_LTR :
-                                                    HB_DIRECTION_RTL,
-                language, block.use_kerning, block.use_ligatures);
+    caret_iter += num_carets;
+  }
+
+  layout.paragraphs
+    .push(Paragraph{
+      .lines  = Slice::range(lines_begin, layout.lines.size()),
+      .runs   = Slice::range(paragraph_runs_begin, paragraph_runs_end),
+      .glyphs = Slice::range(paragraph_glyphs_begin, layout.glyphs.size()),
+      .codepoints       = paragraph.codepoints,
+      .break_codepoints = paragraph.break_codepoints,
+      .carets           = Slice{0, caret_iter},
+      .height           = paragraph_height,
+      .width            = paragraph_width})
+    .unwrap();
+}
+
+void FontSysImpl::layout_text(TextBlock const & block, f32 max_width,
+                              TextLayout & layout, TextEdit edit)
+{
+  auto const text_size = block.size();
+  CHECK(block.runs.size() == (block.fonts.size() + 1), "");
+  CHECK(!block.runs.is_empty(), "No run styling provided for text");
+  CHECK(block.runs.last() >= text_size,
+        "Text runs need to span the entire text");
+
+  usize const hash = layout_hash(block, max_width);
 
-        Slice const codepoints = Slice::range(run_begin, i);
+  // the laid-out paragraphs can only be re-used if they were laid out with
+  // the same parameters
+  if (!layout.laid_out || layout.hash != hash)
+  {
+    layout.clear();
+    edit = TextEdit{};
+  }
 
-        insert_run(layout, s, codepoints, paragraph_begin, f.metrics,
-                   base_segment, infos, positions);
+  usize const old_size = layout.num_codepoints;
+  usize const tail     = min(edit.tail, old_size, text_size);
+  usize const first    = min(edit.first, old_size - tail, text_size - tail);
 
-      } while (i < paragraph_end);
+  Span<Paragraph const> const old = layout.paragraphs.view();
 
-      auto const paragraph_runs_end = layout.runs.size();
+  // re-use the paragraphs ending before the first edited codepoint, and the
+  // paragraphs in the unchanged tail of the text that still begin a paragraph
+  usize const prefix =
+    old.size() - binary_find(old, [&](Paragraph const & p) {
+                   return p.break_codepoints.end() >= first;
+                 }).size();
 
-      // line-break or end of text
-      auto const break_begin = p;
+  usize suffix = old.size() - binary_find(old, [&](Paragraph const & p) {
+                                return p.codepoints.offset >= (old_size - tail);
+                              }).size();
 
-      if (p < text_size)
+  Dyn<LayoutContext *> ctx = acquire_context_();
+  defer                ctx_{[&] { release_context_(std::move(ctx)); }};
+
+  if (suffix < old.size())
+  {
+    usize const begin = old[suffix].codepoints.offset + text_size - old_size;
+    if (begin != 0)
+    {
+      ctx->text.clear();
+      block.read(Slice{begin - 1, 2}, ctx->text);
+      if (paragraph_break(ctx->text, 0) != 1)
       {
-        p++;
+        suffix++;
       }
+    }
+  }
+
+  suffix = max(suffix, prefix);
+
+  usize const edited_begin =
+    (prefix == 0) ? 0 : old[prefix - 1].break_codepoints.end();
+  usize const edited_end =
+    (suffix == old.size()) ?
+      text_size :
+      (old[suffix].codepoints.offset + text_size - old_size);
+
+  // only the edited paragraphs are read from the text
+  ctx->text.clear();
+  block.read(Slice::range(edited_begin, edited_end), ctx->text);
+
+  Str32 const edited_text = ctx->text;
 
-      while (p < text_size && !segments_[p].paragraph_begin)
+  // - the block never has empty paragraphs, unless the text is empty
+  ctx->paragraphs.clear();
+
+  if (edited_begin < edited_end || (prefix == 0 && suffix == old.size()))
+  {
+    usize p = edited_begin;
+
+    do
+    {
+      auto const paragraph_begin = p;
+      usize      brk             = 0;
+
+      while (p < edited_end &&
+             (brk = paragraph_break(edited_text, p - edited_begin)) == 0)
       {
         p++;
       }
 
-      auto const break_end = p;
+      auto const paragraph_end = p;
+
+      // line-break or end of the edited paragraphs
+      p += brk;
 
-      layout.paragraphs
+      ctx->paragraphs
         .push(Paragraph{
-          .runs       = Slice::range(paragraph_runs_begin, paragraph_runs_end),
-          .codepoints = Slice::range(paragraph_begin, paragraph_end),
-          .break_codepoints = Slice::range(break_begin, break_end)})
+          .codepoints       = Slice::range(paragraph_begin, paragraph_end),
+          .break_codepoints = Slice::range(paragraph_end, p)})
         .unwrap();
 
-    } while (p < text_size);
+    } while (p < edited_end);
   }
 
-  f32x2 extent{};
+  hb_language_t language =
+    block.language.is_empty() ?
+      hb_language_get_default() :
+      hb_language_from_string(block.language.data(),
+                              (i32) block.language.size());
+
+  // the edited paragraphs' storage in the layout
+  usize const glyphs_begin = (prefix == 0) ? 0 : old[prefix - 1].glyphs.end();
+  usize const runs_begin   = (prefix == 0) ? 0 : old[prefix - 1].runs.end();
+  usize const lines_begin  = (prefix == 0) ? 0 : old[prefix - 1].lines.end();
+  usize const glyphs_end   = (suffix == old.size()) ? layout.glyphs.size() :
+                                                      old[suffix].glyphs.offset;
+  usize const runs_end     = (suffix == old.size()) ? layout.runs.size() :
+                                                      old[suffix].runs.offset;
+  usize const lines_end    = (suffix == old.size()) ? layout.lines.size() :
+                                                      old[suffix].lines.offset;
+  usize const carets_end =
+    (suffix == old.size()) ? 0 : old[suffix].carets.offset;
+  f32 const top_end = (suffix == old.size()) ? 0 : old[suffix].top;
+
+  usize caret_iter = (prefix == 0) ? 0 : old[prefix - 1].carets.end();
+  f32   top_iter =
+    (prefix == 0) ? 0 : (old[prefix - 1].top + old[prefix - 1].height);
+
+  // the extent's width is only re-computed from all the paragraphs if the
+  // widest of them is replaced
+  f32 replaced_width = 0;
+
+  for (Paragraph const & p : old.slice(Slice::range(prefix, suffix)))
+  {
+    replaced_width = max(replaced_width, p.width);
+  }
 
-  usize caret_iter = 0;
+  Span<Paragraph const> const cur = ctx->paragraphs.view();
 
-  for (auto & paragraph : layout.paragraphs)
-  {
-    auto const lines_begin = layout.lines.size();
+  auto const paragraph_text = [&](Paragraph const & p) {
+    return edited_text.slice(Slice::range(p.codepoints.offset - edited_begin,
+                                          p.break_codepoints.end() -
+                                            edited_begin));
+  };
 
-    for (usize i = paragraph.runs.begin(); i < paragraph.runs.end();)
-    {
-      auto const   first             = i++;
-      auto const & first_run         = layout.runs[first];
-      u8 const     base_level        = first_run.base_level;
-      f32 const    font_height       = block.font_scale * first_run.font_height;
-      auto const   first_run_metrics = first_run.metrics.resolve(font_height);
-      auto const & style             = block.fonts[first_run.style];
-      auto const   advance =
-        first_run_metrics.advance +
-        (first_run.is_spacing() ? 0 : (block.font_scale * style.word_spacing));
-
-      f32 width   = advance;
-      f32 ascent  = first_run_metrics.ascent;
-      f32 descent = first_run_metrics.descent;
-      f32 line_height =
-        max(font_height * first_run.line_height, first_run_metrics.height());
-
-      while (i < paragraph.runs.end())
-      {
-        auto const & r = layout.runs[i];
-        auto const   f = block.font_scale * r.font_height;
-        auto const   m = r.metrics.resolve(f);
-        auto const   l = max(f * r.line_height, m.height());
-        auto const & s = block.fonts[r.style];
-        auto const   a =
-          m.advance +
-          (r.is_spacing() ? 0 : (block.font_scale * s.word_spacing));
-
-        if (block.wrap && r.wrappable && (width + a) > max_width)
-        {
-          break;
-        }
+  TextLayout & edited = ctx->layout;
 
-        width += a;
-        ascent      = max(ascent, m.ascent);
-        descent     = max(descent, m.descent);
-        line_height = max(line_height, l);
-        i++;
-      }
+  edited.clear();
 
-      auto const & last_run = layout.runs[i - 1];
-      auto const   codepoints =
-        Slice::range(first_run.codepoints.offset, last_run.codepoints.end());
+  usize const num_edited = cur.size();
+  usize const num_shards = min(num_edited / MIN_PARAGRAPHS_PER_SHARD,
+                               (usize) scheduler->num_workers() + 1);
 
-      Slice const runs = Slice::range(first, i);
+  if (num_shards <= 1)
+  {
+    for (Paragraph const & p : cur)
+    {
+      layout_paragraph_(*ctx, block, max_width, language, p,
+                        paragraph_text(p), edited);
+    }
+  }
+  else
+  {
+    // the paragraphs are independent, so contiguous ranges of them are laid
+    // out into separate contexts concurrently and then appended in order
+    Vec<Dyn<LayoutContext *>> shards{allocator_};
 
-      auto const num_carets = codepoints.span + 1;
-      auto const carets     = Slice{caret_iter, num_carets};
+    for (usize s = 0; s < num_shards; s++)
+    {
+      shards.push(acquire_context_()).unwrap();
+    }
 
-      Line line{
-        .codepoints = codepoints,
-        .carets     = carets,
-        .runs       = runs,
-        .metrics{.width   = width,
-                 .height  = line_height,
-                 .ascent  = ascent,
-                 .descent = descent,
-                 .level   = base_level}
-      };
+    scheduler->for_each(
+      num_shards,
+      [&](u64 s) {
+        LayoutContext & shard = *shards[s];
 
-      layout.lines.push(line).unwrap();
+        shard.layout.clear();
 
-      reorder_line(layout.runs.view().slice(first, i - first));
+        for (usize i = s * num_edited / num_shards;
+             i < (s + 1) * num_edited / num_shards; i++)
+        {
+          layout_paragraph_(shard, block, max_width, language, cur[i],
+                            paragraph_text(cur[i]), shard.layout);
+        }
+      },
+      allocator_);
 
-      extent.x() = max(extent.x(), width);
-      extent.y() += line_height;
-      caret_iter += num_carets;
+    for (Dyn<LayoutContext *> & shard : shards)
+    {
+      append_paragraphs(edited, shard->layout);
+      release_context_(std::move(shard));
     }
+  }
+
+  // replace the previously edited paragraphs in place, then rebase them and
+  // the paragraphs after them. The lines, runs, and glyphs after them are
+  // only moved.
+  splice(layout.glyphs, Slice::range(glyphs_begin, glyphs_end),
+         edited.glyphs.view().as_const());
+  splice(layout.runs, Slice::range(runs_begin, runs_end),
+         edited.runs.view().as_const());
+  splice(layout.lines, Slice::range(lines_begin, lines_end),
+         edited.lines.view().as_const());
+  splice(layout.line_bottoms, Slice::range(lines_begin, lines_end),
+         edited.line_bottoms.view().as_const());
+  splice(layout.paragraphs, Slice::range(prefix, suffix),
+         edited.paragraphs.view().as_const());
+
+  Slice const placed{prefix, edited.paragraphs.size()};
+
+  shift_paragraphs(
+    layout, placed,
+    LayoutShift{
+      .glyph = glyphs_begin, .run = runs_begin, .line = lines_begin});
+
+  place_paragraphs(layout, placed, caret_iter, top_iter);
+
+  shift_paragraphs(
+    layout, Slice::range(placed.end(), layout.paragraphs.size()),
+    LayoutShift{.codepoint = text_size - old_size,
+                .glyph     = glyphs_begin + edited.glyphs.size() - glyphs_end,
+                .run       = runs_begin + edited.runs.size() - runs_end,
+                .line      = lines_begin + edited.lines.size() - lines_end,
+                .caret     = caret_iter - carets_end,
+                .top       = top_iter - top_end});
+
+  f32 width = 0;
+
+  if (replaced_width < layout.extent.x())
+  {
+    width = layout.extent.x();
 
-    auto const lines_end = layout.lines.size();
-    paragraph.lines      = Slice::range(lines_begin, lines_end);
+    for (Paragraph const & p : edited.paragraphs)
+    {
+      width = max(width, p.width);
+    }
+  }
+  else
+  {
+    for (Paragraph const & p : layout.paragraphs)
+    {
+      width = max(width, p.width);
+    }
   }
 
+  Paragraph const & last = layout.paragraphs.last();
+
+  layout.hash           = hash;
   layout.max_width      = max_width;
-  layout.num_carets     = max(caret_iter, 1ULL);
+  layout.num_carets     = max(last.carets.end(), (usize) 1);
   layout.num_codepoints = text_size;
-  layout.extent         = extent;
+  layout.extent         = f32x2{width, last.top + last.height};
   layout.laid_out       = true;
 }
 
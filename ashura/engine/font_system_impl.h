@@ -3,12 +3,18 @@
 #include "ashura/engine/errors.h"
 #include "ashura/engine/font.h"
 #include "ashura/engine/font_system.h"
+#include "ashura/engine/rect_pack.h"
+#include "ashura/std/async.h"
+#include "ashura/std/dict.h"
+#include "ashura/std/dyn.h"
+#include "ashura/std/range.h"
 #include "ashura/std/types.h"
 #include "ashura/std/vec.h"
 
 extern "C"
 {
 #include "freetype/freetype.h"
+#include "freetype/ftmodapi.h"
 #include "hb.h"
 }
 
@@ -16,6 +22,195 @@ namespace ash
 {
 // [ ] make systems MT-safe?
 
+/// @brief Incremental packer of a glyph atlas layer. The packing context is
+/// heap-allocated as it is self-referential and must not be moved.
+struct GlyphPacker
+{
+  Dyn<rect_pack::Context *> ctx;
+
+  Vec<rect_pack::Node> nodes;
+};
+
+/// @brief A glyph region staged for upload to an atlas layer
+/// @param area padded area of the glyph in the layer
+/// @param offset offset of the glyph's padded pixels in the staging buffer
+struct GlyphUpload
+{
+  gpu::Image image = nullptr;
+
+  RectU area = {};
+
+  u64 offset = 0;
+};
+
+/// @brief A glyph rasterized by a `GlyphRasterJob`
+/// @param extent extent of the glyph's bitmap, measured before rendering
+/// @param format atlas format of the glyph's bitmap
+/// @param layer atlas layer the glyph was packed into
+/// @param area padded area of the glyph in the layer
+/// @param offset offset of the glyph's padded pixels in the job's staging
+/// buffer
+/// @param rendered if the glyph was rendered into the staging buffer
+struct GlyphRaster
+{
+  u32x2 extent = {};
+
+  GlyphAtlasFormat format = GlyphAtlasFormat::Alpha;
+
+  u32 layer = 0;
+
+  RectU area = {};
+
+  u64 offset = 0;
+
+  bool rendered = false;
+};
+
+struct FontImpl;
+
+/// @brief State shared by the shards rasterizing a batch of a font's glyphs in
+/// parallel. Each shard owns an FT_Face over the font's shared memory blob,
+/// so no FreeType object is used across threads. The glyphs are measured in
+/// parallel, packed once, then rendered in parallel into disjoint regions of
+/// the staging buffer.
+/// @param ranges glyph range of each shard
+/// @param rasters measured and packed glyphs, parallel to `glyphs`
+struct GlyphRasterJob
+{
+  FontImpl * font = nullptr;
+
+  u32 font_height = 0;
+
+  Vec<u32> glyphs;
+
+  Vec<Slice32> ranges;
+
+  Vec<GlyphRaster> rasters;
+
+  Vec<FT_Library> ft_libs;
+
+  Vec<FT_Face> ft_faces;
+
+  Vec<u8> staging;
+
+  u32 num_measured = 0;
+
+  u32 num_rendered = 0;
+
+  explicit GlyphRasterJob(Allocator allocator) :
+    glyphs{allocator},
+    ranges{allocator},
+    rasters{allocator},
+    ft_libs{allocator},
+    ft_faces{allocator},
+    staging{allocator}
+  {
+  }
+
+  GlyphRasterJob(GlyphRasterJob const &)             = delete;
+  GlyphRasterJob(GlyphRasterJob &&)                  = delete;
+  GlyphRasterJob & operator=(GlyphRasterJob const &) = delete;
+  GlyphRasterJob & operator=(GlyphRasterJob &&)      = delete;
+  ~GlyphRasterJob()                                  = default;
+
+  u32 num_shards() const
+  {
+    return size32(ranges);
+  }
+};
+
+/// @brief Set of the codepoints a font has glyphs for, built once from the
+/// font's character map when it is loaded so fallback resolution costs a bit
+/// test per codepoint. The codepoint space is split into pages of 256
+/// codepoints and only the pages with at least one covered codepoint are
+/// stored.
+/// @param pages index of each page in `bits`, `NO_PAGE` if the page has no
+/// covered codepoints
+/// @param bits coverage bits of the stored pages
+struct FontCoverage
+{
+  static constexpr u32 PAGE_SHIFT = 8;
+
+  static constexpr u32 PAGE_SIZE = 1U << PAGE_SHIFT;
+
+  static constexpr u32 WORDS_PER_PAGE = PAGE_SIZE / 64;
+
+  static constexpr u32 NUM_PAGES = (UTF32_MAX + 1) >> PAGE_SHIFT;
+
+  static constexpr u16 NO_PAGE = U16_MAX;
+
+  Vec<u16> pages;
+
+  Vec<u64> bits;
+
+  explicit FontCoverage(Allocator allocator) :
+    pages{allocator},
+    bits{allocator}
+  {
+  }
+
+  FontCoverage(FontCoverage const &)             = delete;
+  FontCoverage(FontCoverage &&)                  = default;
+  FontCoverage & operator=(FontCoverage const &) = delete;
+  FontCoverage & operator=(FontCoverage &&)      = default;
+  ~FontCoverage()                                = default;
+
+  Result<> add(c32 codepoint)
+  {
+    if (codepoint > UTF32_MAX)
+    {
+      return Ok{};
+    }
+
+    if (pages.is_empty())
+    {
+      if (!pages.resize(NUM_PAGES))
+      {
+        return Err{};
+      }
+      fill(pages, NO_PAGE);
+    }
+
+    u16 & page = pages[codepoint >> PAGE_SHIFT];
+
+    if (page == NO_PAGE)
+    {
+      page = (u16) (bits.size() / WORDS_PER_PAGE);
+      if (!bits.extend_uninit(WORDS_PER_PAGE))
+      {
+        page = NO_PAGE;
+        return Err{};
+      }
+      fill(bits.view().slice(page * WORDS_PER_PAGE, WORDS_PER_PAGE), 0ULL);
+    }
+
+    bits[page * WORDS_PER_PAGE + ((codepoint >> 6) & (WORDS_PER_PAGE - 1))] |=
+      1ULL << (codepoint & 63);
+
+    return Ok{};
+  }
+
+  bool contains(c32 codepoint) const
+  {
+    if (codepoint > UTF32_MAX || pages.is_empty())
+    {
+      return false;
+    }
+
+    u16 const page = pages[codepoint >> PAGE_SHIFT];
+
+    if (page == NO_PAGE)
+    {
+      return false;
+    }
+
+    return (bits[page * WORDS_PER_PAGE +
+                 ((codepoint >> 6) & (WORDS_PER_PAGE - 1))] >>
+            (codepoint & 63)) &
+           1;
+  }
+};
+
 struct FontImpl final : IFont
 {
   static constexpr u32 MAX_NAME_SIZE = 256;
@@ -59,16 +254,20 @@ struct FontImpl final : IFont
 
   FontMetrics metrics;
 
-  Option<CpuFontAtlas> cpu_atlas = none;
+  /// @brief codepoints the font has glyphs for
+  FontCoverage coverage;
 
   Option<GpuFontAtlas> gpu_atlas = none;
 
+  /// @brief packers of the atlas layers, parallel to `gpu_atlas.layers`
+  Vec<GlyphPacker> packers;
+
   FontImpl(Vec<char> label, Vec<char> font_data, bool has_color,
            Name postscript_name, Name family_name, Name style_name,
            hb_blob_t * hb_blob, hb_face_t * hb_face, hb_font_t * hb_font,
            FT_Library ft_lib, FT_Face ft_face, u32 face,
            Vec<GlyphMetrics> glyphs, u32 replacement_glyph, u32 ellipsis_glyph,
-           u32 space_glyph, FontMetrics metrics) :
+           u32 space_glyph, FontMetrics metrics, FontCoverage coverage) :
     label{std::move(label)},
     font_data{std::move(font_data)},
     has_color{has_color},
@@ -85,7 +284,9 @@ struct FontImpl final : IFont
     replacement_glyph{replacement_glyph},
     ellipsis_glyph{ellipsis_glyph},
     space_glyph{space_glyph},
-    metrics{metrics}
+    metrics{metrics},
+    coverage{std::move(coverage)},
+    packers{this->glyphs.allocator_}
   {
   }
 
@@ -102,18 +303,280 @@ struct FontImpl final : IFont
   virtual FontInfo info() override;
 };
 
+/// @brief Identifies the preprocessed data of a font in the font cache
+/// @param font_hash hash of the contents of the font file
+struct FontCacheKey
+{
+  u64            font_hash   = 0;
+  u32            face        = 0;
+  u32            font_height = 0;
+  FontRasterMode mode        = FontRasterMode::Bitmap;
+
+  constexpr bool operator==(FontCacheKey const &) const = default;
+};
+
+/// @brief Preprocessed data of a font, persisted across runs so loading the
+/// font skips measuring its glyphs, building its coverage, and rasterizing its
+/// prewarmed glyphs. Packing is deterministic, so the prewarmed glyphs are
+/// packed again in the same order to restore the atlas' layout and packers.
+/// @param glyphs metrics of all the font's glyphs
+/// @param raster_glyphs the prewarmed glyphs
+/// @param rasters rasters of the prewarmed glyphs, parallel to `raster_glyphs`
+/// @param staging padded pixels of the prewarmed glyphs, at their rasters'
+/// offsets
+struct FontCache
+{
+  Vec<GlyphMetrics> glyphs;
+
+  FontCoverage coverage;
+
+  Vec<u32> raster_glyphs;
+
+  Vec<GlyphRaster> rasters;
+
+  Vec<u8> staging;
+
+  explicit FontCache(Allocator allocator) :
+    glyphs{allocator},
+    coverage{allocator},
+    raster_glyphs{allocator},
+    rasters{allocator},
+    staging{allocator}
+  {
+  }
+
+  FontCache(FontCache const &)             = delete;
+  FontCache(FontCache &&)                  = default;
+  FontCache & operator=(FontCache const &) = delete;
+  FontCache & operator=(FontCache &&)      = default;
+  ~FontCache()                             = default;
+};
+
+/// @brief parameters a run is shaped with, besides its codepoints
+struct ShapeKey
+{
+  FontId         font          = FontId::None;
+  hb_script_t    script        = HB_SCRIPT_INVALID;
+  hb_direction_t direction     = HB_DIRECTION_INVALID;
+  hb_language_t  language      = nullptr;
+  bool           use_kerning   = false;
+  bool           use_ligatures = false;
+
+  constexpr bool operator==(ShapeKey const &) const = default;
+};
+
+/// @param hash hash of the key and the run's codepoints with their context
+/// @param codepoints the run's codepoints with their context in the cache's
+/// codepoint arena
+/// @param glyphs the run's shaped glyphs in the cache's glyph arena, their
+/// clusters are relative to the run's first codepoint
+/// @param last_use tick of the last lookup that hit the run
+struct ShapedRun
+{
+  ShapeKey key        = {};
+  usize    hash       = 0;
+  Slice32  codepoints = {};
+  Slice32  glyphs     = {};
+  u64      last_use   = 0;
+};
+
+/// @brief Cache of shaped runs, so the runs of re-laid-out text (i.e. edited
+/// paragraphs and repeated labels) skip HarfBuzz. The codepoints and glyphs of
+/// the runs are stored in shared arenas. Once a budget is exceeded, the
+/// least-recently-used half of the runs is evicted and the arenas compacted.
+///
+/// HarfBuzz reads up to CONTEXT codepoints on either side of a run to shape
+/// across its boundaries (i.e. Arabic joining), so the runs are keyed by their
+/// codepoints along with that context.
+struct ShapeCache
+{
+  /// @brief number of codepoints of pre- and post-context HarfBuzz considers,
+  /// see HB_BUFFER_CONTEXT_LENGTH
+  static constexpr usize CONTEXT = 5;
+
+  static constexpr u32 MAX_RUNS = 16'384;
+
+  static constexpr u32 MAX_CODEPOINTS = 262'144;
+
+  static constexpr u32 MAX_GLYPHS = 262'144;
+
+  Vec<c32> codepoints_;
+
+  Vec<GlyphShape> glyphs_;
+
+  Vec<ShapedRun> runs_;
+
+  /// @brief run hash to index of the run. Hash collisions replace the
+  /// existing run.
+  BitDict<usize, u32> index_;
+
+  /// @brief scratch space for finding the eviction threshold
+  Vec<u64> uses_;
+
+  u64 tick_;
+
+  u64 hits_;
+
+  u64 misses_;
+
+  explicit ShapeCache(Allocator allocator) :
+    codepoints_{allocator},
+    glyphs_{allocator},
+    runs_{allocator},
+    index_{allocator},
+    uses_{allocator},
+    tick_{0},
+    hits_{0},
+    misses_{0}
+  {
+  }
+
+  ShapeCache(ShapeCache const &)             = delete;
+  ShapeCache(ShapeCache &&)                  = delete;
+  ShapeCache & operator=(ShapeCache const &) = delete;
+  ShapeCache & operator=(ShapeCache &&)      = delete;
+  ~ShapeCache()                              = default;
+
+  static usize hash(ShapeKey const & key, Str32 text);
+
+  /// @returns the cached glyphs of the run, valid until the next insertion
+  Option<Span<GlyphShape const>> find(ShapeKey const & key, usize hash,
+                                      Str32 text);
+
+  /// @brief cache a run shaped by HarfBuzz
+  /// @param text the run's codepoints with their context
+  /// @param first_cluster cluster of the run's first codepoint
+  /// @returns the cached glyphs of the run, valid until the next insertion
+  Span<GlyphShape const> insert(ShapeKey const & key, usize hash, Str32 text,
+                                u32                             first_cluster,
+                                Span<hb_glyph_info_t const>     infos,
+                                Span<hb_glyph_position_t const> positions);
+
+  /// @brief evict the runs shaped with the font, must be called before its
+  /// id is recycled
+  void evict(FontId font);
+
+  /// @brief evict the least-recently-used half of the runs
+  void evict_lru_();
+
+  /// @brief remove the runs not matching `keep` and compact the arenas
+  void compact_(auto && keep);
+};
+
+/// @brief Scratch state of a single `layout_text` call or of one of its
+/// shards. Contexts are pooled by the font system so concurrent layouts never
+/// share a HarfBuzz buffer.
+/// @param glyphs the glyphs of the run being laid out, copied out of the
+/// shared shape cache
+/// @param paragraphs the edited paragraphs of the text being laid out
+/// @param layout the edited paragraphs' layout, spliced into the call's
+/// layout once complete
+struct LayoutContext
+{
+  hb_buffer_t * hb_buffer;
+
+  /// @brief codepoints of the edited paragraphs
+  Vec<c32> text;
+
+  Vec<TextSegment> segments;
+
+  Vec<GlyphShape> glyphs;
+
+  Vec<Paragraph> paragraphs;
+
+  TextLayout layout;
+
+  LayoutContext(Allocator allocator, hb_buffer_t * hb_buffer) :
+    hb_buffer{hb_buffer},
+    text{allocator},
+    segments{allocator},
+    glyphs{allocator},
+    paragraphs{allocator},
+    layout{allocator}
+  {
+  }
+
+  LayoutContext(LayoutContext const &)             = delete;
+  LayoutContext(LayoutContext &&)                  = delete;
+  LayoutContext & operator=(LayoutContext const &) = delete;
+  LayoutContext & operator=(LayoutContext &&)      = delete;
+
+  ~LayoutContext()
+  {
+    hb_buffer_destroy(hb_buffer);
+  }
+};
+
 struct FontSysImpl final : IFontSys
 {
+  /// @brief extent of each glyph atlas layer
+  static constexpr u32 ATLAS_EXTENT = 512;
+
+  /// @brief number of layers a glyph atlas can grow to before the
+  /// least-recently-used layer is evicted. Exceeded only if all the layers are
+  /// in use by the current frame.
+  static constexpr u32 MAX_ATLAS_LAYERS = 8;
+
+  /// @brief padding around each glyph in the atlas, avoids texture spilling
+  /// due to accumulated floating-point uv interpolation errors
+  static constexpr u32 GLYPH_PADDING = 1;
+
+  /// @brief minimum number of glyphs rasterized by each shard of a
+  /// `GlyphRasterJob`
+  static constexpr u32 MIN_GLYPHS_PER_SHARD = 32;
+
+  /// @brief minimum number of edited paragraphs laid out by each shard of a
+  /// `layout_text` call
+  static constexpr u32 MIN_PARAGRAPHS_PER_SHARD = 16;
+
+  /// @brief distance (px) covered by the signed distance fields of glyphs
+  /// rasterized with `FontRasterMode::Sdf` on either side of their outlines.
+  /// Bounds how far the glyphs can be scaled up before their edges degrade.
+  static constexpr u32 SDF_SPREAD = 8;
+
+  static_assert(ATLAS_EXTENT >= 128, "Font atlas extent must be at least 128px");
+  static_assert(ATLAS_EXTENT % 64 == 0,
+                "Font atlas extent should be a multiple of 64");
+  static_assert(ATLAS_EXTENT <= 1'024,
+                "Font atlas extent too large for GPU platform");
+
   Allocator            allocator_;
   SparseVec<Dyn<Font>> fonts_;
-  Vec<TextSegment>     segments_;
-  hb_buffer_t *        hb_buffer_;
 
-  explicit FontSysImpl(Allocator allocator, hb_buffer_t * hb_buffer) :
+  /// @brief current frame, used for LRU eviction of atlas layers
+  u64 frame_;
+
+  /// @brief pixels of the glyphs rasterized this frame, in the format of
+  /// their atlas layers
+  Vec<u8> staging_;
+
+  Vec<GlyphUpload> uploads_;
+
+  /// @brief shared across the concurrent `layout_text` calls
+  ShapeCache shape_cache_;
+
+  IFutex shape_cache_lock_;
+
+  /// @brief idle layout contexts
+  Vec<Dyn<LayoutContext *>> contexts_;
+
+  ISpinLock contexts_lock_;
+
+  /// @brief directory the fonts' preprocessed data is cached in across runs,
+  /// caching is disabled if empty
+  Vec<char> cache_dir_;
+
+  explicit FontSysImpl(Allocator allocator) :
     allocator_{allocator},
     fonts_{allocator},
-    segments_{allocator},
-    hb_buffer_{hb_buffer}
+    frame_{1},
+    staging_{allocator},
+    uploads_{allocator},
+    shape_cache_{allocator},
+    shape_cache_lock_{},
+    contexts_{allocator},
+    contexts_lock_{},
+    cache_dir_{allocator}
   {
   }
 
@@ -121,27 +584,101 @@ struct FontSysImpl final : IFontSys
   FontSysImpl(FontSysImpl &&)                  = delete;
   FontSysImpl & operator=(FontSysImpl const &) = delete;
   FontSysImpl & operator=(FontSysImpl &&)      = delete;
-  ~FontSysImpl();
+  ~FontSysImpl() = default;
 
   virtual void shutdown() override;
 
+  /// @param cache if provided, the glyph metrics and coverage are taken from
+  /// it instead of being measured
   Result<Dyn<Font>, FontLoadErr> decode_(Str label, Span<u8 const> encoded,
-                                         u32 face = 0);
+                                         u32         face  = 0,
+                                         FontCache * cache = nullptr);
+
+  virtual Result<> rasterize(Font font, u32 font_height,
+                             FontRasterMode mode) override;
+
+  /// @brief rasterize the font's commonly used glyphs in parallel before it
+  /// is uploaded and resolve `fut` once it is uploaded
+  /// @param key the font's cache entry, written once the glyphs are
+  /// rasterized if caching is enabled
+  void prewarm_(Dyn<Font> font, u32 font_height, FontCacheKey const & key,
+                Future<Result<FontId, FontLoadErr>> fut);
+
+  /// @brief pack the prewarmed glyphs of a cache entry into the font's atlas
+  /// and resolve `fut` once it is uploaded, without rasterizing them
+  void restore_(Dyn<Font> font, u32 font_height, FontCache cache,
+                Future<Result<FontId, FontLoadErr>> fut);
+
+  /// @brief pack a measured glyph into the font's atlas and resolve its atlas
+  /// entry, empty glyphs are not packed
+  void pack_raster_(FontImpl & font, u32 glyph, GlyphRaster & r);
+
+  virtual void set_cache_dir(Str dir) override;
+
+  /// @brief read and validate the key's cache entry, if caching is enabled
+  Option<FontCache> load_cache_(FontCacheKey const & key);
+
+  /// @brief write the font's metrics, coverage, and the glyphs rasterized by
+  /// its prewarm job to the key's cache entry in the background
+  void store_cache_(FontCacheKey const & key, FontImpl const & font,
+                    GlyphRasterJob const & job);
+
+  /// @brief create the font's atlas layer images and upload the glyphs
+  /// rasterized by the prewarm job
+  FontId upload_(Dyn<Font> font, GlyphRasterJob const & prewarm);
+
+  /// @brief add a layer of the specified format to the font's atlas. The
+  /// layer's image is created separately by `create_layer_image_` as this can
+  /// be called off the main thread.
+  /// @returns the index of the new layer
+  u32 add_layer_(FontImpl & font, GlyphAtlasFormat format);
+
+  void create_layer_image_(FontImpl & font, u32 layer);
+
+  /// @brief pack a padded glyph area into a layer of the matching format,
+  /// growing the atlas or evicting its least-recently-used layer if it is full
+  /// @param can_evict if layers not used by the current frame can be evicted
+  /// @returns the layer and position of the padded glyph area
+  Tuple<u32, u32x2> pack_glyph_(FontImpl & font, u32 glyph, u32x2 padded_extent,
+                                GlyphAtlasFormat format, bool can_evict);
+
+  /// @brief evict all the glyphs in the atlas layer and reset its packer
+  void evict_layer_(FontImpl & font, u32 layer);
+
+  /// @brief rasterize the glyph and stage its pixels for upload
+  void rasterize_glyph_(FontImpl & font, u32 glyph);
+
+  virtual AtlasGlyph glyph(FontId font, u32 glyph) override;
+
+  virtual void upload_glyphs() override;
+
+  /// @brief take an idle layout context from the pool or create one.
+  /// Thread-safe.
+  Dyn<LayoutContext *> acquire_context_();
 
-  virtual Result<> rasterize(Font font, u32 font_height) override;
+  /// @brief return a layout context to the pool. Thread-safe.
+  void release_context_(Dyn<LayoutContext *> ctx);
 
-  FontId upload_(Dyn<Font> font);
+  /// @brief segment, shape, and break the paragraph into lines, appending
+  /// it to the layout. Its carets and top are placed by the caller.
+  /// Thread-safe.
+  /// @param region_text the paragraph's codepoints followed by its break
+  /// codepoints
+  void layout_paragraph_(LayoutContext & ctx, TextBlock const & block,
+                         f32 max_width, hb_language_t language,
+                         Paragraph const & paragraph, Str32 region_text,
+                         TextLayout & layout);
 
   virtual void layout_text(TextBlock const & block, f32 max_width,
-                           TextLayout & layout) override;
+                           TextLayout & layout, TextEdit edit) override;
 
   virtual Future<Result<FontId, FontLoadErr>>
     load_from_memory(Vec<char> label, Vec<u8> encoded, u32 font_height,
-                     u32 face = 0) override;
+                     u32 face, FontRasterMode mode) override;
 
   virtual Future<Result<FontId, FontLoadErr>>
-    load_from_path(Vec<char> label, Str path, u32 font_height,
-                   u32 face = 0) override;
+    load_from_path(Vec<char> label, Str path, u32 font_height, u32 face,
+                   FontRasterMode mode) override;
 
   virtual FontInfo get(FontId id) override;
 
@@ -391,8 +391,26 @@ GpuDescriptors GpuDescriptors::create(GpuSys sys, Str label, Allocator scratch)
                           std::move(sampled_textures_slots)};
 }
 
+static GpuBufferBlock create_buffer_block(GpuSys sys, u64 capacity,
+                                          Allocator allocator)
+{
+  u8                scratch_buffer_[1_KB];
+  FallbackAllocator scratch{scratch_buffer_, allocator};
+
+  auto buffer = GpuBuffer::create(sys, capacity, GpuBuffer::USAGE,
+                                  "GpuFramePlan / Buffer Block"_str, scratch);
+  auto map    = sys->dev_->get_memory_map(buffer.buffer).unwrap();
+
+  return GpuBufferBlock{.buffer = buffer, .map = map, .size = 0};
+}
+
 void IGpuFramePlan::uninit()
 {
+  for (auto & block : gpu_buffer_blocks_)
+  {
+    block.buffer.uninit(sys_->dev_);
+  }
+  gpu_buffer_blocks_.clear();
 }
 
 void IGpuFramePlan::set_target(GpuFrameTargetInfo target)
@@ -431,6 +449,12 @@ void IGpuFramePlan::add_postframe_task(GpuFrameTask && task)
   post_frame_tasks_.push(std::move(task)).unwrap();
 }
 
+void IGpuFramePlan::add_frame_completed_task(GpuFrameTask && task)
+{
+  CHECK(state_ == GpuFramePlanState::Recording, "");
+  frame_completed_tasks_.push(std::move(task)).unwrap();
+}
+
 void IGpuFramePlan::add_pass(GpuPass && pass)
 {
   CHECK(state_ == GpuFramePlanState::Recording, "");
@@ -453,19 +477,73 @@ CpuBufferId IGpuFramePlan::push_cpu(Span<u8 const> data)
 }
 
 GpuBufferId IGpuFramePlan::push_gpu(Span<u8 const> data)
+{
+  auto [id, map] = push_gpu_uninit(data.size());
+  mem::copy(data, map);
+  return id;
+}
+
+Tuple<GpuBufferId, Span<u8>> IGpuFramePlan::push_gpu_uninit(u64 size)
 {
   CHECK(state_ == GpuFramePlanState::Recording, "");
-  auto offset = gpu_buffer_data_.size();
-  gpu_buffer_data_.extend(data).unwrap();
-  auto size = max(data.size(), (usize) gpu::BUFFER_OFFSET_ALIGNMENT);
-  auto idx  = gpu_buffer_entries_.size();
-  CHECK(gpu_buffer_data_.size() <= U32_MAX, "");
-  gpu_buffer_entries_.push(offset, size).unwrap();
-  auto aligned_size =
-    align_offset<usize>(gpu::BUFFER_OFFSET_ALIGNMENT, gpu_buffer_data_.size());
-  gpu_buffer_data_.resize_uninit(aligned_size).unwrap();
+  auto span         = max(size, (u64) gpu::BUFFER_OFFSET_ALIGNMENT);
+  auto aligned_span = align_offset<u64>(gpu::BUFFER_OFFSET_ALIGNMENT, span);
+
+  if (gpu_buffer_blocks_.is_empty() ||
+      (gpu_buffer_blocks_.last().size + aligned_span) >
+        gpu_buffer_blocks_.last().buffer.capacity)
+  {
+    // chain a new block, the memory of the previous allocations stays valid
+    u64 capacity = gpu_buffer_blocks_.is_empty() ?
+                     0 :
+                     gpu_buffer_blocks_.last().buffer.capacity;
+    capacity = max(aligned_span, capacity * 2, MIN_GPU_BUFFER_BLOCK_SIZE);
+    gpu_buffer_blocks_.push(create_buffer_block(sys_, capacity, allocator_))
+      .unwrap();
+  }
+
+  auto   block_idx = size32(gpu_buffer_blocks_) - 1;
+  auto & block     = gpu_buffer_blocks_.last();
+  auto   offset    = block.size;
+  block.size += aligned_span;
+
+  auto idx = gpu_buffer_entries_.size();
+  CHECK(idx <= U32_MAX, "");
+  gpu_buffer_entries_
+    .push(GpuBufferEntry{
+      .block = block_idx, .slice{offset, span}
+  })
+    .unwrap();
 
-  return GpuBufferId{(u32) idx};
+  return Tuple{GpuBufferId{(u32) idx}, block.map.slice(offset, size)};
+}
+
+Option<Span<u8>> IGpuFramePlan::extend_gpu(GpuBufferId id, u64 extension)
+{
+  CHECK(state_ == GpuFramePlanState::Recording, "");
+  auto & entry = gpu_buffer_entries_[(usize) id];
+  auto & block = gpu_buffer_blocks_[entry.block];
+
+  auto end = align_offset<u64>(gpu::BUFFER_OFFSET_ALIGNMENT, entry.slice.end());
+
+  if ((entry.block + 1) != gpu_buffer_blocks_.size() || end != block.size)
+  {
+    return none;
+  }
+
+  auto span = entry.slice.span + extension;
+  auto new_end =
+    align_offset<u64>(gpu::BUFFER_OFFSET_ALIGNMENT, entry.slice.offset + span);
+
+  if (new_end > block.buffer.capacity)
+  {
+    return none;
+  }
+
+  block.size       = new_end;
+  entry.slice.span = span;
+
+  return block.map.slice(entry.slice.offset, span);
 }
 
 GpuSys IGpuFramePlan::sys() const
@@ -494,18 +572,60 @@ void IGpuFramePlan::end()
 void IGpuFramePlan::reset()
 {
   CHECK(state_ != GpuFramePlanState::Submitted, "");
-  // these buffers are expected to be very large so we reset them on every frame when they aren't being used
-  // Target at least 75% utilization
-  pre_frame_tasks_.shrink_clear().unwrap();
-  post_frame_tasks_.shrink_clear().unwrap();
-  frame_completed_tasks_.shrink_clear().unwrap();
-  gpu_buffer_data_.shrink_clear().unwrap();
-  gpu_buffer_entries_.shrink_clear().unwrap();
-  cpu_buffer_data_.shrink_clear().unwrap();
-  cpu_buffer_entries_.shrink_clear().unwrap();
-  scratch_buffer_sizes_.shrink_clear().unwrap();
+  // the buffers keep their capacity across frames, the frames' sizes are
+  // about the same so they would be reallocated on every frame otherwise
+  pre_frame_tasks_.clear();
+  post_frame_tasks_.clear();
+  frame_completed_tasks_.clear();
+  gpu_buffer_entries_.clear();
+  cpu_buffer_data_.clear();
+  cpu_buffer_entries_.clear();
+  scratch_buffer_sizes_.clear();
   num_scratch_images_ = 0;
-  passes_.shrink_clear().unwrap();
+  passes_.clear();
+
+  u64 used = 0;
+  for (auto const & block : gpu_buffer_blocks_)
+  {
+    used += block.size;
+  }
+
+  // decay the high-water mark so the memory of a transient spike is released
+  gpu_buffer_high_water_ =
+    max(used, gpu_buffer_high_water_ -
+                (gpu_buffer_high_water_ >> GPU_BUFFER_DECAY_SHIFT));
+
+  auto const trimmed_capacity =
+    max(gpu_buffer_high_water_ * 2, MIN_GPU_BUFFER_BLOCK_SIZE);
+
+  // the GPU is done with the blocks. if the frame needed more than one,
+  // coalesce them so the next frames fit in a single block
+  if (gpu_buffer_blocks_.size() > 1)
+  {
+    u64 capacity = 0;
+    for (auto & block : gpu_buffer_blocks_)
+    {
+      capacity += block.buffer.capacity;
+      block.buffer.uninit(sys_->dev_);
+    }
+    gpu_buffer_blocks_.clear();
+    gpu_buffer_blocks_.push(create_buffer_block(sys_, capacity, allocator_))
+      .unwrap();
+  }
+  else if (gpu_buffer_blocks_.size() == 1 &&
+           gpu_buffer_blocks_[0].buffer.capacity > (trimmed_capacity * 2))
+  {
+    // the recent frames use less than a quarter of the block, shrink it
+    gpu_buffer_blocks_[0].buffer.uninit(sys_->dev_);
+    gpu_buffer_blocks_[0] =
+      create_buffer_block(sys_, trimmed_capacity, allocator_);
+  }
+
+  for (auto & block : gpu_buffer_blocks_)
+  {
+    block.size = 0;
+  }
+
   target_ = {};
   arena_.reclaim();
   state_ = GpuFramePlanState::Reset;
@@ -805,7 +925,6 @@ ScratchBuffers ScratchBuffers::create(GpuSys sys, Span<u64 const> sizes,
 
 void GpuFrameResources::uninit(gpu::Device device)
 {
-  buffer.uninit(device);
   scratch_buffers.uninit(device);
   scratch_images.uninit(device);
   queries.uninit(device);
@@ -935,8 +1054,8 @@ Span<GpuBuffer const> IGpuFrame::get_scratch_buffers() const
 GpuBufferSpan IGpuFrame::get(GpuBufferId id)
 {
   CHECK(state_ == GpuFrameState::Recording, "");
-  Slice64 slice = current_plan_->gpu_buffer_entries_.get((usize) id);
-  return {resources_.buffer, slice};
+  auto const & entry = current_plan_->gpu_buffer_entries_.get((usize) id);
+  return {current_plan_->gpu_buffer_blocks_[entry.block].buffer, entry.slice};
 }
 
 Span<u8 const> IGpuFrame::get(CpuBufferId id)
@@ -1005,14 +1124,15 @@ void IGpuFrame::submit()
 
   // [ ] collect time and statistics traces
 
+  // the plan's buffers were written to directly in mapped memory
+  for (auto const & block : current_plan_->gpu_buffer_blocks_)
   {
-    auto label = sformat(scratch, "GpuFrame {} / Buffer"_str, id_).unwrap();
-    CHECK(current_plan_->gpu_buffer_data_.size() <= cfg_.max_buffer_size, "");
-    auto size = clamp(current_plan_->gpu_buffer_data_.size(),
-                      cfg_.min_buffer_size, cfg_.max_buffer_size);
-    grow_buffer(sys_, label, resources_.buffer, size, scratch);
-    mem::copy(current_plan_->gpu_buffer_data_.view(),
-              dev_->get_memory_map(resources_.buffer.buffer).unwrap());
+    CHECK(block.size <= cfg_.max_buffer_size, "");
+    if (block.size != 0)
+    {
+      dev_->flush_mapped_memory(block.buffer.buffer, Slice64{0, block.size})
+        .unwrap();
+    }
   }
 
   {
@@ -1090,7 +1210,6 @@ void IGpuFrame::submit()
   }
 
   command_encoder_->end().unwrap();
-  (void) current_plan_->semaphore_->increment(1);
 
   command_buffer_->begin();
   command_buffer_->record(command_encoder_);
@@ -1133,6 +1252,7 @@ bool IGpuFrame::try_complete(nanoseconds timeout)
   current_plan_->state_ = GpuFramePlanState::Executed;
   state_                = GpuFrameState::Completed;
   (void) semaphore_->increment(1);
+  (void) current_plan_->semaphore_->increment(1);
 
   return true;
 }
@@ -1144,6 +1264,7 @@ void IGpuFrame::reset()
   command_encoder_->reset();
   command_buffer_->reset();
   current_plan_ = nullptr;
+  state_        = GpuFrameState::Reset;
 }
 
 bool IGpuFrame::await(nanoseconds timeout)
@@ -1235,6 +1356,17 @@ void IGpuSys::uninit(Vec<u8> & cache)
   CHECK(drain_semaphore->complete(0), "");
   CHECK(drain_semaphore->await(1ULL, nanoseconds::max()), "");
   dev_->await_idle().unwrap();
+
+  // run the completion tasks of the frames still in flight, i.e. releasing
+  // the resources they used
+  for (auto & frame : frames_)
+  {
+    if (frame->state_ == GpuFrameState::Submitted)
+    {
+      CHECK(frame->try_complete(nanoseconds{0}), "");
+    }
+  }
+
   dev_->get_pipeline_cache_data(pipeline_cache_, cache).unwrap();
 
   for (auto & frame : frames_)
@@ -1244,7 +1376,7 @@ void IGpuSys::uninit(Vec<u8> & cache)
 
   for (auto & plan : plans_)
   {
-    plan.uninit();
+    plan->uninit();
   }
 
   descriptors_.uninit(dev_);
@@ -1310,7 +1442,7 @@ void create_default_samplers(GpuSys sys, Allocator scratch)
                            .compare_enable           = false,
                            .compare_op               = gpu::CompareOp::Never,
                            .min_lod                  = 0,
-                           .max_lod                  = 0,
+                           .max_lod                  = F32_MAX,
                            .border_color             = color,
                            .unnormalized_coordinates = false});
       }
@@ -1561,6 +1693,8 @@ void IGpuSys::init(Allocator allocator, gpu::Device device,
   thread_id_   = thread_id;
   initialized_ = true;
 
+  plans_[frame_ring_index_]->begin();
+
   create_default_textures(this);
   create_default_samplers(this, scratch);
 }
@@ -1632,6 +1766,27 @@ TextureIndex IGpuSys::alloc_texture_index(gpu::ImageView view)
   return static_cast<TextureIndex>(index);
 }
 
+void IGpuSys::update_texture_index(TextureIndex index, gpu::ImageView view)
+{
+  CHECK(initialized_, "");
+
+  LockGuard guard{resources_lock_};
+
+  CHECK(descriptors_.sampled_textures_slots.get((usize) index), "");
+
+  plan()->add_preframe_task([device   = this->dev_,
+                             textures = descriptors_.sampled_textures,
+                             index    = static_cast<u32>(index), view] {
+    device->update_descriptor_set(gpu::DescriptorSetUpdate{
+      .set           = textures,
+      .binding       = 0,
+      .first_element = index,
+      .images        = span({gpu::ImageBinding{.image_view = view}}),
+      .texel_buffers = {},
+      .buffers       = {}});
+  });
+}
+
 void IGpuSys::release_texture_index(TextureIndex index)
 {
   CHECK(initialized_, "");
@@ -1712,8 +1867,12 @@ void IGpuSys::submit_frame()
   auto * frame = frames_[frame_ring_index_].get();
   auto * plan  = plans_[frame_ring_index_].get();
 
+  plan->end();
+
+  auto * next_frame = frames_[(frame_ring_index_ + 1) % buffering_].get();
+
   scheduler_->once(
-    [frame, plan] {
+    [frame, plan, next_frame] {
       frame->await(nanoseconds::max());
       frame->reset();
       frame->begin();
@@ -1721,14 +1880,24 @@ void IGpuSys::submit_frame()
       frame->end();
       frame->submit();
 
-      // [ ] complete????; will need to be in order
+      // the next slot is re-acquired next, complete its frame, submitted
+      // `buffering - 1` frames ago, so the slot's plan can be recorded to
+      // again. the frames in between stay queued on the GPU.
+      if (next_frame->state_ == GpuFrameState::Submitted)
+      {
+        next_frame->try_complete(nanoseconds::max());
+      }
     },
     Ready{}, thread_id_);
 
   frame_ring_index_ = (frame_ring_index_ + 1) % buffering_;
 
-  // wait on the next frame plan
-  plans_[frame_ring_index_]->await(nanoseconds::max());
+  // wait on the next frame plan, it is only signaled once the GPU has
+  // executed it, so its buffers can then be recorded to again
+  auto * next = plans_[frame_ring_index_].get();
+  next->await(nanoseconds::max());
+  next->reset();
+  next->begin();
 }
 
 // [ ] move to scene construction
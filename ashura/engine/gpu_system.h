@@ -342,9 +342,35 @@ enum class GpuFramePlanState : u8
   Executed  = 4
 };
 
+/// @brief A block of persistently mapped GPU buffer memory
+struct GpuBufferBlock
+{
+  GpuBuffer buffer = {};
+
+  /// @brief The host mapping of the buffer, valid for the lifetime of the
+  /// buffer
+  Span<u8> map = {};
+
+  /// @brief Number of bytes allocated from the start of the block
+  u64 size = 0;
+};
+
+struct GpuBufferEntry
+{
+  u32 block = 0;
+
+  Slice64 slice = {};
+};
+
 /// @brief A prepared frame ready to be executed on the render thread
 struct IGpuFramePlan
 {
+  static constexpr u64 MIN_GPU_BUFFER_BLOCK_SIZE = 5_MB;
+
+  /// @brief The high-water mark of the GPU buffers decays by 1/2^SHIFT of
+  /// itself on every reset, halving in about 22 frames
+  static constexpr u32 GPU_BUFFER_DECAY_SHIFT = 5;
+
   Allocator allocator_;
 
   GpuSys sys_;
@@ -355,9 +381,20 @@ struct IGpuFramePlan
 
   Vec<GpuFrameTask> frame_completed_tasks_;
 
-  Vec<u8> gpu_buffer_data_;
+  /// @brief The persistently mapped blocks the GPU buffers of the frame are
+  /// written to. Allocations are bumped from the last block, a new block is
+  /// chained when it is full so the spans already handed out stay valid. The
+  /// plans are buffered like the frames, so the blocks of a plan are only
+  /// written to once the GPU is done reading them; they are coalesced into a
+  /// single block when the plan is reset, and trimmed once the frames use
+  /// much less than the block's capacity.
+  Vec<GpuBufferBlock> gpu_buffer_blocks_;
+
+  /// @brief The decaying high-water mark of the GPU buffer bytes used by the
+  /// frames recorded on the plan
+  u64 gpu_buffer_high_water_;
 
-  Vec<Slice64> gpu_buffer_entries_;
+  Vec<GpuBufferEntry> gpu_buffer_entries_;
 
   Vec<u8> cpu_buffer_data_;
 
@@ -385,7 +422,8 @@ struct IGpuFramePlan
     pre_frame_tasks_{allocator},
     post_frame_tasks_{allocator},
     frame_completed_tasks_{allocator},
-    gpu_buffer_data_{allocator},
+    gpu_buffer_blocks_{allocator},
+    gpu_buffer_high_water_{0},
     gpu_buffer_entries_{allocator},
     cpu_buffer_data_{allocator},
     cpu_buffer_entries_{allocator},
@@ -428,6 +466,19 @@ struct IGpuFramePlan
         .unwrap());
   }
 
+  /// @brief Add a task to be run once the GPU has executed the frame, and
+  /// the frames submitted before it. i.e. to release the resources its passes
+  /// use.
+  void add_frame_completed_task(GpuFrameTask && task);
+
+  template <Callable Lambda>
+  void add_frame_completed_task(Lambda && task)
+  {
+    return add_frame_completed_task(
+      dyn_lambda<GpuFrameTaskFn>(arena_, static_cast<Lambda &&>(task))
+        .unwrap());
+  }
+
   void add_pass(GpuPass && pass);
 
   template <Callable<GpuFrame, gpu::CommandEncoder> Lambda>
@@ -453,6 +504,24 @@ struct IGpuFramePlan
     return push_gpu(data.as_u8().as_const());
   }
 
+  /// @brief Allocate `size` bytes of GPU buffer memory for the frame
+  /// @returns the buffer and its mapped memory, to be written to directly.
+  /// The memory is valid until the plan is reset.
+  Tuple<GpuBufferId, Span<u8>> push_gpu_uninit(u64 size);
+
+  template <typename T>
+  Tuple<GpuBufferId, Span<T>> push_gpu_uninit(usize num)
+  {
+    auto [id, map] = push_gpu_uninit(num * sizeof(T));
+    return Tuple{id, map.reinterpret<T>()};
+  }
+
+  /// @brief Extend the GPU buffer `id` in place by `extension` bytes, only
+  /// the last buffer allocated can be extended, and only if its block has
+  /// enough space left
+  /// @returns the mapped memory of the extended buffer
+  Option<Span<u8>> extend_gpu(GpuBufferId id, u64 extension);
+
   GpuSys sys() const;
 
   gpu::Device device() const;
@@ -509,7 +578,6 @@ struct ScratchBuffers
 
 struct GpuFrameResources
 {
-  GpuBuffer      buffer          = {};
   ScratchBuffers scratch_buffers = {};
   ScratchImages  scratch_images  = {};
   GpuQueries     queries         = {};
@@ -793,6 +861,10 @@ struct IGpuSys
   /// at the start of the next frame
   TextureIndex alloc_texture_index(gpu::ImageView view);
 
+  /// @brief Re-bind an allocated texture slot to another image view at the
+  /// start of the next frame
+  void update_texture_index(TextureIndex index, gpu::ImageView view);
+
   /// @brief Release a texture slot and unbind it from the textures descriptors at the start
   /// of the next frame
   void release_texture_index(TextureIndex index);
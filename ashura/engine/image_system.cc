@@ -10,15 +10,27 @@ namespace ash
 {
 
 ImageInfo IImageSys::create_image_(Vec<char> label, gpu::ImageInfo const & info,
-                                   Span<gpu::ImageViewInfo const> view_infos)
+                                   Span<gpu::ImageViewInfo const> view_infos,
+                                   u32                            first_mip)
 {
-  gpu::Image gpu_image = sys.gpu->device()->create_image(info).unwrap();
+  gpu::ImageInfo resident = info;
+  resident.extent         = info.extent.xy().mip(first_mip).append(1);
+  resident.mip_levels     = info.mip_levels - first_mip;
 
-  Image image{.label = std::move(label), .info = info, .image = gpu_image};
+  gpu::Image gpu_image = sys.gpu->device()->create_image(resident).unwrap();
+
+  Image image{.label        = std::move(label),
+              .info         = info,
+              .image        = gpu_image,
+              .resident_mip = first_mip};
 
   for (gpu::ImageViewInfo view_info : view_infos)
   {
     view_info.image = gpu_image;
+    if (first_mip > 0)
+    {
+      view_info.mip_levels = Slice32{0, resident.mip_levels};
+    }
     gpu::ImageView view =
       sys.gpu->device()->create_image_view(view_info).unwrap();
     TextureIndex tex_index = sys.gpu->alloc_texture_index(view);
@@ -43,9 +55,64 @@ void IImageSys::shutdown()
   }
 }
 
+void IImageSys::prepare_mips_(gpu::ImageInfo const & info,
+                              Span<u8 const> channels, Vec<u8> & mips)
+{
+  CHECK(info.mip_levels > 0, "");
+  CHECK(info.mip_levels <= num_mip_levels(info.extent.xy()), "");
+
+  mips
+    .resize_uninit(mip_chain_size_bytes(info.extent.xy(), info.array_layers, 4,
+                                        info.mip_levels))
+    .unwrap();
+
+  ImageLayerSpan<u8, 4> dst{.channels = mips,
+                            .extent   = info.extent.xy(),
+                            .layers   = info.array_layers};
+
+  switch (info.format)
+  {
+    case gpu::Format::R8G8B8A8_UNORM:
+    {
+      ImageLayerSpan<u8 const, 4> src{.channels = channels,
+                                      .extent   = info.extent.xy(),
+                                      .layers   = info.array_layers};
+
+      for (u32 i = 0; i < info.array_layers; i++)
+      {
+        copy_RGBA_to_BGRA(src.layer(i), dst.layer(i));
+      }
+    }
+    break;
+    case gpu::Format::R8G8B8_UNORM:
+    {
+      ImageLayerSpan<u8 const, 3> src{.channels = channels,
+                                      .extent   = info.extent.xy(),
+                                      .layers   = info.array_layers};
+
+      for (u32 i = 0; i < info.array_layers; i++)
+      {
+        copy_RGB_to_BGRA(src.layer(i), dst.layer(i), U8_MAX);
+      }
+    }
+    break;
+    case gpu::Format::B8G8R8A8_UNORM:
+    {
+      mem::copy(channels.slice(0, pixel_size_bytes(info.extent.xy(), 4) *
+                                    info.array_layers),
+                mips.data());
+    }
+    break;
+    default:
+      CHECK(false, "Unsupported image format: {}", info.format);
+  }
+
+  generate_mips<4>(mips, info.extent.xy(), info.array_layers, info.mip_levels);
+}
+
 ImageInfo IImageSys::upload_(Vec<char> label, gpu::ImageInfo const & info,
                              Span<gpu::ImageViewInfo const> view_infos,
-                             Span<u8 const>                 channels)
+                             Span<u8 const> channels, MipResidency residency)
 {
   CHECK(info.type == gpu::ImageType::Type2D, "");
   CHECK(
@@ -54,7 +121,8 @@ ImageInfo IImageSys::upload_(Vec<char> label, gpu::ImageInfo const & info,
     "");
   CHECK(info.aspects == gpu::ImageAspects::Color, "");
   CHECK(info.extent.z() == 1, "");
-  CHECK(info.mip_levels == 1, "");
+  CHECK(info.mip_levels > 0, "");
+  CHECK(info.mip_levels <= num_mip_levels(info.extent.xy()), "");
   CHECK(info.array_layers > 0, "");
   CHECK(view_infos.size() > 0, "");
   CHECK(info.sample_count == gpu::SampleCount::C1, "");
@@ -62,6 +130,11 @@ ImageInfo IImageSys::upload_(Vec<char> label, gpu::ImageInfo const & info,
           info.format == gpu::Format::R8G8B8_UNORM ||
           info.format == gpu::Format::B8G8R8A8_UNORM,
         "");
+  CHECK(info.mip_levels == 1 || info.format == gpu::Format::B8G8R8A8_UNORM,
+        "Mip chains must be prepared as BGRA");
+  CHECK(residency == MipResidency::None || info.mip_levels > 1 ||
+          num_mip_levels(info.extent.xy()) == 1,
+        "");
 
   gpu::Format resolved_format = gpu::Format::B8G8R8A8_UNORM;
 
@@ -121,6 +194,18 @@ ImageInfo IImageSys::upload_(Vec<char> label, gpu::ImageInfo const & info,
       break;
   }
 
+  // the finest level resident at load time
+  u32 resident_mip = 0;
+
+  if (residency == MipResidency::Streamed)
+  {
+    while ((resident_mip + 1) < info.mip_levels &&
+           info.extent.xy().mip(resident_mip).max() > STREAMED_BASE_EXTENT)
+    {
+      resident_mip++;
+    }
+  }
+
   gpu::ImageInfo resolved_info = info;
   resolved_info.format         = resolved_format;
 
@@ -130,33 +215,255 @@ ImageInfo IImageSys::upload_(Vec<char> label, gpu::ImageInfo const & info,
   for (gpu::ImageViewInfo & info : resolved_view_infos)
   {
     info.view_format = resolved_format;
+    if (residency != MipResidency::None)
+    {
+      info.mip_levels = Slice32{0, resolved_info.mip_levels};
+    }
+  }
+
+  ImageInfo image = create_image_(std::move(label), resolved_info,
+                                  resolved_view_infos, resident_mip);
+
+  Image & img = images_[(usize) image.id].v0;
+
+  upload_mips_(img, bgra, resident_mip, info.mip_levels);
+
+  img.base_mip      = resident_mip;
+  img.requested_mip = resident_mip;
+
+  return img.to_view();
+}
+
+gpu::Image IImageSys::reside_(Image & image, u32 first)
+{
+  gpu::Image const prev = image.image;
+
+  gpu::ImageInfo resident = image.info;
+  resident.extent         = image.info.extent.xy().mip(first).append(1);
+  resident.mip_levels     = image.info.mip_levels - first;
+
+  image.image        = sys.gpu->device()->create_image(resident).unwrap();
+  image.resident_mip = first;
+
+  for (auto [view_info, view, texture] :
+       zip(image.view_infos, image.views, image.textures))
+  {
+    gpu::ImageView const old_view = view;
+    view_info.image               = image.image;
+    view_info.mip_levels          = Slice32{0, resident.mip_levels};
+    view = sys.gpu->device()->create_image_view(view_info).unwrap();
+    sys.gpu->update_texture_index(texture, view);
+    sys.gpu->plan()->add_frame_completed_task(
+      [old_view, dev = sys.gpu->device()] { dev->uninit(old_view); });
   }
 
-  ImageInfo image =
-    create_image_(std::move(label), resolved_info, resolved_view_infos);
-
-  auto buffer_id = sys.gpu->plan()->push_gpu(bgra);
-
-  sys.gpu->plan()->add_pass([buffer_id, img = image.image,
-                             info](GpuFrame frame, gpu::CommandEncoder enc) {
-    auto buffer = frame->get(buffer_id);
-    enc->copy_buffer_to_image(
-      buffer.buffer.buffer, img,
-      span({
-        gpu::BufferImageCopy{
-                             .buffer_offset       = buffer.slice.offset,
-                             .buffer_row_length   = info.extent.x(),
-                             .buffer_image_height = info.extent.y(),
-                             .image_layers{
-            .aspects      = gpu::ImageAspects::Color,
-            .mip_level    = 0,
-            .array_layers = {0, info.array_layers},
-
-          }, .image_area{.offset{0, 0, 0}, .extent = info.extent}}
-    }));
+  // the current frame's passes copy from the previous image, and the frames
+  // in flight still sample it through the texture indices
+  sys.gpu->plan()->add_frame_completed_task(
+    [prev, dev = sys.gpu->device()] { dev->uninit(prev); });
+
+  return prev;
+}
+
+void IImageSys::upload_mips_(Image & image, Span<u8 const> mips, u32 first,
+                             u32 last)
+{
+  CHECK(first < last, "");
+  CHECK(first >= image.resident_mip, "");
+  CHECK(last <= image.info.mip_levels, "");
+
+  u32x2 const extent   = image.info.extent.xy();
+  u32 const   layers   = image.info.array_layers;
+  u32 const   resident = image.resident_mip;
+  u64 const   offset   = mip_offset_bytes(extent, layers, 4, first);
+  u64 const   size     = mip_offset_bytes(extent, layers, 4, last) - offset;
+
+  auto buffer_id = sys.gpu->plan()->push_gpu(mips.slice(offset, size));
+
+  sys.gpu->plan()->add_pass([buffer_id, img = image.image, extent, layers,
+                             resident, first,
+                             last](GpuFrame frame, gpu::CommandEncoder enc) {
+    auto buffer       = frame->get(buffer_id);
+    u64  level_offset = buffer.slice.offset;
+
+    for (u32 level = first; level < last; level++)
+    {
+      u32x2 const level_extent = extent.mip(level);
+      enc->copy_buffer_to_image(
+        buffer.buffer.buffer, img,
+        span({
+          gpu::BufferImageCopy{
+                               .buffer_offset       = level_offset,
+                               .buffer_row_length   = level_extent.x(),
+                               .buffer_image_height = level_extent.y(),
+                               .image_layers{
+              .aspects      = gpu::ImageAspects::Color,
+              .mip_level    = level - resident,
+              .array_layers = {0, layers},
+            }, .image_area{.offset{0, 0, 0},
+                                  .extent = level_extent.append(1)}}
+      }));
+      level_offset += pixel_size_bytes(level_extent, 4) * layers;
+    }
   });
+}
+
+void IImageSys::stream(ImageId id, f32x2 extent)
+{
+  Image & image = images_[(usize) id].v0;
+
+  if (image.source.is_empty())
+  {
+    return;
+  }
+
+  u32x2 const base  = image.info.extent.xy();
+  f32 const   scale = min(base.x() / max(extent.x(), 1.0F),
+                          base.y() / max(extent.y(), 1.0F));
+
+  // the coarsest level that still covers the displayed extent
+  u32 const level =
+    (scale < 2) ? 0 : min(ulog2((u64) scale), image.info.mip_levels - 1);
+
+  image.requested_mip = min(image.requested_mip, level);
+
+  if (level >= image.resident_mip || image.streaming.is_some())
+  {
+    return;
+  }
+
+  u64 const request = next_request_++;
+  image.streaming   = request;
+
+  gpu::ImageInfo info = image.info;
+  info.label          = {};
+
+  Future load_fut = sys.file->load_file(allocator_, image.source);
 
-  return image;
+  // the levels are re-decoded and generated on a worker, the main thread only
+  // records the copies
+  scheduler->once(
+    [this, id, request, level, info, load_fut = load_fut.alias()]() mutable {
+      Vec<u8> mips{allocator_};
+
+      load_fut.get().match(
+        [&](Vec<u8> & buffer) {
+          Vec<u8> channels{allocator_};
+          decode_image(buffer, channels)
+            .match(
+              [&](DecodedImageInfo const & decoded) {
+                if (decoded.extent != info.extent.xy())
+                {
+                  trace("Streamed image source changed, id: {}", (u64) id);
+                  return;
+                }
+                gpu::ImageInfo src = info;
+                src.format         = decoded.format;
+                prepare_mips_(src, channels, mips);
+              },
+              [&](ImageLoadErr) {
+                trace("Failed to decode streamed image, id: {}", (u64) id);
+              });
+        },
+        [&](IoErr) {
+          trace("Failed to load streamed image, id: {}", (u64) id);
+        });
+
+      scheduler->once(
+        [this, id, request, level, mips = std::move(mips)]() {
+          stream_in_(id, request, level, mips);
+        },
+        Ready{}, ThreadId::Main);
+    },
+    AwaitFutures{load_fut.alias()}, ThreadId::AnyWorker);
+}
+
+void IImageSys::stream_in_(ImageId id, u64 request, u32 level,
+                           Span<u8 const> mips)
+{
+  // the image might have been unloaded and its id re-used since the request
+  if (!images_.is_valid_id((usize) id))
+  {
+    return;
+  }
+
+  Image & image = images_[(usize) id].v0;
+
+  if (image.streaming.is_none() || image.streaming.v() != request)
+  {
+    return;
+  }
+
+  image.streaming = none;
+
+  if (mips.is_empty())
+  {
+    // stop streaming, the coarser levels remain usable
+    image.source.reset();
+    return;
+  }
+
+  if (level >= image.resident_mip)
+  {
+    return;
+  }
+
+  reside_(image, level);
+  upload_mips_(image, mips, level, image.info.mip_levels);
+}
+
+void IImageSys::trim()
+{
+  frame_++;
+
+  if (frame_ % STREAM_TRIM_FRAMES != 0)
+  {
+    return;
+  }
+
+  for (Image & image : images_.dense.v0)
+  {
+    if (image.source.is_empty())
+    {
+      continue;
+    }
+
+    u32 const needed    = image.requested_mip;
+    image.requested_mip = image.base_mip;
+
+    if (needed <= image.resident_mip)
+    {
+      continue;
+    }
+
+    // the finer levels were not displayed since the last trim, the coarser
+    // levels are copied over from the previous image
+    u32 const        prev_first = image.resident_mip;
+    gpu::Image const prev       = reside_(image, needed);
+
+    sys.gpu->plan()->add_pass(
+      [prev, img = image.image, extent = image.info.extent.xy(),
+       layers = image.info.array_layers, levels = image.info.mip_levels,
+       prev_first, needed](GpuFrame, gpu::CommandEncoder enc) {
+        for (u32 level = needed; level < levels; level++)
+        {
+          enc->copy_image(
+            prev, img,
+            span({
+              gpu::ImageCopy{
+                             .src_layers{.aspects      = gpu::ImageAspects::Color,
+                            .mip_level    = level - prev_first,
+                            .array_layers = {0, layers}},
+                             .src_area{.offset{0, 0, 0},
+                          .extent = extent.mip(level).append(1)},
+                             .dst_layers{.aspects      = gpu::ImageAspects::Color,
+                            .mip_level    = level - needed,
+                            .array_layers = {0, layers}},
+                             .dst_offset{0, 0, 0}}
+          }));
+        }
+      });
+  }
 }
 
 Result<ImageInfo, ImageLoadErr>
@@ -168,54 +475,82 @@ Result<ImageInfo, ImageLoadErr>
 }
 
 Future<Result<ImageInfo, ImageLoadErr>>
-  IImageSys::load_from_path(Vec<char> label, Str path)
+  IImageSys::load_from_path(Vec<char> label, Str path, MipResidency residency)
 {
   Future fut = future<Result<ImageInfo, ImageLoadErr>>(allocator_).unwrap();
   Future load_fut = sys.file->load_file(allocator_, path);
 
+  Vec<char> source{allocator_};
+
+  if (residency == MipResidency::Streamed)
+  {
+    source.extend(path).unwrap();
+  }
+
   scheduler->once(
     [fut = fut.alias(), load_fut = load_fut.alias(), label = std::move(label),
-     this]() mutable {
+     source = std::move(source), this, residency]() mutable {
       load_fut.get().match(
-        [&, this, label = std::move(label)](Vec<u8> & buffer) mutable {
+        [&, this, label = std::move(label),
+         source = std::move(source)](Vec<u8> & buffer) mutable {
           trace("Decoding image {} ", label);
           Vec<u8> channels{allocator_};
           decode_image(buffer, channels)
             .match(
-              [&, this](DecodedImageInfo const & info) {
+              [&, this](DecodedImageInfo const & decoded) {
                 trace("Succesfully decoded image {}", label);
+
+                gpu::ImageInfo info{
+                  .label        = {},
+                  .type         = gpu::ImageType::Type2D,
+                  .format       = decoded.format,
+                  .usage        = gpu::ImageUsage::Sampled |
+                           gpu::ImageUsage::TransferDst |
+                           gpu::ImageUsage::TransferSrc,
+                  .aspects      = gpu::ImageAspects::Color,
+                  .extent       = decoded.extent.append(1),
+                  .mip_levels   = 1,
+                  .array_layers = 1,
+                  .sample_count = gpu::SampleCount::C1};
+
+                // mips are generated on the worker so the main thread only
+                // records the copies
+                if (residency != MipResidency::None)
+                {
+                  info.mip_levels = num_mip_levels(decoded.extent);
+                  Vec<u8> mips{allocator_};
+                  prepare_mips_(info, channels, mips);
+                  channels    = std::move(mips);
+                  info.format = gpu::Format::B8G8R8A8_UNORM;
+                }
+
                 scheduler->once(
                   [fut = fut.alias(), channels = std::move(channels), this,
-                   info, label                 = std::move(label)]() mutable {
-                    Span label_view = label.view();
-                    fut
-                      .yield(Ok{
-                        upload_(
-                          std::move(label),
-                          gpu::ImageInfo{.label  = label_view,
-                                         .type   = gpu::ImageType::Type2D,
-                                         .format = info.format,
-                                         .usage  = gpu::ImageUsage::Sampled |
-                                                  gpu::ImageUsage::TransferDst |
-                                                  gpu::ImageUsage::TransferSrc,
-                                         .aspects    = gpu::ImageAspects::Color,
-                                         .extent     = info.extent.append(1),
-                                         .mip_levels = 1,
-                                         .array_layers = 1,
-                                         .sample_count = gpu::SampleCount::C1},
-                          span({gpu::ImageViewInfo{
-                            .label       = label_view,
-                            .image       = nullptr,
-                            .view_type   = gpu::ImageViewType::Type2D,
-                            .view_format = info.format,
-                            .mapping     = {},
-                            .aspects     = gpu::ImageAspects::Color,
-                            .mip_levels{0, 1},
-                            .array_layers{0, 1}}}
-                          ),
-                          channels)
-                    })
-                      .unwrap();
+                   info, residency, label = std::move(label),
+                   source = std::move(source)]() mutable {
+                    Span           label_view = label.view();
+                    gpu::ImageInfo resolved   = info;
+                    resolved.label            = label_view;
+                    ImageInfo const image =
+                      upload_(std::move(label), resolved,
+                              span({gpu::ImageViewInfo{
+                                .label       = label_view,
+                                .image       = nullptr,
+                                .view_type   = gpu::ImageViewType::Type2D,
+                                .view_format = info.format,
+                                .mapping     = {},
+                                .aspects     = gpu::ImageAspects::Color,
+                                .mip_levels{0, info.mip_levels},
+                                .array_layers{0, 1}}}),
+                              channels, residency);
+
+                    // the finer levels are re-loaded from the source on demand
+                    if (image.resident_mip > 0)
+                    {
+                      images_[(usize) image.id].v0.source = std::move(source);
+                    }
+
+                    fut.yield(Ok{image}).unwrap();
                   },
                   Ready{}, ThreadId::Main);
               },
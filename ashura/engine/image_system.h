@@ -14,6 +14,23 @@ enum class ImageId : u64
   None = U64_MAX
 };
 
+/// @brief Mip residency mode of an image loaded by the image system
+enum class MipResidency : u8
+{
+  /// @brief Only the base level is generated and uploaded
+  None = 0,
+
+  /// @brief The full mip chain is generated on the CPU and uploaded at load
+  /// time
+  Full = 1,
+
+  /// @brief The full mip chain is generated on the CPU, only the coarsest
+  /// levels are kept and uploaded at load time. The finer levels are re-loaded
+  /// from the image's source when displayed (see: `IImageSys::stream`) and
+  /// evicted once they are no longer displayed (see: `IImageSys::trim`)
+  Streamed = 2
+};
+
 struct ImageInfo
 {
   ImageId id = ImageId::None;
@@ -29,6 +46,8 @@ struct ImageInfo
   gpu::Image image = nullptr;
 
   Span<gpu::ImageView const> views{};
+
+  u32 resident_mip = 0;
 };
 
 struct Image
@@ -47,22 +66,51 @@ struct Image
 
   Vec<gpu::ImageView> views{};
 
+  /// @brief The finest mip level currently resident on the GPU. `image` only
+  /// holds the levels [resident_mip, info.mip_levels), its base level is
+  /// `info.extent.mip(resident_mip)`.
+  u32 resident_mip = 0;
+
+  /// @brief Path the finer levels of a streamed image are re-loaded from.
+  /// Empty if the image is not streamed.
+  Vec<char> source{};
+
+  /// @brief The finest level of a streamed image kept resident when it is
+  /// not displayed
+  u32 base_mip = 0;
+
+  /// @brief The finest level requested since the image was last trimmed
+  u32 requested_mip = 0;
+
+  /// @brief The stream-in request in flight, if any
+  Option<u64> streaming = none;
+
   constexpr ImageInfo to_view() const
   {
-    return {.id         = id,
-            .label      = label,
-            .textures   = textures,
-            .info       = info,
-            .view_infos = view_infos,
-            .image      = image,
-            .views      = views};
+    return {.id           = id,
+            .label        = label,
+            .textures     = textures,
+            .info         = info,
+            .view_infos   = view_infos,
+            .image        = image,
+            .views        = views,
+            .resident_mip = resident_mip};
   }
 };
 
 struct IImageSys
 {
+  /// @brief Streamed images initially upload the levels at most this extent
+  static constexpr u32 STREAMED_BASE_EXTENT = 128;
+
+  /// @brief Number of rendered frames the finer levels of a streamed image are
+  /// kept resident for after they were last requested
+  static constexpr u64 STREAM_TRIM_FRAMES = 120;
+
   Allocator        allocator_;
   SparseVec<Image> images_{};
+  u64              frame_        = 0;
+  u64              next_request_ = 0;
 
   explicit IImageSys(Allocator allocator) :
     allocator_{allocator},
@@ -78,20 +126,62 @@ struct IImageSys
 
   void shutdown();
 
+  /// @param first_mip the finest mip level resident on the GPU, the GPU image
+  /// only holds the levels [first_mip, info.mip_levels)
   ImageInfo create_image_(Vec<char> label, gpu::ImageInfo const & info,
-                          Span<gpu::ImageViewInfo const> view_infos);
-
+                          Span<gpu::ImageViewInfo const> view_infos,
+                          u32                            first_mip = 0);
+
+  /// @brief Re-create the GPU image of `image` to hold the mip levels
+  /// [first, info.mip_levels) and re-target its views in place, so its
+  /// texture indices remain valid. The previous image and views are released
+  /// once the current frame has executed, the frames submitted before it that
+  /// sample them have executed by then too.
+  /// @returns the previous GPU image, valid for the current frame's passes
+  gpu::Image reside_(Image & image, u32 first);
+
+  /// @brief Convert `channels` to BGRA and generate `info.mip_levels` mip
+  /// levels from its base level.
+  /// @param channels base level of the image, in `info.format`
+  /// @param mips output BGRA, level-major mip chain
+  void prepare_mips_(gpu::ImageInfo const & info, Span<u8 const> channels,
+                     Vec<u8> & mips);
+
+  /// @param channels the image's data. If `info.mip_levels` is greater than 1,
+  /// this is the BGRA, level-major mip chain produced by `prepare_mips_`,
+  /// otherwise the base level in `info.format`.
   ImageInfo upload_(Vec<char> label, gpu::ImageInfo const & info,
                     Span<gpu::ImageViewInfo const> view_infos,
-                    Span<u8 const>                 channels);
+                    Span<u8 const> channels,
+                    MipResidency   residency = MipResidency::None);
+
+  /// @brief Upload mip levels [first, last) of the image. They must be
+  /// resident on the GPU.
+  /// @param mips BGRA, level-major mip chain of the image from its base level
+  void upload_mips_(Image & image, Span<u8 const> mips, u32 first, u32 last);
+
+  /// @brief Upload the levels re-loaded for a stream-in request
+  /// @param mips the re-loaded mip chain, empty if re-loading failed
+  void stream_in_(ImageId id, u64 request, u32 level, Span<u8 const> mips);
 
   Result<ImageInfo, ImageLoadErr>
     load_from_memory(Vec<char> label, gpu::ImageInfo const & info,
                      Span<gpu::ImageViewInfo const> view_infos,
                      Span<u8 const>                 channels);
 
-  Future<Result<ImageInfo, ImageLoadErr>> load_from_path(Vec<char> label,
-                                                         Str       path);
+  Future<Result<ImageInfo, ImageLoadErr>>
+    load_from_path(Vec<char> label, Str path,
+                   MipResidency residency = MipResidency::None);
+
+  /// @brief Request the mip levels needed to display a streamed image at
+  /// `extent` (px). The missing finer levels are re-loaded from the image's
+  /// source on a worker thread and uploaded once ready.
+  void stream(ImageId id, f32x2 extent);
+
+  /// @brief Called once per rendered frame. Evicts the finer levels of the
+  /// streamed images that were not requested in the last `STREAM_TRIM_FRAMES`
+  /// rendered frames.
+  void trim();
 
   Option<ImageInfo> get(Str label);
 
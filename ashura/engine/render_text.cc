@@ -1,6 +1,7 @@
 /// SPDX-License-Identifier: MIT
 #include "ashura/engine/render_text.h"
 #include "ashura/engine/systems.h"
+#include "ashura/std/allocators.h"
 #include "ashura/std/range.h"
 
 namespace ash
@@ -118,6 +119,7 @@ RenderText & RenderText::run(TextStyle const & style, FontStyle const & font,
     }
   }
 
+  edits_.add(Slice{first, count}(size()), size());
   hash_ = HASH_DIRTY;
 
   return *this;
@@ -210,9 +212,9 @@ RenderText & RenderText::alignment(f32 alignment)
   return *this;
 }
 
-Str32 RenderText::get_text() const
+void RenderText::get_text(Vec<c32> & out, Slice range) const
 {
-  return text_;
+  text_.read(range, out).unwrap();
 }
 
 RenderText & RenderText::text(Str32 utf32, TextStyle const & style,
@@ -227,7 +229,9 @@ RenderText & RenderText::text(Str32 utf32, TextStyle const & style,
 RenderText & RenderText::text(Str32 utf32)
 {
   text_.clear();
-  text_.extend(utf32).unwrap();
+  text_.insert(0, utf32).unwrap();
+  generation_++;
+  edits_ = TextEdit{};
   flush_text();
   return *this;
 }
@@ -243,15 +247,49 @@ RenderText & RenderText::text(Str8 utf8, TextStyle const & style,
 
 RenderText & RenderText::text(Str8 utf8)
 {
-  text_.clear();
-  utf8_decode(utf8, text_).unwrap();
-  flush_text();
-  return *this;
+  u8                scratch[512];
+  FallbackAllocator allocator{Arena::from(scratch), default_allocator};
+  Vec<c32>          utf32{allocator};
+  utf8_decode(utf8, utf32).unwrap();
+  return text(utf32);
+}
+
+void RenderText::add_edit_(Slice codepoints)
+{
+  edits_.add(codepoints, size());
+
+  // the runs are not moved by edits, so the styles of the codepoints after a
+  // run boundary following the edit change
+  if (runs_.size() > 2 && runs_[runs_.size() - 2] > codepoints.offset)
+  {
+    edits_.tail = 0;
+  }
+}
+
+Slice RenderText::insert(usize codepoint, Str32 text)
+{
+  codepoint = min(codepoint, size());
+  add_edit_(Slice{codepoint, 0});
+  return text_.insert(codepoint, text).unwrap();
+}
+
+void RenderText::insert_pieces(usize codepoint, Span<Slice const> pieces)
+{
+  codepoint = min(codepoint, size());
+  add_edit_(Slice{codepoint, 0});
+  text_.insert_pieces(codepoint, pieces).unwrap();
+}
+
+void RenderText::erase(Slice codepoints, Vec<Slice> & erased)
+{
+  codepoints = codepoints(size());
+  add_edit_(codepoints);
+  text_.erase(codepoints, erased).unwrap();
 }
 
 TextBlock RenderText::block() const
 {
-  return TextBlock{.text          = text_,
+  return TextBlock{.pieces        = &text_,
                    .runs          = runs_,
                    .fonts         = fonts_,
                    .font_scale    = font_scale_,
@@ -283,8 +321,9 @@ void RenderText::layout(f32 max_width)
     return;
   }
 
-  sys->font.layout_text(block(), max_width, layout_);
-  hash_ = HASH_CLEAN;
+  sys->font.layout_text(block(), max_width, layout_, edits_);
+  edits_ = TextEdit::none();
+  hash_  = HASH_CLEAN;
 }
 
 void RenderText::render(TextRenderer renderer, f32x2 center, f32 align_width,
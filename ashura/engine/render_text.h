@@ -4,6 +4,7 @@
 #include "ashura/engine/canvas.h"
 #include "ashura/engine/text.h"
 #include "ashura/std/error.h"
+#include "ashura/std/piece_table.h"
 #include "ashura/std/text.h"
 #include "ashura/std/types.h"
 
@@ -15,6 +16,11 @@ namespace ash
 /// - manages and checks for text layout invalidation
 /// - recalculates text layout when it changes and if necessary
 /// - renders the text using the computed style information
+/// @param text_ pieces of the text, the erased and inserted pieces are kept
+/// for undo. The layout only reads the edited paragraphs from it.
+/// @param generation_ incremented whenever the text is replaced, which
+/// invalidates the pieces of the previous text
+/// @param edits_ the codepoints edited since the text was last laid out
 /// @param runs  Run-End encoded sequences of the runs
 struct RenderText
 {
@@ -28,7 +34,9 @@ struct RenderText
   TextDirection      direction_     : 2;
   f32                alignment_;
   f32                font_scale_;
-  Vec<c32>           text_;
+  PieceTable<c32>    text_;
+  u64                generation_;
+  TextEdit           edits_;
   Vec<usize>         runs_;
   Vec<TextStyle>     styles_;
   Vec<FontStyle>     fonts_;
@@ -48,6 +56,8 @@ struct RenderText
     alignment_{ALIGNMENT_LEFT},
     font_scale_{1},
     text_{allocator},
+    generation_{0},
+    edits_{},
     runs_{allocator},
     styles_{allocator},
     fonts_{allocator},
@@ -76,6 +86,7 @@ struct RenderText
   RenderText & run(TextStyle const & style, FontStyle const & font,
                    usize first = 0, usize count = USIZE_MAX);
 
+  /// @brief invalidate the layout after edits
   RenderText & flush_text();
 
   RenderText & wrap(bool wrap);
@@ -100,7 +111,8 @@ struct RenderText
 
   RenderText & alignment(f32 alignment);
 
-  Str32 get_text() const;
+  /// @brief append the codepoints in `range` to `out`
+  void get_text(Vec<c32> & out, Slice range = Slice{0, USIZE_MAX}) const;
 
   RenderText & text(Str32 utf32, TextStyle const & style,
                     FontStyle const & font);
@@ -111,6 +123,22 @@ struct RenderText
 
   RenderText & text(Str8 utf8);
 
+  /// @brief record the edited codepoints for the next layout
+  void add_edit_(Slice codepoints);
+
+  /// @brief insert text at the codepoint. Laid out once flushed.
+  /// @returns the piece of the text holding the inserted codepoints
+  Slice insert(usize codepoint, Str32 text);
+
+  /// @brief re-insert pieces of the text at the codepoint, i.e. erased
+  /// pieces. Laid out once flushed.
+  void insert_pieces(usize codepoint, Span<Slice const> pieces);
+
+  /// @brief erase the codepoints. Laid out once flushed.
+  /// @param[out] erased the pieces of the erased codepoints, valid until the
+  /// text is replaced
+  void erase(Slice codepoints, Vec<Slice> & erased);
+
   usize size() const
   {
     return text_.size();
@@ -62,7 +62,8 @@ enum class ShapeType : u32
 {
   RRect    = 0,
   Squircle = 1,
-  SDFMap   = 2
+  SDFMap   = 2,
+  GlyphSDF = 3
 };
 
 enum class ShadeType : u32
@@ -253,6 +254,7 @@ struct QuadItem
 {
   alignas(16) f32x4x4 world_transform;
   alignas(16) f32x4x4 uv_transform;
+  alignas(16) f32x4 clip;
   alignas(16) f32x4x4 corners;
   MaterialType material;
 };
@@ -264,6 +266,7 @@ struct SdfItem
 {
   alignas(16) f32x4x4 world_transform;
   alignas(16) f32x4x4 uv_transform;
+  alignas(16) f32x4 clip;
   alignas(16) f32x4 radii;
   alignas(8) f32x2 half_bbox_extent;
   alignas(8) f32x2 half_extent;
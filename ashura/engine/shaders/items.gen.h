@@ -147,7 +147,8 @@ enum class SdfShapeType : u32
 {
   RRect    = 0,
   Squircle = 1,
-  SDFMap   = 2
+  SDFMap   = 2,
+  GlyphSDF = 3
 };
 
 enum class SdfShadeType : u32
@@ -311,6 +312,7 @@ struct QuadItem
 {
   alignas(16) f32x4x4 world_transform;
   alignas(16) f32x4x4 uv_transform;
+  alignas(16) f32x4 clip;
   alignas(16) f32x4x4 corners;
   MaterialType material;
 };
@@ -322,6 +324,7 @@ struct SdfItem
 {
   alignas(16) f32x4x4 world_transform;
   alignas(16) f32x4x4 uv_transform;
+  alignas(16) f32x4 clip;
   alignas(16) f32x4 radii;
   alignas(8) f32x2 half_bbox_extent;
   alignas(8) f32x2 half_extent;
@@ -0,0 +1,69 @@
+/// SPDX-License-Identifier: MIT
+
+#include "gtest/gtest.h"
+
+#include "ashura/engine/canvas.h"
+#include "ashura/engine/encoders.h"
+#include "ashura/engine/gpu_system.h"
+
+using namespace ash;
+
+static void record(ICanvas & canvas, GpuFramePlan plan)
+{
+  canvas.begin(
+    gpu::Viewport{.extent{100, 100}, .min_depth = 0, .max_depth = 1},
+    f32x2{100, 100}, u32x2{100, 100}, plan);
+  canvas.rect({
+    .area{.center{-20, -20}, .extent{10, 10}}
+  });
+  canvas.rect({
+    .area{.center{20, 20}, .extent{10, 10}}
+  });
+  canvas.end();
+}
+
+TEST(Canvas, RecordsIntoPlan)
+{
+  // a host block stands in for the plan's mapped GPU memory, so no GPU
+  // buffer is allocated
+  alignas(64) static u8 memory[64_KB];
+
+  IGpuFramePlan plan{default_allocator, nullptr,
+                     dyn<ISemaphore>(inplace, default_allocator, 1ULL).unwrap()};
+  plan.gpu_buffer_blocks_
+    .push(GpuBufferBlock{.buffer{.capacity = sizeof(memory)}, .map = span(memory)})
+    .unwrap();
+  plan.begin();
+
+  // the shapes of a canvas begun with its plan are written to the plan's
+  // GPU buffers as they are recorded
+  {
+    ICanvas canvas{default_allocator};
+    record(canvas, &plan);
+
+    ASSERT_EQ(canvas.encoders_.size(), 1);
+    auto & enc = *(SdfEncoder *) canvas.encoders_[0].get();
+
+    EXPECT_EQ(enc.num_instances_, 2);
+    EXPECT_TRUE(enc.items_.is_empty());
+    EXPECT_NE(enc.size_, 0);
+    EXPECT_EQ(plan.gpu_buffer_entries_.size(), 1);
+    EXPECT_GE(plan.gpu_buffer_blocks_[0].size, enc.size_);
+  }
+
+  // otherwise they are staged until the canvas is executed
+  {
+    ICanvas canvas{default_allocator};
+    record(canvas, nullptr);
+
+    ASSERT_EQ(canvas.encoders_.size(), 1);
+    auto & enc = *(SdfEncoder *) canvas.encoders_[0].get();
+
+    EXPECT_EQ(enc.num_instances_, 2);
+    EXPECT_FALSE(enc.items_.is_empty());
+    EXPECT_EQ(plan.gpu_buffer_entries_.size(), 1);
+  }
+
+  // the block is not a GPU buffer
+  plan.gpu_buffer_blocks_.clear();
+}
@@ -40,3 +40,79 @@ TEST(RenderText, RunManagement)
   text.run({}, {}, 0, USIZE_MAX);
   ASSERT_EQ(text.runs_.size(), 1);
 }
+
+TEST(RenderText, Edits)
+{
+  using namespace ash;
+
+  RenderText text{default_allocator};
+  text.text(U"hello world"_str);
+
+  Vec<Slice> erased{default_allocator};
+  Vec<c32>   read{default_allocator};
+  text.erase(Slice{5, 6}, erased);
+  text.insert(0, U"say "_str);
+  text.get_text(read);
+  ASSERT_TRUE(mem::eq(read.view(), U"say hello"_str));
+
+  text.insert_pieces(text.size(), erased);
+  read.clear();
+  text.get_text(read);
+  ASSERT_TRUE(mem::eq(read.view(), U"say hello world"_str));
+
+  read.clear();
+  text.get_text(read, Slice{4, 5});
+  ASSERT_TRUE(mem::eq(read.view(), U"hello"_str));
+}
+
+TEST(TextLayout, ClipCulling)
+{
+  using namespace ash;
+
+  // 2 paragraphs of 5 lines, 20 units tall, centered at the origin
+  TextLayout layout{default_allocator};
+  layout.extent = f32x2{100, 200};
+  for (usize i = 0; i < 10; i++)
+  {
+    layout.lines
+      .push(Line{
+        .metrics{.width = 100, .height = 20}
+    })
+      .unwrap();
+    layout.line_bottoms.push(20.0F * ((i % 5) + 1)).unwrap();
+  }
+
+  for (usize i = 0; i < 2; i++)
+  {
+    layout.paragraphs
+      .push(Paragraph{.lines  = Slice{i * 5, 5},
+                      .top    = 100.0F * i,
+                      .height = 100,
+                      .width  = 100})
+      .unwrap();
+  }
+
+  CRect const clip{
+    .center = {0, 50},
+    .extent = {100, 30}
+  };
+
+  auto visible = [&](f32x4x4 const & transform) {
+    return layout.visible_lines(f32x2{0, 0},
+                                TextLayout::layout_clip(transform, clip));
+  };
+
+  Slice const identity = visible(f32x4x4::identity());
+  ASSERT_EQ(identity.begin(), 6);
+  ASSERT_EQ(identity.end(), 9);
+
+  // the block is moved down by 100 units, its upper lines are visible
+  Slice const translated = visible(translate3d(f32x3{0, 100, 0}).to_mat());
+  ASSERT_EQ(translated.begin(), 1);
+  ASSERT_EQ(translated.end(), 4);
+
+  // the block is twice as large, the lines nearer its center are visible
+  Slice const scaled = visible(scale3d(f32x3{2, 2, 1}).to_mat());
+  ASSERT_EQ(scaled.begin(), 5);
+  ASSERT_EQ(scaled.end(), 7);
+}
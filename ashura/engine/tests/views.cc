@@ -3,7 +3,554 @@
 
 #include "gtest/gtest.h"
 
+#include "ashura/engine/canvas.h"
 #include "ashura/engine/view.h"
 #include "ashura/engine/view_system.h"
-#include "ashura/engine/views.h"
+#include "ashura/engine/views/list.h"
+#include "ashura/engine/views/table.h"
+#include "ashura/std/async.h"
+#include <memory>
+#include <thread>
+#include <tuple>
 
+using namespace ash;
+
+TEST(ListTest, ItemExtents)
+{
+  ui::ItemExtents extents{default_allocator};
+  extents.fallback_ = 20;
+
+  // unmeasured items are estimated at the fallback extent
+  ASSERT_EQ(extents.offset(10), 200);
+  ASSERT_EQ(extents.at(205), 10);
+
+  // mixed extents, measured past the initial capacity of the trees
+  Vec<f64> offsets{default_allocator};
+  f64      offset = 0;
+  for (usize i = 0; i < 1'000; i++)
+  {
+    f32 const extent = (i % 7 == 0) ? 60 : ((i % 3 == 0) ? 10 : 30);
+    extents.measure(i, extent);
+    offsets.push(offset).unwrap();
+    offset += extent;
+  }
+
+  for (usize i = 0; i < 1'000; i++)
+  {
+    ASSERT_EQ(extents.offset(i), offsets[i]);
+    ASSERT_EQ(extents.at(offsets[i]), i);
+    ASSERT_EQ(extents.at(offsets[i] + 5), i);
+  }
+
+  // remeasuring an item shifts the items after it
+  extents.measure(0, 100);
+  ASSERT_EQ(extents.offset(1), 100);
+  ASSERT_EQ(extents.offset(2), offsets[2] + 40);
+
+  // past the measured items, the items are estimated at the average extent
+  f64 const estimate = extents.estimate();
+  ASSERT_EQ(extents.at(extents.offset(1'024) + estimate * 3.5), 1'027);
+}
+
+TEST(TableTest, SortFilter)
+{
+  using experimental::df::ArrayInfo;
+  using experimental::df::Slicing;
+  using experimental::df::Type;
+
+  u32       ids[]      = {3, 1, 2, 1};
+  c8 const  names[]    = {'c', 'b', 'b', 'b', 'a'};
+  u64       segments[] = {0, 1, 1, 1, 2, 2, 4, 1};
+  ArrayInfo slices{.type = Type::Uint, .bit_size = 64, .size = 8,
+                   .data = segments};
+  ArrayInfo * components[] = {nullptr, &slices};
+
+  ArrayInfo const columns[] = {
+    ArrayInfo{.type = Type::Uint, .bit_size = 32, .size = 4, .data = ids},
+    ArrayInfo{.type           = Type::Utf8,
+              .slicing        = Slicing::Segments,
+              .bit_size       = 8,
+              .num_components = 2,
+              .size           = 4,
+              .components     = components,
+              .data           = (void *) names}
+  };
+
+  Vec<c8> text{default_allocator};
+  ui::format_cell(columns[1], 2, text);
+  ASSERT_TRUE(mem::eq(text.view(), u8"bb"_str));
+  text.clear();
+  ui::format_cell(columns[0], 0, text);
+  ASSERT_TRUE(mem::eq(text.view(), u8"3"_str));
+
+  ui::Table table;
+  table.columns(span(columns), {});
+  ASSERT_EQ(table.state_.size(), 4);
+
+  // sorting by the names then by the ids orders the rows by both
+  table.sort(1).sort(0);
+  ASSERT_TRUE(mem::eq(table.state_.rows.view(), span<u64>({3, 1, 2, 0})));
+
+  table.filter([&](u64 row) { return ids[row] != 1; });
+  ASSERT_TRUE(mem::eq(table.state_.rows.view(), span<u64>({2, 0})));
+
+  table.reset_rows();
+  ASSERT_EQ(table.state_.size(), 4);
+  ASSERT_EQ(table.state_.row(3), 3);
+}
+
+constexpr f32x2 VIEWPORT = {800, 600};
+
+constexpr nanoseconds WORKER_SLEEP[] = {1ms, 1ms};
+
+/// @brief a fixed-extent view that counts its ticks, fits, and renders
+struct Box : ui::View
+{
+  f32x2 extent;
+  CRect opaque       = {};
+  u32   ticks        = 0;
+  u32   fits         = 0;
+  u32   renders      = 0;
+  i32   layer_offset = 0;
+  i32   z_offset     = 0;
+
+  explicit Box(f32x2 extent = {10, 10}, bool retained = true) :
+    extent{extent}
+  {
+    retained_ = retained;
+  }
+
+  virtual ui::State tick(ui::Ctx const &, ui::Events const &,
+                         Fn<void(ui::View &)>) override
+  {
+    ticks++;
+    return {};
+  }
+
+  virtual ui::Layout fit(f32x2, Span<f32x2 const>, Span<f32x2>) override
+  {
+    fits++;
+    return ui::Layout{.extent = extent, .opaque = opaque};
+  }
+
+  virtual i32 layer(i32 allocated, Span<i32>) override
+  {
+    return allocated + layer_offset;
+  }
+
+  virtual i32 z_index(i32 allocated, Span<i32>) override
+  {
+    return allocated + z_offset;
+  }
+
+  virtual void render(Canvas, ui::RenderInfo const &) override
+  {
+    renders++;
+  }
+};
+
+/// @brief stacks its items from the top-left of the viewport
+struct Column : ui::View
+{
+  Vec<ref<ui::View>> items;
+
+  Column() : items{default_allocator}
+  {
+    retained_ = true;
+  }
+
+  virtual ui::State tick(ui::Ctx const &, ui::Events const &,
+                         Fn<void(ui::View &)> build) override
+  {
+    for (ref item : items)
+    {
+      build(item);
+    }
+    return {};
+  }
+
+  virtual ui::Layout fit(f32x2 allocated, Span<f32x2 const> sizes,
+                         Span<f32x2> centers) override
+  {
+    f32 y = 0;
+    for (usize i = 0; i < centers.size(); i++)
+    {
+      centers[i] = f32x2{sizes[i].x() - allocated.x(),
+                         2 * y + sizes[i].y() - allocated.y()} *
+                   0.5F;
+      y += sizes[i].y();
+    }
+    return ui::Layout{.extent = allocated};
+  }
+};
+
+/// @brief stacks its items on top of each other at its center, the later
+/// items above the earlier ones
+struct Overlay : Column
+{
+  virtual ui::Layout fit(f32x2 allocated, Span<f32x2 const>,
+                         Span<f32x2> centers) override
+  {
+    fill(centers, f32x2{0, 0});
+    return ui::Layout{.extent = allocated};
+  }
+};
+
+/// @brief replaces its parent's items on its next tick
+struct Replacer : Box
+{
+  Column &          parent;
+  Option<ui::View &> next = none;
+
+  Replacer(Column & parent) : Box{f32x2{100, 50}, false}, parent{parent}
+  {
+  }
+
+  virtual ui::State tick(ui::Ctx const & ctx, ui::Events const & events,
+                         Fn<void(ui::View &)> build) override
+  {
+    next.match([&](ui::View & v) {
+      parent.items.push(v).unwrap();
+      parent.mark_dirty(ui::Dirty::Children);
+    });
+    next = none;
+    return Box::tick(ctx, events, build);
+  }
+};
+
+template <typename I>
+struct BasicViewTree
+{
+  Dyn<Scheduler> sched;
+  IViewSysT<I>   sys;
+  InputState     input;
+  Column         root;
+
+  BasicViewTree() :
+    sched{IScheduler::create(
+      SchedulerInfo{.allocator           = default_allocator,
+                    .worker_thread_sleep = span(WORKER_SLEEP),
+                    .main_thread_id      = std::this_thread::get_id()})},
+    sys{default_allocator},
+    input{default_allocator}
+  {
+    hook_scheduler(sched);
+    input.window.extent = VIEWPORT.to<u32>();
+  }
+
+  ~BasicViewTree()
+  {
+    sched->shutdown();
+    hook_scheduler(nullptr);
+  }
+
+  void tick()
+  {
+    sys.tick(input, root, noop);
+  }
+
+  I index(ui::View & view) const
+  {
+    for (auto [i, v] : enumerate(sys.views))
+    {
+      if (v.ptr() == &view)
+      {
+        return (I) i;
+      }
+    }
+    CHECK_UNREACHABLE();
+  }
+};
+
+using ViewTree = BasicViewTree<u16>;
+
+/// @brief if the z-order holds every view once, ordered by layer, z-index,
+/// then depth, with ties in tree order
+template <typename I>
+static bool is_stacked(IViewSysT<I> const & sys)
+{
+  auto key = [&](I i) {
+    return std::tuple{sys.layers[i], sys.z_idx[i], sys.nodes.depth[i], i};
+  };
+
+  Vec<bool> seen{default_allocator};
+  seen.resize(sys.views.size()).unwrap();
+
+  for (usize z = 0; z < sys.z_ord.size(); z++)
+  {
+    I const i = sys.z_ord[z];
+
+    if (seen[i] || (z != 0 && !(key(sys.z_ord[z - 1]) < key(i))))
+    {
+      return false;
+    }
+
+    seen[i] = true;
+  }
+
+  return true;
+}
+
+TEST(ViewSysTest, IdleFrame)
+{
+  ViewTree tree;
+  Box      a{f32x2{100, 50}};
+  Box      b{f32x2{200, 50}};
+  Box      c{f32x2{100, 50}, false};
+  tree.root.items.extend(span<ref<ui::View>>({a, b, c})).unwrap();
+
+  tree.tick();
+  ASSERT_TRUE(tree.sys.damage.is_some());
+
+  // an unchanged tree is neither rebuilt nor redrawn, the views that aren't
+  // retained are ticked in-place
+  tree.tick();
+  ASSERT_TRUE(tree.sys.damage.is_none());
+  ASSERT_EQ(a.ticks, 1);
+  ASSERT_EQ(b.ticks, 1);
+  ASSERT_EQ(c.ticks, 2);
+
+  tree.tick();
+  ASSERT_TRUE(tree.sys.damage.is_none());
+  ASSERT_EQ(c.ticks, 3);
+}
+
+TEST(ViewSysTest, StateDamage)
+{
+  ViewTree tree;
+  Box      a{f32x2{100, 50}};
+  Box      b{f32x2{200, 50}};
+  tree.root.items.extend(span<ref<ui::View>>({a, b})).unwrap();
+
+  tree.tick();
+  tree.tick();
+
+  // only the region of the view that changed is redrawn
+  b.mark_dirty(ui::Dirty::State);
+  tree.tick();
+  auto const & region = tree.sys.regions[tree.index(b)];
+  ASSERT_TRUE(tree.sys.damage.is_some());
+  ASSERT_TRUE(tree.sys.damage.v() == region);
+  ASSERT_EQ(region.extent, (f32x2{200, 50}));
+  ASSERT_EQ(a.ticks, 1);
+  ASSERT_EQ(b.ticks, 2);
+
+  tree.tick();
+  ASSERT_TRUE(tree.sys.damage.is_none());
+}
+
+TEST(ViewSysTest, ChildrenMarkedByTick)
+{
+  ViewTree tree;
+  Box      a{f32x2{100, 50}};
+  Replacer r{tree.root};
+  tree.root.items.extend(span<ref<ui::View>>({a, r})).unwrap();
+
+  tree.tick();
+  tree.tick();
+
+  // the children replaced by a later view's tick are applied on the same
+  // frame, without ticking the ticked views twice
+  Box b{f32x2{100, 50}};
+  r.next = b;
+  tree.tick();
+  ASSERT_EQ(tree.sys.views.size(), 5);
+  ASSERT_EQ(tree.index(b), 4);
+  ASSERT_EQ(b.ticks, 1);
+  ASSERT_EQ(r.ticks, 3);
+  ASSERT_EQ(a.ticks, 2);
+}
+
+TEST(ViewSysTest, Occlusion)
+{
+  ViewTree tree;
+  Overlay  overlay;
+  Box      under{f32x2{100, 50}};
+  Box      partial{f32x2{400, 50}};
+  Box      over{f32x2{200, 100}};
+  over.opaque = CRect{.center = {}, .extent = over.extent};
+  overlay.items.extend(span<ref<ui::View>>({under, partial, over})).unwrap();
+  tree.root.items.push(overlay).unwrap();
+
+  tree.tick();
+
+  ICanvas canvas{default_allocator};
+  canvas.begin(gpu::Viewport{.extent = VIEWPORT, .min_depth = 0, .max_depth = 1},
+               VIEWPORT, VIEWPORT.to<u32>());
+  Canvas c = &canvas;
+  tree.sys.render(c);
+  canvas.end();
+
+  // the view fully covered by the opaque view above it is not rendered, the
+  // partially covered one is
+  ASSERT_EQ(under.renders, 0);
+  ASSERT_EQ(partial.renders, 1);
+  ASSERT_EQ(over.renders, 1);
+}
+
+TEST(ViewSysTest, HitTest)
+{
+  ViewTree tree;
+  Overlay  overlay;
+  Column   column;
+  Box      big{f32x2{600, 400}};
+  Box      small{f32x2{100, 100}};
+  Box      items[] = {Box{f32x2{150, 70}}, Box{f32x2{150, 70}},
+                      Box{f32x2{150, 70}}, Box{f32x2{150, 70}}};
+  for (Box & item : items)
+  {
+    column.items.push(item).unwrap();
+  }
+  overlay.items.extend(span<ref<ui::View>>({column, big, small})).unwrap();
+  tree.root.items.push(overlay).unwrap();
+
+  tree.tick();
+  ASSERT_FALSE(tree.sys.grid.entries.is_empty());
+
+  // the top-most view at the position is hit
+  ASSERT_EQ(tree.sys.hit_test({0, 0}).unwrap_or(U16_MAX), tree.index(small));
+  ASSERT_EQ(tree.sys.hit_test({250, 0}).unwrap_or(U16_MAX), tree.index(big));
+  ASSERT_EQ(tree.sys.hit_test({-390, -290}).unwrap_or(U16_MAX),
+            tree.index(items[0]));
+  ASSERT_EQ(tree.sys.hit_test({-390, -40}).unwrap_or(U16_MAX),
+            tree.index(items[3]));
+  ASSERT_EQ(tree.sys.hit_test({390, 290}).unwrap_or(U16_MAX),
+            tree.index(column));
+
+  // the grid finds the same views as testing all of them, including at the
+  // cell boundaries and outside the viewport
+  for (f32 y = -320; y <= 320; y += 16)
+  {
+    for (f32 x = -420; x <= 420; x += 16)
+    {
+      ASSERT_EQ(tree.sys.hit_test({x, y}).unwrap_or(U16_MAX),
+                tree.sys.scan_hit({x, y}).unwrap_or(U16_MAX));
+    }
+  }
+}
+
+TEST(ViewSysTest, U32Indices)
+{
+  // more views than u16 indices can address
+  static constexpr u32 NUM_VIEWS = 70'000;
+
+  BasicViewTree<u32>     tree;
+  Overlay                overlay;
+  std::unique_ptr<Box[]> boxes = std::make_unique<Box[]>(NUM_VIEWS);
+  overlay.items.reserve(NUM_VIEWS).unwrap();
+  for (u32 i = 0; i < NUM_VIEWS; i++)
+  {
+    overlay.items.push(boxes[i]).unwrap();
+  }
+  tree.root.items.push(overlay).unwrap();
+
+  tree.tick();
+
+  // the root view, the root column, and the overlay precede the boxes
+  ASSERT_EQ(tree.sys.views.size(), NUM_VIEWS + 3);
+  ASSERT_EQ(tree.index(boxes[NUM_VIEWS - 1]), NUM_VIEWS + 2);
+  ASSERT_EQ(tree.sys.nodes.parent[NUM_VIEWS + 2], tree.index(overlay));
+  ASSERT_EQ(tree.sys.extents[NUM_VIEWS + 2], (f32x2{10, 10}));
+
+  // the last box is above all the others
+  ASSERT_EQ(tree.sys.z_ord[NUM_VIEWS + 2], NUM_VIEWS + 2);
+  ASSERT_EQ(tree.sys.hit_test({0, 0}).unwrap_or(U32_MAX), NUM_VIEWS + 2);
+}
+
+TEST(ViewSysTest, LayoutMemo)
+{
+  ViewTree tree;
+  Box      a{f32x2{100, 50}};
+  Box      b{f32x2{200, 50}};
+  Box      c{f32x2{100, 50}};
+  tree.root.items.extend(span<ref<ui::View>>({a, b, c})).unwrap();
+
+  tree.tick();
+  ASSERT_EQ(a.fits, 1);
+  ASSERT_EQ(b.fits, 1);
+  ASSERT_EQ(c.fits, 1);
+
+  // a view whose layout changed but not its extent is fit alone
+  b.mark_dirty(ui::Dirty::Layout);
+  tree.tick();
+  ASSERT_EQ(a.fits, 1);
+  ASSERT_EQ(b.fits, 2);
+  ASSERT_EQ(c.fits, 1);
+  ASSERT_FALSE(tree.sys.refit[tree.index(tree.root)]);
+
+  // its parent is fit again once its extent changes, its siblings keep their
+  // layouts
+  b.extent = f32x2{300, 50};
+  b.mark_dirty(ui::Dirty::Layout);
+  tree.tick();
+  ASSERT_EQ(a.fits, 1);
+  ASSERT_EQ(b.fits, 3);
+  ASSERT_EQ(c.fits, 1);
+  ASSERT_TRUE(tree.sys.refit[tree.index(tree.root)]);
+  ASSERT_EQ(tree.sys.canvas_extents[tree.index(b)], (f32x2{300, 50}));
+  ASSERT_EQ(tree.sys.canvas_centers[tree.index(c)], (f32x2{-350, -175}));
+
+  // all the views are allocated new extents when the viewport is resized
+  tree.input.window.extent = u32x2{1'024, 768};
+  tree.tick();
+  ASSERT_EQ(a.fits, 2);
+  ASSERT_EQ(b.fits, 4);
+  ASSERT_EQ(c.fits, 2);
+}
+
+TEST(ViewSysTest, ZOrder)
+{
+  ViewTree tree;
+  Overlay  overlay;
+  Box      boxes[32];
+  for (Box & box : boxes)
+  {
+    overlay.items.push(box).unwrap();
+  }
+  tree.root.items.push(overlay).unwrap();
+
+  tree.tick();
+  ASSERT_TRUE(is_stacked(tree.sys));
+  ASSERT_EQ(tree.sys.hit_test({0, 0}).unwrap_or(U16_MAX),
+            tree.index(boxes[31]));
+
+  // restacking the views reorders them, including below their parents
+  for (i32 round = 0; round < 4; round++)
+  {
+    for (auto [i, box] : enumerate<i32>(boxes))
+    {
+      box.z_offset     = ((i * 7 + round * 3) % 5) - 2;
+      box.layer_offset = (i % 3 == round % 3) ? 1 : 0;
+      box.mark_dirty(ui::Dirty::Layout);
+    }
+    tree.tick();
+    ASSERT_TRUE(is_stacked(tree.sys));
+    ASSERT_EQ(tree.sys.hit_test({0, 0}).unwrap_or(U16_MAX),
+              tree.sys.z_ord[tree.sys.z_ord.size() - 1]);
+  }
+
+  // the z-order is reused while the views' stacking is unchanged
+  auto const n = tree.sys.z_ord.size();
+  swap(tree.sys.z_ord[n - 1], tree.sys.z_ord[n - 2]);
+  boxes[0].mark_dirty(ui::Dirty::Layout);
+  tree.tick();
+  ASSERT_FALSE(is_stacked(tree.sys));
+
+  // and sorted again once it changes
+  boxes[0].z_offset++;
+  boxes[0].mark_dirty(ui::Dirty::Layout);
+  tree.tick();
+  ASSERT_TRUE(is_stacked(tree.sys));
+
+  // stacking too wide to be radix sorted
+  boxes[1].layer_offset = I32_MIN;
+  boxes[2].z_offset     = I32_MAX;
+  boxes[3].z_offset     = I32_MIN;
+  for (Box & box : boxes)
+  {
+    box.mark_dirty(ui::Dirty::Layout);
+  }
+  tree.tick();
+  ASSERT_TRUE(is_stacked(tree.sys));
+  ASSERT_EQ(tree.sys.z_ord[0], tree.index(boxes[1]));
+}
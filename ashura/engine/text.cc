@@ -8,6 +8,63 @@
 namespace ash
 {
 
+/// @brief first line for which `line_pred(paragraph, line)` holds, with its
+/// paragraph found by `paragraph_pred(paragraph)`. The predicates must be
+/// monotonic and agree on the paragraph's last line. `lines.size()` if there
+/// is none.
+template <typename ParagraphPred, typename LinePred>
+static usize find_line(TextLayout const & layout,
+                       ParagraphPred && paragraph_pred, LinePred && line_pred)
+{
+  auto const p = binary_find(layout.paragraphs.view(), paragraph_pred);
+
+  if (p.is_empty())
+  {
+    return layout.lines.size();
+  }
+
+  Paragraph const & paragraph = p[0];
+
+  auto const l =
+    binary_find(layout.lines.view().slice(paragraph.lines),
+                [&](Line const & l) {
+                  return line_pred(paragraph,
+                                   (usize) (&l - layout.lines.data()));
+                });
+
+  return paragraph.lines.end() - l.size();
+}
+
+/// @brief first line whose carets end after `caret`, or at it if `inclusive`
+static usize find_caret_line(TextLayout const & layout, usize caret,
+                             bool inclusive)
+{
+  auto const after = [&](usize end) {
+    return inclusive ? (end >= caret) : (end > caret);
+  };
+
+  return find_line(
+    layout, [&](Paragraph const & p) { return after(p.carets.end()); },
+    [&](Paragraph const & p, usize l) {
+      return after(p.carets.offset + layout.lines[l].carets.end());
+    });
+}
+
+/// @brief first line whose bottom is below `y`, or at it if `inclusive`. `y`
+/// is relative to the top of the block
+static usize find_y_line(TextLayout const & layout, f32 y, bool inclusive)
+{
+  auto const below = [&](f32 bottom, f32 y) {
+    return inclusive ? (bottom >= y) : (bottom > y);
+  };
+
+  return find_line(
+    layout, [&](Paragraph const & p) { return below(p.height, y - p.top); },
+    [&](Paragraph const & p, usize l) {
+      return below(layout.line_bottoms[l], y - p.top);
+    });
+}
+
 isize TextLayout::to_caret(usize codepoint, bool before) const
 {
   CHECK(laid_out, "");
@@ -22,13 +79,15 @@ isize TextLayout::to_caret(usize codepoint, bool before) const
     return num_carets - 1;
   }
 
-  auto l = binary_find(lines.view(), [&](Line const & l) {
-    return l.codepoints.end() > codepoint;
-  });
+  usize const iln = find_line(
+    *this, [&](Paragraph const & p) { return p.codepoints.end() > codepoint; },
+    [&](Paragraph const & p, usize l) {
+      return (p.codepoints.offset + lines[l].codepoints.end()) > codepoint;
+    });
 
-  CHECK(!l.is_empty(), "");
+  CHECK(iln < lines.size(), "");
 
-  auto const & line = l[0];
+  Line const line = get_line(iln);
 
   if (line.codepoints.contains(codepoint))
   {
@@ -47,9 +106,9 @@ isize TextLayout::to_caret(usize codepoint, bool before) const
     // line-break codepoints are not part of the line's codepoints
     if (before)
     {
-      CHECK(l.data() > lines.data(), "");
+      CHECK(iln > 0, "");
       // adjust to the caret of the previous line
-      return (l.data() - 1)[0].carets.last();
+      return get_line(iln - 1).carets.last();
     }
     else
     {
@@ -71,10 +130,10 @@ isize TextLayout::align_caret(CaretAlignment alignment) const
   if (alignment.y >= CaretYAlignment{(isize) lines.size()} ||
       alignment.y >= CaretYAlignment::Bottom)
   {
-    return lines.last().carets.last();
+    return get_line(lines.size() - 1).carets.last();
   }
 
-  auto const & line = lines[(usize) alignment.y];
+  Line const line = get_line((usize) alignment.y);
 
   if (alignment.x <= CaretXAlignment::Start)
   {
@@ -96,19 +155,14 @@ Slice TextLayout::get_caret_selection(Slice carets) const
 
   carets = carets(num_carets);
 
-  auto line0 = binary_find(lines.view(), [&](Line const & l) {
-    return l.carets.end() > carets.begin();
-  });
-
-  auto line1 = binary_find(lines.view(), [&](Line const & l) {
-    return l.carets.end() >= carets.end();
-  });
+  Line const line0 = get_line(find_caret_line(*this, carets.begin(), false));
+  Line const line1 = get_line(find_caret_line(*this, carets.end(), true));
 
-  auto line0_begin = carets.begin() - line0[0].carets.begin();
-  auto line1_end   = carets.end() - line1[0].carets.begin();
+  auto line0_begin = carets.begin() - line0.carets.begin();
+  auto line1_end   = carets.end() - line1.carets.begin();
 
-  return Slice::range(line0[0].codepoints.offset + line0_begin,
-                      line1[0].codepoints.offset + line1_end);
+  return Slice::range(line0.codepoints.offset + line0_begin,
+                      line1.codepoints.offset + line1_end);
 }
 
 Slice TextLayout::to_caret_selection(Slice codepoints) const
@@ -141,16 +195,14 @@ CaretCodepoint TextLayout::get_caret_codepoint(usize caret) const
   CHECK(laid_out, "");
   CHECK(caret <= num_carets, "");
 
-  auto l =
-    binary_find(lines.view(), [&](Line & l) { return l.carets.end() > caret; });
+  auto iln = find_caret_line(*this, caret, false);
 
-  l = l.is_empty() ? lines.view().slice(lines.size() - 1, 1) : l;
+  iln = (iln == lines.size()) ? (lines.size() - 1) : iln;
 
-  auto         iln       = l.as_slice_of(lines).offset;
-  auto const & ln        = l[0];
-  auto         column    = caret - ln.carets.offset;
-  auto         codepoint = ln.codepoints.offset + column;
-  auto         after     = column >= (ln.carets.span - 1);
+  Line const ln        = get_line(iln);
+  auto       column    = caret - ln.carets.offset;
+  auto       codepoint = ln.codepoints.offset + column;
+  auto       after     = column >= (ln.carets.span - 1);
 
   return CaretCodepoint{.line = iln, .codepoint = codepoint, .after = after};
 }
@@ -195,17 +247,20 @@ CaretPlacement TextLayout::get_caret_placement(usize caret) const
   CHECK(laid_out, "");
   auto c = get_caret_codepoint(caret);
 
-  auto const & line = lines[c.line];
+  Paragraph const & paragraph = paragraphs[line_paragraph(c.line)];
+  Line const        line      = paragraph.rebase(lines[c.line]);
 
   Option<GlyphMatch> match;
 
-  for (auto const & run : runs.view().slice(line.runs))
+  for (TextRun const & r : runs.view().slice(line.runs))
   {
+    TextRun const run = paragraph.rebase(r);
+
     // find the glyph with the nearest glyph cluster to the caret's codepoint position
     for (auto [i, glyph] : enumerate(glyphs.view().slice(run.glyphs)))
     {
       GlyphMatch current{.glyph   = i + run.glyphs.offset,
-                         .cluster = glyph.cluster};
+                         .cluster = paragraph.cluster(glyph)};
       match.match(
         [&](GlyphMatch & m) {
           if (current.better_than(c.codepoint, m, run.direction()))
@@ -227,6 +282,54 @@ CaretPlacement TextLayout::get_caret_placement(usize caret) const
     });
 }
 
+usize TextLayout::line_paragraph(usize line) const
+{
+  auto const p = binary_find(paragraphs.view(), [&](Paragraph const & p) {
+    return p.lines.end() > line;
+  });
+
+  CHECK(!p.is_empty(), "");
+
+  return paragraphs.size() - p.size();
+}
+
+Line TextLayout::get_line(usize line) const
+{
+  return paragraphs[line_paragraph(line)].rebase(lines[line]);
+}
+
+f32 TextLayout::line_top(usize line) const
+{
+  Paragraph const & p = paragraphs[line_paragraph(line)];
+  return p.top + ((line == p.lines.offset) ? 0 : line_bottoms[line - 1]);
+}
+
+Slice TextLayout::visible_lines(f32 top, f32 bottom) const
+{
+  usize const begin = find_y_line(*this, top, true);
+  // the line containing the bottom of the range is visible
+  usize const end   = min(find_y_line(*this, bottom, false) + 1, lines.size());
+
+  return Slice::range(begin, max(begin, end));
+}
+
+Slice TextLayout::visible_lines(f32x2 center, CRect const & clip) const
+{
+  f32 const block_top = center.y() - 0.5F * extent.y();
+  return visible_lines(clip.begin().y() - block_top,
+                       clip.end().y() - block_top);
+}
+
+CRect TextLayout::layout_clip(f32x4x4 const & transform, CRect const & clip)
+{
+  auto const inv_xfm = inverse(transform);
+  auto const to_layout = [&](f32x2 p) {
+    return ash::transform(inv_xfm, p.append(0)).xy();
+  };
+  return CRect::bounding(to_layout(clip.tl()), to_layout(clip.tr()),
+                         to_layout(clip.bl()), to_layout(clip.br()));
+}
+
 Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
                                              TextBlockStyle const & style,
                                              f32x2                  pos) const
@@ -235,8 +338,8 @@ Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
 
   f32x2 const block_extent{max(extent.x(), style.align_width), extent.y()};
   f32x2 const half_block_extent = 0.5F * block_extent;
-  f32         ln_top            = -half_block_extent.y();
-  f32         last_ln_bottom    = half_block_extent.y();
+  f32 const   ln_top            = -half_block_extent.y();
+  f32 const   last_ln_bottom    = half_block_extent.y();
   isize       ln                = 0;
 
   // separated vertical and horizontal hit test
@@ -250,17 +353,8 @@ Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
   }
   else
   {
-    for (auto [i, line] : enumerate(lines))
-    {
-      auto line_bottom = ln_top + line.metrics.height;
-      if (pos.y() <= line_bottom)
-      {
-        ln = (isize) i;
-        break;
-      }
-
-      ln_top = line_bottom;
-    }
+    usize const below = find_y_line(*this, pos.y() - ln_top, true);
+    ln = (below == lines.size()) ? ISIZE_MAX : (isize) below;
   }
 
   if (ln < 0)
@@ -279,9 +373,10 @@ Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
     };
   }
 
-  auto const & line      = lines[ln];
-  auto const   direction = line.metrics.direction();
-  f32 const    alignment =
+  Paragraph const & paragraph = paragraphs[line_paragraph((usize) ln)];
+  Line const        line      = paragraph.rebase(lines[ln]);
+  auto const        direction = line.metrics.direction();
+  f32 const         alignment =
     style.alignment * ((direction == TextDirection::LeftToRight) ? 1 : -1);
   f32 cursor = space_align(block_extent.x(), line.metrics.width, alignment) -
                line.metrics.width * 0.5F;
@@ -309,8 +404,9 @@ Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
     }
   }
 
-  for (auto [irun, run] : enumerate(runs.view().slice(line.runs)))
+  for (TextRun const & r : runs.view().slice(line.runs))
   {
+    auto const   run         = paragraph.rebase(r);
     auto const & font_style  = block.fonts[run.style];
     f32 const    font_height = block.font_scale * run.font_height;
     auto const   metrics     = run.metrics.resolve(font_height);
@@ -327,10 +423,11 @@ Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
       goto next_run;
     }
 
-    for (auto [iglyph, sh] : enumerate(glyphs.view().slice(run.glyphs)))
+    for (GlyphShape const & sh : glyphs.view().slice(run.glyphs))
     {
-      f32 const  advance = au_to_px(sh.advance, font_height);
-      bool const intersects =
+      f32 const   advance = au_to_px(sh.advance, font_height);
+      usize const cluster = paragraph.cluster(sh);
+      bool const  intersects =
         pos.x() >= glyph_cursor && pos.x() <= (glyph_cursor + advance);
 
       if (intersects)
@@ -341,22 +438,22 @@ Tuple<isize, CaretAlignment> TextLayout::hit(TextBlock const &      block,
         {
           if (pos.x() <= (glyph_cursor + 0.5F * advance))
           {
-            codepoint = sh.cluster;
+            codepoint = cluster;
           }
           else
           {
-            codepoint = sh.cluster + 1;
+            codepoint = cluster + 1;
           }
         }
         else
         {
           if (pos.x() <= (glyph_cursor + 0.5F * advance))
           {
-            codepoint = sh.cluster + 1;
+            codepoint = cluster + 1;
           }
           else
           {
-            codepoint = sh.cluster;
+            codepoint = cluster;
           }
         }
 
@@ -463,7 +560,12 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
     infos.push(i).unwrap();
   };
 
-  f32 ln_top = -(0.5F * block_extent.y());
+  f32 const block_top = -(0.5F * block_extent.y());
+
+  // the clip is in canvas-space, the lines are culled against its bounds in
+  // the layout's space. Only the lines overlapping it vertically are visited
+  CRect const local_clip = layout_clip(info.transform, clip);
+  Slice const visible    = visible_lines(info.area.center, local_clip);
 
   push(
     ShapeInfo{
@@ -473,8 +575,21 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
   },
     TextLayer::Block, TextRenderInfo{});
 
-  for (auto [iln, ln] : enumerate(lines))
+  usize ipara = visible.is_empty() ? 0 : line_paragraph(visible.begin());
+
+  for (usize iln = visible.begin(); iln < visible.end(); iln++)
   {
+    // the lines are visited in order, and so are their paragraphs
+    while (paragraphs[ipara].lines.end() <= iln)
+    {
+      ipara++;
+    }
+
+    Paragraph const & paragraph = paragraphs[ipara];
+    Line const        ln        = paragraph.rebase(lines[iln]);
+    auto const        ln_top =
+      block_top + paragraph.top +
+      ((iln == paragraph.lines.offset) ? 0 : line_bottoms[iln - 1]);
     auto const ln_bottom = ln_top + ln.metrics.height;
     auto const baseline =
       ln_bottom - (ln.metrics.leading() + ln.metrics.descent);
@@ -491,8 +606,8 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
       .center = ln_center, .extent{ln.metrics.width, ln.metrics.height}
     };
 
-    if (!clip.overlaps(CRect{.center = info.area.center + ln_rect.center,
-                             .extent = ln_rect.extent}))
+    if (!local_clip.overlaps(CRect{.center = info.area.center + ln_rect.center,
+                                   .extent = ln_rect.extent}))
     {
       goto next_line;
     }
@@ -546,12 +661,13 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
           TextLayer::Highlight, {.line = iln});
       }
 
-      for (auto [i, run] : enumerate(runs.view().slice(ln.runs)))
+      for (auto [i, r] : enumerate(runs.view().slice(ln.runs)))
       {
+        auto const   run         = paragraph.rebase(r);
         auto const   irun        = ln.runs.offset + i;
         auto const & font_style  = block.fonts[run.style];
         auto const & run_style   = style.runs[run.style];
-        auto const   font        = sys->font.get(font_style.font);
+        auto const   font        = sys->font.get(run.font);
         auto const & atlas       = font.gpu_atlas.v();
         auto const   font_height = block.font_scale * run.font_height;
         auto const   metrics     = run.metrics.resolve(font_height);
@@ -651,9 +767,11 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
 
         for (auto [i, sh] : enumerate(glyphs.view().slice(run.glyphs)))
         {
-          auto const           iglyph = run.glyphs.offset + i;
-          GlyphMetrics const & m      = font.glyphs[sh.glyph];
-          AtlasGlyph const &   agl    = atlas.glyphs[sh.glyph];
+          auto const           iglyph  = run.glyphs.offset + i;
+          auto const           cluster = paragraph.cluster(sh);
+          GlyphMetrics const & m       = font.glyphs[sh.glyph];
+          AtlasGlyph const     agl =
+            sys->font.glyph(run.font, (u32) sh.glyph);
           f32x2 const          extent = au_to_px(m.extent, font_height);
           f32x2 const          center = f32x2{glyph_cursor, baseline} +
                                au_to_px(m.bearing, font_height) +
@@ -662,7 +780,7 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
 
           // before and after carets
           auto const glyph_carets =
-            Slice{ln.carets.offset + (sh.cluster - ln.codepoints.offset), 1};
+            Slice{ln.carets.offset + (cluster - ln.codepoints.offset), 1};
 
           if (run_style.has_shadow())
           {
@@ -688,7 +806,8 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
                .run       = irun,
                .run_style = run.style,
                .glyph     = iglyph,
-               .cluster   = sh.cluster});
+               .cluster   = cluster,
+               .atlas     = atlas.format(agl)});
           }
 
           if (run_style.has_color())
@@ -710,7 +829,8 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
                .run       = irun,
                .run_style = run.style,
                .glyph     = iglyph,
-               .cluster   = sh.cluster});
+               .cluster   = cluster,
+               .atlas     = atlas.format(agl)});
           }
 
           if (!style.caret.is_none())
@@ -778,7 +898,7 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
                  .run       = irun,
                  .run_style = run.style,
                  .glyph     = iglyph,
-                 .cluster   = sh.cluster});
+                 .cluster   = cluster});
             }
           }
 
@@ -789,8 +909,7 @@ void TextLayout::render(TextRenderer renderer, ShapeInfo const & info,
       }
     }
 
-  next_line:
-    ln_top = ln_bottom;
+  next_line:;
   }
 
   Vec<usize> sorted{allocator};
@@ -3,6 +3,7 @@
 
 #include "ashura/engine/font.h"
 #include "ashura/std/color.h"
+#include "ashura/std/piece_table.h"
 #include "ashura/std/types.h"
 #include "ashura/std/vec.h"
 
@@ -394,15 +395,35 @@ struct TextCursor
   }
 };
 
+inline constexpr u32 MAX_FONT_FALLBACKS = 4;
+
+using FontFallbacks = InplaceVec<FontId, MAX_FONT_FALLBACKS>;
+
 /// @param font font to use to render the text
 /// @param word_spacing px. additional word spacing, can be negative
 /// @param line_height relative. multiplied by font_height
+/// @param fallbacks fonts to render the codepoints `font` has no glyphs for
+/// with, in order of preference. Codepoints no font in the chain covers are
+/// rendered with `font`'s replacement glyph.
 struct FontStyle
 {
-  FontId font         = FontId::None;
-  f32    height       = 20;
-  f32    line_height  = 1.2F;
-  f32    word_spacing = 0;
+  FontId        font         = FontId::None;
+  f32           height       = 20;
+  f32           line_height  = 1.2F;
+  f32           word_spacing = 0;
+  FontFallbacks fallbacks    = {};
+
+  /// @brief number of fonts in the fallback chain, including the primary font
+  constexpr u32 chain_size() const
+  {
+    return 1 + (u32) fallbacks.size();
+  }
+
+  /// @brief the `i`th font of the fallback chain, 0 is the primary font
+  constexpr FontId chain(u32 i) const
+  {
+    return (i == 0) ? font : fallbacks[i - 1];
+  }
 };
 
 /// @param shadow_scale relative. multiplied by font_height
@@ -436,6 +457,8 @@ struct TextStyle
 /// @brief A block of text to be laid-out, consists of multiple runs of text
 /// spanning multiple paragraphs.
 /// @param text utf-32-encoded text
+/// @param pieces the utf-32-encoded text if it is stored in pieces, used
+/// instead of `text`. Only the edited paragraphs are read from it.
 /// @param runs end offset of each text run
 /// @param fonts font style of each text run
 /// @param direction base text direction
@@ -445,15 +468,59 @@ struct TextStyle
 /// @param use_ligatures use standard and contextual font ligature substitution
 struct TextBlock
 {
-  Str32                 text          = {};
-  Span<usize const>     runs          = {};
-  Span<FontStyle const> fonts         = {};
-  f32                   font_scale    = 1;
-  TextDirection         direction     = TextDirection::LeftToRight;
-  Str                   language      = {};
-  bool                  wrap          = true;
-  bool                  use_kerning   = true;
-  bool                  use_ligatures = true;
+  Str32                   text          = {};
+  PieceTable<c32> const * pieces        = nullptr;
+  Span<usize const>       runs          = {};
+  Span<FontStyle const>   fonts         = {};
+  f32                     font_scale    = 1;
+  TextDirection           direction     = TextDirection::LeftToRight;
+  Str                     language      = {};
+  bool                    wrap          = true;
+  bool                    use_kerning   = true;
+  bool                    use_ligatures = true;
+
+  usize size() const
+  {
+    return (pieces == nullptr) ? text.size() : pieces->size();
+  }
+
+  /// @brief append the codepoints in `range` to `out`
+  void read(Slice range, Vec<c32> & out) const
+  {
+    if (pieces == nullptr)
+    {
+      out.extend(text.slice(range)).unwrap();
+    }
+    else
+    {
+      pieces->read(range, out).unwrap();
+    }
+  }
+};
+
+/// @brief The codepoints of a text block edited or re-styled since it was
+/// last laid out. The paragraphs before and after them are re-used by the
+/// layout.
+/// @param first first edited codepoint
+/// @param tail number of codepoints at the end of the text unchanged by the
+/// edits
+struct TextEdit
+{
+  usize first = 0;
+  usize tail  = 0;
+
+  static constexpr TextEdit none()
+  {
+    return TextEdit{.first = USIZE_MAX, .tail = USIZE_MAX};
+  }
+
+  /// @brief record an edit replacing `codepoints` of a text of `size`
+  /// codepoints
+  constexpr void add(Slice codepoints, usize size)
+  {
+    first = min(first, codepoints.offset);
+    tail  = min(tail, size - codepoints.end());
+  }
 };
 
 /// @param styles styles for each run in the source text, for each
@@ -472,7 +539,8 @@ struct TextBlockStyle
   CaretStyle            caret               = {};
 };
 
-/// @param cluster codepoint cluster within the text run
+/// @param cluster first codepoint of the glyph's cluster, relative to the
+/// paragraph
 /// @param advance context-dependent horizontal-layout advance
 /// @param offset context-dependent text shaping offset from normal font glyph
 /// position, i.e. offset from GlyphMetrics::bearing
@@ -485,6 +553,8 @@ struct GlyphShape
 };
 
 /// @param style the text/font style of the current run
+/// @param font index of the font the codepoint is rendered with in the style's
+/// fallback chain
 /// @param script script of the current codepoint
 /// @param base_level the current paragraph's embedding level
 /// @param level embedding level of the current codepoint in the paragraph
@@ -493,6 +563,7 @@ struct GlyphShape
 struct TextSegment
 {
   u32        style               = 0;
+  u8         font                = 0;
   TextScript script              = TextScript::None;
   bool       linebreak_begin : 1 = false;
   bool       paragraph_begin : 1 = false;
@@ -517,16 +588,21 @@ enum class TextRunType : u8
 
 struct TextRun
 {
-  /// @brief Codepoints in the source text the run belongs to
+  /// @brief Codepoints the run belongs to, relative to the paragraph
   Slice codepoints = {};
 
   /// @brief Style in the list of specified text styles
   u32 style = 0;
 
+  /// @brief Font the run is shaped and rendered with, resolved from the
+  /// style's fallback chain
+  FontId font = FontId::None;
+
   f32 font_height = 0;
 
   f32 line_height = 0;
 
+  /// @brief Glyphs of the run, relative to the paragraph
   Slice glyphs = {};
 
   FontMetrics metrics = {};
@@ -587,7 +663,8 @@ struct LineMetrics
   }
 };
 
-/// @brief
+/// @brief A laid-out line. Its indices are relative to its paragraph, see
+/// `Paragraph::rebase`.
 struct Line
 {
   /// @brief Codepoints in the line (excludes the preceding line-breaks if any).
@@ -602,15 +679,55 @@ struct Line
   LineMetrics metrics = {};
 };
 
+/// @brief A laid-out paragraph. Its slices are the bases of the indices of
+/// its lines, runs, and glyphs, so moving it within the layout only updates
+/// the paragraph.
 struct Paragraph
 {
   Slice lines = {};
 
   Slice runs = {};
 
+  /// @brief Glyphs of all the runs in the paragraph
+  Slice glyphs = {};
+
   Slice codepoints = {};
 
   Slice break_codepoints = {};
+
+  Slice carets = {};
+
+  /// @brief Top of the paragraph relative to the top of the block
+  f32 top = 0;
+
+  /// @brief Sum of the paragraph's line heights
+  f32 height = 0;
+
+  /// @brief Width of the paragraph's widest line
+  f32 width = 0;
+
+  /// @brief the line's codepoints, carets, and runs in the layout
+  constexpr Line rebase(Line line) const
+  {
+    line.codepoints.offset += codepoints.offset;
+    line.carets.offset += carets.offset;
+    line.runs.offset += runs.offset;
+    return line;
+  }
+
+  /// @brief the run's codepoints and glyphs in the layout
+  constexpr TextRun rebase(TextRun run) const
+  {
+    run.codepoints.offset += codepoints.offset;
+    run.glyphs.offset += glyphs.offset;
+    return run;
+  }
+
+  /// @brief the glyph's cluster in the text
+  constexpr usize cluster(GlyphShape const & glyph) const
+  {
+    return codepoints.offset + glyph.cluster;
+  }
 };
 
 enum class CaretXAlignment : isize
@@ -683,6 +800,10 @@ struct TextRenderInfo
 
   /// @brief set to the current caret being rendered for
   Option<isize> caret = none;
+
+  /// @brief set to the atlas format of the current glyph being rendered for.
+  /// Alpha glyphs are sampled as white coverage and should be tinted.
+  Option<GlyphAtlasFormat> atlas = none;
 };
 
 typedef Fn<void(Span<TextLayer const>, Span<ShapeInfo const>,
@@ -690,6 +811,7 @@ typedef Fn<void(Span<TextLayer const>, Span<ShapeInfo const>,
   TextRenderer;
 
 /// @brief cached/pre-computed text layout
+/// @param hash hash of the block parameters the text was laid out with
 /// @param max_width maximum width the text was laid out with
 /// @param extent current extent of the text block after layout
 /// @param segments each segment matches a codepoint in the source text.
@@ -697,6 +819,14 @@ typedef Fn<void(Span<TextLayer const>, Span<ShapeInfo const>,
 /// independent of the font style as long as the font matches.
 /// @param lines lines in the text as constrained by max_width and paragraphs
 /// found in the text.
+/// @param line_bottoms prefix sums of the line heights within each paragraph,
+/// i.e. the bottom of each line relative to the top of its paragraph.
+/// Binary-searched along with the paragraphs' tops to find the lines within a
+/// vertical range, so rendering and hit-testing cost is proportional to the
+/// visible lines.
+/// @param paragraphs laid-out paragraphs. The lines, runs, and glyphs are
+/// stored relative to their paragraph, so an edit only rebases the paragraphs
+/// after it.
 ///
 ///
 ///
@@ -708,6 +838,7 @@ typedef Fn<void(Span<TextLayer const>, Span<ShapeInfo const>,
 struct TextLayout
 {
   bool            laid_out;
+  usize           hash;
   f32             max_width;
   usize           num_carets;
   usize           num_codepoints;
@@ -715,10 +846,12 @@ struct TextLayout
   Vec<GlyphShape> glyphs;
   Vec<TextRun>    runs;
   Vec<Line>       lines;
+  Vec<f32>        line_bottoms;
   Vec<Paragraph>  paragraphs;
 
   explicit TextLayout(Allocator allocator) :
     laid_out{false},
+    hash{0},
     max_width{0},
     num_carets{0},
     num_codepoints{0},
@@ -726,6 +859,7 @@ struct TextLayout
     glyphs{allocator},
     runs{allocator},
     lines{allocator},
+    line_bottoms{allocator},
     paragraphs{allocator}
   {
   }
@@ -739,6 +873,7 @@ struct TextLayout
   void clear()
   {
     laid_out       = false;
+    hash           = 0;
     max_width      = 0;
     num_carets     = 0;
     num_codepoints = 0;
@@ -746,6 +881,7 @@ struct TextLayout
     glyphs.clear();
     runs.clear();
     lines.clear();
+    line_bottoms.clear();
     paragraphs.clear();
   }
 
@@ -761,6 +897,29 @@ struct TextLayout
 
   CaretPlacement get_caret_placement(usize caret) const;
 
+  /// @brief index of the paragraph the line belongs to
+  usize line_paragraph(usize line) const;
+
+  /// @brief the line, with its codepoints, carets, and runs in the layout
+  Line get_line(usize line) const;
+
+  /// @brief top of the line relative to the top of the block
+  f32 line_top(usize line) const;
+
+  /// @brief get the lines overlapping the vertical range
+  /// @param top top of the range relative to the top of the block
+  /// @param bottom bottom of the range relative to the top of the block
+  Slice visible_lines(f32 top, f32 bottom) const;
+
+  /// @brief get the lines overlapping a clip rect vertically
+  /// @param center layout-space center of the block
+  /// @param clip layout-space clip rect, see `layout_clip`
+  Slice visible_lines(f32x2 center, CRect const & clip) const;
+
+  /// @brief bounds of a canvas-space clip rect in the layout's space
+  /// @param transform the block's layout-space to canvas-space transform
+  static CRect layout_clip(f32x4x4 const & transform, CRect const & clip);
+
   /// @brief given a position in the laid-out text return the caret the cursor points
   /// to and its location.
   /// @param pos relative position in laid-out text to hit
@@ -8,15 +8,15 @@
 namespace ash
 {
 
-TextCompositor TextCompositor::create(Allocator allocator, usize buffer_size,
+TextCompositor TextCompositor::create(Allocator allocator, usize pieces_size,
                                       usize records_size, Str32 word_symbols)
 {
-  CHECK(buffer_size > 1, "");
+  CHECK(pieces_size > 1, "");
   CHECK(records_size > 1, "");
 
-  Vec<c32> buffer{allocator};
+  Vec<Slice> pieces{allocator};
 
-  buffer.reserve(buffer_size).unwrap();
+  pieces.reserve(pieces_size).unwrap();
 
   Vec<TextEditRecord> records{allocator};
 
@@ -28,7 +28,8 @@ TextCompositor TextCompositor::create(Allocator allocator, usize buffer_size,
                          .type        = TextEditRecordType::Erase})
     .unwrap();
 
-  return TextCompositor{std::move(buffer), std::move(records), word_symbols};
+  return TextCompositor{std::move(pieces), Vec<Slice>{allocator},
+                        std::move(records), word_symbols};
 }
 
 TextCursor TextCompositor::cursor() const
@@ -59,25 +60,25 @@ void TextCompositor::pop_records(usize num)
   }
 
   erase            = erase(records_.size());
-  auto const slice = buffer_slice(erase);
+  auto const slice = pieces_slice(erase);
 
-  buffer_.erase(slice);
+  pieces_.erase(slice);
   records_.erase(erase);
 }
 
-Slice TextCompositor::buffer_slice(Slice records) const
+Slice TextCompositor::pieces_slice(Slice records) const
 {
   records = records(records_.size());
 
   Slice slice;
   for (usize i = 0; i < records.offset; i++)
   {
-    slice.offset += records_[i].buffer_usage();
+    slice.offset += records_[i].num_pieces();
   }
 
   for (usize i = records.offset; i < records.end(); i++)
   {
-    slice.span += records_[i].buffer_usage();
+    slice.span += records_[i].num_pieces();
   }
 
   return slice;
@@ -86,16 +87,27 @@ Slice TextCompositor::buffer_slice(Slice records) const
 void TextCompositor::truncate_records()
 {
   auto const first = state_ + 1;
-  auto       slice = buffer_slice(Slice{first, USIZE_MAX});
-  buffer_.erase(slice);
+  auto       slice = pieces_slice(Slice{first, USIZE_MAX});
+  pieces_.erase(slice);
   records_.erase(first, USIZE_MAX);
 }
 
+static usize pieces_size(Span<Slice const> pieces)
+{
+  usize size = 0;
+  for (Slice const & p : pieces)
+  {
+    size += p.span;
+  }
+  return size;
+}
+
 void TextCompositor::push_record(TextEditRecordType type, usize text_pos,
-                                 Str32 erase, Str32 insert)
+                                 Span<Slice const> erase,
+                                 Span<Slice const> insert)
 {
   auto const total_size = insert.size() + erase.size();
-  if (total_size > buffer_.capacity())
+  if (total_size > pieces_.capacity())
   {
     // clear all records as we can't insert a new record without invalidating
     // the history
@@ -103,8 +115,8 @@ void TextCompositor::push_record(TextEditRecordType type, usize text_pos,
     return;
   }
 
-  // try to allocate buffer space
-  while ((buffer_.size() + total_size) > buffer_.capacity())
+  // try to allocate piece entries
+  while ((pieces_.size() + total_size) > pieces_.capacity())
   {
     // pop half, to amortize shifting cost.
     // always pop by atleast 1. since the buffer can fit it and atleast 1
@@ -122,22 +134,24 @@ void TextCompositor::push_record(TextEditRecordType type, usize text_pos,
 
   truncate_records();
 
-  buffer_.extend(erase).unwrap();
-  buffer_.extend(insert).unwrap();
+  pieces_.extend(erase).unwrap();
+  pieces_.extend(insert).unwrap();
 
   auto const idx = records_.size();
 
   records_
-    .push(TextEditRecord{.text_pos    = text_pos,
-                         .erase_size  = erase.size(),
-                         .insert_size = insert.size(),
-                         .type        = type})
+    .push(TextEditRecord{.text_pos          = text_pos,
+                         .erase_size        = pieces_size(erase),
+                         .insert_size       = pieces_size(insert),
+                         .num_erase_pieces  = erase.size(),
+                         .num_insert_pieces = insert.size(),
+                         .type              = type})
     .unwrap();
 
   state_ = idx;
 }
 
-Option<Slice> TextCompositor::undo(Vec<c32> & str)
+Option<Slice> TextCompositor::undo(RenderText & text)
 {
   if (state_ == 0)
   {
@@ -146,33 +160,31 @@ Option<Slice> TextCompositor::undo(Vec<c32> & str)
 
   // undo changes of current record
   auto const & record = records_[state_];
-  auto const   slice  = buffer_slice(Slice{state_, 1});
+  auto const   slice  = pieces_slice(Slice{state_, 1});
+  auto const   erased =
+    pieces_.view().slice(slice.offset, record.num_erase_pieces);
   state_--;
 
   switch (record.type)
   {
     case TextEditRecordType::Erase:
     {
-      str
-        .insert_span(record.text_pos,
-                     buffer_.view().slice(slice.offset, record.erase_size))
-        .unwrap();
+      text.insert_pieces(record.text_pos, erased);
       return Slice{record.text_pos, record.erase_size};
     }
 
     case TextEditRecordType::Insert:
     {
-      str.erase(record.text_pos, record.insert_size);
+      erased_.clear();
+      text.erase(Slice{record.text_pos, record.insert_size}, erased_);
       return Slice{record.text_pos, 0};
     }
 
     case TextEditRecordType::Replace:
     {
-      str
-        .insert_span(record.text_pos,
-                     buffer_.view().slice(slice.offset, record.erase_size))
-        .unwrap();
-      str.erase(record.text_pos, record.insert_size);
+      erased_.clear();
+      text.erase(Slice{record.text_pos, record.insert_size}, erased_);
+      text.insert_pieces(record.text_pos, erased);
       return Slice{record.text_pos, record.erase_size};
     }
 
@@ -181,7 +193,7 @@ Option<Slice> TextCompositor::undo(Vec<c32> & str)
   }
 }
 
-Option<Slice> TextCompositor::redo(Vec<c32> & str)
+Option<Slice> TextCompositor::redo(RenderText & text)
 {
   if ((state_ + 1) >= records_.size())
   {
@@ -192,34 +204,31 @@ Option<Slice> TextCompositor::redo(Vec<c32> & str)
 
   // apply changes of next record
   auto const & record = records_[state_];
-  auto const   slice  = buffer_slice(Slice{state_, 1});
+  auto const   slice  = pieces_slice(Slice{state_, 1});
+  auto const   inserted =
+    pieces_.view().slice(slice.offset + record.num_erase_pieces,
+                         record.num_insert_pieces);
 
   switch (record.type)
   {
     case TextEditRecordType::Erase:
     {
-      str.erase(record.text_pos, record.erase_size);
+      erased_.clear();
+      text.erase(Slice{record.text_pos, record.erase_size}, erased_);
       return Slice{record.text_pos, 0};
     }
 
     case TextEditRecordType::Insert:
     {
-      str
-        .insert_span(record.text_pos,
-                     buffer_.view().slice(slice.offset, record.insert_size))
-        .unwrap();
+      text.insert_pieces(record.text_pos, inserted);
       return Slice{record.text_pos, record.insert_size};
     }
 
     case TextEditRecordType::Replace:
     {
-      str.erase(record.text_pos, record.erase_size);
-      str
-        .insert_span(record.text_pos,
-                     buffer_.view().slice(slice.offset + record.erase_size,
-                                          record.insert_size))
-        .unwrap();
-
+      erased_.clear();
+      text.erase(Slice{record.text_pos, record.erase_size}, erased_);
+      text.insert_pieces(record.text_pos, inserted);
       return Slice{record.text_pos, record.insert_size};
     }
 
@@ -228,17 +237,17 @@ Option<Slice> TextCompositor::redo(Vec<c32> & str)
   }
 }
 
-bool TextCompositor::erase(Vec<c32> & str, Slice slice)
+bool TextCompositor::erase(RenderText & text, Slice slice)
 {
-  slice = slice(str.size());
-  if (str.is_empty() || slice.is_empty())
+  slice = slice(text.size());
+  if (text.size() == 0 || slice.is_empty())
   {
     return false;
   }
 
-  push_record(TextEditRecordType::Erase, slice.offset, str.view().slice(slice),
-              {});
-  str.erase(slice);
+  erased_.clear();
+  text.erase(slice, erased_);
+  push_record(TextEditRecordType::Erase, slice.offset, erased_, {});
 
   return true;
 }
@@ -248,20 +257,22 @@ static constexpr bool is_symbol(Span<c32 const> symbols, c32 c)
   return !find(symbols, c).is_empty();
 }
 
+/// @brief the codepoints are read from the pieces one at a time, so seeking
+/// costs O(log n) per codepoint visited rather than copying the text
 template <typename Fn>
-static constexpr Option<usize> seek(Str32 text, usize pos, bool left,
-                                    Fn && pred)
+static Option<usize> seek(PieceTable<c32> const & text, usize pos, bool left,
+                          Fn && pred)
 {
   if (pos >= text.size())
   {
     return none;
   }
 
-  c32 const * iter    = text.pbegin() + pos;
-  c32 const * end     = left ? (text.pbegin() - 1) : text.pend();
-  isize       advance = left ? -1 : 1;
+  isize       iter    = (isize) pos;
+  isize const end     = left ? -1 : (isize) text.size();
+  isize const advance = left ? -1 : 1;
 
-  while (iter != end && !pred(*iter))
+  while (iter != end && !pred(text[(usize) iter]))
   {
     iter += advance;
   }
@@ -271,17 +282,17 @@ static constexpr Option<usize> seek(Str32 text, usize pos, bool left,
     return none;
   }
 
-  return iter - text.pbegin();
+  return (usize) iter;
 }
 
-static constexpr Option<usize> seek_sym(Str32 text, usize pos, bool left,
-                                        Span<c32 const> symbols)
+static Option<usize> seek_sym(PieceTable<c32> const & text, usize pos,
+                              bool left, Span<c32 const> symbols)
 {
   return seek(text, pos, left, [&](c32 c) { return is_symbol(symbols, c); });
 }
 
 template <typename Fn>
-static constexpr Slice span_boundary(Str32 text, usize pos, Fn && pred)
+static Slice span_boundary(PieceTable<c32> const & text, usize pos, Fn && pred)
 {
   if (pos >= text.size())
   {
@@ -303,8 +314,8 @@ static constexpr Slice span_boundary(Str32 text, usize pos, Fn && pred)
   }
 }
 
-static constexpr Slice span_sym_boundary(Str32 text, usize pos,
-                                         Span<c32 const> symbols)
+static Slice span_sym_boundary(PieceTable<c32> const & text, usize pos,
+                               Span<c32 const> symbols)
 {
   return span_boundary(text, pos, [&](c32 c) { return is_symbol(symbols, c); });
 }
@@ -338,8 +349,15 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
   u8                tmp[512];
   FallbackAllocator tmp_allocator{Arena::from(tmp), scratch_allocator};
 
-  auto & layout = rendered.get_layout();
-  auto & text   = rendered.text_;
+  auto &                  layout = rendered.get_layout();
+  PieceTable<c32> const & text   = rendered.text_;
+
+  // the text was replaced, the records reference pieces of the previous text
+  if (generation_ != rendered.generation_)
+  {
+    pop_records(records_.size());
+    generation_ = rendered.generation_;
+  }
 
   auto perform_layout = [&]() {
     rendered.flush_text();
@@ -368,7 +386,7 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
       }
 
       Slice carets = cursor_.selection();
-      erase(text, layout.get_caret_selection(carets));
+      erase(rendered, layout.get_caret_selection(carets));
       perform_layout();
       cursor_.unselect_left();
     }
@@ -381,7 +399,7 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
       }
 
       Slice carets = cursor_.selection();
-      erase(text, layout.get_caret_selection(carets));
+      erase(rendered, layout.get_caret_selection(carets));
       perform_layout();
       cursor_.unselect_left();
     }
@@ -427,10 +445,11 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
           // [ ] process replace correctly
           // [ ] hit span starts with the last hit, sometimes not ideal
           auto selection = layout.get_caret_selection(carets);
-          push_record(TextEditRecordType::Replace, selection.offset,
-                      text.view().slice(selection), input);
-          text.erase(selection);
-          text.insert_span(selection.offset, input).unwrap();
+          erased_.clear();
+          rendered.erase(selection, erased_);
+          Slice const inserted = rendered.insert(selection.offset, input);
+          push_record(TextEditRecordType::Replace, selection.offset, erased_,
+                      span({inserted}));
           perform_layout();
           cursor_
             .move_to(layout.to_caret(selection.offset + input.size(), true))
@@ -440,8 +459,9 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
         {
           auto cp        = layout.get_caret_codepoint(cursor_.caret());
           auto codepoint = cp.codepoint + (cp.after ? 1 : 0);
-          push_record(TextEditRecordType::Insert, codepoint, {}, input);
-          text.insert_span(codepoint, input).unwrap();
+          Slice const inserted = rendered.insert(codepoint, input);
+          push_record(TextEditRecordType::Insert, codepoint, {},
+                      span({inserted}));
           perform_layout();
           cursor_.unselect()
             .move_to(layout.to_caret(codepoint + input.size(), true))
@@ -481,13 +501,13 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
     case TextCommand::LineStart:
     {
       auto c = layout.get_caret_codepoint(cursor_.caret());
-      cursor_.move_to(layout.lines[c.line].carets.first());
+      cursor_.move_to(layout.get_line(c.line).carets.first());
     }
     break;
     case TextCommand::LineEnd:
     {
       auto c = layout.get_caret_codepoint(cursor_.caret());
-      cursor_.move_to(layout.lines[c.line].carets.last());
+      cursor_.move_to(layout.get_line(c.line).carets.last());
     }
     break;
     case TextCommand::Up:
@@ -561,13 +581,13 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
     case TextCommand::SelectToLineStart:
     {
       auto c = layout.get_caret_codepoint(cursor_.caret());
-      cursor_.span_to(layout.lines[c.line].carets.first());
+      cursor_.span_to(layout.get_line(c.line).carets.first());
     }
     break;
     case TextCommand::SelectToLineEnd:
     {
       auto c = layout.get_caret_codepoint(cursor_.caret());
-      cursor_.span_to(layout.lines[c.line].carets.last());
+      cursor_.span_to(layout.get_line(c.line).carets.last());
     }
     break;
     case TextCommand::SelectPageUp:
@@ -600,7 +620,7 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
     case TextCommand::SelectLine:
     {
       auto c = layout.get_caret_codepoint(cursor_.caret());
-      cursor_.select(layout.lines[c.line].carets);
+      cursor_.select(layout.get_line(c.line).carets);
     }
     break;
     case TextCommand::SelectAll:
@@ -614,12 +634,14 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
       if (!cursor_.has_selection())
       {
         auto cp = layout.get_caret_codepoint(cursor_.caret());
-        cursor_.select(layout.lines[cp.line].carets);
+        cursor_.select(layout.get_line(cp.line).carets);
       }
 
-      auto selection = layout.get_caret_selection(cursor_.selection());
-      utf8_encode(text.view().slice(selection), data8).unwrap();
-      erase(text, selection);
+      auto     selection = layout.get_caret_selection(cursor_.selection());
+      Vec<c32> selected{tmp_allocator};
+      rendered.get_text(selected, selection);
+      utf8_encode(selected, data8).unwrap();
+      erase(rendered, selection);
       perform_layout();
       clipboard.set(MIME_TEXT_UTF8, data8.view().as_u8()).unwrap();
     }
@@ -630,17 +652,19 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
       if (!cursor_.has_selection())
       {
         auto cp = layout.get_caret_codepoint(cursor_.caret());
-        cursor_.select(layout.lines[cp.line].carets);
+        cursor_.select(layout.get_line(cp.line).carets);
       }
 
-      auto selection = layout.get_caret_selection(cursor_.selection());
-      utf8_encode(text.view().slice(selection), data8).unwrap();
+      auto     selection = layout.get_caret_selection(cursor_.selection());
+      Vec<c32> selected{tmp_allocator};
+      rendered.get_text(selected, selection);
+      utf8_encode(selected, data8).unwrap();
       clipboard.set(MIME_TEXT_UTF8, data8.view().as_u8()).unwrap();
     }
     break;
     case TextCommand::Undo:
     {
-      undo(text).match([&](Slice inserted) {
+      undo(rendered).match([&](Slice inserted) {
         cursor_.select(layout.to_caret_selection(inserted));
         perform_layout();
       });
@@ -648,7 +672,7 @@ void TextCompositor::command(RenderText & rendered, TextCommand cmd,
     break;
     case TextCommand::Redo:
     {
-      redo(text).match([&](Slice inserted) {
+      redo(rendered).match([&](Slice inserted) {
         cursor_.select(layout.to_caret_selection(inserted));
         perform_layout();
       });
@@ -17,18 +17,25 @@ enum class TextEditRecordType : u32
 };
 
 /// @brief
-/// @param slice region of the original text this info belongs to
-/// @param is_insert whether this is a erase or insert record
+/// @param text_pos codepoint the edit was made at
+/// @param erase_size number of codepoints erased
+/// @param insert_size number of codepoints inserted
+/// @param num_erase_pieces number of pieces of the erased codepoints in the
+/// compositor's pieces
+/// @param num_insert_pieces number of pieces of the inserted codepoints in
+/// the compositor's pieces, after the erased pieces
 struct TextEditRecord
 {
-  usize              text_pos    = 0;
-  usize              erase_size  = 0;
-  usize              insert_size = 0;
-  TextEditRecordType type        = TextEditRecordType::Insert;
-
-  constexpr usize buffer_usage() const
+  usize              text_pos          = 0;
+  usize              erase_size        = 0;
+  usize              insert_size       = 0;
+  usize              num_erase_pieces  = 0;
+  usize              num_insert_pieces = 0;
+  TextEditRecordType type              = TextEditRecordType::Insert;
+
+  constexpr usize num_pieces() const
   {
-    return erase_size + insert_size;
+    return num_erase_pieces + num_insert_pieces;
   }
 };
 
@@ -96,38 +103,47 @@ enum class TextCommand : u8
   Submit = 39
 };
 
-/// @brief A stack-based text compositor
+/// @brief A stack-based text compositor. The edit records reference the
+/// immutable pieces of the edited text's piece table rather than copies of
+/// the erased and inserted text.
+/// @param pieces_ pieces of the records, in the order of the records
+/// @param erased_ scratch space for the pieces of erased text
+/// @param generation_ generation of the text the records were made on
 struct TextCompositor
 {
   static constexpr u32   MAX_TAB_WIDTH          = 32;
-  static constexpr usize DEFAULT_BUFFER_SIZE    = 2'048;
+  static constexpr usize DEFAULT_PIECES_SIZE    = 2'048;
   static constexpr usize DEFAULT_RECORDS_SIZE   = 2'048;
   static constexpr c32   DEFAULT_WORD_SYMBOLS[] = {U' ', U'\t'};
   static constexpr c32   DEFAULT_LINE_SYMBOLS[] = {U'\n', 0x2029};
 
   TextCursor          cursor_;
   CaretXAlignment     caret_alignment_;
-  Vec<c32>            buffer_;
+  Vec<Slice>          pieces_;
+  Vec<Slice>          erased_;
   Vec<TextEditRecord> records_;
   Span<c32 const>     word_symbols_;
+  u64                 generation_;
 
   /// @brief record representing the current text composition state;
   /// the base state is always at index 0
   usize state_;
 
-  TextCompositor(Vec<c32> buffer, Vec<TextEditRecord> records,
-                 Span<c32 const> word_symbols) :
+  TextCompositor(Vec<Slice> pieces, Vec<Slice> erased,
+                 Vec<TextEditRecord> records, Span<c32 const> word_symbols) :
     cursor_{},
     caret_alignment_{CaretXAlignment::Start},
-    buffer_{std::move(buffer)},
+    pieces_{std::move(pieces)},
+    erased_{std::move(erased)},
     records_{std::move(records)},
     word_symbols_{word_symbols},
+    generation_{0},
     state_{0}
   {
   }
 
   static TextCompositor
-    create(Allocator allocator, usize buffer_size = DEFAULT_BUFFER_SIZE,
+    create(Allocator allocator, usize pieces_size = DEFAULT_PIECES_SIZE,
            usize           records_size = DEFAULT_RECORDS_SIZE,
            Span<c32 const> word_symbols = DEFAULT_WORD_SYMBOLS);
 
@@ -139,7 +155,8 @@ struct TextCompositor
 
   TextCursor cursor() const;
 
-  Slice buffer_slice(Slice records) const;
+  /// @brief get the range of `pieces_` used by the records
+  Slice pieces_slice(Slice records) const;
 
   /// @brief pop the first `num` earliest records
   void pop_records(usize num);
@@ -148,14 +165,16 @@ struct TextCompositor
   /// i.e. when editing from a present state, all redo history from that point is cleared.
   void truncate_records();
 
-  void push_record(TextEditRecordType type, usize text_pos, Str32 erase,
-                   Str32 insert);
+  /// @param erase pieces of the erased codepoints
+  /// @param insert pieces of the inserted codepoints
+  void push_record(TextEditRecordType type, usize text_pos,
+                   Span<Slice const> erase, Span<Slice const> insert);
 
-  Option<Slice> undo(Vec<c32> & str);
+  Option<Slice> undo(RenderText & text);
 
-  Option<Slice> redo(Vec<c32> & str);
+  Option<Slice> redo(RenderText & text);
 
-  bool erase(Vec<c32> & str, Slice slice);
+  bool erase(RenderText & text, Slice slice);
 
   /// @param input text from IME to insert
   /// @param center the canvas-space center of the text
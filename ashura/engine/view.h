@@ -212,6 +212,18 @@ struct CornerRadii
   {
     return f32x4{tl, tr, bl, br};
   }
+
+  /// @brief The region, relative to its center, fully covered by a filled
+  /// rect of `extent` with these corners: the band between its left and
+  /// right corners
+  constexpr CRect inner(f32x2 extent) const
+  {
+    f32 const r = max(tl, tr, bl, br);
+    return CRect{
+      .center = {},
+      .extent = {max(extent.x() - 2 * r, 0.0F), extent.y()}
+    };
+  }
 };
 
 struct Padding
@@ -621,32 +633,33 @@ struct State
 
 struct Theme
 {
-  u8x4   background       = {};
-  u8x4   surface          = {};
-  u8x4   surface_variant  = {};
-  u8x4   primary          = {};
-  u8x4   primary_variant  = {};
-  u8x4   error            = {};
-  u8x4   warning          = {};
-  u8x4   success          = {};
-  u8x4   active           = {};
-  u8x4   inactive         = {};
-  u8x4   on_background    = {};
-  u8x4   on_surface       = {};
-  u8x4   on_primary       = {};
-  u8x4   on_error         = {};
-  u8x4   on_warning       = {};
-  u8x4   on_success       = {};
-  u8x4   focus            = {};
-  u8x4   highlight        = {};
-  u8x4   caret            = {};
-  f32    head_font_height = {};
-  f32    body_font_height = {};
-  f32    line_height      = {};
-  FontId head_font        = FontId::None;
-  FontId body_font        = FontId::None;
-  FontId icon_font        = FontId::None;
-  void * user_data        = nullptr;
+  u8x4          background          = {};
+  u8x4          surface             = {};
+  u8x4          surface_variant     = {};
+  u8x4          primary             = {};
+  u8x4          primary_variant     = {};
+  u8x4          error               = {};
+  u8x4          warning             = {};
+  u8x4          success             = {};
+  u8x4          active              = {};
+  u8x4          inactive            = {};
+  u8x4          on_background       = {};
+  u8x4          on_surface          = {};
+  u8x4          on_primary          = {};
+  u8x4          on_error            = {};
+  u8x4          on_warning          = {};
+  u8x4          on_success          = {};
+  u8x4          focus               = {};
+  u8x4          highlight           = {};
+  u8x4          caret               = {};
+  f32           head_font_height    = {};
+  f32           body_font_height    = {};
+  f32           line_height         = {};
+  FontId        head_font           = FontId::None;
+  FontId        body_font           = FontId::None;
+  FontId        icon_font           = FontId::None;
+  FontFallbacks body_font_fallbacks = {};
+  void *        user_data           = nullptr;
 };
 
 extern Theme theme;
@@ -666,6 +679,11 @@ struct Layout
 
   /// @brief Viewport-space re-positioning of the view
   Option<f32x2> fixed_center = none;
+
+  /// @brief Region of the view, relative to its center, that is fully opaque
+  /// when rendered. Views below it in the z-order that it fully covers are
+  /// not rendered. Empty if the view is translucent.
+  CRect opaque = {};
 };
 
 enum class ViewId : u64
@@ -698,6 +716,24 @@ struct LayerStack
 
 inline constexpr LayerStack LAYERS;
 
+/// @brief Changes to a retained view since the view system last ticked it,
+/// ordered by the amount of work needed to apply them.
+enum class Dirty : u8
+{
+  /// @brief The view's previous tick, children, and layout are reused
+  None = 0,
+
+  /// @brief The view needs to be ticked again (i.e. it is animating or
+  /// its events changed), but its children and size inputs are unchanged
+  State = 1,
+
+  /// @brief The view's size inputs changed, the tree is laid out again
+  Layout = 2,
+
+  /// @brief The view's children changed, the tree is rebuilt
+  Children = 3
+};
+
 // [ ] Message-oriented architecture, fn-state hook for message querying + message queue? or just hashmap. state hook can modify0
 // [ ] fn-style and state hooks for renderers?
 
@@ -717,7 +753,28 @@ struct View
 
   bool hot_;
 
-  constexpr View() : id_{ViewId::None}, hot_{false}
+  /// @brief If the view reports all of its changes using `mark_dirty`. Views
+  /// that are not retained are ticked on every frame and assumed to have
+  /// changed on the frames they receive events, otherwise they must mark their
+  /// changes, i.e. animations and loads.
+  bool retained_;
+
+  /// @brief Changes to the view since it was last ticked. The view system
+  /// resets it before ticking the view, changes marked during `tick` are
+  /// applied on the same frame and tick the view once more on the next frame.
+  Dirty dirty_;
+
+  /// @brief If the view's `size` and `fit` only access the view's own state
+  /// and can be called concurrently with other views'. Their calls are
+  /// otherwise serialized on the layout thread.
+  bool concurrent_;
+
+  constexpr View() :
+    id_{ViewId::None},
+    hot_{false},
+    retained_{false},
+    dirty_{Dirty::Children},
+    concurrent_{false}
   {
   }
 
@@ -733,10 +790,21 @@ struct View
     return id_;
   }
 
+  /// @brief Report a change to the view's state, size inputs, or children.
+  /// Views that aren't retained only need to report the changes they didn't
+  /// make in response to events.
+  constexpr void mark_dirty(Dirty dirty)
+  {
+    dirty_ = max(dirty_, dirty);
+  }
+
   /// @brief Called on every frame. used for state changes, animations, task
   /// dispatch and lightweight processing related to the GUI. heavy-weight and
   /// non-sub-millisecond tasks should be dispatched to a subsystem that would
   /// handle it. i.e. using the multi-tasking or asset-loading systems.
+  /// Retained views are only ticked on frames they are dirty or receive
+  /// events, and must then build the same children unless they marked
+  /// `Dirty::Children`.
   /// @param ctx the associated context of the previous frame
   /// @param events events due to the previous frame's state
   /// @param build callback to be called to insert subviews.
@@ -757,8 +825,20 @@ struct View
     fill(sizes, allocated);
   }
 
+  /// @brief Performs the view's expensive layout work that only depends on
+  /// its allocated size (i.e. text layout), so `fit` is cheap. Called after
+  /// `size` and before `fit`, concurrently with the other views' `prefit`, so
+  /// it must only access the view's own state and thread-safe systems.
+  /// @param allocated the size allocated to this view
+  constexpr virtual void prefit(f32x2 allocated)
+  {
+    (void) allocated;
+  }
+
   /// @brief Fits itself around its children and positions child views
-  /// relative to its center
+  /// relative to its center. Retained views are only sized and fit if they
+  /// marked `Dirty::Layout` or their allocated size or their children's sizes
+  /// changed, their previous layout is reused otherwise.
   /// @param allocated the size allocated to this view
   /// @param sizes sizes of the child views
   /// @param[out] centers parent-space centers of the child views
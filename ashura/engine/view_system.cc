@@ -1,5 +1,6 @@
 /// SPDX-License-Identifier: MIT
 #include "ashura/engine/view_system.h"
+#include "ashura/std/async.h"
 #include "ashura/std/error.h"
 #include "ashura/std/range.h"
 #include "ashura/std/trace.h"
@@ -7,7 +8,8 @@
 namespace ash
 {
 
-void IViewSys::clear_frame()
+template <typename I>
+void IViewSysT<I>::clear_frame()
 {
   views.clear();
   nodes.depth.clear();
@@ -15,7 +17,9 @@ void IViewSys::clear_frame()
   nodes.children.clear();
   ids.clear();
   att.tab_idx.clear();
+  att.tab_order.clear();
   att.viewports.clear();
+  att.concealed.clear();
   att.hidden.clear();
   att.pointable.clear();
   att.clickable.clear();
@@ -32,6 +36,7 @@ void IViewSys::clear_frame()
   viewport_zooms.clear();
   fixed.clear();
   fixed_centers.clear();
+  opaque.clear();
   z_idx.clear();
   layers.clear();
   canvas_xfm.clear();
@@ -40,14 +45,18 @@ void IViewSys::clear_frame()
   canvas_extents.clear();
   clips.clear();
   z_ord.clear();
+  stacking.clear();
   focus_ord.clear();
   focus_idx.clear();
   closing_deferred = false;
   focus_grab_tgt   = none;
 }
 
-void IViewSys::prepare_for(u16 n)
+template <typename I>
+void IViewSysT<I>::prepare_for(I n)
 {
+  allocated.resize_uninit(n).unwrap();
+  prev_allocated.resize_uninit(n).unwrap();
   extents.resize_uninit(n).unwrap();
   centers.resize_uninit(n).unwrap();
   viewport_extents.resize_uninit(n).unwrap();
@@ -55,6 +64,7 @@ void IViewSys::prepare_for(u16 n)
   viewport_zooms.resize_uninit(n).unwrap();
   fixed.resize_uninit(n).unwrap();
   fixed_centers.resize_uninit(n).unwrap();
+  opaque.resize_uninit(n).unwrap();
   z_idx.resize_uninit(n).unwrap();
   layers.resize_uninit(n).unwrap();
   canvas_xfm.resize_uninit(n).unwrap();
@@ -65,17 +75,31 @@ void IViewSys::prepare_for(u16 n)
   z_ord.resize_uninit(n).unwrap();
   focus_ord.resize_uninit(n).unwrap();
   focus_idx.resize_uninit(n).unwrap();
+  stale.resize_uninit(n).unwrap();
+  resized.resize_uninit(n).unwrap();
+  refit.resize_uninit(n).unwrap();
+  reshaped.resize_uninit(n).unwrap();
+
+  // the tree was rebuilt, the previous layouts don't match its indices
+  for (I i = 0; i < n; i++)
+  {
+    stale.set_bit(i);
+  }
 }
 
-void IViewSys::push_view(ui::View & view, u16 depth,
-                         [[maybe_unused]] u16 breadth, u16 parent)
+template <typename I>
+void IViewSysT<I>::push_view(ui::View & view, u16 depth,
+                             [[maybe_unused]] I breadth, I parent)
 {
+  CHECK(views.size() < MAX_VIEWS, "");
   views.push(view).unwrap();
   nodes.depth.push(depth).unwrap();
   nodes.parent.push(parent).unwrap();
   nodes.children.extend_uninit(1).unwrap();
   att.tab_idx.extend_uninit(1).unwrap();
+  att.tab_order.extend_uninit(1).unwrap();
   att.viewports.extend_uninit(1).unwrap();
+  att.concealed.extend_uninit(1).unwrap();
   att.hidden.extend_uninit(1).unwrap();
   att.pointable.extend_uninit(1).unwrap();
   att.clickable.extend_uninit(1).unwrap();
@@ -87,7 +111,8 @@ void IViewSys::push_view(ui::View & view, u16 depth,
   att.is_viewport.extend_uninit(1).unwrap();
 }
 
-ui::Events IViewSys::drain_events(ui::View & view, u16 idx)
+template <typename I>
+ui::Events IViewSysT<I>::drain_events(ui::View & view, I idx)
 {
   ui::Events event;
 
@@ -109,20 +134,11 @@ ui::Events IViewSys::drain_events(ui::View & view, u16 idx)
   return event;
 }
 
-void IViewSys::build_children(ui::Ctx const & ctx, ui::View & view, u16 idx,
-                              u16 depth, u16 viewport, i32 & tab_index)
+template <typename I>
+void IViewSysT<I>::set_state(I idx, ui::State const & s)
 {
-  Slice16 children{size16(views), 0};
-
-  auto build = [&](ui::View & child) {
-    push_view(child, depth + 1, children.span++, idx);
-  };
-
-  ui::State s = view.tick(ctx, drain_events(view, idx), &build);
-
-  att.tab_idx.set(idx, s.tab.unwrap_or(tab_index));
-  att.viewports.set(idx, viewport);
-  att.hidden.set(idx, s.hidden);
+  att.tab_idx.set(idx, s.tab.unwrap_or(att.tab_order[idx]));
+  att.concealed.set(idx, s.hidden);
   att.pointable.set(idx, s.pointable);
   att.clickable.set(idx, s.clickable);
   att.scrollable.set(idx, s.scrollable);
@@ -137,6 +153,57 @@ void IViewSys::build_children(ui::Ctx const & ctx, ui::View & view, u16 idx,
   {
     focus_grab_tgt = idx;
   }
+}
+
+template <typename I>
+void IViewSysT<I>::build_children(ui::Ctx const & ctx, ui::View & view,
+                                  I idx, u16 depth, I viewport,
+                                  i32 & tab_index)
+{
+  CoreSlice<I> children{(I) views.size(), 0};
+
+  auto build = [&](ui::View & child) {
+    push_view(child, depth + 1, children.span++, idx);
+  };
+
+  ui::State s;
+
+  Option<u32> t = none;
+
+  // the view's children might have been replaced by another view's tick after
+  // it was ticked
+  if (!ticked.is_empty() && view.dirty_ != ui::Dirty::Children) [[unlikely]]
+  {
+    t = ticked_ids.try_get(view.id()).unref();
+  }
+
+  if (t)
+  {
+    // already ticked in-place on this frame before its children changed
+    auto const & cached = ticked[t.v()];
+
+    if (cached.hot)
+    {
+      ids.push(view.id(), idx).unwrap();
+    }
+
+    for (ref child : ticked_children.view().slice(cached.children))
+    {
+      build(child);
+    }
+
+    s = cached.state;
+  }
+  else
+  {
+    view.dirty_ = ui::Dirty::None;
+    s           = view.tick(ctx, drain_events(view, idx), &build);
+    view.dirty_ = min(view.dirty_, ui::Dirty::State);
+  }
+
+  att.tab_order.set(idx, tab_index);
+  att.viewports.set(idx, viewport);
+  set_state(idx, s);
 
   nodes.children[idx] = children;
 
@@ -149,14 +216,148 @@ void IViewSys::build_children(ui::Ctx const & ctx, ui::View & view, u16 idx,
   }
 }
 
-void IViewSys::build(ui::Ctx const & ctx, RootView & root)
+template <typename I>
+void IViewSysT<I>::build(ui::Ctx const & ctx, RootView & root)
 {
   push_view(root, 0, 0, RootView::PARENT);
   i32 tab_index = 0;
   build_children(ctx, root, 0, 0, RootView::VIEWPORT, tab_index);
 }
 
-void IViewSys::focus_order()
+template <typename I>
+ui::Dirty IViewSysT<I>::retick(ui::Ctx const & ctx, I idx)
+{
+  ref        view  = views[idx];
+  bool const hot   = view->hot_;
+  u32 const  first = size32(ticked_children);
+
+  auto build = [&](ui::View & child) { ticked_children.push(child).unwrap(); };
+
+  // changes marked since the view was last ticked, i.e. by its owner
+  auto const pending = view->dirty_;
+
+  view->dirty_ = ui::Dirty::None;
+  ui::State const s = view->tick(ctx, drain_events(view, idx), &build);
+  auto changes      = max(pending, view->dirty_);
+  view->dirty_      = min(view->dirty_, ui::Dirty::State);
+
+  // the views that don't report their changes are assumed to have changed in
+  // response to their events
+  if (!view->retained_ && hot)
+  {
+    changes = max(changes, ui::Dirty::Layout);
+  }
+
+  Slice32 const children{first, size32(ticked_children) - first};
+
+  u32 const t = size32(ticked);
+  ticked_ids.push(view->id(), t).unwrap();
+  ticked
+    .push(Ticked{.view = idx, .state = s, .children = children, .hot = hot})
+    .unwrap();
+
+  auto const prev = nodes.children[idx];
+
+  if (prev.span != children.span)
+  {
+    return ui::Dirty::Children;
+  }
+
+  for (u32 c = 0; c < children.span; c++)
+  {
+    if (views[prev.offset + c].ptr() !=
+        ticked_children[children.offset + c].ptr())
+    {
+      return ui::Dirty::Children;
+    }
+  }
+
+  if (changes == ui::Dirty::Children)
+  {
+    return changes;
+  }
+
+  if (changes == ui::Dirty::Layout)
+  {
+    stale.set_bit(idx);
+  }
+
+  // the focus order, visibility, and viewport transforms depend on these
+  if (att.tab_idx[idx] != s.tab.unwrap_or(att.tab_order[idx]) ||
+      att.concealed[idx] != s.hidden || att.is_viewport[idx] != s.viewport)
+  {
+    changes = ui::Dirty::Layout;
+  }
+
+  set_state(idx, s);
+
+  ticked[t].changes = changes;
+
+  return changes;
+}
+
+template <typename I>
+ui::Dirty IViewSysT<I>::tick_retained(ui::Ctx const & ctx)
+{
+  ScopeTrace trace;
+
+  dirty.clear();
+  ticked_ids.clear();
+  ticked.clear();
+  ticked_children.clear();
+
+  // closing is rare; rebuild so the close deferrals are up-to-date
+  if (views.is_empty() || ctx.closing)
+  {
+    return ui::Dirty::Children;
+  }
+
+  // parents come before their children, so a parent whose children changed
+  // is found before its removed (and possibly destroyed) children
+  for (auto [i, view] : enumerate(views))
+  {
+    if (view->dirty_ == ui::Dirty::Children)
+    {
+      return ui::Dirty::Children;
+    }
+
+    // the views that aren't retained are ticked on every frame
+    if (!view->retained_ || view->hot_ || view->dirty_ != ui::Dirty::None)
+    {
+      dirty.push((I) i).unwrap();
+    }
+  }
+
+  ids.clear();
+  focus_grab_tgt = none;
+
+  auto changes = ui::Dirty::None;
+
+  for (auto i : dirty)
+  {
+    changes = max(changes, retick(ctx, i));
+
+    if (changes == ui::Dirty::Children)
+    {
+      return changes;
+    }
+  }
+
+  // the ticks might have replaced the children of other views, i.e. of the
+  // views they own, which are otherwise only applied on the next frame
+  for (auto & view : views)
+  {
+    if (view->dirty_ == ui::Dirty::Children)
+    {
+      return ui::Dirty::Children;
+    }
+  }
+
+  return changes;
+}
+
+template <typename I>
+void IViewSysT<I>::focus_order()
 {
   ScopeTrace trace;
 
@@ -172,7 +373,78 @@ void IViewSys::focus_order()
   }
 }
 
-void IViewSys::layout(f32x2 viewport_extent)
+/// @brief Number of views processed per task by the concurrent layout passes.
+/// Fewer views are processed on the calling thread.
+static constexpr usize LAYOUT_BATCH = 1'024;
+
+/// @brief Call `fn(i)` for each `i` in `[begin, end)`, concurrently in batches
+/// of `LAYOUT_BATCH` if there are enough of them. `fn` must only write to
+/// state no other index writes to.
+template <typename F>
+static void parallel_for(usize begin, usize end, F && fn)
+{
+  usize const n = end - begin;
+
+  if (n < 2 * LAYOUT_BATCH)
+  {
+    for (usize i = begin; i < end; i++)
+    {
+      fn(i);
+    }
+    return;
+  }
+
+  scheduler->for_each(
+    (n + LAYOUT_BATCH - 1) / LAYOUT_BATCH,
+    [&](u64 batch) {
+      usize const first = begin + batch * LAYOUT_BATCH;
+      usize const last  = min(first + LAYOUT_BATCH, end);
+      for (usize i = first; i < last; i++)
+      {
+        fn(i);
+      }
+    },
+    default_allocator);
+}
+
+template <typename I>
+void IViewSysT<I>::order_depths()
+{
+  auto const n = views.size();
+
+  u16 max_depth = 0;
+
+  for (auto depth : nodes.depth)
+  {
+    max_depth = max(max_depth, depth);
+  }
+
+  // counting sort; the views of a level stay in tree order
+  depth_offsets.resize_uninit(max_depth + 3).unwrap();
+  fill(depth_offsets.view(), 0U);
+
+  for (auto depth : nodes.depth)
+  {
+    depth_offsets[depth + 2]++;
+  }
+
+  for (usize d = 2; d < depth_offsets.size(); d++)
+  {
+    depth_offsets[d] += depth_offsets[d - 1];
+  }
+
+  depth_ord.resize_uninit(n).unwrap();
+
+  for (usize i = 0; i < n; i++)
+  {
+    depth_ord[depth_offsets[nodes.depth[i] + 1]++] = (I) i;
+  }
+
+  depth_offsets.pop();
+}
+
+template <typename I>
+void IViewSysT<I>::layout(f32x2 viewport_extent)
 {
   ScopeTrace trace;
 
@@ -183,61 +455,156 @@ void IViewSys::layout(f32x2 viewport_extent)
 
   auto const n = views.size();
 
+  order_depths();
+
+  auto const num_levels = depth_offsets.size() - 1;
+
+  // call `fn(i)` for the views of the level, the concurrent views first then
+  // the rest on the calling thread
+  auto each_view = [&](usize level, auto && fn) {
+    auto const begin = depth_offsets[level];
+    auto const end   = depth_offsets[level + 1];
+
+    parallel_for(begin, end, [&](usize o) {
+      auto const i = depth_ord[o];
+      if (views[i]->concurrent_)
+      {
+        fn(i);
+      }
+    });
+
+    for (auto o = begin; o < end; o++)
+    {
+      auto const i = depth_ord[o];
+      if (!views[i]->concurrent_)
+      {
+        fn(i);
+      }
+    }
+  };
+
+  swap(allocated, prev_allocated);
+
   // allocate sizes to children recursively
-  extents[0] = viewport_extent;
+  allocated[0] = viewport_extent;
+  resized[0]   = !bit_eq(allocated[0], prev_allocated[0]);
 
-  for (auto [children, view, extent] : zip(nodes.children, views, extents))
+  for (usize level = 0; level < num_levels; level++)
   {
-    view->size(extent, extents.view().slice(children));
+    each_view(level, [&](I i) {
+      auto const children = nodes.children[i];
+
+      if (!stale[i] && !resized[i])
+      {
+        // the children are allocated the same extents
+        for (auto c = children.begin(); c < children.end(); c++)
+        {
+          allocated[c] = prev_allocated[c];
+          resized[c]   = false;
+        }
+        return;
+      }
+
+      views[i]->size(allocated[i], allocated.view().slice(children));
+
+      for (auto c = children.begin(); c < children.end(); c++)
+      {
+        resized[c] = !bit_eq(allocated[c], prev_allocated[c]);
+      }
+    });
   }
 
-  centers[0] = f32x2::splat(0);
+  // the allocated sizes are final; run the views' expensive size-dependent
+  // work (i.e. text layout) concurrently before fitting. only the views whose
+  // inputs changed are dispatched, none on idle frames.
+  prefits.clear();
 
-  // fit parent views along the finalized sizes of the child views and
-  // assign centers to the children based on their sizes.
-  for (usize i = n; i != 0;)
+  for (usize i = 0; i < n; i++)
   {
-    i--;
-    auto const children = nodes.children[i];
-    auto layout = views[i]->fit(extents[i], extents.view().slice(children),
-                                centers.view().slice(children));
-    extents[i]  = layout.extent;
-    viewport_extents[i] = layout.viewport_extent;
-    viewport_centers[i] = layout.viewport_center;
-    viewport_zooms[i]   = layout.viewport_zoom;
-    fixed.set(i, layout.fixed_center.is_some());
-    fixed_centers[i] = layout.fixed_center.unwrap_or();
+    if (stale[i] || resized[i])
+    {
+      prefits.push((I) i).unwrap();
+    }
   }
 
-  // calculate fixed centers; parent-space to local viewport space
+  parallel_for(0, prefits.size(), [&](usize p) {
+    auto const i = prefits[p];
+    views[i]->prefit(allocated[i]);
+  });
 
-  for (auto [i, children] : enumerate(nodes.children))
+  centers[0] = f32x2::splat(0);
+
+  // fit parent views along the finalized sizes of the child views and
+  // assign centers to the children based on their sizes. The previous layout
+  // of the view and its children's centers are still in place if none of its
+  // inputs changed.
+  for (usize level = num_levels; level != 0;)
   {
-    // viewports don't propagate fixed-position centers to children
-    auto const fc = att.is_viewport[i] ? f32x2::zero() : fixed_centers[i];
+    level--;
+    each_view(level, [&](I i) {
+      auto const children = nodes.children[i];
 
-    for (auto c = children.begin(); c < children.end(); c++)
-    {
-      if (!fixed[c]) [[likely]]
+      bool changed = stale[i] || resized[i];
+
+      for (auto c = children.begin(); c < children.end() && !changed; c++)
       {
-        fixed_centers[c] = centers[c] + fc;
+        changed = reshaped[c];
       }
-    }
+
+      refit[i] = changed;
+
+      if (!changed)
+      {
+        reshaped[i] = false;
+        return;
+      }
+
+      auto layout = views[i]->fit(allocated[i], extents.view().slice(children),
+                                  centers.view().slice(children));
+      reshaped[i] = !bit_eq(layout.extent, extents[i]);
+      extents[i]  = layout.extent;
+      viewport_extents[i] = layout.viewport_extent;
+      viewport_centers[i] = layout.viewport_center;
+      viewport_zooms[i]   = layout.viewport_zoom;
+      fixed[i]            = layout.fixed_center.is_some();
+      fixed_centers[i]    = layout.fixed_center.unwrap_or();
+      opaque[i]           = layout.opaque;
+    });
   }
 
-  // recursively apply viewport transforms to child viewports
-  canvas_xfm[0]     = affinef32x3::identity();
-  canvas_inv_xfm[0] = affinef32x3::identity();
+  usize num_fit = 0;
 
   for (usize i = 0; i < n; i++)
   {
+    num_fit += refit[i] ? 1 : 0;
+    stale.set(i, false);
+  }
+
+  usize const num_reused = n - num_fit;
+
+  TraceRecord const memo_records[] = {
+    {.label = "views"_str,    .i = (i64) n                      },
+    {.label = "reused"_str,   .i = (i64) num_reused             },
+    {.label = "hit_rate"_str, .f = (f64) num_reused / (f64) n}
+  };
+
+  trace_sink->trace(TraceEvent{.label = "layout.memo"_str}, span(memo_records));
+
+  canvas_xfm[0]     = affinef32x3::identity();
+  canvas_inv_xfm[0] = affinef32x3::identity();
+  clips[0]          = CRect{.center = {}, .extent = viewport_extent};
+
+  // a view's fixed center is final once its parent's level is placed, and its
+  // parent viewport is on a level above it
+  auto place = [&](I i) {
+    auto const parent_viewport = att.viewports[i];
+
+    // recursively apply viewport transforms to child viewports
     if (att.is_viewport[i]) [[unlikely]]
     {
-      auto parent = att.viewports[i];
-
       // accumulated parent transform
-      auto const & accum     = canvas_xfm[parent];
-      auto const & inv_accum = canvas_inv_xfm[parent];
+      auto const & accum     = canvas_xfm[parent_viewport];
+      auto const & inv_accum = canvas_inv_xfm[parent_viewport];
 
       // transform we are applying to the viewport's contents
       auto const transform = translate2d(fixed_centers[i]) *
@@ -249,25 +616,21 @@ void IViewSys::layout(f32x2 viewport_extent)
       canvas_xfm[i]     = accum * transform;
       canvas_inv_xfm[i] = inv_accum * inv_transform;
     }
-  }
 
-  canvas_centers[0] = fixed_centers[0];
-  canvas_extents[0] = extents[0];
-
-  for (usize i = 1; i < n; i++)
-  {
-    auto const & transform = canvas_xfm[att.viewports[i]];
-    auto const   zoom      = f32x2{transform[0][0], transform[1][1]};
-    canvas_centers[i]      = ash::transform(transform, fixed_centers[i]);
-    canvas_extents[i]      = extents[i] * zoom;
-  }
-
-  clips[0] = CRect{.center = {}, .extent = viewport_extent};
+    if (i == RootView::NODE) [[unlikely]]
+    {
+      canvas_centers[i] = fixed_centers[i];
+      canvas_extents[i] = extents[i];
+    }
+    else
+    {
+      auto const & transform = canvas_xfm[parent_viewport];
+      auto const   zoom      = f32x2{transform[0][0], transform[1][1]};
+      canvas_centers[i]      = ash::transform(transform, fixed_centers[i]);
+      canvas_extents[i]      = extents[i] * zoom;
+    }
 
-  /// clip viewports recursively and assign viewport clips to contained views
-  for (usize i = 0; i < n; i++)
-  {
-    auto const parent_viewport = att.viewports[i];
+    // clip viewports recursively and assign viewport clips to contained views
     if (att.is_viewport[i]) [[unlikely]]
     {
       CRect const clip{.center = canvas_centers[i],
@@ -278,6 +641,25 @@ void IViewSys::layout(f32x2 viewport_extent)
     {
       clips[i] = clips[parent_viewport];
     }
+
+    // calculate fixed centers; parent-space to local viewport space
+    // viewports don't propagate fixed-position centers to children
+    auto const children = nodes.children[i];
+    auto const fc = att.is_viewport[i] ? f32x2::zero() : fixed_centers[i];
+
+    for (auto c = children.begin(); c < children.end(); c++)
+    {
+      if (!fixed[c]) [[likely]]
+      {
+        fixed_centers[c] = centers[c] + fc;
+      }
+    }
+  };
+
+  for (usize level = 0; level < num_levels; level++)
+  {
+    parallel_for(depth_offsets[level], depth_offsets[level + 1],
+                 [&](usize o) { place(depth_ord[o]); });
   }
 }
 
@@ -305,7 +687,8 @@ static constexpr Order z_cmp(i32 a_layer, i32 a_z_index, u16 a_depth,
   return cmp(a_depth, b_depth);
 }
 
-void IViewSys::stack()
+template <typename I>
+void IViewSysT<I>::stack()
 {
   ScopeTrace trace;
 
@@ -328,19 +711,120 @@ void IViewSys::stack()
     layer = view->layer(layer, layers.view().slice(children));
   }
 
+  auto const n = views.size();
+
+  // the depths only change if the tree is rebuilt, which clears `stacking`
+  bool restack = stacking.size() != n;
+
+  stacking.resize_uninit(n).unwrap();
+
+  for (usize i = 0; i < n; i++)
+  {
+    u64 const s = ((u64) (u32) layers[i] << 32) | (u64) (u32) z_idx[i];
+    restack |= stacking[i] != s;
+    stacking[i] = s;
+  }
+
+  if (!restack)
+  {
+    return;
+  }
+
+  i32 min_layer = layers[0];
+  i32 max_layer = layers[0];
+  i32 min_z     = z_idx[0];
+  i32 max_z     = z_idx[0];
+  u16 max_depth = 0;
+
+  for (usize i = 0; i < n; i++)
+  {
+    min_layer = min(min_layer, layers[i]);
+    max_layer = max(max_layer, layers[i]);
+    min_z     = min(min_z, z_idx[i]);
+    max_z     = max(max_z, z_idx[i]);
+    max_depth = max(max_depth, nodes.depth[i]);
+  }
+
+  u32 const layer_bits =
+    (u32) std::bit_width((u64) ((i64) max_layer - (i64) min_layer));
+  u32 const z_bits = (u32) std::bit_width((u64) ((i64) max_z - (i64) min_z));
+  u32 const depth_bits = (u32) std::bit_width(max_depth);
+  u32 const key_bits   = layer_bits + z_bits + depth_bits;
+
   iota(z_ord.view(), 0U);
 
-  // sort layers
-  indirect_sort(z_ord.view(), [&](auto a, auto b) {
-    return z_cmp(layers[a], z_idx[a], nodes.depth[a], layers[b], z_idx[b],
-                 nodes.depth[b]) == Order::Less;
-  });
+  if (key_bits >= 64) [[unlikely]]
+  {
+    // the ranges of the layers and z-indices are too wide to be packed. the
+    // sort is stable so ties are ordered by index, as with the radix sort
+    indirect_stable_sort(z_ord.view(), [&](auto a, auto b) {
+      return z_cmp(layers[a], z_idx[a], nodes.depth[a], layers[b], z_idx[b],
+                   nodes.depth[b]) == Order::Less;
+    });
+    return;
+  }
+
+  // pack the (layer, z-index, depth) keys relative to their minimums, and
+  // sort them with a stable LSD radix sort over the used bits only. The views
+  // start in tree order, so ties are ordered by index.
+  z_keys.resize_uninit(n).unwrap();
+  z_keys_tmp.resize_uninit(n).unwrap();
+  z_ord_tmp.resize_uninit(n).unwrap();
+
+  for (usize i = 0; i < n; i++)
+  {
+    z_keys[i] = ((u64) ((i64) layers[i] - (i64) min_layer)
+                 << (z_bits + depth_bits)) |
+                ((u64) ((i64) z_idx[i] - (i64) min_z) << depth_bits) |
+                (u64) nodes.depth[i];
+  }
+
+  static constexpr u32 RADIX_BITS = 8;
+  static constexpr u32 RADIX      = 1 << RADIX_BITS;
+
+  for (u32 shift = 0; shift < key_bits; shift += RADIX_BITS)
+  {
+    Array<u32, RADIX + 1> offsets{};
+
+    for (usize i = 0; i < n; i++)
+    {
+      offsets[((z_keys[i] >> shift) & (RADIX - 1)) + 1]++;
+    }
+
+    for (u32 d = 0; d < RADIX; d++)
+    {
+      offsets[d + 1] += offsets[d];
+    }
+
+    for (usize i = 0; i < n; i++)
+    {
+      u32 const dst   = offsets[(z_keys[i] >> shift) & (RADIX - 1)]++;
+      z_keys_tmp[dst] = z_keys[i];
+      z_ord_tmp[dst]  = z_ord[i];
+    }
+
+    swap(z_keys, z_keys_tmp);
+    swap(z_ord, z_ord_tmp);
+  }
 }
 
-void IViewSys::visibility()
+template <typename I>
+void IViewSysT<I>::visibility()
 {
   ScopeTrace trace;
 
+  culled.resize_uninit(views.size()).unwrap();
+
+  parallel_for(0, views.size(), [&](usize i) {
+    culled[i] = !clips[att.viewports[i]].overlaps(
+      CRect{.center = canvas_centers[i], .extent = canvas_extents[i]});
+  });
+
+  for (auto i : range(views.size()))
+  {
+    att.hidden.set(i, att.concealed[i]);
+  }
+
   for (auto [i, children] : enumerate(nodes.children))
   {
     if (att.hidden[i])
@@ -353,23 +837,308 @@ void IViewSys::visibility()
     }
     else
     {
-      auto const & clip = clips[att.viewports[i]];
+      att.hidden.set(i, culled[i]);
+    }
+  }
+}
+
+/// @brief The range of grid cells overlapped by the canvas-space rect, none
+/// if it lies outside the grid
+template <typename Grid>
+static Option<Tuple<u32x2, u32x2>> grid_cells(Grid const & grid, f32x2 begin,
+                                              f32x2 end)
+{
+  auto const scale = 1 / Grid::CELL_SIZE;
+  auto const b     = floor((begin - grid.origin) * scale).to<i32>();
+  auto const e     = floor((end - grid.origin) * scale).to<i32>();
+  auto const last  = grid.dims.to<i32>() - i32x2::splat(1);
+
+  if (e.x() < 0 || e.y() < 0 || b.x() > last.x() || b.y() > last.y())
+  {
+    return none;
+  }
+
+  return Tuple{b.clamp(i32x2::splat(0), last).to<u32>(),
+               e.clamp(i32x2::splat(0), last).to<u32>()};
+}
+
+template <typename I>
+void IViewSysT<I>::index()
+{
+  ScopeTrace trace;
+
+  auto const n = (I) views.size();
+
+  grid.origin = -0.5F * viewport_extent;
+  grid.dims =
+    floor(viewport_extent * (1 / Grid::CELL_SIZE)).to<u32>() + u32x2::splat(1);
+
+  u32 const num_cells = grid.dims.x() * grid.dims.y();
+
+  // call `fn(cell, z)` for every cell overlapped by the visible views, in
+  // z-order
+  auto each = [&](auto && fn) {
+    for (I z = 0; z < n; z++)
+    {
+      auto const i = z_ord[z];
+
+      if (att.hidden[i])
+      {
+        continue;
+      }
+
+      CRect const area{.center = canvas_centers[i], .extent = canvas_extents[i]};
+
+      grid_cells(grid, area.begin(), area.end()).match([&](auto cells) {
+        auto [b, e] = cells;
+        for (u32 y = b.y(); y <= e.y(); y++)
+        {
+          for (u32 x = b.x(); x <= e.x(); x++)
+          {
+            fn(y * grid.dims.x() + x, z);
+          }
+        }
+      });
+    }
+  };
+
+  grid.offsets.resize_uninit(num_cells + 1).unwrap();
+  fill(grid.offsets.view(), 0U);
+
+  each([&](u32 cell, I) { grid.offsets[cell + 1]++; });
+
+  for (u32 c = 0; c < num_cells; c++)
+  {
+    grid.offsets[c + 1] += grid.offsets[c];
+  }
+
+  grid.cursors.resize_uninit(num_cells).unwrap();
+
+  for (u32 c = 0; c < num_cells; c++)
+  {
+    grid.cursors[c] = grid.offsets[c];
+  }
+
+  grid.entries.resize_uninit(grid.offsets[num_cells]).unwrap();
+
+  each([&](u32 cell, I z) { grid.entries[grid.cursors[cell]++] = z; });
+}
+
+template <typename I>
+CRect IViewSysT<I>::visible_region(I i) const
+{
+  if (att.hidden[i])
+  {
+    return CRect{};
+  }
+
+  CRect const  area{.center = canvas_centers[i], .extent = canvas_extents[i]};
+  auto const & clip = clips[att.viewports[i]];
+
+  return area.overlaps(clip) ? area.intersect(clip) : CRect{};
+}
+
+template <typename I>
+void IViewSysT<I>::occlusion()
+{
+  ScopeTrace trace;
+
+  /// @brief maximum number of occluders tested against; the largest ones are
+  /// kept, i.e. full-screen panels and modal backdrops
+  static constexpr u32 MAX_OCCLUDERS = 16;
+
+  auto const n = (I) views.size();
+
+  occluded.resize_uninit(n).unwrap();
+
+  Array<CRect, MAX_OCCLUDERS> occluders;
+  u32                         num_occluders = 0;
+
+  auto covers = [](CRect const & a, CRect const & b) {
+    auto const ab = a.begin();
+    auto const ae = a.end();
+    auto const bb = b.begin();
+    auto const be = b.end();
+    return ab.x() <= bb.x() && ab.y() <= bb.y() && be.x() <= ae.x() &&
+           be.y() <= ae.y();
+  };
+
+  // front to back, a view can only be covered by the views above it
+  for (I z = n; z != 0;)
+  {
+    z--;
+    auto const i = z_ord[z];
+
+    occluded.set(i, false);
+
+    auto const region = visible_region(i);
+
+    if (!region.is_visible())
+    {
+      continue;
+    }
+
+    for (u32 o = 0; o < num_occluders; o++)
+    {
+      if (covers(occluders[o], region))
+      {
+        occluded.set(i, true);
+        break;
+      }
+    }
+
+    if (occluded[i] || !opaque[i].is_visible())
+    {
+      continue;
+    }
+
+    auto const & clip = clips[att.viewports[i]];
+    auto const & xfm  = canvas_xfm[att.viewports[i]];
+    auto const   zoom = f32x2{xfm[0][0], xfm[1][1]};
+
+    CRect const area{.center = canvas_centers[i] + opaque[i].center * zoom,
+                     .extent = opaque[i].extent * zoom};
+
+    if (!area.overlaps(clip))
+    {
+      continue;
+    }
+
+    auto const occluder = area.intersect(clip);
+
+    if (num_occluders < MAX_OCCLUDERS)
+    {
+      occluders[num_occluders++] = occluder;
+      continue;
+    }
+
+    // replace the smallest occluder
+    u32 smallest = 0;
+    for (u32 o = 1; o < num_occluders; o++)
+    {
+      if (occluders[o].area() < occluders[smallest].area())
+      {
+        smallest = o;
+      }
+    }
+
+    if (occluders[smallest].area() < occluder.area())
+    {
+      occluders[smallest] = occluder;
+    }
+  }
+}
+
+template <typename I>
+void IViewSysT<I>::track_damage(ui::Dirty changes, bool relayout)
+{
+  ScopeTrace trace;
+
+  auto const n = (I) views.size();
+
+  damage = none;
+
+  auto add = [&](CRect const & r) {
+    if (r.is_visible())
+    {
+      damage = damage.is_some() ? damage.v().unioned(r) : r;
+    }
+  };
+
+  if (changes == ui::Dirty::Children)
+  {
+    // the tree was rebuilt, its indices don't match the previous frame's
+    regions.resize_uninit(n).unwrap();
+
+    for (I i = 0; i < n; i++)
+    {
+      regions[i] = visible_region(i);
+    }
+
+    damage = CRect{.center = f32x2::splat(0), .extent = viewport_extent};
+    return;
+  }
+
+  if (relayout)
+  {
+    for (I i = 0; i < n; i++)
+    {
+      auto const r = visible_region(i);
 
-      bool const hidden = !clip.overlaps(
-        CRect{.center = canvas_centers[i], .extent = canvas_extents[i]});
+      if (r != regions[i])
+      {
+        add(regions[i]);
+        add(r);
+        regions[i] = r;
+      }
+    }
+  }
 
-      att.hidden.set(i, hidden);
+  // the views ticked in-place that changed might render differently
+  for (auto const & t : ticked)
+  {
+    if (t.changes != ui::Dirty::None)
+    {
+      add(regions[t.view]);
     }
   }
 }
 
-void IViewSys::render(Canvas & canvas)
+template <typename I>
+void IViewSysT<I>::render(Canvas & canvas)
 {
   ScopeTrace trace;
 
-  for (auto i : z_ord)
+  auto const damaged = canvas->damage();
+
+  auto const cells = grid_cells(grid, damaged.begin(), damaged.end());
+
+  if (!cells)
+  {
+    return;
+  }
+
+  auto const [b, e]      = cells.v();
+  u32 const  num_cells   = grid.dims.x() * grid.dims.y();
+  auto const num_damaged = e - b + u32x2::splat(1);
+
+  render_ord.clear();
+
+  if (num_damaged.x() * num_damaged.y() * 2 >= num_cells)
+  {
+    // most of the viewport is damaged, the views are already in z-order
+    render_ord.resize_uninit(views.size()).unwrap();
+    iota(render_ord.view(), 0U);
+  }
+  else
+  {
+    // only render the views in the damaged cells
+    for (u32 y = b.y(); y <= e.y(); y++)
+    {
+      for (u32 x = b.x(); x <= e.x(); x++)
+      {
+        u32 const c = y * grid.dims.x() + x;
+        render_ord
+          .extend(grid.entries.view().slice(
+            grid.offsets[c], grid.offsets[c + 1] - grid.offsets[c]))
+          .unwrap();
+      }
+    }
+
+    sort(render_ord.view());
+  }
+
+  for (auto [r, z] : enumerate(render_ord))
   {
-    if (!att.hidden[i])
+    // views spanning multiple damaged cells appear once per cell
+    if (r != 0 && render_ord[r - 1] == z)
+    {
+      continue;
+    }
+
+    auto const i = z_ord[z];
+
+    if (!att.hidden[i] && !occluded[i] && damaged.overlaps(regions[i]))
     {
       auto         parent_viewport = att.viewports[i];
       auto const & clip            = clips[parent_viewport];
@@ -389,7 +1158,8 @@ void IViewSys::render(Canvas & canvas)
   }
 }
 
-void IViewSys::focus_on(u16 i, bool active, bool grab_focus)
+template <typename I>
+void IViewSysT<I>::focus_on(I i, bool active, bool grab_focus)
 {
   auto old        = focus_state.tgt;
   bool was_active = focus_state.active;
@@ -445,7 +1215,39 @@ void IViewSys::focus_on(u16 i, bool active, bool grab_focus)
   }
 }
 
-Option<u16> IViewSys::hit_test(f32x2 position) const
+template <typename I>
+Option<I> IViewSysT<I>::hit_test(f32x2 position) const
+{
+  auto const cells = grid_cells(grid, position, position);
+
+  if (!cells) [[unlikely]]
+  {
+    // outside the viewport, i.e. when dragging out of the window
+    return scan_hit(position);
+  }
+
+  auto const [cell, _] = cells.v();
+  auto const c         = cell.y() * grid.dims.x() + cell.x();
+
+  // find in reverse z-order
+  for (auto e = grid.offsets[c + 1]; e != grid.offsets[c];)
+  {
+    e--;
+
+    auto const i = z_ord[grid.entries[e]];
+
+    if (CRect{.center = canvas_centers[i], .extent = canvas_extents[i]}
+          .contains(position))
+    {
+      return i;
+    }
+  }
+
+  return none;
+}
+
+template <typename I>
+Option<I> IViewSysT<I>::scan_hit(f32x2 position) const
 {
   // find in reverse z-order
   for (auto z = views.size(); z != 0;)
@@ -466,7 +1268,8 @@ Option<u16> IViewSys::hit_test(f32x2 position) const
   return none;
 }
 
-ui::HitInfo IViewSys::get_hit_info(u16 view, f32x2 position) const
+template <typename I>
+ui::HitInfo IViewSysT<I>::get_hit_info(I view, f32x2 position) const
 {
   auto viewport          = att.viewports[view];
   auto viewport_position = transform(canvas_inv_xfm[viewport], position);
@@ -486,7 +1289,8 @@ ui::HitInfo IViewSys::get_hit_info(u16 view, f32x2 position) const
   };
 }
 
-u16 IViewSys::navigate_focus(u16 from_idx, bool forward) const
+template <typename I>
+I IViewSysT<I>::navigate_focus(I from_idx, bool forward) const
 {
   CHECK(from_idx < views.size(), "");
   CHECK(!views.is_empty(), "");
@@ -496,7 +1300,7 @@ u16 IViewSys::navigate_focus(u16 from_idx, bool forward) const
     return from_idx;
   }
 
-  i64 const n    = size16(views);
+  i64 const n    = (i64) views.size();
   auto      from = focus_idx[from_idx];
   i64       f    = from;
 
@@ -531,7 +1335,8 @@ u16 IViewSys::navigate_focus(u16 from_idx, bool forward) const
   return from_idx;
 }
 
-IViewSys::HitState IViewSys::none_seq(ui::Ctx const & ctx)
+template <typename I>
+typename IViewSysT<I>::HitState IViewSysT<I>::none_seq(ui::Ctx const & ctx)
 {
   if (!ctx.mouse.focused)
   {
@@ -541,10 +1346,11 @@ IViewSys::HitState IViewSys::none_seq(ui::Ctx const & ctx)
   return point_seq(ctx, none);
 }
 
-IViewSys::HitState IViewSys::drag_start_seq(ui::Ctx const & ctx,
-                                            Option<u16>     src)
+template <typename I>
+typename IViewSysT<I>::HitState
+  IViewSysT<I>::drag_start_seq(ui::Ctx const & ctx, Option<I> src)
 {
-  auto diff = [&](Option<u16> tgt, Option<ui::HitInfo> hit) {
+  auto diff = [&](Option<I> tgt, Option<ui::HitInfo> hit) {
     tgt.match([&](auto i) {
       events.push(Event{.dst = i, .type = ui::Events::DragIn, .hit = hit})
         .unwrap();
@@ -607,11 +1413,12 @@ IViewSys::HitState IViewSys::drag_start_seq(ui::Ctx const & ctx,
   return DragState{.seq = DragState::Update, .src = src, .tgt = tgt};
 }
 
-IViewSys::HitState IViewSys::drag_update_seq(ui::Ctx const & ctx,
-                                             Option<u16>     src,
-                                             Option<u16>     prev_tgt)
+template <typename I>
+typename IViewSysT<I>::HitState
+  IViewSysT<I>::drag_update_seq(ui::Ctx const & ctx, Option<I> src,
+                                Option<I> prev_tgt)
 {
-  auto diff = [&](Option<u16> tgt, Option<ui::HitInfo> hit) {
+  auto diff = [&](Option<I> tgt, Option<ui::HitInfo> hit) {
     tgt.match([&](auto i) {
       if (prev_tgt == i)
       {
@@ -680,11 +1487,12 @@ IViewSys::HitState IViewSys::drag_update_seq(ui::Ctx const & ctx,
   return DragState{.seq = DragState::Update, .src = src, .tgt = tgt};
 }
 
-IViewSys::HitState IViewSys::point_seq(ui::Ctx const & ctx,
-                                       Option<u16>     prev_tgt)
+template <typename I>
+typename IViewSysT<I>::HitState
+  IViewSysT<I>::point_seq(ui::Ctx const & ctx, Option<I> prev_tgt)
 {
   // [ ] handle external drop
-  auto diff = [&](Option<u16> tgt, Option<ui::HitInfo> hit) {
+  auto diff = [&](Option<I> tgt, Option<ui::HitInfo> hit) {
     tgt.match([&](auto i) {
       if (i != prev_tgt)
       {
@@ -797,7 +1605,8 @@ IViewSys::HitState IViewSys::point_seq(ui::Ctx const & ctx,
   return PointState{.tgt = tgt};
 }
 
-void IViewSys::hit_seq(ui::Ctx const & ctx)
+template <typename I>
+void IViewSysT<I>::hit_seq(ui::Ctx const & ctx)
 {
   // build hitstate from the ids
   // process event state
@@ -858,14 +1667,22 @@ void IViewSys::hit_seq(ui::Ctx const & ctx)
     });
 }
 
-void IViewSys::focus_seq(ui::Ctx const & ctx)
+template <typename I>
+void IViewSysT<I>::focus_seq(ui::Ctx const & ctx)
 {
   // view might be gone when we begin this frame so we can focus on the root view if it has disappeared
-  focus_state =
-    FocusState{.active = xframe_focus_state.active,
-               .tgt = ids.try_get(xframe_focus_state.tgt).unref().unwrap_or()};
+  auto tgt = ids.try_get(xframe_focus_state.tgt).unref();
 
-  views[focus_state.tgt]->hot_ = true;
+  // the focused view is only hot on the frames focus events are dispatched to
+  // it. It is still at its previous index if the view there has its id.
+  if (tgt.is_none() && focus_state.tgt < views.size() &&
+      views[focus_state.tgt]->id() == xframe_focus_state.tgt)
+  {
+    tgt = focus_state.tgt;
+  }
+
+  focus_state =
+    FocusState{.active = xframe_focus_state.active, .tgt = tgt.unwrap_or()};
 
   focus_grab_tgt.match([&](auto i) { focus_on(i, true, true); });
 
@@ -913,9 +1730,10 @@ void IViewSys::focus_seq(ui::Ctx const & ctx)
   }
 }
 
-void IViewSys::compose_event(ui::ViewId id, ui::Events::Type event,
-                             Option<ui::HitInfo>    hit,
-                             Option<ui::ScrollInfo> scroll)
+template <typename I>
+void IViewSysT<I>::compose_event(ui::ViewId id, ui::Events::Type event,
+                                 Option<ui::HitInfo>    hit,
+                                 Option<ui::ScrollInfo> scroll)
 {
   auto [_, v] = event_queue.push(id, ui::Events{}, nullptr, false).v();
 
@@ -932,7 +1750,8 @@ void IViewSys::compose_event(ui::ViewId id, ui::Events::Type event,
   }
 }
 
-void IViewSys::process_input(ui::Ctx const & ctx)
+template <typename I>
+void IViewSysT<I>::process_input(ui::Ctx const & ctx)
 {
   ScopeTrace trace;
 
@@ -973,33 +1792,59 @@ void IViewSys::process_input(ui::Ctx const & ctx)
   events.clear();
 }
 
-Option<TextInputInfo> IViewSys::text_input() const
+template <typename I>
+Option<TextInputInfo> IViewSysT<I>::text_input() const
 {
   return input_info;
 }
 
-bool IViewSys::tick(InputState const & input, ui::View & root, Canvas & canvas,
-                    Fn<void(ui::Ctx const &)> loop)
+template <typename I>
+bool IViewSysT<I>::tick(InputState const & input, ui::View & root,
+                        Fn<void(ui::Ctx const &)> loop)
 {
   ScopeTrace trace;
   // [ ] message propagation, i.e theme change
 
-  clear_frame();
-
-  root_view.next_ = root;
+  if (root_view.next_.is_none() || &root_view.next_.v() != &root)
+  {
+    root_view.next_ = root;
+    root_view.mark_dirty(ui::Dirty::Children);
+  }
 
   ctx.focused = focus_rect;
   ctx.cursor  = cursor;
 
   loop(ctx);
-  build(ctx, root_view);
+
+  // only the dirty views are ticked if the tree's structure is unchanged, the
+  // rest of the tree and its layout are reused from the previous frame
+  auto const changes = tick_retained(ctx);
+
+  if (changes == ui::Dirty::Children)
+  {
+    clear_frame();
+    build(ctx, root_view);
+    prepare_for((I) views.size());
+  }
+
   event_queue.clear();
-  prepare_for(size16(views));
-  focus_order();
-  layout(input.window.extent.to<f32>());
-  stack();
-  visibility();
-  render(canvas);
+
+  auto const extent = input.window.extent.to<f32>();
+  bool const relayout =
+    changes >= ui::Dirty::Layout || extent != viewport_extent;
+
+  if (relayout)
+  {
+    viewport_extent = extent;
+    focus_order();
+    layout(extent);
+    stack();
+    visibility();
+    index();
+    occlusion();
+  }
+
+  track_damage(changes, relayout);
 
   ctx.tick(input);
 
@@ -1012,4 +1857,7 @@ bool IViewSys::tick(InputState const & input, ui::View & root, Canvas & canvas,
   return !should_close;
 }
 
+template struct IViewSysT<u16>;
+template struct IViewSysT<u32>;
+
 }    // namespace ash
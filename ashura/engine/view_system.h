@@ -19,6 +19,7 @@ struct RootView : ui::View
 
   constexpr RootView(Option<View &> next) : next_{next}
   {
+    retained_ = true;
   }
 
   constexpr virtual ui::State tick(ui::Ctx const &, ui::Events const &,
@@ -37,7 +38,11 @@ struct RootView : ui::View
                                    Span<f32x2> centers) override
   {
     fill(centers, f32x2{0, 0});
-    return ui::Layout{.extent = allocated, .viewport_extent = allocated};
+    return ui::Layout{
+      .extent          = allocated,
+      .viewport_extent = allocated,
+      .opaque          = CRect{.center = {}, .extent = allocated}
+    };
   }
 
   constexpr virtual i32 layer(i32, Span<i32> indices) override
@@ -78,15 +83,18 @@ enum class FocusAction : u8
   Backward = 2
 };
 
-// [ ] overlap culling; occlusion rects sent to views; quadtrees
+// [ ] partial occlusion rects sent to views
 // [ ] mouse displacement for transformed/distorted views
 // [ ] view click area re-targeting
 
-typedef struct IViewSys * ViewSys;
-
 /// @brief A compact View Hierarchy
-struct IViewSys
+/// @tparam I index type of the views. `u16` trees hold up to 65,535 views,
+/// `u32` trees are larger at twice the memory per index.
+template <typename I>
+struct IViewSysT
 {
+  static constexpr usize MAX_VIEWS = NumTraits<I>::MAX;
+
   struct DragState
   {
     enum Seq : u8
@@ -95,14 +103,14 @@ struct IViewSys
       Update = 1
     };
 
-    Seq         seq = Start;
-    Option<u16> src = none;
-    Option<u16> tgt = none;
+    Seq       seq = Start;
+    Option<I> src = none;
+    Option<I> tgt = none;
   };
 
   struct PointState
   {
-    Option<u16> tgt = none;
+    Option<I> tgt = none;
   };
 
   using HitState = Enum<None, DragState, PointState>;
@@ -112,7 +120,7 @@ struct IViewSys
     /// @brief If focusing is active
     bool active = false;
 
-    u16 tgt = 0;
+    I tgt = 0;
   };
 
   struct XFrameDragState
@@ -143,15 +151,15 @@ struct IViewSys
 
   /// @brief Flattened hierarchical tree node, all siblings are
   /// packed sequentially. This only represents the parent node. Since the tree is
-  /// rebuilt from scratch every time, the order is preserved in that parents
-  /// always come before children.
+  /// rebuilt from scratch whenever its structure changes, the order is
+  /// preserved in that parents always come before children.
   /// @param depth depth of the tree this node belongs to. there's ever only one
   /// node at depth 0: the root node.
   struct Nodes
   {
-    Vec<u16>     depth;
-    Vec<u16>     parent;
-    Vec<Slice16> children;
+    Vec<u16>          depth;
+    Vec<I>            parent;
+    Vec<CoreSlice<I>> children;
 
     Nodes(Allocator allocator) :
       depth{allocator},
@@ -162,10 +170,16 @@ struct IViewSys
   };
 
   /// View Attributes
+  /// @param tab_order depth-first order of the views, the tab index of views
+  /// that don't specify one
+  /// @param concealed if the view requested to be hidden. `hidden` also
+  /// includes the culled views and the descendants of concealed views.
   struct Attrs
   {
     Vec<i32>                   tab_idx;
-    Vec<u16>                   viewports;
+    Vec<i32>                   tab_order;
+    Vec<I>                     viewports;
+    BitVec<u64>                concealed;
     BitVec<u64>                hidden;
     BitVec<u64>                pointable;
     BitVec<u64>                clickable;
@@ -178,7 +192,9 @@ struct IViewSys
 
     Attrs(Allocator allocator) :
       tab_idx{allocator},
+      tab_order{allocator},
       viewports{allocator},
+      concealed{allocator},
       hidden{allocator},
       pointable{allocator},
       clickable{allocator},
@@ -194,12 +210,53 @@ struct IViewSys
 
   struct Event
   {
-    u16                    dst    = 0;
+    I                      dst    = 0;
     ui::Events::Type       type   = ui::Events::PointerIn;
     Option<ui::HitInfo>    hit    = none;
     Option<ui::ScrollInfo> scroll = none;
   };
 
+  /// @brief Uniform grid over the viewport indexing the visible views by the
+  /// cells their canvas regions overlap. The entries of a cell are the
+  /// z-order positions of its views in ascending order, so hit tests can stop
+  /// at the first hit from the top.
+  /// @param origin canvas-space top-left corner of the grid
+  /// @param dims number of cells along each axis
+  /// @param offsets range of each cell's entries, the entries of cell `c` are
+  /// `[offsets[c], offsets[c + 1])`
+  struct Grid
+  {
+    static constexpr f32 CELL_SIZE = 64;
+
+    f32x2    origin;
+    u32x2    dims;
+    Vec<u32> offsets;
+    Vec<u32> cursors;
+    Vec<I>   entries;
+
+    Grid(Allocator allocator) :
+      origin{},
+      dims{},
+      offsets{allocator},
+      cursors{allocator},
+      entries{allocator}
+    {
+    }
+  };
+
+  /// @brief State and children of a view ticked in-place, reused if the tree
+  /// has to be rebuilt on the same frame
+  /// @param changes changes to the view on this tick, the views that changed
+  /// nothing aren't damaged
+  struct Ticked
+  {
+    I         view     = 0;
+    ui::State state    = {};
+    Slice32   children = {};
+    bool      hot      = false;
+    ui::Dirty changes  = ui::Dirty::None;
+  };
+
   /// @brief Id to current frame's view tree index map of hot views
 
   RootView root_view;
@@ -217,27 +274,65 @@ struct IViewSys
 
   Vec<ref<ui::View>>       views;
   Nodes                    nodes;
-  BitDict<ui::ViewId, u16> ids;
+  BitDict<ui::ViewId, I>   ids;
 
   Attrs att;
 
   /// Computed data
 
+  /// @brief Extents allocated to the views by their parents, and the ones of
+  /// the previous layout
+  Vec<f32x2> allocated;
+  Vec<f32x2> prev_allocated;
+
   Vec<f32x2> extents;
   Vec<f32x2> centers;
   Vec<f32x2> viewport_extents;
   Vec<f32x2> viewport_centers;
   Vec<f32x2> viewport_zooms;
 
-  /// @brief If the view is at a fixed location in the viewport
-  BitVec<u64> fixed;
+  /// @brief If the view is at a fixed location in the viewport. Not packed,
+  /// so the views can be fit concurrently.
+  Vec<bool> fixed;
 
   /// @brief The viewport location of the views
   Vec<f32x2> fixed_centers;
 
+  /// @brief View-space opaque regions of the views, relative to their centers
+  Vec<CRect> opaque;
+
   Vec<i32> z_idx;
   Vec<i32> layers;
 
+  /// @brief The views ordered by depth. The views of depth `d` are
+  /// `depth_ord[depth_offsets[d]:depth_offsets[d + 1]]`, and only depend on
+  /// the views above or below them, so each level is laid out concurrently.
+  Vec<I>   depth_ord;
+  Vec<u32> depth_offsets;
+
+  /// @brief If the view is outside its viewport's clip
+  Vec<bool> culled;
+
+  /// Layout memoization. A view's `size` is only called if it is stale or its
+  /// allocated extent changed, and its `fit` only if its children's extents
+  /// changed as well. The views' previous layouts are otherwise reused.
+
+  /// @brief If the view changed in ways that affect its layout since the last
+  /// layout
+  BitVec<u64> stale;
+
+  /// @brief If the view's allocated extent changed on this layout
+  Vec<bool> resized;
+
+  /// @brief If the view was fit on this layout
+  Vec<bool> refit;
+
+  /// @brief If the view's extent changed on this layout
+  Vec<bool> reshaped;
+
+  /// @brief The stale or resized views, to be prefit on this layout
+  Vec<I> prefits;
+
   /// @brief Transforms from viewport-space to the canvas-space
   Vec<affinef32x3> canvas_xfm;
 
@@ -246,17 +341,54 @@ struct IViewSys
   Vec<f32x2>       canvas_centers;
   Vec<f32x2>       canvas_extents;
   Vec<CRect>       clips;
-  Vec<u16>         z_ord;
+  Vec<I>           z_ord;
+
+  /// @brief The views' packed (layer, z-index). The z-order is only sorted
+  /// again if they change or the tree is rebuilt.
+  Vec<u64> stacking;
+
+  /// @brief Radix sort keys of the z-order and the sort's scratch space
+  Vec<u64> z_keys;
+  Vec<u64> z_keys_tmp;
+  Vec<I>   z_ord_tmp;
+
+  /// @brief Clipped canvas-space regions of the views, empty if hidden
+  Vec<CRect> regions;
+
+  /// @brief If the view is fully covered by the opaque views above it
+  BitVec<u64> occluded;
+
+  Grid grid;
+
+  /// @brief Z-order positions of the views to be rendered
+  Vec<I> render_ord;
 
   // maps the focus tree index to the view
-  Vec<u16> focus_ord;
+  Vec<I> focus_ord;
 
   // maps the view to its focus index
-  Vec<u16> focus_idx;
+  Vec<I> focus_idx;
+
+  /// @brief Viewport extent the tree was last laid out with
+  f32x2 viewport_extent;
+
+  /// @brief Canvas-space bounds of the regions whose rendering changed on
+  /// this frame, none if the frame renders the same as the previous one
+  Option<CRect> damage;
+
+  /// Retained frame info
+
+  /// @brief Indices of the views to be ticked in-place: the dirty and hot
+  /// views, and the views that aren't retained
+  Vec<I> dirty;
+
+  BitDict<ui::ViewId, u32> ticked_ids;
+  Vec<Ticked>              ticked;
+  Vec<ref<ui::View>>       ticked_children;
 
   /// Frame Computed Info
-  bool        closing_deferred;
-  Option<u16> focus_grab_tgt;
+  bool      closing_deferred;
+  Option<I> focus_grab_tgt;
 
   XFrameHitState   xframe_hit_state;
   XFrameFocusState xframe_focus_state;
@@ -273,7 +405,7 @@ struct IViewSys
   Option<Cursor>        cursor;
   f32                   scroll_delta;
 
-  explicit IViewSys(Allocator allocator) :
+  explicit IViewSysT(Allocator allocator) :
     root_view{none},
     frame{0},
     next_id{0},
@@ -282,6 +414,8 @@ struct IViewSys
     nodes{allocator},
     ids{allocator},
     att{allocator},
+    allocated{allocator},
+    prev_allocated{allocator},
     extents{allocator},
     centers{allocator},
     viewport_extents{allocator},
@@ -289,13 +423,36 @@ struct IViewSys
     viewport_zooms{allocator},
     fixed{allocator},
     fixed_centers{allocator},
+    opaque{allocator},
     z_idx{allocator},
     layers{allocator},
+    depth_ord{allocator},
+    depth_offsets{allocator},
+    culled{allocator},
+    stale{allocator},
+    resized{allocator},
+    refit{allocator},
+    reshaped{allocator},
+    prefits{allocator},
     canvas_xfm{allocator},
     canvas_inv_xfm{allocator},
     z_ord{allocator},
+    stacking{allocator},
+    z_keys{allocator},
+    z_keys_tmp{allocator},
+    z_ord_tmp{allocator},
+    regions{allocator},
+    occluded{allocator},
+    grid{allocator},
+    render_ord{allocator},
     focus_ord{allocator},
     focus_idx{allocator},
+    viewport_extent{},
+    damage{none},
+    dirty{allocator},
+    ticked_ids{allocator},
+    ticked{allocator},
+    ticked_children{allocator},
     closing_deferred{false},
     focus_grab_tgt{none},
     xframe_hit_state{none},
@@ -310,43 +467,72 @@ struct IViewSys
   {
   }
 
-  IViewSys(IViewSys const &)             = delete;
-  IViewSys(IViewSys &&)                  = default;
-  IViewSys & operator=(IViewSys const &) = delete;
-  IViewSys & operator=(IViewSys &&)      = default;
-  ~IViewSys()                            = default;
+  IViewSysT(IViewSysT const &)             = delete;
+  IViewSysT(IViewSysT &&)                  = default;
+  IViewSysT & operator=(IViewSysT const &) = delete;
+  IViewSysT & operator=(IViewSysT &&)      = default;
+  ~IViewSysT()                             = default;
 
   void clear_frame();
 
-  void push_view(ui::View & view, u16 depth, u16 breadth, u16 parent);
+  void push_view(ui::View & view, u16 depth, I breadth, I parent);
 
-  ui::Events drain_events(ui::View & view, u16 idx);
+  ui::Events drain_events(ui::View & view, I idx);
 
-  void build_children(ui::Ctx const & ctx, ui::View & view, u16 idx, u16 depth,
-                      u16 viewport, i32 & tab_index);
+  void build_children(ui::Ctx const & ctx, ui::View & view, I idx, u16 depth,
+                      I viewport, i32 & tab_index);
 
   void build(ui::Ctx const & ctx, RootView & root);
 
-  void prepare_for(u16 n);
+  void set_state(I idx, ui::State const & s);
+
+  ui::Dirty retick(ui::Ctx const & ctx, I idx);
+
+  ui::Dirty tick_retained(ui::Ctx const & ctx);
+
+  void prepare_for(I n);
 
   void focus_order();
 
+  /// @brief Bucket the views by depth into `depth_ord`
+  void order_depths();
+
   void layout(f32x2 viewport_extent);
 
   void stack();
 
   void visibility();
 
+  /// @brief Index the visible views in the grid
+  void index();
+
+  /// @brief Mark the visible views fully covered by the opaque regions of the
+  /// views above them
+  void occlusion();
+
+  /// @brief Canvas-space region of the view within its viewport clip, empty if
+  /// hidden
+  CRect visible_region(I view) const;
+
+  void track_damage(ui::Dirty changes, bool relayout);
+
+  /// @brief Record the views overlapping the canvas' damaged region
   void render(Canvas & canvas);
 
-  void focus_on(u16 view, bool active, bool grab_focus);
+  void focus_on(I view, bool active, bool grab_focus);
+
+  /// @brief Find the top-most visible view containing the canvas-space
+  /// position using the grid
+  Option<I> hit_test(f32x2 position) const;
 
-  Option<u16> hit_test(f32x2 position) const;
+  /// @brief Find the top-most visible view containing the canvas-space
+  /// position by testing all the views
+  Option<I> scan_hit(f32x2 position) const;
 
-  ui::HitInfo get_hit_info(u16 view, f32x2 position) const;
+  ui::HitInfo get_hit_info(I view, f32x2 position) const;
 
   template <typename Match>
-  Option<u16> bubble(u16 from, Match && match) const
+  Option<I> bubble(I from, Match && match) const
   {
     auto current = from;
 
@@ -377,22 +563,21 @@ struct IViewSys
   }
 
   template <typename Match>
-  Option<u16> bubble_hit(f32x2 position, Match && match) const
+  Option<I> bubble_hit(f32x2 position, Match && match) const
   {
     return hit_test(position).and_then(
       [&](auto i) { return bubble(i, match); });
   }
 
-  u16 navigate_focus(u16 from, bool forward) const;
+  I navigate_focus(I from, bool forward) const;
 
   HitState none_seq(ui::Ctx const & ctx);
 
-  HitState drag_start_seq(ui::Ctx const & ctx, Option<u16> src);
+  HitState drag_start_seq(ui::Ctx const & ctx, Option<I> src);
 
-  HitState drag_update_seq(ui::Ctx const & ctx, Option<u16> src,
-                           Option<u16> tgt);
+  HitState drag_update_seq(ui::Ctx const & ctx, Option<I> src, Option<I> tgt);
 
-  HitState point_seq(ui::Ctx const & ctx, Option<u16> tgt);
+  HitState point_seq(ui::Ctx const & ctx, Option<I> tgt);
 
   void hit_seq(ui::Ctx const & ctx);
 
@@ -408,8 +593,28 @@ struct IViewSys
   Option<TextInputInfo> text_input() const;
 
   // [ ] make positions relative to center of the screen; especially in the inputstate goptten from the view
-  bool tick(InputState const & input, ui::View & root, Canvas & canvas,
+  /// @brief Tick, layout, and process the input of the view tree. The views
+  /// are recorded separately using `render`, and only if `damage` is set.
+  bool tick(InputState const & input, ui::View & root,
             Fn<void(ui::Ctx const &)> loop);
 };
 
+extern template struct IViewSysT<u16>;
+extern template struct IViewSysT<u32>;
+
+#if ASH_UI_U32_INDICES
+using ViewIdx = u32;
+#else
+using ViewIdx = u16;
+#endif
+
+typedef struct IViewSys * ViewSys;
+
+/// @brief The engine's view system, indexed by `ViewIdx`. Builds with
+/// `ASH_UI_U32_INDICES` support view trees of more than 65,535 views.
+struct IViewSys : IViewSysT<ViewIdx>
+{
+  using IViewSysT::IViewSysT;
+};
+
 }    // namespace ash
@@ -131,7 +131,16 @@ Layout Button::fit(f32x2, Span<f32x2 const> sizes, Span<f32x2> centers)
     padded.x = padded.y = max(padded.x, padded.y);
   }
 
-  return {.extent = padded};
+  // filled with an opaque tint in every state, the squircle's corners are
+  // not bounded by its radii
+  bool const opaque = style_.stroke == 0 &&
+                      style_.shape != ButtonShape::Squircle &&
+                      style_.color.w() == U8_MAX &&
+                      style_.hovered_color.w() == U8_MAX &&
+                      style_.disabled_color.w() == U8_MAX;
+
+  return {.extent = padded,
+          .opaque = opaque ? style_.corner_radii.inner(padded) : CRect{}};
 }
 
 void Button::render(Canvas & canvas, RenderInfo const & info)
@@ -110,14 +110,16 @@ struct TextButton : Button
     TextStyle const & style     = TextStyle{.color = theme.on_surface},
     FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                             .height      = theme.body_font_height,
-                                            .line_height = theme.line_height},
+                                            .line_height = theme.line_height,
+                                            .fallbacks   = theme.body_font_fallbacks},
     Allocator      allocator = default_allocator);
 
   TextButton(
     Str8 text, TextStyle const & style = TextStyle{.color = theme.on_surface},
     FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                             .height      = theme.body_font_height,
-                                            .line_height = theme.line_height},
+                                            .line_height = theme.line_height,
+                                            .fallbacks   = theme.body_font_fallbacks},
     Allocator      allocator = default_allocator);
 
   TextButton(TextButton const &)             = delete;
@@ -172,6 +172,8 @@ void TextComboItem::render(Canvas & canvas, RenderInfo const & info)
 
 Combo::Combo(Allocator allocator) : Flex{allocator}
 {
+  // state changes in `tick` are not reported
+  retained_ = false;
   Flex::axis(Axis::Y)
     .main_align(MainAlign::Start)
     .frame(Frame{}.rel(1, 1))
@@ -319,6 +321,20 @@ ui::State Combo::tick(Ctx const &, Events const &, Fn<void(View &)> build)
   return ui::State{};
 }
 
+Layout Combo::fit(f32x2 allocated, Span<f32x2 const> sizes,
+                  Span<f32x2> centers)
+{
+  Layout layout = Flex::fit(allocated, sizes, centers);
+
+  // the panel is filled with its color behind the items
+  if (style_.stroke == 0 && style_.color.w() == U8_MAX)
+  {
+    layout.opaque = style_.corner_radii.inner(layout.extent);
+  }
+
+  return layout;
+}
+
 void Combo::render(Canvas & canvas, RenderInfo const & info)
 {
   canvas.rrect({.area         = info.canvas_region,
@@ -78,14 +78,16 @@ struct TextComboItem : ComboItem
     Str32 text, TextStyle const & style = TextStyle{.color = theme.on_surface},
     FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                             .height      = theme.body_font_height,
-                                            .line_height = theme.line_height},
+                                            .line_height = theme.line_height,
+                                            .fallbacks   = theme.body_font_fallbacks},
     Allocator      allocator = default_allocator);
 
   TextComboItem(
     Str8 text, TextStyle const & style = TextStyle{.color = theme.on_surface},
     FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                             .height      = theme.body_font_height,
-                                            .line_height = theme.line_height},
+                                            .line_height = theme.line_height,
+                                            .fallbacks   = theme.body_font_fallbacks},
     Allocator      allocator = default_allocator);
 
   TextComboItem(TextComboItem const &)             = delete;
@@ -194,6 +196,9 @@ struct Combo : Flex
   virtual ui::State tick(Ctx const & ctx, Events const & events,
                          Fn<void(View &)> build) override;
 
+  virtual Layout fit(f32x2 allocated, Span<f32x2 const> sizes,
+                     Span<f32x2> centers) override;
+
   virtual void render(Canvas & canvas, RenderInfo const & info) override;
 };
 
@@ -10,41 +10,49 @@ namespace ui
 
 Flex::Flex(Allocator allocator) : items_{allocator}
 {
+  retained_   = true;
+  concurrent_ = true;
 }
 
 Flex & Flex::axis(Axis a)
 {
   style_.axis = a;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Flex & Flex::wrap(bool w)
 {
   style_.wrap = w;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Flex & Flex::main_align(MainAlign align)
 {
   style_.main_align = align;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Flex & Flex::cross_align(f32 align)
 {
   style_.cross_align = align;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Flex & Flex::frame(Frame f)
 {
   style_.frame = f;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Flex & Flex::item_frame(Frame f)
 {
   style_.item_frame = f;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
@@ -56,6 +64,7 @@ Flex & Flex::items(std::initializer_list<ref<View>> list)
 Flex & Flex::items(Span<ref<View> const> list)
 {
   items_.extend(list).unwrap();
+  mark_dirty(Dirty::Children);
   return *this;
 }
 
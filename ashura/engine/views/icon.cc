@@ -45,6 +45,11 @@ ui::State Icon::tick(Ctx const &, Events const &, Fn<void(View &)>)
   return ui::State{.hidden = state_.hidden};
 }
 
+void Icon::prefit(f32x2 allocated)
+{
+  text_.layout(allocated.x);
+}
+
 Layout Icon::fit(f32x2 allocated, Span<f32x2 const>, Span<f32x2>)
 {
   text_.layout(allocated.x);
@@ -49,6 +49,8 @@ struct Icon : View
   ui::State tick(Ctx const & ctx, Events const & events,
                  Fn<void(View &)> build) override;
 
+  virtual void prefit(f32x2 allocated) override;
+
   virtual Layout fit(f32x2 allocated, Span<f32x2 const> sizes,
                      Span<f32x2> centers) override;
 
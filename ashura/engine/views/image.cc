@@ -1,6 +1,8 @@
 /// SPDX-License-Identifier: MIT
 #include "ashura/engine/views/image.h"
 #include "ashura/engine/engine.h"
+#include "ashura/engine/image_system.h"
+#include "ashura/engine/systems.h"
 
 namespace ash
 {
@@ -59,6 +61,8 @@ Image & Image::align(f32x2 a)
 
 ui::State Image::tick(Ctx const &, Events const &, Fn<void(View &)>)
 {
+  bool const pending = state_.resolved.is(0);
+
   state_.resolved.match(
     [&](None) {
       src_.match(
@@ -80,6 +84,12 @@ ui::State Image::tick(Ctx const &, Events const &, Fn<void(View &)>)
 
   src_ = none;
 
+  // the resolved image's extent determines the view's extent
+  if (pending && !state_.resolved.is(0))
+  {
+    mark_dirty(Dirty::Layout);
+  }
+
   return ui::State{};
 }
 
@@ -145,6 +155,9 @@ static void render_image(Canvas & canvas, CRect const & region,
     .uv{uv0,                    uv1   },
     .clip = clip
   });
+
+  // request the mip level needed for the number of texels actually displayed
+  sys.image->stream(img.id, extent / (uv1 - uv0));
 }
 
 void Image::render(Canvas & canvas, RenderInfo const & info)
@@ -196,11 +196,17 @@ ui::State Input::tick(Ctx const & ctx, Events const & events, Fn<void(View &)>)
   };
 }
 
+void Input::prefit(f32x2 allocated)
+{
+  content_.layout(allocated.x);
+  stub_.layout(allocated.x);
+}
+
 Layout Input::fit(f32x2 allocated, Span<f32x2 const>, Span<f32x2>)
 {
   content_.layout(allocated.x);
   stub_.layout(allocated.x);
-  if (content_.text_.is_empty())
+  if (content_.size() == 0)
   {
     return {.extent = stub_.layout_.extent};
   }
@@ -209,7 +215,7 @@ Layout Input::fit(f32x2 allocated, Span<f32x2 const>, Span<f32x2>)
 
 void Input::render(Canvas & canvas, RenderInfo const & info)
 {
-  if (content_.text_.is_empty())
+  if (content_.size() == 0)
   {
     // [ ] placeholder overlay when empty. use child view instead
     stub_.render(canvas.text_renderer(), info.viewport_region.center,
@@ -79,14 +79,16 @@ struct Input : View
         TextStyle const & style     = TextStyle{.color = theme.on_surface},
         FontStyle const & font      = FontStyle{.font   = theme.body_font,
                                                 .height = theme.body_font_height,
-                                                .line_height = theme.line_height},
+                                                .line_height = theme.line_height,
+                                                .fallbacks   = theme.body_font_fallbacks},
         Allocator      allocator = default_allocator);
 
   Input(Str8              stub,
         TextStyle const & style     = TextStyle{.color = theme.on_surface},
         FontStyle const & font      = FontStyle{.font   = theme.body_font,
                                                 .height = theme.body_font_height,
-                                                .line_height = theme.line_height},
+                                                .line_height = theme.line_height,
+                                                .fallbacks   = theme.body_font_fallbacks},
         Allocator      allocator = default_allocator);
 
   Input(Input const &)             = delete;
@@ -128,6 +130,8 @@ struct Input : View
   virtual ui::State tick(Ctx const & ctx, Events const & events,
                          Fn<void(View &)> build) override;
 
+  virtual void prefit(f32x2 allocated) override;
+
   virtual Layout fit(f32x2 allocated, Span<f32x2 const>, Span<f32x2>) override;
 
   virtual void render(Canvas & canvas, RenderInfo const & info) override;
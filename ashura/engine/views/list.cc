@@ -8,83 +8,336 @@ namespace ash
 namespace ui
 {
 
+/// @brief Smallest capacity of the extent trees
+static constexpr usize MIN_ITEM_EXTENTS = 64;
+
+ItemExtents::ItemExtents(Allocator allocator) :
+  extents_{allocator},
+  sums_{allocator},
+  counts_{allocator}
+{
+}
+
+usize ItemExtents::capacity() const
+{
+  return extents_.size();
+}
+
+f32 ItemExtents::estimate() const
+{
+  if (num_measured_ == 0)
+  {
+    return fallback_;
+  }
+  return max((f32) (total_ / (f64) num_measured_), 1.0F);
+}
+
+void ItemExtents::clear()
+{
+  extents_.clear();
+  sums_.clear();
+  counts_.clear();
+  total_        = 0;
+  num_measured_ = 0;
+}
+
+void ItemExtents::measure(usize i, f32 extent)
+{
+  extent = max(extent, 0.0F);
+
+  if (i >= capacity())
+  {
+    // grow and rebuild the trees bottom-up in O(n), the capacity doubles so
+    // the rebuilds are amortized over the measurements
+    usize const old_capacity = capacity();
+    usize const new_capacity = max(std::bit_ceil(i + 1), MIN_ITEM_EXTENTS);
+    extents_.resize_uninit(new_capacity).unwrap();
+    fill(extents_.view().slice(old_capacity), -1.0F);
+    sums_.resize_uninit(new_capacity + 1).unwrap();
+    counts_.resize_uninit(new_capacity + 1).unwrap();
+    sums_[0]   = 0;
+    counts_[0] = 0;
+
+    for (usize j = 0; j < new_capacity; j++)
+    {
+      bool const measured = extents_[j] >= 0;
+      sums_[j + 1]        = measured ? extents_[j] : 0.0;
+      counts_[j + 1]      = measured ? 1 : 0;
+    }
+
+    for (usize j = 1; j <= new_capacity; j++)
+    {
+      usize const parent = j + (j & (~j + 1));
+      if (parent <= new_capacity)
+      {
+        sums_[parent] += sums_[j];
+        counts_[parent] += counts_[j];
+      }
+    }
+  }
+
+  f32 const previous = extents_[i];
+
+  if (previous == extent)
+  {
+    return;
+  }
+
+  bool const measured = previous >= 0;
+  f64 const  delta    = measured ? (f64) (extent - previous) : (f64) extent;
+  u32 const  count    = measured ? 0 : 1;
+
+  for (usize j = i + 1; j <= capacity(); j += j & (~j + 1))
+  {
+    sums_[j] += delta;
+    counts_[j] += count;
+  }
+
+  extents_[i] = extent;
+  total_ += delta;
+  num_measured_ += count;
+}
+
+f64 ItemExtents::offset(usize i) const
+{
+  f64   sum   = 0;
+  usize count = 0;
+
+  for (usize j = min(i, capacity()); j != 0; j &= j - 1)
+  {
+    sum += sums_[j];
+    count += counts_[j];
+  }
+
+  return sum + (f64) (i - count) * (f64) estimate();
+}
+
+usize ItemExtents::at(f64 offset) const
+{
+  if (offset <= 0)
+  {
+    return 0;
+  }
+
+  f64 const estimate = this->estimate();
+  usize     pos      = 0;
+  f64       acc      = 0;
+
+  // binary lifting: each step checks if the whole node following `pos` fits
+  // within `offset`
+  for (usize step = capacity(); step != 0; step >>= 1)
+  {
+    usize const next = pos + step;
+    if (next > capacity())
+    {
+      continue;
+    }
+    f64 const extent = sums_[next] + (f64) (step - counts_[next]) * estimate;
+    if (acc + extent <= offset)
+    {
+      pos = next;
+      acc += extent;
+    }
+  }
+
+  // past the trees, the items are all estimated
+  if (pos == capacity())
+  {
+    pos += (usize) ((offset - acc) / estimate);
+  }
+
+  return pos;
+}
+
 List::List(Generator generator, Allocator allocator) :
-  state_{.generator = generator, .items{allocator}},
+  state_{.generator = generator,
+         .extents   = ItemExtents{allocator},
+         .items{allocator},
+         .pool{allocator},
+         .dropped{allocator},
+         .expired{allocator}},
   allocator_{allocator}
 {
+  retained_ = true;
 }
 
-List & List::generator(Generator generator)
+void List::reset()
 {
-  state_.total_translation = 0;
-  state_.view_extent       = 0;
-  state_.first_item        = 0;
-  state_.max_count         = USIZE_MAX;
-  state_.num_loaded        = 0;
-  state_.item_size         = none;
-  state_.generator         = generator;
+  state_.scroll     = 0;
+  state_.origin     = 0;
+  state_.first_item = 0;
+  state_.max_count  = USIZE_MAX;
+  state_.extents.clear();
+
+  for (Dyn<View *> & item : state_.items)
+  {
+    drop(std::move(item));
+  }
+
+  for (Dyn<View *> & item : state_.pool)
+  {
+    drop(std::move(item));
+  }
+
   state_.items.clear();
+  state_.pool.clear();
+}
+
+void List::drop(Dyn<View *> item)
+{
+  state_.dropped.push(std::move(item)).unwrap();
+}
+
+List & List::generator(Generator generator)
+{
+  reset();
+  state_.generator = generator;
+  mark_dirty(Dirty::Children);
+  return *this;
+}
+
+List & List::recycler(Recycler recycler)
+{
+  state_.recycler = recycler;
+
+  for (Dyn<View *> & item : state_.pool)
+  {
+    drop(std::move(item));
+  }
+
+  state_.pool.clear();
+  mark_dirty(Dirty::State);
   return *this;
 }
 
 List & List::axis(Axis axis)
 {
   style_.axis = axis;
+  state_.extents.clear();
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 List & List::frame(Frame frame)
 {
   style_.frame = frame;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 List & List::item_frame(Frame frame)
 {
   style_.item_frame = frame;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
-ui::State List::tick(Ctx const &, Events const & events, Fn<void(View &)> build)
+void List::load(Slice visible)
 {
-  u32 const axis = style_.axis == Axis::X ? 0 : 1;
+  Slice const loaded = state_.range();
+  Slice const kept =
+    Slice::range(clamp(visible.begin(), loaded.begin(), loaded.end()),
+                 clamp(visible.end(), loaded.begin(), loaded.end()));
 
-  if (events.scroll())
+  // pool the item views scrolled out of the viewport, or release them
+  for (usize i = loaded.begin(); i < loaded.end(); i++)
   {
-    auto info                = events.scroll_info.unwrap();
-    state_.total_translation = info.center[axis];
+    if (kept.contains(i))
+    {
+      continue;
+    }
+
+    Dyn<View *> & item = state_.items[i - loaded.begin()];
+
+    if (state_.recycler.is_some() && state_.pool.size() < loaded.span)
+    {
+      state_.pool.push(std::move(item)).unwrap();
+    }
+    else
+    {
+      drop(std::move(item));
+    }
   }
 
-  Slice visible = state_.visible().unwrap_or(Slice{0, 1})(state_.max_count);
+  state_.items.erase(kept.end() - loaded.begin(), loaded.end() - kept.end());
+  state_.items.erase(0, kept.begin() - loaded.begin());
 
-  if (visible != state_.range())
+  auto make = [&](usize i) -> Option<Dyn<View *>> {
+    if (state_.recycler.is_none() || state_.pool.is_empty())
+    {
+      return state_.generator(allocator_, i);
+    }
+
+    Dyn<View *> item = std::move(state_.pool.last());
+    state_.pool.pop();
+
+    if (!state_.recycler.v()(*item, i))
+    {
+      state_.pool.push(std::move(item)).unwrap();
+      return none;
+    }
+
+    // the recycled view is bound to a different item
+    item->mark_dirty(Dirty::Layout);
+    return item;
+  };
+
+  usize const front = kept.is_empty() ? visible.end() : kept.begin();
+  usize const back  = kept.is_empty() ? visible.begin() : kept.end();
+
+  state_.first_item = front;
+
+  // the items scrolled in before the kept ones
+  for (usize i = front; i > visible.begin(); i--)
   {
-    auto old_range = state_.range();
-    auto i         = visible.begin();
+    Option<Dyn<View *>> item = make(i - 1);
+    if (item.is_none())
+    {
+      break;
+    }
+    state_.items.insert(0, item.unwrap()).unwrap();
+    state_.first_item = i - 1;
+  }
 
-    for (; i < visible.end(); i++)
+  // the items scrolled in after the kept ones
+  for (usize i = back; i < visible.end(); i++)
+  {
+    Option<Dyn<View *>> item = make(i);
+    if (item.is_none())
     {
-      if (old_range.contains(i))
-      {
-        state_.items.push(std::move(state_.items[i])).unwrap();
-      }
-      else
-      {
-        if (auto item = state_.generator(allocator_, i); item.is_some())
-        {
-          state_.items.push(item.unwrap()).unwrap();
-        }
-        else
-        {
-          state_.max_count = i;
-          break;
-        }
-      }
+      state_.max_count = i;
+      break;
     }
+    state_.items.push(item.unwrap()).unwrap();
+  }
+}
+
+ui::State List::tick(Ctx const &, Events const & events, Fn<void(View &)> build)
+{
+  u32 const axis = style_.axis == Axis::X ? 0 : 1;
+
+  // the views dropped before the last tick were not built by it, so the view
+  // tree no longer references them
+  state_.expired.clear();
+  swap(state_.expired, state_.dropped);
 
-    state_.items.erase(0, old_range.span);
-    state_.first_item = visible.begin();
-    state_.num_loaded = max(state_.range().end(), state_.num_loaded);
+  if (events.scroll())
+  {
+    auto info = events.scroll_info.unwrap();
+    state_.scroll =
+      state_.origin + info.center[axis] - 0.5 * state_.view_extent;
+    mark_dirty(Dirty::Layout);
+  }
+
+  state_.scroll =
+    clamp(state_.scroll, 0.0, max(state_.extent() - state_.view_extent, 0.0));
+
+  Slice const visible = state_.visible();
+
+  if (visible != state_.range())
+  {
+    load(visible);
+    mark_dirty(Dirty::Children);
   }
 
   // [ ] ScrollBar: NEED TO GET SIZE INFO
@@ -99,7 +352,10 @@ ui::State List::tick(Ctx const &, Events const & events, Fn<void(View &)> build)
 
 void List::size(f32x2 allocated, Span<f32x2> sizes)
 {
-  fill(sizes, style_.item_frame(style_.frame(allocated)));
+  u32 const   axis = style_.axis == Axis::X ? 0 : 1;
+  f32x2 const item = style_.item_frame(style_.frame(allocated));
+  state_.extents.fallback_ = max(item[axis], 1.0F);
+  fill(sizes, item);
 }
 
 Layout List::fit(f32x2 allocated, Span<f32x2 const> sizes, Span<f32x2> centers)
@@ -109,40 +365,45 @@ Layout List::fit(f32x2 allocated, Span<f32x2 const> sizes, Span<f32x2> centers)
   u32 const axis       = style_.axis == Axis::X ? 0 : 1;
   u32 const cross_axis = style_.axis == Axis::X ? 1 : 0;
 
-  // Calculate total extent along main axis
-  for (auto const size : sizes)
+  // the loaded items are measured as they are laid out, the items are then
+  // positioned relative to the first one
+  for (usize i = 0; i < sizes.size(); i++)
   {
-    extent[cross_axis] = max(extent[cross_axis], size[cross_axis]);
-    extent[axis] += size[axis];
+    state_.extents.measure(state_.first_item + i, sizes[i][axis]);
   }
 
-  // Position items along main axis with translation
-  auto first_item_offset = state_.first_item * state_.item_size.unwrap_or();
+  state_.origin      = state_.extents.offset(state_.first_item);
+  state_.view_extent = frame[axis];
 
-  f32 cursor = -0.5F * extent[axis];
-  cursor += state_.total_translation;
-  cursor -= first_item_offset;
+  f32 cursor = 0;
 
   for (auto [center, size] : zip(centers, sizes))
   {
     center[axis]       = cursor + size[axis] * 0.5F;
     center[cross_axis] = 0;
     cursor += size[axis];
+    extent[cross_axis] = max(extent[cross_axis], size[cross_axis]);
   }
 
-  if (!sizes.is_empty())
+  extent[axis] = (f32) state_.extent();
+
+  // the measurements or the viewport changed the items within the viewport,
+  // load them and lay them out on the next frame
+  if (state_.visible() != state_.range())
   {
-    state_.item_size = sizes[0][axis];
+    mark_dirty(Dirty::Layout);
   }
 
-  state_.view_extent = frame[axis];
+  f32x2 center = {};
+  center[axis] = (f32) (state_.scroll - state_.origin) + 0.5F * frame[axis];
 
   return {
     .extent          = frame,
     .viewport_extent = extent,
-    .viewport_center = {-state_.total_translation, 0}
+    .viewport_center = center
   };
 }
+
 }    // namespace ui
 
 }    // namespace ash
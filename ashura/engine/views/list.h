@@ -3,6 +3,7 @@
 
 #include "ashura/engine/view.h"
 #include "ashura/std/types.h"
+#include "ashura/std/vec.h"
 
 namespace ash
 {
@@ -10,20 +11,77 @@ namespace ash
 namespace ui
 {
 
-// [ ] segmentation
-// [ ] measure function
-/// @brief An infinitely scrollable List of elements.
+/// @brief Extents of the items of a virtualized list along its main axis.
+/// Items that haven't been measured yet are estimated at the average extent of
+/// the measured ones. The measured extents and the number of measured items are
+/// kept in Fenwick trees, so the offset of an item and the item at an offset
+/// are found in O(log n) for any mix of item extents.
+struct ItemExtents
+{
+  /// @brief Measured extent of each item, negative if not yet measured
+  Vec<f32> extents_;
+
+  /// @brief Fenwick tree of the measured extents, 1-indexed
+  Vec<f64> sums_;
+
+  /// @brief Fenwick tree of the number of measured items, 1-indexed
+  Vec<u32> counts_;
+
+  /// @brief Sum of the measured extents
+  f64 total_ = 0;
+
+  /// @brief Number of measured items
+  usize num_measured_ = 0;
+
+  /// @brief Estimated extent of the items when none has been measured
+  f32 fallback_ = 1;
+
+  explicit ItemExtents(Allocator allocator);
+
+  /// @brief Number of items the trees can hold, always a power of 2
+  usize capacity() const;
+
+  /// @brief Estimated extent of an unmeasured item
+  f32 estimate() const;
+
+  /// @brief Forget all the measurements
+  void clear();
+
+  /// @brief Record the measured extent of item `i`
+  void measure(usize i, f32 extent);
+
+  /// @brief Offset of the start of item `i` along the axis
+  f64 offset(usize i) const;
+
+  /// @brief Index of the item spanning `offset`
+  usize at(f64 offset) const;
+};
+
+/// @brief An infinitely scrollable List of elements with variable extents.
+/// Only the items within the viewport are generated and laid out. Their
+/// extents are measured as they are laid out, and the item views scrolled out
+/// of the viewport are kept in a pool and re-bound to the items scrolled in,
+/// so the cost per frame depends on the viewport and not on the item count.
 struct List : View
 {
   typedef Fn<Option<Dyn<View *>>(Allocator, usize i)> Generator;
 
+  /// @brief Re-binds a recycled item view to item `i`, returns false if there
+  /// is no item `i`
+  typedef Fn<bool(View &, usize i)> Recycler;
+
   static constexpr auto DEFAULT_GENERATOR =
     [](Allocator, usize) -> Option<Dyn<View *>> { return none; };
 
   struct State
   {
-    /// @brief Effective translation of the entire list
-    f32 total_translation = 0;
+    /// @brief Offset of the start of the viewport along the axis
+    f64 scroll = 0;
+
+    /// @brief Offset along the axis the item centers of the last layout are
+    /// relative to. The items are positioned relative to the first loaded item
+    /// so the centers stay precise for very long lists
+    f64 origin = 0;
 
     /// @brief The view extent of the viewport
     f32 view_extent = 0;
@@ -34,28 +92,52 @@ struct List : View
     /// @brief Determined upper bound
     usize max_count = USIZE_MAX;
 
-    usize num_loaded = 0;
-
-    Option<f32> item_size = none;
-
     /// @brief The item generator
     Generator generator = DEFAULT_GENERATOR;
 
+    /// @brief Re-binds the pooled item views, the views are not recycled if
+    /// none
+    Option<Recycler> recycler = none;
+
+    ItemExtents extents;
+
     Vec<Dyn<View *>> items;
 
+    /// @brief The item views scrolled out of the viewport, waiting to be
+    /// re-bound to other items
+    Vec<Dyn<View *>> pool;
+
+    /// @brief The item views dropped since the last tick. The view tree built
+    /// before they were dropped can still reference them, so they are only
+    /// released once a tick has rebuilt the tree without them.
+    Vec<Dyn<View *>> dropped;
+
+    /// @brief The item views dropped before the last tick, released on the
+    /// next tick
+    Vec<Dyn<View *>> expired;
+
     Slice range() const
     {
       return Slice{first_item, items.size()};
     }
 
-    Option<Slice> visible() const
+    /// @brief The items within the viewport
+    Slice visible() const
     {
-      return item_size.map([&](f32 s) {
-        auto first =
-          static_cast<usize>(std::abs(std::floor((-total_translation) / s)));
-        auto count = static_cast<usize>(std::abs(std::ceil(view_extent / s)));
-        return Slice{first, count};
-      });
+      usize const first = extents.at(scroll);
+      usize const last  = extents.at(scroll + view_extent);
+      return Slice::range(first, last + 1)(max_count);
+    }
+
+    /// @brief Extent of the entire list along the axis, estimated from the
+    /// loaded items if the item count isn't known yet
+    f64 extent() const
+    {
+      if (max_count != USIZE_MAX)
+      {
+        return extents.offset(max_count);
+      }
+      return extents.offset(range().end()) + view_extent;
     }
 
   } state_;
@@ -71,11 +153,15 @@ struct List : View
 
   Allocator allocator_;
 
-  List(Generator    generator = DEFAULT_GENERATOR,
+  List(Generator generator = DEFAULT_GENERATOR,
        Allocator allocator = default_allocator);
 
   List & generator(Generator generator);
 
+  /// @brief Recycle the item views scrolled out of the viewport, `recycler`
+  /// re-binds them to the items scrolled in instead of generating new views
+  List & recycler(Recycler recycler);
+
   List & axis(Axis axis);
 
   List & frame(Frame frame);
@@ -89,6 +175,16 @@ struct List : View
 
   virtual Layout fit(f32x2 allocated, Span<f32x2 const> sizes,
                      Span<f32x2> centers) override;
+
+  /// @brief Drop the items, their views, and the measurements
+  void reset();
+
+  /// @brief Release the item view once the view tree can no longer reference
+  /// it
+  void drop(Dyn<View *> item);
+
+  /// @brief Load the items in `visible`, keeping the loaded ones
+  void load(Slice visible);
 };
 
 }    // namespace ui
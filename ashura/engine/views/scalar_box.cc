@@ -89,7 +89,11 @@ ui::State ScalarDragBox::tick(Ctx const & ctx, Events const & events,
   }
   else if (input_.state_.editing)
   {
-    scalar_parse(input_.content_.get_text(), state_.spec, state_.scalar);
+    u8                buffer[512];
+    FallbackAllocator allocator{Arena::from(buffer), default_allocator};
+    Vec<c32>          text{allocator};
+    input_.content_.get_text(text);
+    scalar_parse(text, state_.spec, state_.scalar);
     cb.update(state_.scalar);
   }
 
@@ -162,6 +166,8 @@ ScalarBox::ScalarBox(Str32 decrease_text, Str32 increase_text,
   inc_{increase_text, button_text_style, icon_font, allocator},
   drag_{drag_text_style, text_font, allocator}
 {
+  // state changes in `tick` are not reported
+  retained_ = false;
   Flex::axis(Axis::X)
     .wrap(false)
     .main_align(MainAlign::Start)
@@ -141,7 +141,8 @@ struct ScalarDragBox : View
     TextStyle const & style     = TextStyle{.color = theme.on_surface},
     FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                             .height      = theme.body_font_height,
-                                            .line_height = theme.line_height},
+                                            .line_height = theme.line_height,
+                                            .fallbacks   = theme.body_font_fallbacks},
     Allocator      allocator = default_allocator);
 
   ScalarDragBox(ScalarDragBox const &)             = delete;
@@ -192,7 +193,8 @@ struct ScalarBox : Flex
                                                     .line_height = theme.line_height},
     FontStyle const & text_font         = FontStyle{.font   = theme.body_font,
                                                     .height = theme.body_font_height,
-                                                    .line_height = theme.line_height},
+                                                    .line_height = theme.line_height,
+                                                    .fallbacks   = theme.body_font_fallbacks},
     Allocator      allocator         = default_allocator);
 
   ScalarBox(ScalarBox const &)             = delete;
@@ -8,9 +8,16 @@ namespace ash
 namespace ui
 {
 
+Space::Space()
+{
+  retained_   = true;
+  concurrent_ = true;
+}
+
 Space & Space::frame(Frame frame)
 {
   style_.frame = frame;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
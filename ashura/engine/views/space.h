@@ -17,7 +17,7 @@ struct Space : View
     Frame frame{};
   } style_;
 
-  Space()                          = default;
+  Space();
   Space(Space const &)             = delete;
   Space(Space &&)                  = default;
   Space & operator=(Space const &) = delete;
@@ -10,23 +10,28 @@ namespace ui
 
 Stack::Stack(Allocator allocator) : items_{allocator}
 {
+  retained_   = true;
+  concurrent_ = true;
 }
 
 Stack & Stack::reverse(bool r)
 {
   style_.reverse = r;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Stack & Stack::align(f32x2 a)
 {
   style_.alignment = a;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Stack & Stack::frame(Frame f)
 {
   style_.frame = f;
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
@@ -39,6 +44,7 @@ Stack & Stack::items(std::initializer_list<ref<View>> list)
 Stack & Stack::items(Span<ref<View> const> list)
 {
   items_.extend(span(list)).unwrap();
+  mark_dirty(Dirty::Children);
   return *this;
 }
 
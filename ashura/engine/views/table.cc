@@ -1,6 +1,7 @@
 /// SPDX-License-Identifier: MIT
 #include "ashura/engine/views/table.h"
 #include "ashura/engine/engine.h"
+#include "ashura/std/sformat.h"
 
 namespace ash
 {
@@ -8,6 +9,627 @@ namespace ash
 namespace ui
 {
 
+namespace df = experimental::df;
+
+/// @brief Index of the component holding the slices of the sliced types
+static constexpr u64 SLICES_INDEX = df::ArrayInfo::NULL_MASK_INDEX + 1;
+
+/// @brief Capacity of the inline buffer the cells are formatted into
+static constexpr usize CELL_BUFFER_SIZE = 256;
+
+static bool is_null(df::ArrayInfo const & column, u64 row)
+{
+  if (column.num_components <= df::ArrayInfo::NULL_MASK_INDEX ||
+      column.components == nullptr)
+  {
+    return false;
+  }
+
+  df::ArrayInfo const * mask =
+    column.components[df::ArrayInfo::NULL_MASK_INDEX];
+
+  if (mask == nullptr || mask->data == nullptr)
+  {
+    return false;
+  }
+
+  u64 const * bits = reinterpret_cast<u64 const *>(mask->data);
+  return (bits[row >> 6] >> (row & 63)) & 1;
+}
+
+static u64 load_uint(df::ArrayInfo const & column, u64 row)
+{
+  switch (column.bit_size)
+  {
+    case 1:
+      return (reinterpret_cast<u64 const *>(column.data)[row >> 6] >>
+              (row & 63)) &
+             1;
+    case 8:
+      return reinterpret_cast<u8 const *>(column.data)[row];
+    case 16:
+      return reinterpret_cast<u16 const *>(column.data)[row];
+    case 32:
+      return reinterpret_cast<u32 const *>(column.data)[row];
+    case 64:
+      return reinterpret_cast<u64 const *>(column.data)[row];
+    default:
+      return 0;
+  }
+}
+
+static i64 load_int(df::ArrayInfo const & column, u64 row)
+{
+  switch (column.bit_size)
+  {
+    case 8:
+      return reinterpret_cast<i8 const *>(column.data)[row];
+    case 16:
+      return reinterpret_cast<i16 const *>(column.data)[row];
+    case 32:
+      return reinterpret_cast<i32 const *>(column.data)[row];
+    case 64:
+      return reinterpret_cast<i64 const *>(column.data)[row];
+    default:
+      return 0;
+  }
+}
+
+static f64 load_float(df::ArrayInfo const & column, u64 row)
+{
+  switch (column.bit_size)
+  {
+    case 32:
+      return reinterpret_cast<f32 const *>(column.data)[row];
+    case 64:
+      return reinterpret_cast<f64 const *>(column.data)[row];
+    default:
+      return 0;
+  }
+}
+
+static Str8 load_utf8(df::ArrayInfo const & column, u64 row)
+{
+  c8 const * data = reinterpret_cast<c8 const *>(column.data);
+
+  if (column.slicing == df::Slicing::None)
+  {
+    u64 const size = column.bit_size / 8;
+    return Str8{data + row * size, size};
+  }
+
+  if (column.num_components <= SLICES_INDEX || column.components == nullptr ||
+      column.components[SLICES_INDEX] == nullptr)
+  {
+    return Str8{};
+  }
+
+  u64 const * slices =
+    reinterpret_cast<u64 const *>(column.components[SLICES_INDEX]->data);
+
+  switch (column.slicing)
+  {
+    case df::Slicing::Segments:
+      return Str8{data + slices[row * 2], slices[row * 2 + 1]};
+    case df::Slicing::Runs:
+      return Str8{data + slices[row], slices[row + 1] - slices[row]};
+    default:
+      return Str8{};
+  }
+}
+
+void format_cell(df::ArrayInfo const & column, u64 row, Vec<c8> & text)
+{
+  if (is_null(column, row))
+  {
+    return;
+  }
+
+  auto append = [&](auto value) {
+    snformat<32>("{}"_str, value)
+      .match([&](auto & str) { text.extend(str.view().as_c8()).unwrap(); },
+             [](auto &) {});
+  };
+
+  switch (column.type)
+  {
+    case df::Type::Bool:
+      text.extend(load_uint(column, row) != 0 ? u8"true"_str : u8"false"_str)
+        .unwrap();
+      break;
+    case df::Type::Uint:
+      append(load_uint(column, row));
+      break;
+    case df::Type::Int:
+      append(load_int(column, row));
+      break;
+    case df::Type::Float:
+      append(load_float(column, row));
+      break;
+    case df::Type::Utf8:
+      text.extend(load_utf8(column, row)).unwrap();
+      break;
+    default:
+      break;
+  }
+}
+
+bool cell_less(df::ArrayInfo const & column, u64 a, u64 b)
+{
+  bool const a_null = is_null(column, a);
+  bool const b_null = is_null(column, b);
+
+  if (a_null || b_null)
+  {
+    return a_null && !b_null;
+  }
+
+  switch (column.type)
+  {
+    case df::Type::Bool:
+    case df::Type::Uint:
+      return load_uint(column, a) < load_uint(column, b);
+    case df::Type::Int:
+      return load_int(column, a) < load_int(column, b);
+    case df::Type::Float:
+      return load_float(column, a) < load_float(column, b);
+    case df::Type::Utf8:
+    {
+      Str8 const  x = load_utf8(column, a);
+      Str8 const  y = load_utf8(column, b);
+      usize const n = min(x.size(), y.size());
+      for (usize i = 0; i < n; i++)
+      {
+        if (x[i] != y[i])
+        {
+          return (u8) x[i] < (u8) y[i];
+        }
+      }
+      return x.size() < y.size();
+    }
+    default:
+      return false;
+  }
+}
+
+/// @brief Index of the column spanning `offset`, the last column if past the
+/// end
+static u64 column_at(Span<f64 const> offsets, f64 offset)
+{
+  u64 first = 0;
+  u64 last  = offsets.size() - 1;
+
+  while (last - first > 1)
+  {
+    u64 const mid = first + (last - first) / 2;
+    if (offsets[mid] <= offset)
+    {
+      first = mid;
+    }
+    else
+    {
+      last = mid;
+    }
+  }
+
+  return first;
+}
+
+Slice64 Table::State::visible_rows(f32 row_extent) const
+{
+  if (row_extent <= 0)
+  {
+    return Slice64{};
+  }
+
+  u64 const first = (u64) (scroll[1] / row_extent);
+  u64 const last  = (u64) ((scroll[1] + view_extent[1]) / row_extent);
+  return Slice64::range(first, last + 1)(size());
+}
+
+Slice64 Table::State::visible_columns() const
+{
+  if (columns.is_empty())
+  {
+    return Slice64{};
+  }
+
+  u64 const first = column_at(column_offsets.view(), scroll[0]);
+  u64 const last =
+    column_at(column_offsets.view(), scroll[0] + view_extent[0]);
+  return Slice64::range(first, last + 1);
+}
+
+/// @brief Materialize the display order of the rows so it can be permuted
+static void permute(Table::State & state)
+{
+  if (state.permuted)
+  {
+    return;
+  }
+  state.rows.resize_uninit(state.num_rows).unwrap();
+  iota(state.rows.view(), (u64) 0);
+  state.permuted = true;
+}
+
+Table::Table(Allocator allocator) :
+  state_{.rows{allocator},
+         .column_offsets{allocator},
+         .cells{allocator},
+         .header_texts{allocator}},
+  allocator_{allocator}
+{
+  retained_ = true;
+  state_.column_offsets.push(0.0).unwrap();
+}
+
+Table & Table::columns(Span<Column const> columns, Span<Str8 const> headers)
+{
+  state_.columns  = columns;
+  state_.headers  = headers;
+  state_.num_rows = columns.is_empty() ? 0 : U64_MAX;
+
+  for (Column const & column : columns)
+  {
+    state_.num_rows = min(state_.num_rows, column.size);
+  }
+
+  state_.column_offsets.resize_uninit(columns.size() + 1).unwrap();
+
+  for (usize c = 0; c <= columns.size(); c++)
+  {
+    state_.column_offsets[c] = (f64) c * (f64) style_.column_extent;
+  }
+
+  state_.header_texts.clear();
+
+  for (usize c = 0; c < columns.size(); c++)
+  {
+    state_.header_texts.push(allocator_).unwrap();
+  }
+
+  state_.scroll = {};
+  state_.origin = {};
+  return reset_rows();
+}
+
+Table & Table::formatter(Formatter formatter)
+{
+  state_.formatter = formatter;
+  invalidate();
+  mark_dirty(Dirty::State);
+  return *this;
+}
+
+Table & Table::column_extent(usize column, f32 extent)
+{
+  CHECK(column < state_.columns.size(), "");
+  f64 const delta = (f64) extent - (state_.column_offsets[column + 1] -
+                                    state_.column_offsets[column]);
+
+  for (usize c = column + 1; c < state_.column_offsets.size(); c++)
+  {
+    state_.column_offsets[c] += delta;
+  }
+
+  invalidate();
+  mark_dirty(Dirty::Layout);
+  return *this;
+}
+
+Table & Table::frame(Frame frame)
+{
+  style_.frame = frame;
+  mark_dirty(Dirty::Layout);
+  return *this;
+}
+
+Table & Table::row_extent(f32 extent)
+{
+  style_.row_extent = extent;
+  mark_dirty(Dirty::Layout);
+  return *this;
 }
 
+Table & Table::header_extent(f32 extent)
+{
+  style_.header_extent = extent;
+  mark_dirty(Dirty::Layout);
+  return *this;
+}
+
+Table & Table::text_style(TextStyle const & style, FontStyle const & font)
+{
+  style_.text_style = style;
+  style_.font       = font;
+  invalidate();
+  mark_dirty(Dirty::State);
+  return *this;
+}
+
+Table & Table::sort(usize column, bool ascending)
+{
+  CHECK(column < state_.columns.size(), "");
+  permute(state_);
+
+  Column const & c = state_.columns[column];
+
+  indirect_stable_sort(state_.rows.view(), [&](u64 a, u64 b) {
+    return ascending ? cell_less(c, a, b) : cell_less(c, b, a);
+  });
+
+  invalidate();
+  mark_dirty(Dirty::State);
+  return *this;
+}
+
+Table & Table::filter(Filter filter)
+{
+  permute(state_);
+
+  usize num_shown = 0;
+
+  for (usize i = 0; i < state_.rows.size(); i++)
+  {
+    u64 const row = state_.rows[i];
+    if (filter(row))
+    {
+      state_.rows[num_shown++] = row;
+    }
+  }
+
+  state_.rows.resize_uninit(num_shown).unwrap();
+
+  invalidate();
+  mark_dirty(Dirty::Layout);
+  return *this;
+}
+
+Table & Table::reset_rows()
+{
+  state_.permuted = false;
+  state_.rows.clear();
+  invalidate();
+  mark_dirty(Dirty::Layout);
+  return *this;
+}
+
+void Table::invalidate()
+{
+  state_.generation++;
+}
+
+RenderText & Table::cell(u64 r, u64 c)
+{
+  u64 const row  = state_.row(r);
+  Cell &    cell = state_.cells[(r % state_.cache_rows) * state_.cache_columns +
+                              (c % state_.cache_columns)];
+
+  if (cell.row == row && cell.column == c &&
+      cell.generation == state_.generation)
+  {
+    return cell.text;
+  }
+
+  u8                buffer[CELL_BUFFER_SIZE];
+  FallbackAllocator allocator{Arena::from(buffer), allocator_};
+  Vec<c8>           text{allocator};
+
+  state_.formatter(state_.columns[c], row, text);
+
+  f32 const width =
+    (f32) (state_.column_offsets[c + 1] - state_.column_offsets[c]);
+
+  cell.text.text(text.view(), style_.text_style, style_.font).wrap(false);
+  cell.text.layout(max(width - 2 * style_.padding, 0.0F));
+  cell.row        = row;
+  cell.column     = c;
+  cell.generation = state_.generation;
+
+  return cell.text;
+}
+
+ui::State Table::tick(Ctx const &, Events const & events, Fn<void(View &)>)
+{
+  if (events.scroll())
+  {
+    auto info = events.scroll_info.unwrap();
+    for (u32 i = 0; i < 2; i++)
+    {
+      state_.scroll[i] = state_.origin[i] + info.center[i] -
+                         0.5 * state_.view_extent[i];
+    }
+    mark_dirty(Dirty::Layout);
+  }
+
+  f64 const width  = state_.column_offsets.last();
+  f64 const height = (f64) state_.size() * (f64) style_.row_extent;
+
+  state_.scroll[0] =
+    clamp(state_.scroll[0], 0.0, max(width - state_.view_extent[0], 0.0));
+  state_.scroll[1] =
+    clamp(state_.scroll[1], 0.0, max(height - state_.view_extent[1], 0.0));
+
+  return ui::State{.scrollable = true, .viewport = true};
+}
+
+Layout Table::fit(f32x2 allocated, Span<f32x2 const>, Span<f32x2>)
+{
+  f32x2 const extent = style_.frame(allocated);
+  f32x2 const view_extent{extent.x(),
+                          max(extent.y() - style_.header_extent, 0.0F)};
+
+  state_.view_extent = view_extent;
+
+  // the cache holds a slot for each cell that can be visible at once,
+  // including the partially visible rows and columns at both ends, so the
+  // visible cells never share a slot
+  u32 const cache_rows =
+    (style_.row_extent > 0) ?
+      ((u32) std::ceil(view_extent.y() / style_.row_extent) + 1) :
+      1;
+
+  u64 const num_columns   = state_.columns.size();
+  u64       cache_columns = 0;
+
+  for (u64 first = 0, last = 0; first < num_columns; first++)
+  {
+    while (last < num_columns && state_.column_offsets[last] <
+                                   state_.column_offsets[first] +
+                                     (f64) view_extent.x())
+    {
+      last++;
+    }
+    cache_columns = max(cache_columns, last - first + 2);
+  }
+
+  cache_columns = max(min(cache_columns, num_columns), (u64) 1);
+
+  if (cache_rows != state_.cache_rows || cache_columns != state_.cache_columns)
+  {
+    state_.cache_rows    = cache_rows;
+    state_.cache_columns = (u32) cache_columns;
+    state_.cells.clear();
+
+    for (u64 i = 0; i < (u64) cache_rows * cache_columns; i++)
+    {
+      state_.cells.push(Cell{.text = RenderText{allocator_}}).unwrap();
+    }
+  }
+
+  state_.origin[0] = 0;
+  state_.origin[1] = (f64) state_.visible_rows(style_.row_extent).begin() *
+                     (f64) style_.row_extent;
+
+  f64 const width  = state_.column_offsets.last();
+  f64 const height = (f64) state_.size() * (f64) style_.row_extent;
+
+  return {
+    .extent          = extent,
+    .viewport_extent = f32x2{(f32) width, (f32) height},
+    .viewport_center = f32x2{
+                       (f32) (state_.scroll[0] - state_.origin[0]) +
+                         0.5F * view_extent.x(),
+                       (f32) (state_.scroll[1] - state_.origin[1]) +
+                         0.5F * view_extent.y()}
+  };
+}
+
+void Table::render(Canvas & canvas, RenderInfo const & info)
+{
+  if (state_.cells.is_empty())
+  {
+    return;
+  }
+
+  Slice64 const rows      = state_.visible_rows(style_.row_extent);
+  Slice64 const columns   = state_.visible_columns();
+  f32x4x4 const transform = transform2d_to_3d(info.canvas_transform);
+  CRect const & region    = info.viewport_region;
+  f32x2 const   top_left  = region.center - 0.5F * region.extent;
+  f32 const     body_top  = top_left.y() + style_.header_extent;
+  f32 const     padding   = style_.padding;
+
+  auto column_width = [&](u64 c) {
+    return (f32) (state_.column_offsets[c + 1] - state_.column_offsets[c]);
+  };
+
+  // the cells are positioned relative to the scroll in f64, so they stay
+  // precise for very long tables
+  auto column_center = [&](u64 c) {
+    return top_left.x() +
+           (f32) (state_.column_offsets[c] - state_.scroll[0]) +
+           0.5F * column_width(c);
+  };
+
+  auto row_center = [&](u64 r) {
+    return body_top +
+           (f32) ((f64) r * (f64) style_.row_extent - state_.scroll[1]) +
+           0.5F * style_.row_extent;
+  };
+
+  CRect body{
+    .center = f32x2{region.center.x(),
+                    body_top + 0.5F * state_.view_extent.y()},
+    .extent = f32x2{region.extent.x(), state_.view_extent.y()}
+  };
+
+  CRect const body_clip = body.transform(info.canvas_transform)
+                            .intersect(info.clip);
+
+  for (u64 r = rows.begin(); r < rows.end(); r++)
+  {
+    CRect row{
+      .center = f32x2{region.center.x(), row_center(r)},
+      .extent = f32x2{region.extent.x(), style_.row_extent}
+    };
+
+    u8x4 const tint =
+      ((r & 1) != 0) ? style_.alternate_row_color : style_.row_color;
+
+    canvas.rrect({.area         = row.transform(info.canvas_transform),
+                  .corner_radii = f32x4::splat(0),
+                  .tint         = tint,
+                  .clip         = body_clip});
+
+    for (u64 c = columns.begin(); c < columns.end(); c++)
+    {
+      CRect cell{
+        .center = f32x2{column_center(c), row_center(r)},
+        .extent = f32x2{column_width(c), style_.row_extent}
+      };
+
+      this->cell(r, c).render(
+        canvas.text_renderer(), cell.center, cell.extent.x() - 2 * padding,
+        transform, cell.transform(info.canvas_transform).intersect(body_clip),
+        allocator_);
+    }
+  }
+
+  // the header row sticks to the top of the viewport, it scrolls only
+  // horizontally with the columns
+  CRect header{
+    .center = f32x2{region.center.x(),
+                    top_left.y() + 0.5F * style_.header_extent},
+    .extent = f32x2{region.extent.x(), style_.header_extent}
+  };
+
+  CRect const header_clip = header.transform(info.canvas_transform)
+                              .intersect(info.clip);
+
+  canvas.rrect({.area         = header.transform(info.canvas_transform),
+                .corner_radii = f32x4::splat(0),
+                .tint         = style_.header_color,
+                .clip         = info.clip});
+
+  if (state_.header_generation != state_.generation)
+  {
+    for (u64 c = 0; c < state_.columns.size(); c++)
+    {
+      Str8 const label =
+        (c < state_.headers.size()) ? state_.headers[c] : Str8{};
+      state_.header_texts[c]
+        .text(label, style_.text_style, style_.header_font)
+        .wrap(false);
+      state_.header_texts[c].layout(max(column_width(c) - 2 * padding, 0.0F));
+    }
+    state_.header_generation = state_.generation;
+  }
+
+  for (u64 c = columns.begin(); c < columns.end(); c++)
+  {
+    CRect label{
+      .center = f32x2{column_center(c), header.center.y()},
+      .extent = f32x2{column_width(c), style_.header_extent}
+    };
+
+    state_.header_texts[c].render(
+      canvas.text_renderer(), label.center, label.extent.x() - 2 * padding,
+      transform, label.transform(info.canvas_transform).intersect(header_clip),
+      allocator_);
+  }
+}
+
+}    // namespace ui
+
 }    // namespace ash
@@ -1,8 +1,11 @@
 /// SPDX-License-Identifier: MIT
 #pragma once
 
+#include "ashura/engine/render_text.h"
 #include "ashura/engine/view.h"
+#include "ashura/std/dataframe.h"
 #include "ashura/std/types.h"
+#include "ashura/std/vec.h"
 
 namespace ash
 {
@@ -10,11 +13,203 @@ namespace ash
 namespace ui
 {
 
-// [ ] implement
-// - coloring specific rows/columns/cells
-// - large columns and rows
+/// @brief Append the text of the `row`-th element of `column` to `text`.
+/// Bool, Uint, Int, and Float columns of up to 64 bits are formatted, as are
+/// Utf8 columns sliced by `Segments` (u64 offset and size pairs) or `Runs`
+/// (u64 run ends) in their `NULL_MASK_INDEX + 1`-th component. Null elements
+/// (set in the bit mask at the `NULL_MASK_INDEX`-th component) are left empty.
+void format_cell(experimental::df::ArrayInfo const & column, u64 row,
+                 Vec<c8> & text);
+
+/// @brief Compare the `a`-th and `b`-th elements of `column`, null elements
+/// order first.
+bool cell_less(experimental::df::ArrayInfo const & column, u64 a, u64 b);
+
+// [ ] coloring specific rows/columns/cells
+// [ ] column resizing and reordering by dragging the headers
+/// @brief A table over columnar data. The cells are not views: only the rows
+/// and columns within the viewport are culled, using the uniform row extent and
+/// the prefix sums of the column extents, and rendered. The text of the cells
+/// is shaped once as they scroll in and cached until they scroll out. The
+/// header row sticks to the top of the viewport. Sorting and filtering permute
+/// the indices of the rows; the columns are never copied or reordered.
 struct Table : View
 {
+  typedef experimental::df::ArrayInfo Column;
+
+  typedef Fn<void(Column const & column, u64 row, Vec<c8> & text)> Formatter;
+
+  /// @brief Returns true if the `row`-th row is shown
+  typedef Fn<bool(u64 row)> Filter;
+
+  static constexpr auto DEFAULT_FORMATTER =
+    [](Column const & column, u64 row, Vec<c8> & text) {
+      format_cell(column, row, text);
+    };
+
+  /// @brief Shaped text of a cell. The cache slot of the cell at row `r` and
+  /// column `c` of the display is at `(r % cache_rows, c % cache_columns)`, the
+  /// visible cells never share a slot.
+  struct Cell
+  {
+    u64 row = U64_MAX;
+
+    u64 column = U64_MAX;
+
+    u64 generation = 0;
+
+    RenderText text;
+  };
+
+  struct State
+  {
+    /// @brief The columns of the table, owned by the caller
+    Span<Column const> columns = {};
+
+    /// @brief The labels of the columns' headers, owned by the caller
+    Span<Str8 const> headers = {};
+
+    /// @brief Number of rows of the data, the size of the smallest column
+    u64 num_rows = 0;
+
+    /// @brief If the rows are shown in the order of `rows` instead of in the
+    /// order of the data
+    bool permuted = false;
+
+    /// @brief The data rows shown, in display order, if permuted
+    Vec<u64> rows;
+
+    /// @brief Offset of the start of each column and the extent of all the
+    /// columns at the end
+    Vec<f64> column_offsets;
+
+    /// @brief Content offset of the start of the viewport below the header
+    f64x2 scroll = {};
+
+    /// @brief Content offset the viewport center of the last layout is
+    /// relative to, so it stays precise for very long tables
+    f64x2 origin = {};
+
+    /// @brief Extent of the viewport below the header
+    f32x2 view_extent = {};
+
+    Formatter formatter = DEFAULT_FORMATTER;
+
+    /// @brief Incremented when the text of the cached cells is invalidated
+    u64 generation = 1;
+
+    Vec<Cell> cells;
+
+    u32 cache_rows = 0;
+
+    u32 cache_columns = 0;
+
+    Vec<RenderText> header_texts;
+
+    u64 header_generation = 0;
+
+    /// @brief Number of rows shown
+    u64 size() const
+    {
+      return permuted ? rows.size() : num_rows;
+    }
+
+    /// @brief The data row at display row `i`
+    u64 row(u64 i) const
+    {
+      return permuted ? rows[i] : i;
+    }
+
+    /// @brief The display rows within the viewport
+    Slice64 visible_rows(f32 row_extent) const;
+
+    /// @brief The columns within the viewport
+    Slice64 visible_columns() const;
+
+  } state_;
+
+  struct Style
+  {
+    Frame frame = Frame{}.rel(1, 1);
+
+    f32 row_extent = 24;
+
+    f32 header_extent = 32;
+
+    f32 column_extent = 120;
+
+    f32 padding = 8;
+
+    u8x4 header_color = theme.surface_variant;
+
+    u8x4 row_color = theme.surface;
+
+    u8x4 alternate_row_color = theme.background;
+
+    TextStyle text_style = TextStyle{.color = theme.on_surface};
+
+    FontStyle font = FontStyle{.font        = theme.body_font,
+                               .height      = theme.body_font_height,
+                               .line_height = theme.line_height,
+                               .fallbacks   = theme.body_font_fallbacks};
+
+    FontStyle header_font = FontStyle{.font        = theme.head_font,
+                                      .height      = theme.body_font_height,
+                                      .line_height = theme.line_height,
+                                      .fallbacks   = theme.body_font_fallbacks};
+  } style_;
+
+  Allocator allocator_;
+
+  Table(Allocator allocator = default_allocator);
+
+  Table(Table const &)             = delete;
+  Table(Table &&)                  = default;
+  Table & operator=(Table const &) = delete;
+  Table & operator=(Table &&)      = default;
+  virtual ~Table() override        = default;
+
+  /// @brief Bind the table to `columns`, the columns and the headers must
+  /// outlive the table or be re-bound. Shows all the rows in data order.
+  Table & columns(Span<Column const> columns, Span<Str8 const> headers);
+
+  Table & formatter(Formatter formatter);
+
+  Table & column_extent(usize column, f32 extent);
+
+  Table & frame(Frame frame);
+
+  Table & row_extent(f32 extent);
+
+  Table & header_extent(f32 extent);
+
+  Table & text_style(TextStyle const & style, FontStyle const & font);
+
+  /// @brief Stable-sort the shown rows by the elements of `column`. Sorting by
+  /// several columns in turn orders the rows by the last column, then by the
+  /// previous ones.
+  Table & sort(usize column, bool ascending = true);
+
+  /// @brief Show only the shown rows accepted by `filter`, in their order
+  Table & filter(Filter filter);
+
+  /// @brief Show all the rows in data order
+  Table & reset_rows();
+
+  virtual ui::State tick(Ctx const & ctx, Events const & events,
+                         Fn<void(View &)> build) override;
+
+  virtual Layout fit(f32x2 allocated, Span<f32x2 const> sizes,
+                     Span<f32x2> centers) override;
+
+  virtual void render(Canvas & canvas, RenderInfo const & info) override;
+
+  /// @brief Invalidate the shaped text of the cached cells
+  void invalidate();
+
+  /// @brief The shaped text of display row `r` and column `c`, shaping it if
+  /// it isn't cached
+  RenderText & cell(u64 r, u64 c);
 };
 
 }    // namespace ui
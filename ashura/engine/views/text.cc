@@ -227,6 +227,7 @@ Text::Text(Str32 t, TextStyle const & style, FontStyle const & font,
   text_{allocator},
   compositor_{TextCompositor::create(allocator)}
 {
+  retained_ = true;
   text(t).run(style, font);
 }
 
@@ -235,18 +236,21 @@ Text::Text(Str8 t, TextStyle const & style, FontStyle const & font,
   text_{allocator},
   compositor_{TextCompositor::create(allocator)}
 {
+  retained_ = true;
   text(t).run(style, font);
 }
 
 Text & Text::copyable(bool allow)
 {
   state_.copyable = allow;
+  mark_dirty(Dirty::State);
   return *this;
 }
 
 Text & Text::highlight_style(TextHighlightStyle highlight)
 {
   style_.highlight = highlight;
+  mark_dirty(Dirty::State);
   return *this;
 }
 
@@ -254,24 +258,27 @@ Text & Text::run(TextStyle const & style, FontStyle const & font, usize first,
                  usize count)
 {
   text_.run(style, font, first, count);
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Text & Text::text(Str32 t)
 {
   text_.text(t);
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
 Text & Text::text(Str8 t)
 {
   text_.text(t);
+  mark_dirty(Dirty::Layout);
   return *this;
 }
 
-Str32 Text::text() const
+void Text::get_text(Vec<c32> & out) const
 {
-  return text_.get_text();
+  text_.get_text(out);
 }
 
 ui::State Text::tick(Ctx const & ctx, Events const & events, Fn<void(View &)>)
@@ -291,6 +298,11 @@ ui::State Text::tick(Ctx const & ctx, Events const & events, Fn<void(View &)>)
     hit_info.viewport_region.extent.x, hit_info.canvas_hit,
     transform2d_to_3d(hit_info.canvas_transform), default_allocator);
 
+  if (cmd != TextCommand::None)
+  {
+    mark_dirty(Dirty::State);
+  }
+
   // [ ] copyable for input
   text_.clear_highlights()
     .add_highlight(compositor_.cursor().selection())
@@ -299,6 +311,11 @@ ui::State Text::tick(Ctx const & ctx, Events const & events, Fn<void(View &)>)
   return ui::State{.draggable = state_.copyable};
 }
 
+void Text::prefit(f32x2 allocated)
+{
+  text_.layout(allocated.x);
+}
+
 Layout Text::fit(f32x2 allocated, Span<f32x2 const>, Span<f32x2>)
 {
   text_.layout(allocated.x);
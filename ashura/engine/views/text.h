@@ -33,14 +33,16 @@ struct Text : View
        TextStyle const & style     = TextStyle{.color = theme.on_surface},
        FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                                .height      = theme.body_font_height,
-                                               .line_height = theme.line_height},
+                                               .line_height = theme.line_height,
+                                               .fallbacks   = theme.body_font_fallbacks},
        Allocator      allocator = default_allocator);
 
   Text(Str8              text,
        TextStyle const & style     = TextStyle{.color = theme.on_surface},
        FontStyle const & font      = FontStyle{.font        = theme.body_font,
                                                .height      = theme.body_font_height,
-                                               .line_height = theme.line_height},
+                                               .line_height = theme.line_height,
+                                               .fallbacks   = theme.body_font_fallbacks},
        Allocator      allocator = default_allocator);
 
   Text(Text const &)             = delete;
@@ -62,11 +64,14 @@ struct Text : View
 
   Text & text(Str8 text);
 
-  Str32 text() const;
+  /// @brief append the text's codepoints to `out`
+  void get_text(Vec<c32> & out) const;
 
   virtual ui::State tick(Ctx const & ctx, Events const & events,
                          Fn<void(View &)> build) override;
 
+  virtual void prefit(f32x2 allocated) override;
+
   virtual Layout fit(f32x2 allocated, Span<f32x2 const> sizes,
                      Span<f32x2> centers) override;
 
@@ -1112,6 +1112,45 @@ enum class ThreadId : u32
 ///
 typedef struct IScheduler * Scheduler;
 
+/// @brief Shared state of an `IScheduler::for_each` call
+/// @param next next index to be claimed
+/// @param done advanced by the number of indices whose calls have completed,
+/// it reaches stage `n` once all have completed
+struct ForEachState
+{
+  u64           n    = 0;
+  u64           next = 0;
+  ISemaphore    done = {};
+  Fn<void(u64)> fn   = {};
+
+  /// @brief claim and run indices until all have been claimed. `fn` is only
+  /// called for claimed indices, so this is safe to call after the caller of
+  /// `for_each` has returned.
+  void run()
+  {
+    u64 completed = 0;
+
+    while (true)
+    {
+      u64 const i =
+        std::atomic_ref{next}.fetch_add(1, std::memory_order_relaxed);
+
+      if (i >= n)
+      {
+        break;
+      }
+
+      fn(i);
+      completed++;
+    }
+
+    if (completed != 0)
+    {
+      (void) done.increment(completed);
+    }
+  }
+};
+
 struct SchedulerInfo
 {
   // thread-safe allocator to allocate tasks from, must be able to allocate page-sized allocations
@@ -1293,6 +1332,39 @@ struct IScheduler
         }},
       thread);
   }
+
+  /// @brief Call `fn(i)` for each `i` in `[0, n)` across the worker threads
+  /// and the calling thread, returning once all the calls have completed.
+  /// The calling thread claims indices too, so it always makes progress, even
+  /// when called from a worker thread or when the workers are busy. Once none
+  /// are left to claim, it blocks on a semaphore until the workers' calls have
+  /// completed.
+  /// @param allocator thread-safe allocator for the shared state
+  template <Callable<u64> F>
+  void for_each(u64 n, F && fn, Allocator allocator)
+  {
+    if (n == 0)
+    {
+      return;
+    }
+
+    Rc<ForEachState *> state =
+      rc<ForEachState>(inplace, allocator,
+                       ForEachState{.n = n, .next = 0, .done{}, .fn = &fn})
+        .unwrap();
+
+    u64 const num_tasks = min(n - 1, (u64) num_workers());
+
+    this->shard<ForEachState *>(
+      state.alias(), [](TaskInstance, ForEachState * s) { s->run(); },
+      num_tasks);
+
+    state->run();
+
+    // all the indices have been claimed, block until the calls claimed by the
+    // workers have completed
+    CHECK(state->done.await(n - 1, nanoseconds::max()), "");
+  }
 };
 
 extern Scheduler scheduler;
@@ -0,0 +1,114 @@
+/// SPDX-License-Identifier: MIT
+#include "ashura/std/text.h"
+#include "ashura/std/types.h"
+#include "ashura/std/vec.h"
+#include <benchmark/benchmark.h>
+
+using namespace ash;
+
+constexpr Str8 LATIN =
+  u8"Lorem ipsum dolor sit amet, consectetur adipiscing elit. Nullam "
+  u8"ultricies purus facilisis orci euismod eleifend. Pellentesque "
+  u8"bibendum pretium velit, à la façon de Zoë Ægir Øresund. "_str;
+
+constexpr Str8 ARABIC =
+  u8"العربية هي أكثر اللغات السامية تحدثاً، وإحدى أكثر اللغات انتشاراً في "
+  u8"العالم، يتحدثها أكثر من 467 مليون نسمة. "_str;
+
+constexpr Str8 CJK =
+  u8"天地玄黄，宇宙洪荒。日月盈昃，辰宿列张。寒来暑往，秋收冬藏。"
+  u8"いろはにほへと ちりぬるを わかよたれそ つねならむ。"
+  u8"한국어는 대한민국과 조선민주주의인민공화국의 공용어이다. "_str;
+
+constexpr Str8 CORPORA[] = {LATIN, ARABIC, CJK};
+
+/// @brief ~64KiB of repetitions of the corpus
+static Vec<c8> make_corpus(Str8 corpus)
+{
+  Vec<c8> text{default_allocator};
+  while (text.size() < 65'536)
+  {
+    text.extend(corpus).unwrap();
+  }
+  return text;
+}
+
+static void BM_Utf8Validate(benchmark::State & state)
+{
+  Vec<c8> const text = make_corpus(CORPORA[state.range(0)]);
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(is_valid_utf8(text.view()));
+  }
+
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+static void BM_Utf8Decode(benchmark::State & state)
+{
+  Vec<c8> const text = make_corpus(CORPORA[state.range(0)]);
+  Vec<c32>      decoded{default_allocator};
+  decoded.resize(text.size()).unwrap();
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(simd_utf8_decode(text.view(), decoded.view()));
+  }
+
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+/// @brief baseline: byte-by-byte decoding
+static void BM_Utf8DecodeScalar(benchmark::State & state)
+{
+  Vec<c8> const text = make_corpus(CORPORA[state.range(0)]);
+  Vec<c32>      decoded{default_allocator};
+  decoded.resize(text.size()).unwrap();
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(scalar_utf8_decode(text.view(), decoded.view()));
+  }
+
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+static void BM_Utf8Encode(benchmark::State & state)
+{
+  Vec<c32> decoded{default_allocator};
+  utf8_decode(make_corpus(CORPORA[state.range(0)]).view(), decoded).unwrap();
+  Vec<c8> encoded{default_allocator};
+  encoded.resize(decoded.size() * 4).unwrap();
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(simd_utf8_encode(decoded.view(), encoded.view()));
+  }
+
+  state.SetItemsProcessed(state.iterations() * decoded.size());
+}
+
+/// @brief baseline: codepoint-by-codepoint encoding
+static void BM_Utf8EncodeScalar(benchmark::State & state)
+{
+  Vec<c32> decoded{default_allocator};
+  utf8_decode(make_corpus(CORPORA[state.range(0)]).view(), decoded).unwrap();
+  Vec<c8> encoded{default_allocator};
+  encoded.resize(decoded.size() * 4).unwrap();
+
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(
+      scalar_utf8_encode(decoded.view(), encoded.view()));
+  }
+
+  state.SetItemsProcessed(state.iterations() * decoded.size());
+}
+
+// 0: Latin, 1: Arabic, 2: CJK
+BENCHMARK(BM_Utf8Validate)->DenseRange(0, 2);
+BENCHMARK(BM_Utf8Decode)->DenseRange(0, 2);
+BENCHMARK(BM_Utf8DecodeScalar)->DenseRange(0, 2);
+BENCHMARK(BM_Utf8Encode)->DenseRange(0, 2);
+BENCHMARK(BM_Utf8EncodeScalar)->DenseRange(0, 2);
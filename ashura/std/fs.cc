@@ -83,7 +83,7 @@ Result<Void, IoErr> write_to_file(Str path, Span<u8 const> buff, bool append)
   mem::copy(path, path_c_str.data());
   path_c_str.last() = '\0';
 
-  std::FILE * file = std::fopen(path_c_str.data(), append ? "a" : "w");
+  std::FILE * file = std::fopen(path_c_str.data(), append ? "ab" : "wb");
 
   if (file == nullptr)
   {
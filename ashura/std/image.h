@@ -13,6 +13,33 @@ constexpr u64 pixel_size_bytes(u32x2 extent, u32 bytes_per_pixel)
   return (u64) extent.x() * (u64) extent.y() * (u64) bytes_per_pixel;
 }
 
+/// @brief Number of levels in the full mip chain of an image of `extent`
+constexpr u32 num_mip_levels(u32x2 extent)
+{
+  return (extent.x() == 0 | extent.y() == 0) ? 0 : (extent.mips() + 1);
+}
+
+/// @brief Byte offset of mip `level` in a dense, level-major mip chain. Each
+/// level contains `layers` layers of its mip extent.
+constexpr u64 mip_offset_bytes(u32x2 extent, u32 layers, u32 bytes_per_pixel,
+                               u32 level)
+{
+  u64 offset = 0;
+  for (u32 i = 0; i < level; i++)
+  {
+    offset += pixel_size_bytes(extent.mip(i), bytes_per_pixel) * layers;
+  }
+  return offset;
+}
+
+/// @brief Size in bytes of a dense, level-major mip chain of `num_levels`
+/// levels
+constexpr u64 mip_chain_size_bytes(u32x2 extent, u32 layers,
+                                   u32 bytes_per_pixel, u32 num_levels)
+{
+  return mip_offset_bytes(extent, layers, bytes_per_pixel, num_levels);
+}
+
 /// @brief A dense, multi-channel, and row-major image span, format insensitive.
 /// @param stride number of pixels to skip to move from row i to row i+1
 /// i+1
@@ -184,4 +211,66 @@ void copy_RGB_to_BGRA(ImageSpan<T const, 3> src, ImageSpan<T, 4> dst, T A)
   }
 }
 
+/// @brief Downsample `src` into `dst` using a 2x2 box filter. `dst` is
+/// expected to be the next mip level of `src`. Odd edges are clamped.
+/// The inner loop is branch-free so it can be auto-vectorized.
+template <u32 C>
+void downsample_box(ImageSpan<u8 const, C> src, ImageSpan<u8, C> dst)
+{
+  if (src.is_empty() || dst.is_empty())
+  {
+    return;
+  }
+
+  u32 const last_x = src.extent.x() - 1;
+  u32 const last_y = src.extent.y() - 1;
+  u32 const width  = min(dst.extent.x(), src.extent.mip(1).x());
+  u32 const height = min(dst.extent.y(), src.extent.mip(1).y());
+
+  for (u32 y = 0; y < height; y++)
+  {
+    auto const * ASH_RESTRICT row0 =
+      src.channels.data() + (u64) min(y * 2, last_y) * src.pitch();
+    auto const * ASH_RESTRICT row1 =
+      src.channels.data() + (u64) min(y * 2 + 1, last_y) * src.pitch();
+    auto * ASH_RESTRICT out = dst.channels.data() + (u64) y * dst.pitch();
+
+    for (u32 x = 0; x < width; x++)
+    {
+      u32 const x0 = min(x * 2, last_x) * C;
+      u32 const x1 = min(x * 2 + 1, last_x) * C;
+#pragma unroll
+      for (u32 c = 0; c < C; c++)
+      {
+        u32 const sum = (u32) row0[x0 + c] + (u32) row0[x1 + c] +
+                        (u32) row1[x0 + c] + (u32) row1[x1 + c];
+        out[x * C + c] = (u8) ((sum + 2) >> 2);
+      }
+    }
+  }
+}
+
+/// @brief Generate levels [1, num_levels) of a dense, level-major mip chain
+/// whose level 0 has already been written to the start of `chain`.
+template <u32 C>
+void generate_mips(Span<u8> chain, u32x2 extent, u32 layers, u32 num_levels)
+{
+  for (u32 level = 1; level < num_levels; level++)
+  {
+    ImageLayerSpan<u8, C> src{
+      .channels = chain.slice(mip_offset_bytes(extent, layers, C, level - 1)),
+      .extent   = extent.mip(level - 1),
+      .layers   = layers};
+    ImageLayerSpan<u8, C> dst{
+      .channels = chain.slice(mip_offset_bytes(extent, layers, C, level)),
+      .extent   = extent.mip(level),
+      .layers   = layers};
+
+    for (u32 i = 0; i < layers; i++)
+    {
+      downsample_box<C>(src.layer(i), dst.layer(i));
+    }
+  }
+}
+
 }    // namespace ash
@@ -0,0 +1,459 @@
+/// SPDX-License-Identifier: MIT
+#pragma once
+#include "ashura/std/error.h"
+#include "ashura/std/tuple.h"
+#include "ashura/std/types.h"
+#include "ashura/std/vec.h"
+
+namespace ash
+{
+
+/// @brief A sequence stored as an ordered list of pieces of an append-only
+/// buffer. Inserted elements are appended to the buffer and never moved or
+/// modified, so the pieces of erased ranges remain valid and can be inserted
+/// again without copying (i.e. by undo/redo histories).
+///
+/// The pieces are kept in an implicit treap keyed by their position in the
+/// sequence, so inserting and erasing costs O(log n) in the number of pieces
+/// rather than shifting the tail of the sequence.
+///
+/// @param buffer_ append-only storage of all the elements ever inserted
+/// @param nodes_ treap nodes, one per piece
+/// @param free_ indices of the recycled nodes
+template <typename T>
+struct PieceTable
+{
+  static constexpr u32 NIL = U32_MAX;
+
+  /// @param piece range of the buffer holding the node's elements
+  /// @param size number of elements in the node's subtree
+  struct Node
+  {
+    Slice piece    = {};
+    usize size     = 0;
+    u32   priority = 0;
+    u32   left     = NIL;
+    u32   right    = NIL;
+  };
+
+  Vec<T> buffer_;
+
+  Vec<Node> nodes_;
+
+  Vec<u32> free_;
+
+  u32 root_;
+
+  /// @brief xorshift state for the node priorities
+  u32 seed_;
+
+  explicit PieceTable(Allocator allocator) :
+    buffer_{allocator},
+    nodes_{allocator},
+    free_{allocator},
+    root_{NIL},
+    seed_{0x9E37'79B9U}
+  {
+  }
+
+  PieceTable(PieceTable const &)             = delete;
+  PieceTable(PieceTable &&)                  = default;
+  PieceTable & operator=(PieceTable const &) = delete;
+  PieceTable & operator=(PieceTable &&)      = default;
+  ~PieceTable()                              = default;
+
+  usize size() const
+  {
+    return size_(root_);
+  }
+
+  bool is_empty() const
+  {
+    return root_ == NIL;
+  }
+
+  /// @brief remove all the elements and release the buffer. Invalidates all
+  /// the pieces.
+  void clear()
+  {
+    buffer_.clear();
+    nodes_.clear();
+    free_.clear();
+    root_ = NIL;
+  }
+
+  /// @brief get the elements of a piece
+  Span<T const> piece(Slice piece) const
+  {
+    return buffer_.view().slice(piece);
+  }
+
+  T const & operator[](usize index) const
+  {
+    CHECK(index < size(), "");
+    u32 t = root_;
+
+    while (true)
+    {
+      Node const & n         = nodes_[t];
+      usize const  left_size = size_(n.left);
+
+      if (index < left_size)
+      {
+        t = n.left;
+      }
+      else if (index < (left_size + n.piece.span))
+      {
+        return buffer_[n.piece.offset + (index - left_size)];
+      }
+      else
+      {
+        index -= left_size + n.piece.span;
+        t = n.right;
+      }
+    }
+  }
+
+  /// @brief call `fn(chunk)` on the contiguous chunks of the elements in
+  /// `range`, in order
+  template <typename F>
+  void chunks(Slice range, F && fn) const
+  {
+    range = range(size());
+    if (range.is_empty())
+    {
+      return;
+    }
+    chunks_(root_, 0, range, fn);
+  }
+
+  template <typename F>
+  void chunks(F && fn) const
+  {
+    chunks(Slice{0, USIZE_MAX}, fn);
+  }
+
+  /// @brief append the elements in `range` to `out`
+  Result<> read(Slice range, Vec<T> & out) const
+  {
+    range = range(size());
+
+    if (!out.reserve(out.size() + range.span))
+    {
+      return Err{};
+    }
+
+    chunks(range, [&](Span<T const> chunk) { out.extend(chunk).unwrap(); });
+
+    return Ok{};
+  }
+
+  /// @brief insert the elements at `pos`, appending them to the buffer
+  /// @returns the piece holding the inserted elements
+  Result<Slice, Void> insert(usize pos, Span<T const> data)
+  {
+    pos = min(pos, size());
+
+    usize const offset = buffer_.size();
+
+    if (!buffer_.extend(data))
+    {
+      return Err{};
+    }
+
+    Slice const piece{offset, data.size()};
+
+    if (piece.is_empty())
+    {
+      return Ok{piece};
+    }
+
+    // consecutive insertions (i.e. typing) extend the piece they were
+    // appended after instead of adding a piece each
+    if (pos != 0 && extend_(root_, pos, piece))
+    {
+      return Ok{piece};
+    }
+
+    if (!insert_pieces(pos, span({piece})))
+    {
+      buffer_.resize(offset).unwrap();
+      return Err{};
+    }
+
+    return Ok{piece};
+  }
+
+  /// @brief insert previously erased or inserted pieces at `pos`
+  Result<> insert_pieces(usize pos, Span<Slice const> pieces)
+  {
+    pos = min(pos, size());
+
+    if (!reserve_(pieces.size() + 1))
+    {
+      return Err{};
+    }
+
+    u32 mid = NIL;
+
+    for (Slice const & p : pieces)
+    {
+      if (!p.is_empty())
+      {
+        mid = merge_(mid, alloc_(p));
+      }
+    }
+
+    auto [left, right] = split_(root_, pos);
+    root_              = merge_(merge_(left, mid), right);
+
+    return Ok{};
+  }
+
+  /// @brief erase the elements in `range`
+  /// @param[out] erased the pieces of the erased elements are appended to it,
+  /// in order. They remain valid until the table is cleared.
+  Result<> erase(Slice range, Vec<Slice> & erased)
+  {
+    range = range(size());
+
+    if (range.is_empty())
+    {
+      return Ok{};
+    }
+
+    // at most one piece is split at each end of the range
+    if (!reserve_(2))
+    {
+      return Err{};
+    }
+
+    auto [left, rest] = split_(root_, range.offset);
+    auto [mid, right] = split_(rest, range.span);
+
+    Result<> result = collect_(mid, erased);
+
+    root_ = merge_(left, right);
+
+    return result;
+  }
+
+  usize size_(u32 t) const
+  {
+    return (t == NIL) ? 0 : nodes_[t].size;
+  }
+
+  void update_(u32 t)
+  {
+    Node & n = nodes_[t];
+    n.size   = size_(n.left) + n.piece.span + size_(n.right);
+  }
+
+  u32 next_priority_()
+  {
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+    return seed_;
+  }
+
+  /// @brief ensure `n` nodes can be allocated without failing, so the treap is
+  /// never left partially modified
+  Result<> reserve_(usize n)
+  {
+    if (free_.size() >= n)
+    {
+      return Ok{};
+    }
+
+    return nodes_.reserve(nodes_.size() + (n - free_.size()));
+  }
+
+  u32 alloc_(Slice piece)
+  {
+    Node const node{.piece    = piece,
+                    .size     = piece.span,
+                    .priority = next_priority_(),
+                    .left     = NIL,
+                    .right    = NIL};
+
+    if (!free_.is_empty())
+    {
+      u32 const t = free_.last();
+      free_.pop();
+      nodes_[t] = node;
+      return t;
+    }
+
+    u32 const t = (u32) nodes_.size();
+    nodes_.push(node).unwrap();
+    return t;
+  }
+
+  u32 merge_(u32 a, u32 b)
+  {
+    if (a == NIL)
+    {
+      return b;
+    }
+
+    if (b == NIL)
+    {
+      return a;
+    }
+
+    if (nodes_[a].priority > nodes_[b].priority)
+    {
+      u32 const right = merge_(nodes_[a].right, b);
+      nodes_[a].right = right;
+      update_(a);
+      return a;
+    }
+
+    u32 const left = merge_(a, nodes_[b].left);
+    nodes_[b].left = left;
+    update_(b);
+    return b;
+  }
+
+  /// @brief split the treap into the first `pos` elements and the rest,
+  /// splitting the piece containing `pos` if necessary
+  Tuple<u32, u32> split_(u32 t, usize pos)
+  {
+    if (t == NIL)
+    {
+      return {NIL, NIL};
+    }
+
+    usize const left_size = size_(nodes_[t].left);
+    Slice const piece     = nodes_[t].piece;
+
+    if (pos <= left_size)
+    {
+      auto [l, r]    = split_(nodes_[t].left, pos);
+      nodes_[t].left = r;
+      update_(t);
+      return {l, t};
+    }
+
+    if (pos >= (left_size + piece.span))
+    {
+      auto [l, r] = split_(nodes_[t].right, pos - left_size - piece.span);
+      nodes_[t].right = l;
+      update_(t);
+      return {t, r};
+    }
+
+    // split within the piece; the node keeps its head and its tail becomes
+    // the first node of the right treap
+    usize const head  = pos - left_size;
+    u32 const   right = nodes_[t].right;
+
+    nodes_[t].piece.span = head;
+    nodes_[t].right      = NIL;
+    update_(t);
+
+    u32 const tail = alloc_(Slice{piece.offset + head, piece.span - head});
+
+    return {t, merge_(tail, right)};
+  }
+
+  /// @brief extend the piece ending at `pos` with `piece` if it directly
+  /// precedes `piece` in the buffer
+  bool extend_(u32 t, usize pos, Slice piece)
+  {
+    if (t == NIL)
+    {
+      return false;
+    }
+
+    Node &      n         = nodes_[t];
+    usize const left_size = size_(n.left);
+    usize const end       = left_size + n.piece.span;
+
+    bool extended = false;
+
+    if (pos <= left_size)
+    {
+      extended = extend_(n.left, pos, piece);
+    }
+    else if (pos == end)
+    {
+      extended = n.piece.end() == piece.offset;
+      if (extended)
+      {
+        n.piece.span += piece.span;
+      }
+    }
+    else if (pos > end)
+    {
+      extended = extend_(n.right, pos - end, piece);
+    }
+
+    if (extended)
+    {
+      n.size += piece.span;
+    }
+
+    return extended;
+  }
+
+  /// @brief append the pieces of the treap to `out` in order and free its
+  /// nodes
+  Result<> collect_(u32 t, Vec<Slice> & out)
+  {
+    if (t == NIL)
+    {
+      return Ok{};
+    }
+
+    Node const n = nodes_[t];
+
+    Result<> result = collect_(n.left, out);
+
+    if (result && !out.push(n.piece))
+    {
+      result = Err{};
+    }
+
+    free_.push(t).unwrap();
+
+    Result<> right = collect_(n.right, out);
+
+    return result ? right : result;
+  }
+
+  template <typename F>
+  void chunks_(u32 t, usize offset, Slice range, F & fn) const
+  {
+    if (t == NIL)
+    {
+      return;
+    }
+
+    Node const & n           = nodes_[t];
+    usize const  piece_begin = offset + size_(n.left);
+    usize const  piece_end   = piece_begin + n.piece.span;
+
+    if (range.begin() < piece_begin)
+    {
+      chunks_(n.left, offset, range, fn);
+    }
+
+    usize const begin = max(range.begin(), piece_begin);
+    usize const end   = min(range.end(), piece_end);
+
+    if (begin < end)
+    {
+      fn(buffer_.view().slice(n.piece.offset + (begin - piece_begin),
+                              end - begin));
+    }
+
+    if (range.end() > piece_end)
+    {
+      chunks_(n.right, piece_end, range, fn);
+    }
+  }
+};
+
+}    // namespace ash
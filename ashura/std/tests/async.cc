@@ -63,3 +63,27 @@ TEST(AsyncTest, Basic)
 
   std::this_thread::sleep_for(500ms);
 }
+
+TEST(AsyncTest, ForEach)
+{
+  using namespace ash;
+
+  Dyn<Scheduler> sched =
+    IScheduler::create({}, std::this_thread::get_id(),
+                       span<nanoseconds>({1ns, 2ns}), span({2ns, 5ns}));
+
+  defer sched_{[&] { sched->shutdown(); }};
+
+  u64 counts[1'000] = {};
+
+  sched->for_each(
+    1'000, [&](u64 i) { std::atomic_ref{counts[i]}.fetch_add(1); }, {});
+
+  for (u64 count : counts)
+  {
+    EXPECT_EQ(count, 1);
+  }
+
+  // no calls, returns immediately
+  sched->for_each(0, [](u64) { ASSERT_TRUE(false); }, {});
+}
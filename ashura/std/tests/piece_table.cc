@@ -0,0 +1,104 @@
+/// SPDX-License-Identifier: MIT
+#include "gtest/gtest.h"
+
+#include "ashura/std/piece_table.h"
+#include "ashura/std/vec.h"
+
+using namespace ash;
+
+static Vec<int> flatten(PieceTable<int> const & t)
+{
+  Vec<int> out{default_allocator};
+  t.read(Slice{0, USIZE_MAX}, out).unwrap();
+  return out;
+}
+
+TEST(PieceTableTest, InsertErase)
+{
+  PieceTable<int> t{default_allocator};
+
+  ASSERT_TRUE(t.is_empty());
+  ASSERT_TRUE(t.insert(0, span({1, 2, 3, 4})));
+  ASSERT_TRUE(t.insert(2, span({7, 8})));
+  ASSERT_TRUE(t.insert(t.size(), span({9})));
+  ASSERT_EQ(t.size(), 7);
+  ASSERT_TRUE(mem::eq(flatten(t).view(), span({1, 2, 7, 8, 3, 4, 9})));
+  ASSERT_EQ(t[2], 7);
+  ASSERT_EQ(t[6], 9);
+
+  Vec<Slice> erased{default_allocator};
+  ASSERT_TRUE(t.erase(Slice{1, 3}, erased));
+  ASSERT_TRUE(mem::eq(flatten(t).view(), span({1, 3, 4, 9})));
+
+  Vec<int> erased_items{default_allocator};
+  for (Slice p : erased)
+  {
+    erased_items.extend(t.piece(p)).unwrap();
+  }
+  ASSERT_TRUE(mem::eq(erased_items.view(), span({2, 7, 8})));
+
+  // re-inserting the erased pieces restores the sequence without copying
+  ASSERT_TRUE(t.insert_pieces(1, erased));
+  ASSERT_TRUE(mem::eq(flatten(t).view(), span({1, 2, 7, 8, 3, 4, 9})));
+
+  t.clear();
+  ASSERT_TRUE(t.is_empty());
+  ASSERT_EQ(t.size(), 0);
+}
+
+TEST(PieceTableTest, Typing)
+{
+  PieceTable<int> t{default_allocator};
+
+  for (int i = 0; i < 1'000; i++)
+  {
+    ASSERT_TRUE(t.insert(t.size(), span({i})));
+  }
+
+  // consecutive insertions extend the same piece
+  ASSERT_EQ(t.nodes_.size(), 1);
+
+  usize chunks = 0;
+  t.chunks(Slice{10, 20}, [&](Span<int const> chunk) {
+    chunks++;
+    ASSERT_EQ(chunk.size(), 20);
+    ASSERT_EQ(chunk[0], 10);
+  });
+  ASSERT_EQ(chunks, 1);
+}
+
+TEST(PieceTableTest, Random)
+{
+  PieceTable<int> t{default_allocator};
+  Vec<int>        ref{default_allocator};
+  Vec<Slice>      erased{default_allocator};
+  u32             seed = 1;
+
+  auto rand = [&]() {
+    seed = seed * 1'664'525U + 1'013'904'223U;
+    return seed >> 8;
+  };
+
+  for (int i = 0; i < 2'000; i++)
+  {
+    usize const pos = ref.is_empty() ? 0 : (rand() % (ref.size() + 1));
+
+    if ((rand() % 3) != 0)
+    {
+      int const v[] = {i, i + 1, i + 2};
+      ASSERT_TRUE(t.insert(pos, span(v)));
+      ref.insert_span(pos, span(v)).unwrap();
+    }
+    else
+    {
+      usize const n = rand() % 8;
+      erased.clear();
+      ASSERT_TRUE(t.erase(Slice{pos, n}, erased));
+      ref.erase(Slice{pos, n}(ref.size()));
+    }
+
+    ASSERT_EQ(t.size(), ref.size());
+  }
+
+  ASSERT_TRUE(mem::eq(flatten(t).view(), ref.view()));
+}
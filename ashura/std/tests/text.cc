@@ -0,0 +1,57 @@
+/// SPDX-License-Identifier: MIT
+#include "gtest/gtest.h"
+
+#include "ashura/std/text.h"
+#include "ashura/std/vec.h"
+
+using namespace ash;
+
+TEST(TextTest, Utf8RoundTrip)
+{
+  // ASCII blocks interleaved with 2, 3, and 4-byte sequences that straddle
+  // the vector blocks
+  Str32 const text =
+    U"The quick brown fox jumps over the lazy dog. مرحبا بالعالم "
+    U"こんにちは世界 😀🚀 and some trailing ASCII to fill a few blocks"_str;
+
+  Vec<c8> encoded{default_allocator};
+  utf8_encode(text, encoded).unwrap();
+
+  Vec<c8> scalar_encoded{default_allocator};
+  scalar_encoded.resize(text.size() * 4).unwrap();
+  scalar_encoded
+    .resize(scalar_utf8_encode(text, scalar_encoded.view()))
+    .unwrap();
+
+  ASSERT_TRUE(mem::eq(encoded.view(), scalar_encoded.view()));
+  ASSERT_TRUE(is_valid_utf8(encoded.view()));
+
+  Vec<c32> decoded{default_allocator};
+  utf8_decode(encoded.view(), decoded).unwrap();
+
+  ASSERT_TRUE(mem::eq(decoded.view(), text));
+}
+
+TEST(TextTest, Utf8Validation)
+{
+  ASSERT_TRUE(is_valid_utf8(u8""_str));
+  ASSERT_TRUE(is_valid_utf8(u8"plain ASCII text spanning multiple blocks"_str));
+
+  c8 const overlong[]  = {'a', (c8) 0xC0, (c8) 0xAF};
+  c8 const surrogate[] = {(c8) 0xED, (c8) 0xA0, (c8) 0x80};
+  c8 const too_large[] = {(c8) 0xF4, (c8) 0x90, (c8) 0x80, (c8) 0x80};
+  c8 const truncated[] = {'a', 'b', (c8) 0xE3, (c8) 0x81};
+  c8 const stray[]     = {(c8) 0x80};
+
+  ASSERT_FALSE(is_valid_utf8(span(overlong)));
+  ASSERT_FALSE(is_valid_utf8(span(surrogate)));
+  ASSERT_FALSE(is_valid_utf8(span(too_large)));
+  ASSERT_FALSE(is_valid_utf8(span(truncated)));
+  ASSERT_FALSE(is_valid_utf8(span(stray)));
+
+  // truncated sequences decode to the replacement codepoint
+  Vec<c32> decoded{default_allocator};
+  utf8_decode(span(truncated), decoded).unwrap();
+  ASSERT_EQ(decoded.size(), 3);
+  ASSERT_EQ(decoded[2], 0xFFFD);
+}
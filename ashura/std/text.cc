@@ -0,0 +1,297 @@
+/// SPDX-License-Identifier: MIT
+#include "ashura/std/text.h"
+#include "ashura/std/cfg.h"
+#include "ashura/std/mem.h"
+
+#if ASH_CFG(ARCH, X86) || ASH_CFG(ARCH, X86_64)
+#  include <emmintrin.h>
+#  define ASH_TEXT_SSE2 1
+#elif ASH_CFG(ARCH, ARM64)
+#  include <arm_neon.h>
+#  define ASH_TEXT_NEON 1
+#endif
+
+namespace ash
+{
+
+/// @brief number of code units processed per vector iteration
+static constexpr usize BLOCK_SIZE = 16;
+
+static constexpr c32 REPLACEMENT_CODEPOINT = 0xFFFD;
+
+/// @brief check if the 16 bytes at `in` are all ASCII
+static inline bool is_ascii_block(c8 const * in)
+{
+#if ASH_TEXT_SSE2
+  __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in));
+  return _mm_movemask_epi8(v) == 0;
+#elif ASH_TEXT_NEON
+  uint8x16_t const v = vld1q_u8(reinterpret_cast<u8 const *>(in));
+  return vmaxvq_u8(v) < 0x80;
+#else
+  u64 w[2];
+  mem::copy(Span{in, BLOCK_SIZE}, reinterpret_cast<c8 *>(w));
+  return ((w[0] | w[1]) & 0x8080'8080'8080'8080ULL) == 0;
+#endif
+}
+
+/// @brief zero-extend 16 ASCII bytes at `in` to 16 codepoints at `out`
+static inline void widen_ascii_block(c8 const * in, c32 * out)
+{
+#if ASH_TEXT_SSE2
+  __m128i const zero = _mm_setzero_si128();
+  __m128i const v    = _mm_loadu_si128(reinterpret_cast<__m128i const *>(in));
+  __m128i const lo   = _mm_unpacklo_epi8(v, zero);
+  __m128i const hi   = _mm_unpackhi_epi8(v, zero);
+  __m128i *     dst  = reinterpret_cast<__m128i *>(out);
+  _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, zero));
+  _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+  _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+  _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+#elif ASH_TEXT_NEON
+  uint8x16_t const v  = vld1q_u8(reinterpret_cast<u8 const *>(in));
+  uint16x8_t const lo = vmovl_u8(vget_low_u8(v));
+  uint16x8_t const hi = vmovl_u8(vget_high_u8(v));
+  u32 *            dst = reinterpret_cast<u32 *>(out);
+  vst1q_u32(dst + 0, vmovl_u16(vget_low_u16(lo)));
+  vst1q_u32(dst + 4, vmovl_u16(vget_high_u16(lo)));
+  vst1q_u32(dst + 8, vmovl_u16(vget_low_u16(hi)));
+  vst1q_u32(dst + 12, vmovl_u16(vget_high_u16(hi)));
+#else
+  for (usize i = 0; i < BLOCK_SIZE; i++)
+  {
+    out[i] = static_cast<c32>(in[i]);
+  }
+#endif
+}
+
+/// @brief if the 16 codepoints at `in` are all ASCII, narrow them to 16 bytes
+/// at `out`
+static inline bool narrow_ascii_block(c32 const * in, c8 * out)
+{
+#if ASH_TEXT_SSE2
+  __m128i const * src = reinterpret_cast<__m128i const *>(in);
+  __m128i const   a   = _mm_loadu_si128(src + 0);
+  __m128i const   b   = _mm_loadu_si128(src + 1);
+  __m128i const   c   = _mm_loadu_si128(src + 2);
+  __m128i const   d   = _mm_loadu_si128(src + 3);
+  __m128i const   any =
+    _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+  __m128i const non_ascii = _mm_andnot_si128(_mm_set1_epi32(0x7F), any);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi32(non_ascii, _mm_setzero_si128())) !=
+      0xFFFF)
+  {
+    return false;
+  }
+  __m128i const v =
+    _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(out), v);
+  return true;
+#elif ASH_TEXT_NEON
+  u32 const *      src = reinterpret_cast<u32 const *>(in);
+  uint32x4_t const a   = vld1q_u32(src + 0);
+  uint32x4_t const b   = vld1q_u32(src + 4);
+  uint32x4_t const c   = vld1q_u32(src + 8);
+  uint32x4_t const d   = vld1q_u32(src + 12);
+  uint32x4_t const any = vorrq_u32(vorrq_u32(a, b), vorrq_u32(c, d));
+  if (vmaxvq_u32(any) >= 0x80)
+  {
+    return false;
+  }
+  uint16x8_t const lo = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+  uint16x8_t const hi = vcombine_u16(vmovn_u32(c), vmovn_u32(d));
+  vst1q_u8(reinterpret_cast<u8 *>(out),
+           vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+  return true;
+#else
+  c32 any = 0;
+  for (usize i = 0; i < BLOCK_SIZE; i++)
+  {
+    any |= in[i];
+  }
+  if (any >= 0x80)
+  {
+    return false;
+  }
+  for (usize i = 0; i < BLOCK_SIZE; i++)
+  {
+    out[i] = static_cast<c8>(in[i]);
+  }
+  return true;
+#endif
+}
+
+/// @brief length of the sequence started by the lead byte, 0 if it is not a
+/// valid lead byte
+static inline u32 utf8_sequence_size(c8 lead)
+{
+  u8 const c = static_cast<u8>(lead);
+  if (c < 0x80)
+  {
+    return 1;
+  }
+  if (c < 0xC2)
+  {
+    // continuation byte or overlong 2-byte sequence
+    return 0;
+  }
+  if (c < 0xE0)
+  {
+    return 2;
+  }
+  if (c < 0xF0)
+  {
+    return 3;
+  }
+  if (c < 0xF5)
+  {
+    return 4;
+  }
+  return 0;
+}
+
+static inline bool is_continuation(c8 c)
+{
+  return (static_cast<u8>(c) & 0xC0) == 0x80;
+}
+
+/// see: Unicode 15, Table 3-7. Well-Formed UTF-8 Byte Sequences
+static inline bool is_valid_utf8_sequence(c8 const * in, u32 size)
+{
+  u8 const c0 = static_cast<u8>(in[0]);
+
+  switch (size)
+  {
+    case 1:
+      return true;
+    case 2:
+      return is_continuation(in[1]);
+    case 3:
+    {
+      u8 const c1 = static_cast<u8>(in[1]);
+      // overlongs and surrogates
+      bool const c1_valid = (c0 == 0xE0) ? (c1 >= 0xA0 && c1 <= 0xBF) :
+                            (c0 == 0xED) ? (c1 >= 0x80 && c1 <= 0x9F) :
+                                           is_continuation(in[1]);
+      return c1_valid && is_continuation(in[2]);
+    }
+    case 4:
+    {
+      u8 const c1 = static_cast<u8>(in[1]);
+      // overlongs and codepoints above U+10FFFF
+      bool const c1_valid = (c0 == 0xF0) ? (c1 >= 0x90 && c1 <= 0xBF) :
+                            (c0 == 0xF4) ? (c1 >= 0x80 && c1 <= 0x8F) :
+                                           is_continuation(in[1]);
+      return c1_valid && is_continuation(in[2]) && is_continuation(in[3]);
+    }
+    default:
+      return false;
+  }
+}
+
+bool is_valid_utf8(Str8 text)
+{
+  c8 const * in  = text.pbegin();
+  c8 const * end = text.pend();
+
+  while (in != end)
+  {
+    if ((end - in) >= (isize) BLOCK_SIZE && is_ascii_block(in))
+    {
+      in += BLOCK_SIZE;
+      continue;
+    }
+
+    u32 const size = utf8_sequence_size(*in);
+
+    if (size == 0 || (end - in) < (isize) size ||
+        !is_valid_utf8_sequence(in, size))
+    {
+      return false;
+    }
+
+    in += size;
+  }
+
+  return true;
+}
+
+usize simd_utf8_decode(Str8 text, MutStr32 decoded)
+{
+  c8 const * in  = text.pbegin();
+  c8 const * end = text.pend();
+  c32 *      out = decoded.pbegin();
+
+  while (in != end)
+  {
+    if ((end - in) >= (isize) BLOCK_SIZE && is_ascii_block(in))
+    {
+      widen_ascii_block(in, out);
+      in += BLOCK_SIZE;
+      out += BLOCK_SIZE;
+      continue;
+    }
+
+    // decode the non-ASCII codepoints of the block one at a time, then
+    // resume the vector path
+    c8 const * block_end = in + min((usize) (end - in), BLOCK_SIZE);
+
+    while (in < block_end)
+    {
+      u32 const c0 = static_cast<u8>(*in);
+
+      if (c0 < 0x80)
+      {
+        *out++ = c0;
+        in++;
+        continue;
+      }
+
+      // the sequence size as decoded by `seek_utf8_codepoint`
+      u32 const size = ((c0 & 0xF8) == 0xF0) ? 4 :
+                       ((c0 & 0xF0) == 0xE0) ? 3 :
+                       ((c0 & 0xE0) == 0xC0) ? 2 :
+                                               1;
+
+      if ((end - in) < (isize) size)
+      {
+        *out++ = REPLACEMENT_CODEPOINT;
+        in     = end;
+        break;
+      }
+
+      *out++ = seek_utf8_codepoint(in).v0;
+    }
+  }
+
+  return out - decoded.pbegin();
+}
+
+usize simd_utf8_encode(Str32 text, MutStr8 encoded)
+{
+  c32 const * in  = text.pbegin();
+  c32 const * end = text.pend();
+  c8 *        out = encoded.pbegin();
+
+  while (in != end)
+  {
+    if ((end - in) >= (isize) BLOCK_SIZE && narrow_ascii_block(in, out))
+    {
+      in += BLOCK_SIZE;
+      out += BLOCK_SIZE;
+      continue;
+    }
+
+    c32 const * block_end = in + min((usize) (end - in), BLOCK_SIZE);
+
+    usize const n     = (usize) (block_end - in);
+    usize const count = scalar_utf8_encode(Str32{in, n}, MutStr8{out, n * 4});
+
+    in = block_end;
+    out += count;
+  }
+
+  return out - encoded.pbegin();
+}
+
+}    // namespace ash
@@ -9,7 +9,19 @@
 namespace ash
 {
 
-[[nodiscard]] constexpr bool is_valid_utf8(Str8 text);
+/// @brief Check if the text is well-formed UTF-8, rejecting overlong
+/// encodings, surrogates, codepoints above U+10FFFF, and truncated sequences.
+/// Vectorized, with a fast path for ASCII.
+[[nodiscard]] bool is_valid_utf8(Str8 text);
+
+/// @brief Vectorized `utf8_decode`, decodes 16 ASCII codepoints per
+/// iteration. Truncated sequences at the end of the text are decoded as
+/// U+FFFD.
+[[nodiscard]] usize simd_utf8_decode(Str8 text, MutStr32 decoded);
+
+/// @brief Vectorized `utf8_encode`, encodes 16 ASCII codepoints per
+/// iteration.
+[[nodiscard]] usize simd_utf8_encode(Str32 text, MutStr8 encoded);
 
 /// @brief Count number of utf8 codepoints found in the text. does no
 /// utf8-validation
@@ -43,7 +55,8 @@ template <typename Iter>
     iter++;
     c32 const c3 = static_cast<c32>(*iter);
     iter++;
-    return {((c0 & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((c2 & 0x3F) << 6) | c3,
+    return {((c0 & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((c2 & 0x3F) << 6) |
+              (c3 & 0x3F),
             4};
   }
   else if ((c0 & 0xF0) == 0xE0)
@@ -88,7 +101,7 @@ constexpr u8 codepoint_width(c32 c)
 }
 
 /// @brief `decoded.size()` must be at least `encoded.size()`
-[[nodiscard]] constexpr usize utf8_decode(Str8 text, MutStr32 decoded)
+[[nodiscard]] constexpr usize scalar_utf8_decode(Str8 text, MutStr32 decoded)
 {
   c8 const * in  = text.data();
   c8 const * end = text.pend();
@@ -104,7 +117,7 @@ constexpr u8 codepoint_width(c32 c)
 }
 
 /// @brief `encoded.size()` must be at least `text.size() * 4`
-[[nodiscard]] constexpr usize utf8_encode(Str32 text, MutStr8 encoded)
+[[nodiscard]] constexpr usize scalar_utf8_encode(Str32 text, MutStr8 encoded)
 {
   c8 *        out = encoded.data();
   c32 const * in  = text.data();
@@ -147,6 +160,26 @@ constexpr u8 codepoint_width(c32 c)
   return out - encoded.pbegin();
 }
 
+/// @brief `decoded.size()` must be at least `encoded.size()`
+[[nodiscard]] constexpr usize utf8_decode(Str8 text, MutStr32 decoded)
+{
+  if !consteval
+  {
+    return simd_utf8_decode(text, decoded);
+  }
+  return scalar_utf8_decode(text, decoded);
+}
+
+/// @brief `encoded.size()` must be at least `text.size() * 4`
+[[nodiscard]] constexpr usize utf8_encode(Str32 text, MutStr8 encoded)
+{
+  if !consteval
+  {
+    return simd_utf8_encode(text, encoded);
+  }
+  return scalar_utf8_encode(text, encoded);
+}
+
 /// @brief Converts UTF-8 text from @p encoded to UTF-32 and appends into @p
 /// `decoded`
 inline Result<> utf8_decode(Str8 text, Vec<c32> & decoded)